@@ -0,0 +1,33 @@
+// Helper process for RegJournalTest: commits a journaled batch and dies partway through
+// applying it, the way a crash would, leaving the record in the journal file.
+//
+// The test makes RegJournalKey\Volatile a volatile key before starting this program. A key
+// that is not volatile cannot be created below it, so the batch fails at that change after
+// the keys that sort before it have been written; the process then terminates itself
+// without unwinding, closing the journal or emptying it.
+#include <Windows.h>
+#include <string>
+#include "../registry_journal.h"
+
+int main(int argc, char* argv[])
+{
+	if (argc != 2)
+		return 2;
+
+	reg::journal journal(argv[1]);
+	for (DWORD i = 0; i < 4; i++)
+		journal.set<DWORD>(HKEY_CURRENT_USER, "RegJournalKey\\A" + std::to_string(i), "Value", i);
+	journal.set<DWORD>(HKEY_CURRENT_USER, "RegJournalKey\\Volatile\\Blocked", "Value", 4);
+	for (DWORD i = 0; i < 4; i++)
+		journal.set<DWORD>(HKEY_CURRENT_USER, "RegJournalKey\\Z" + std::to_string(i), "Value", 5 + i);
+
+	try
+	{
+		journal.commit();
+	}
+	catch (...)
+	{
+		TerminateProcess(GetCurrentProcess(), 3);
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry.h"
+#include <string>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegApi
+{
+	TEST_CLASS(Wide)
+	{
+	public:
+		TEST_METHOD(Unicode_Names_And_Data_Round_Trip)
+		{
+			const std::string key = u8"RegApiKey\\\u00C4rger \u03A9 \u043A\u043B\u044E\u0447";
+			const std::string name = u8"Gr\u00F6\u00DFe \U0001F600";
+			const std::string data = u8"\u6570\u636E \u00E9t\u00E9";
+
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApiKey");
+			reg::create::string(HKEY_CURRENT_USER, key, name, data);
+
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, key));
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, key, name) == data);
+
+			auto keys = reg::query::keys(HKEY_CURRENT_USER, "RegApiKey");
+			Assert::AreEqual(keys.size(), static_cast<size_t>(1));
+			Assert::IsTrue("RegApiKey\\" + keys[0] == key);
+
+			auto names = reg::query::value_names(HKEY_CURRENT_USER, key);
+			Assert::AreEqual(names.size(), static_cast<size_t>(1));
+			Assert::IsTrue(names[0] == name);
+
+			// sizes of strings are reported in UTF-8, terminator included
+			auto [type, size] = reg::peekvalue(HKEY_CURRENT_USER, key, name);
+			Assert::AreEqual(type, static_cast<DWORD>(REG_SZ));
+			Assert::AreEqual(size, data.size() + 1);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApiKey"));
+		}
+
+		TEST_METHOD(Long_Names_Use_The_Heap)
+		{
+			const std::string name(300, 'n');
+			const std::string data(5000, 'd');
+
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApiKey");
+			reg::create::string(HKEY_CURRENT_USER, "RegApiKey", name, data);
+
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegApiKey", name) == data);
+			Assert::IsTrue(reg::query::value_names(HKEY_CURRENT_USER, "RegApiKey")[0] == name);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApiKey"));
+		}
+
+		TEST_METHOD(Names_Need_Not_Be_Terminated)
+		{
+			const std::string text = "RegApiKeyTrailing";
+			const std::string_view key = std::string_view(text).substr(0, 9);
+
+			reg::remove::cluster(HKEY_CURRENT_USER, key);
+			reg::create::number(HKEY_CURRENT_USER, key, "Number", 7);
+
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, "RegApiKey"));
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, text));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, key));
+		}
+	};
+}
@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_apply.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegApply
+{
+	TEST_CLASS(Apply)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+		}
+
+		TEST_METHOD(Second_Apply_Changes_Nothing)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+
+			reg::spec desired;
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey\\One", "Number", 7);
+			desired.set<std::string>(HKEY_CURRENT_USER, "RegApplyKey\\One", "Text", "seven");
+			desired.set<std::vector<std::string>>(HKEY_CURRENT_USER, "RegApplyKey\\Two", "List", { "a", "b" });
+			desired.ensure_key(HKEY_CURRENT_USER, "RegApplyKey\\Empty");
+
+			reg::apply_result first = reg::apply(desired);
+			Assert::AreEqual(first.created, static_cast<size_t>(6)); // three keys, three values
+			Assert::AreEqual(first.updated, static_cast<size_t>(0));
+			Assert::AreEqual(first.unchanged, static_cast<size_t>(0));
+
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey\\One", "Number"), static_cast<DWORD>(7));
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegApplyKey\\One", "Text") == "seven");
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, "RegApplyKey\\Empty"));
+
+			reg::apply_result second = reg::apply(desired);
+			Assert::AreEqual(second.created, static_cast<size_t>(0));
+			Assert::AreEqual(second.updated, static_cast<size_t>(0));
+			Assert::AreEqual(second.removed, static_cast<size_t>(0));
+			Assert::AreEqual(second.unchanged, static_cast<size_t>(4));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey"));
+		}
+
+		TEST_METHOD(Only_Differences_Are_Written)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegApplyKey", "Same", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegApplyKey", "Changed", 1);
+			reg::create::string(HKEY_CURRENT_USER, "RegApplyKey", "Retyped", "1");
+			reg::create::number(HKEY_CURRENT_USER, "RegApplyKey", "Obsolete", 1);
+
+			reg::spec desired;
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "Same", 1);
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "Changed", 2);
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "Retyped", 1);
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "Added", 1);
+			desired.unset(HKEY_CURRENT_USER, "RegApplyKey", "Obsolete");
+			desired.unset(HKEY_CURRENT_USER, "RegApplyKey", "Never");
+
+			reg::apply_result result = reg::apply(desired);
+			Assert::AreEqual(result.created, static_cast<size_t>(1));
+			Assert::AreEqual(result.updated, static_cast<size_t>(2));
+			Assert::AreEqual(result.removed, static_cast<size_t>(1));
+			Assert::AreEqual(result.unchanged, static_cast<size_t>(2));
+
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey", "Changed"), static_cast<DWORD>(2));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey", "Retyped"), static_cast<DWORD>(1));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegApplyKey", "Obsolete"));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey"));
+		}
+
+		TEST_METHOD(Last_Entry_Wins_Across_Spellings)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+
+			reg::spec desired;
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "Value", 1);
+			desired.set<DWORD>(HKEY_CURRENT_USER, "REGAPPLYKEY", "value", 2);
+			desired.unset(HKEY_CURRENT_USER, "regapplykey", "Gone");
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey", "GONE", 3);
+
+			reg::apply_result result = reg::apply(desired);
+			Assert::AreEqual(result.created, static_cast<size_t>(3)); // the key and two values
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey", "Value"), static_cast<DWORD>(2));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey", "Gone"), static_cast<DWORD>(3));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey"));
+		}
+
+		TEST_METHOD(Removed_Keys_Go_First)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegApplyKey\\Old\\Deep", "Stale", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegApplyKey\\Reset", "Stale", 1);
+
+			reg::spec desired;
+			desired.set<DWORD>(HKEY_CURRENT_USER, "RegApplyKey\\Reset", "Fresh", 1);
+			desired.remove_key(HKEY_CURRENT_USER, "RegApplyKey\\Old");
+			desired.remove_key(HKEY_CURRENT_USER, "RegApplyKey\\Reset");
+			desired.remove_key(HKEY_CURRENT_USER, "RegApplyKey\\Missing");
+
+			reg::apply_result result = reg::apply(desired);
+			Assert::AreEqual(result.removed, static_cast<size_t>(2));
+			Assert::AreEqual(result.unchanged, static_cast<size_t>(1));
+			Assert::AreEqual(result.created, static_cast<size_t>(2)); // Reset again, and Fresh
+
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegApplyKey\\Old"));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegApplyKey\\Reset", "Stale"));
+			Assert::IsTrue(reg::value_exists(HKEY_CURRENT_USER, "RegApplyKey\\Reset", "Fresh"));
+
+			Assert::ExpectException<std::invalid_argument>([&desired] {
+				desired.remove_key(HKEY_CURRENT_USER, "");
+				});
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey"));
+		}
+
+		TEST_METHOD(Keys_Are_Applied_In_Parallel)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey");
+
+			reg::spec desired;
+			for (DWORD i = 0; i < 64; i++)
+			{
+				const std::string key = "RegApplyKey\\Key" + std::to_string(i);
+				desired.set<DWORD>(HKEY_CURRENT_USER, key, "Index", i);
+				desired.set<std::string>(HKEY_CURRENT_USER, key, "Name", key);
+			}
+
+			reg::apply_result first = reg::apply(desired, 8);
+			Assert::AreEqual(first.created, static_cast<size_t>(64 * 3));
+			for (DWORD i = 0; i < 64; i++)
+				Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegApplyKey\\Key" + std::to_string(i), "Index"), i);
+
+			reg::apply_result second = reg::apply(desired, 8);
+			Assert::AreEqual(second.unchanged, static_cast<size_t>(64 * 2));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegApplyKey"));
+		}
+	};
+}
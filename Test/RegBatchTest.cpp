@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_batch.h"
+#include <string>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegBatch
+{
+	TEST_CLASS(Batch)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey");
+		}
+
+		TEST_METHOD(Repeated_Writes_Collapse)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey");
+
+			reg::write_batch batch;
+			for (DWORD i = 0; i < 100; i++)
+				batch.set<DWORD>(HKEY_CURRENT_USER, "RegBatchKey", "Counter", i);
+			batch.set<std::string>(HKEY_CURRENT_USER, "regbatchkey", "COUNTER", "last");
+			batch.set<std::string>(HKEY_CURRENT_USER, "RegBatchKey\\Sub", "Counter", "other key");
+			Assert::AreEqual(batch.size(), static_cast<size_t>(2));
+
+			Assert::AreEqual(batch.commit(), static_cast<size_t>(2));
+			Assert::IsTrue(batch.empty());
+
+			// the last write decides the type as well as the data
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegBatchKey", "Counter") == "last");
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegBatchKey\\Sub", "Counter") == "other key");
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey"));
+		}
+
+		TEST_METHOD(Deletes_Replace_Writes_And_Back)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegBatchKey", "Old", 1);
+
+			reg::write_batch batch;
+			batch.set<DWORD>(HKEY_CURRENT_USER, "RegBatchKey", "Old", 2);
+			batch.remove(HKEY_CURRENT_USER, "RegBatchKey", "Old");
+			batch.remove(HKEY_CURRENT_USER, "RegBatchKey", "Revived");
+			batch.set<DWORD>(HKEY_CURRENT_USER, "RegBatchKey", "Revived", 3);
+			batch.remove(HKEY_CURRENT_USER, "RegBatchKey", "Never");
+			batch.remove(HKEY_CURRENT_USER, "RegBatchKey\\Missing", "Value");
+			Assert::AreEqual(batch.size(), static_cast<size_t>(4));
+
+			// the missing key is not created for a deletion
+			Assert::AreEqual(batch.commit(), static_cast<size_t>(1));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegBatchKey", "Old"));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegBatchKey", "Revived"), static_cast<DWORD>(3));
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegBatchKey\\Missing"));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey"));
+		}
+
+		TEST_METHOD(Clear_Drops_Everything)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey");
+
+			reg::write_batch batch;
+			batch.set<DWORD>(HKEY_CURRENT_USER, "RegBatchKey", "Value", 1);
+			batch.clear();
+			Assert::AreEqual(batch.commit(), static_cast<size_t>(0));
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegBatchKey"));
+
+			// the index is cleared with the operations
+			batch.set<DWORD>(HKEY_CURRENT_USER, "RegBatchKey", "Value", 2);
+			Assert::AreEqual(batch.size(), static_cast<size_t>(1));
+			batch.commit();
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegBatchKey", "Value"), static_cast<DWORD>(2));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchKey"));
+		}
+	};
+}
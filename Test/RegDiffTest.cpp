@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_diff.h"
+#include <sstream>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegDiff
+{
+	struct recorded
+	{
+		reg::difference::kind_t kind;
+		std::string path;
+		std::string name;
+	};
+
+	std::string dword(DWORD v)
+	{
+		return std::string(reinterpret_cast<const char*>(&v), sizeof(v));
+	}
+
+	reg::tree before()
+	{
+		reg::tree root;
+		root.create("Same\\Deep").set("Value", reg::types::dword, dword(1));
+		root.create("Changed").set("Kept", reg::types::dword, dword(2));
+		root.create("Changed").set("Modified", reg::types::dword, dword(3));
+		root.create("Changed").set("Removed", reg::types::binary, "x");
+		root.create("Gone\\Child").set("Value", reg::types::dword, dword(4));
+		return root;
+	}
+
+	reg::tree after()
+	{
+		reg::tree root;
+		root.create("same\\DEEP").set("value", reg::types::dword, dword(1));
+		root.create("Changed").set("Added", reg::types::binary, "y");
+		root.create("Changed").set("Kept", reg::types::dword, dword(2));
+		root.create("Changed").set("Modified", reg::types::qword, dword(3) + dword(0));
+		root.create("New\\Child").set("Value", reg::types::dword, dword(5));
+		return root;
+	}
+
+	TEST_CLASS(Diff)
+	{
+	public:
+		TEST_METHOD(Reports_Changes_In_Order)
+		{
+			reg::tree a = before();
+			reg::tree b = after();
+			reg::source::tree x(a);
+			reg::source::tree y(b);
+
+			std::vector<recorded> changes;
+			reg::diff(x, &a, y, &b, "Root", [&changes](const reg::difference& d) {
+				changes.push_back({ d.kind, std::string(d.path), std::string(d.name) });
+				});
+
+			Assert::AreEqual(changes.size(), static_cast<size_t>(7));
+			Assert::IsTrue(changes[0].kind == reg::difference::value_added && changes[0].name == "Added");
+			Assert::IsTrue(changes[1].kind == reg::difference::value_modified && changes[1].name == "Modified");
+			Assert::IsTrue(changes[2].kind == reg::difference::value_removed && changes[2].name == "Removed");
+			Assert::IsTrue(changes[3].kind == reg::difference::key_removed && changes[3].path == "Root\\Gone");
+			Assert::IsTrue(changes[4].kind == reg::difference::key_added && changes[4].path == "Root\\New");
+			Assert::IsTrue(changes[5].kind == reg::difference::key_added && changes[5].path == "Root\\New\\Child");
+			Assert::IsTrue(changes[6].kind == reg::difference::value_added && changes[6].name == "Value");
+		}
+
+		TEST_METHOD(Identical_Trees_Have_No_Changes)
+		{
+			reg::tree a = before();
+			reg::tree b = before();
+			reg::source::tree x(a);
+			reg::source::tree y(b);
+
+			size_t count = 0;
+			reg::diff(x, &a, y, &b, "", [&count](const reg::difference&) { ++count; });
+			Assert::AreEqual(count, static_cast<size_t>(0));
+		}
+
+		TEST_METHOD(Patch_Turns_First_Into_Second)
+		{
+			reg::tree a = before();
+			reg::tree b = after();
+			reg::source::tree x(a);
+			reg::source::tree y(b);
+
+			std::ostringstream out;
+			reg::diff_reg(x, &a, y, &b, "HKEY_CURRENT_USER\\Root", out, reg::file::encoding::UTF8);
+
+			reg::tree patched;
+			patched.create("HKEY_CURRENT_USER\\Root") = before();
+			std::istringstream in(out.str());
+			reg::file::tree_builder builder(patched);
+			reg::file::parse(in, builder);
+
+			reg::source::tree z(patched);
+			size_t count = 0;
+			reg::diff(z, patched.find("HKEY_CURRENT_USER\\Root"), y, &b, "", [&count](const reg::difference&) { ++count; });
+			Assert::AreEqual(count, static_cast<size_t>(0));
+			Assert::AreEqual(out.str().find("Same"), std::string::npos);
+		}
+	};
+
+	TEST_CLASS(Registry)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegDiffKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegDiffKey");
+		}
+
+		TEST_METHOD(Apply_Diff_To_Registry)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegDiffKey\\Changed", "Modified", 3);
+			reg::create::number(HKEY_CURRENT_USER, "RegDiffKey\\Gone\\Child", "Value", 4);
+
+			reg::tree desired = after();
+			reg::source::tree source(desired);
+			reg::apply_diff(HKEY_CURRENT_USER, "RegDiffKey", source, &desired);
+
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegDiffKey\\Gone"));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegDiffKey\\New\\Child", "Value"), static_cast<DWORD>(5));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegDiffKey\\Changed", "Kept"), static_cast<DWORD>(2));
+
+			reg::source::live live(HKEY_CURRENT_USER);
+			size_t count = 0;
+			reg::diff(live, *live.open("RegDiffKey"), source, &desired, "", [&count](const reg::difference&) { ++count; });
+			Assert::AreEqual(count, static_cast<size_t>(0));
+		}
+	};
+}
@@ -0,0 +1,410 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_file.h"
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegFile
+{
+	const char* const sample =
+		"Windows Registry Editor Version 5.00\r\n"
+		"\r\n"
+		"[HKEY_CURRENT_USER\\RegFileKey]\r\n"
+		"@=\"default\"\r\n"
+		"\"Path\"=\"C:\\\\Program Files\\\\\\\"Quoted\\\"\"\r\n"
+		"\"Count\"=dword:0000002a\r\n"
+		"\"Blob\"=hex:01,02,03,\\\r\n"
+		"  04,05\r\n"
+		"\"Big\"=hex(b):ff,00,00,00,00,00,00,00\r\n"
+		"\r\n"
+		"; comments are ignored\r\n"
+		"[HKEY_CURRENT_USER\\RegFileKey\\Child]\r\n"
+		"\"Inner\"=dword:00000001\r\n"
+		"\r\n"
+		"[-HKEY_CURRENT_USER\\RegFileKey\\Child]\r\n";
+
+	/// Feeds the sample in tiny chunks so that lines, escapes and continuations straddle them
+	reg::tree parse_in_chunks(std::string_view content, size_t chunk)
+	{
+		reg::tree root;
+		reg::file::tree_builder builder(root);
+		reg::file::parser<reg::file::tree_builder> parser(builder);
+		for (size_t i = 0; i < content.size(); i += chunk)
+			parser.feed(content.substr(i, chunk));
+		parser.finish();
+		return root;
+	}
+
+	TEST_CLASS(Parse)
+	{
+	public:
+		TEST_METHOD(Values_Are_Decoded)
+		{
+			for (size_t chunk : { 1, 3, 16, 4096 })
+			{
+				reg::tree root = parse_in_chunks(sample, chunk);
+
+				const reg::tree* key = root.find("HKEY_CURRENT_USER\\regfilekey");
+				Assert::IsNotNull(key);
+
+				Assert::AreEqual(reg::utf::from_utf16le(key->get("")->data).c_str(), "default");
+				Assert::AreEqual(reg::utf::from_utf16le(key->get("path")->data).c_str(), "C:\\Program Files\\\"Quoted\"");
+				Assert::AreEqual(key->get("Count")->type, reg::types::dword);
+				Assert::IsTrue(key->get("Count")->data == std::string("\x2a\0\0\0", 4));
+				Assert::IsTrue(key->get("Blob")->data == std::string("\1\2\3\4\5", 5));
+				Assert::AreEqual(key->get("Big")->type, reg::types::qword);
+				Assert::IsNull(key->find("Child"));
+			}
+		}
+
+		TEST_METHOD(Utf16_File)
+		{
+			std::u16string text = reg::utf::to_utf16(sample);
+			std::string content = "\xFF\xFE";
+			content.append(reinterpret_cast<const char*>(text.data()), text.size() * 2);
+
+			for (size_t chunk : { 1, 5, 4096 })
+			{
+				reg::tree root = parse_in_chunks(content, chunk);
+				Assert::IsNotNull(root.find("HKEY_CURRENT_USER\\RegFileKey"));
+			}
+		}
+
+		TEST_METHOD(Regedit4_Strings_Are_Widened)
+		{
+			reg::tree root = parse_in_chunks("REGEDIT4\n\n[HKCU\\A]\n\"e\"=hex(2):25,50,25,00\n", 4096);
+			const reg::value* value = root.find("HKCU\\A")->get("e");
+
+			Assert::AreEqual(value->type, reg::types::expand_sz);
+			Assert::AreEqual(reg::utf::from_utf16le(value->data).c_str(), "%P%");
+
+			// the bytes are in the ANSI code page, not UTF-8
+			root = parse_in_chunks("REGEDIT4\n\n[HKCU\\A]\n\"m\"=hex(7):e9,00,41,00,00\n", 4096);
+			value = root.find("HKCU\\A")->get("m");
+			wchar_t expected[5] = {};
+			Assert::AreEqual(MultiByteToWideChar(CP_ACP, 0, "\xE9\0A\0\0", 5, expected, 5), 5);
+			Assert::AreEqual(value->type, reg::types::multi_sz);
+			Assert::IsTrue(value->data == std::string(reinterpret_cast<const char*>(expected), sizeof(expected)));
+
+			// quoted strings, value names and key paths are in the same code page
+			root = parse_in_chunks("REGEDIT4\n\n[HKCU\\A]\n\"x\"=hex(2):43,61,66,e9,00\n\n[HKCU\\Caf\xE9]\n\"Caf\xE9\"=\"Caf\xE9\"\n", 4096);
+			const std::string cafe = reg::utf::from_utf16le(root.find("HKCU\\A")->get("x")->data);
+			Assert::IsTrue(cafe.size() > 3 && cafe.find("\xEF\xBF\xBD") == std::string::npos);
+			const reg::tree* key = root.find("HKCU\\" + cafe);
+			Assert::IsNotNull(key);
+			value = key->get(cafe);
+			Assert::IsNotNull(value);
+			Assert::AreEqual(value->type, reg::types::sz);
+			Assert::AreEqual(reg::utf::from_utf16le(value->data).c_str(), cafe.c_str());
+		}
+
+		TEST_METHOD(Malformed_Input)
+		{
+			Assert::ExpectException<reg::except::parse_error>([]() { parse_in_chunks("[HKCU\\A]\n", 4096); });
+			Assert::ExpectException<reg::except::parse_error>([]() { parse_in_chunks("REGEDIT4\n\"a\"=dword:1\n", 4096); });
+			Assert::ExpectException<reg::except::parse_error>([]() { parse_in_chunks("REGEDIT4\n[A]\n\"a\"=dword:xyz\n", 4096); });
+			Assert::ExpectException<reg::except::parse_error>([]() { parse_in_chunks("REGEDIT4\n[A]\n\"a=\"b\"\n", 4096); });
+		}
+	};
+
+	TEST_CLASS(Import)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegFileKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegFileKey");
+		}
+
+		TEST_METHOD(Import_Into_Registry)
+		{
+			std::istringstream in(sample);
+			reg::import_reg(in);
+
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, "RegFileKey"));
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegFileKey\\Child"));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegFileKey", "Count"), static_cast<DWORD>(42));
+			Assert::AreEqual(reg::query::string(HKEY_CURRENT_USER, "RegFileKey", "Path").c_str(), "C:\\Program Files\\\"Quoted\"");
+
+			auto [type, size] = reg::peekvalue(HKEY_CURRENT_USER, "RegFileKey", "Blob");
+			Assert::AreEqual(type, static_cast<DWORD>(REG_BINARY));
+			Assert::AreEqual(size, static_cast<size_t>(5));
+
+			std::istringstream removal(
+				"Windows Registry Editor Version 5.00\r\n"
+				"[HKEY_CURRENT_USER\\RegFileKey]\r\n"
+				"\"Count\"=-\r\n");
+			reg::import_reg(removal);
+
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegFileKey", "Count"));
+		}
+
+		TEST_METHOD(Hive_Root_Is_Not_Removed)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegFileKey", "Count", 1);
+
+			for (const char* line : { "[-HKEY_CURRENT_USER]\r\n", "[-HKCU\\]\r\n" })
+			{
+				std::istringstream removal(std::string("Windows Registry Editor Version 5.00\r\n") + line);
+				Assert::ExpectException<std::invalid_argument>([&removal]() { reg::import_reg(removal); });
+			}
+
+			Assert::IsTrue(reg::value_exists(HKEY_CURRENT_USER, "RegFileKey", "Count"));
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegFileKey"));
+		}
+	};
+
+	/// Assembles a minimal regf image: a base block followed by one bin of cells
+	class hive_builder
+	{
+	public:
+		hive_builder()
+		{
+			image.replace(0, 4, "regf");
+			image += "hbin";
+			image.append(28, '\0');
+		}
+
+		uint32_t value(const std::string& name, uint32_t type, const std::string& data)
+		{
+			std::string cell = "vk";
+			u16(cell, static_cast<uint16_t>(name.size()));
+			if (data.size() <= 4)
+			{
+				u32(cell, static_cast<uint32_t>(data.size()) | 0x80000000u);
+				std::string inline_data = data;
+				inline_data.resize(4);
+				cell += inline_data;
+			}
+			else
+			{
+				u32(cell, static_cast<uint32_t>(data.size()));
+				u32(cell, data.size() > 16344 ? big_data(data) : add(data));
+			}
+			u32(cell, type);
+			u16(cell, 1);
+			u16(cell, 0);
+			cell += name;
+			return add(cell);
+		}
+
+		uint32_t key(const std::string& name, const std::vector<uint32_t>& subkeys, const std::vector<uint32_t>& values)
+		{
+			uint32_t subkey_list = 0xFFFFFFFF;
+			uint32_t value_list = 0xFFFFFFFF;
+			if (!subkeys.empty())
+			{
+				std::string list = "lf";
+				u16(list, static_cast<uint16_t>(subkeys.size()));
+				for (uint32_t subkey : subkeys)
+				{
+					u32(list, subkey);
+					u32(list, 0);
+				}
+				subkey_list = add(list);
+			}
+			if (!values.empty())
+			{
+				std::string list;
+				for (uint32_t value : values)
+					u32(list, value);
+				value_list = add(list);
+			}
+
+			std::string cell = "nk";
+			u16(cell, 0x20);
+			for (uint32_t field : { 0u, 0u, 0u, 0u, static_cast<uint32_t>(subkeys.size()), 0u, subkey_list, 0xFFFFFFFFu,
+				static_cast<uint32_t>(values.size()), value_list, 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u, 0u, 0u, 0u })
+				u32(cell, field);
+			u16(cell, static_cast<uint16_t>(name.size()));
+			u16(cell, 0);
+			cell += name;
+
+			const uint32_t offset = add(cell);
+			for (uint32_t subkey : subkeys)
+				parent(subkey, offset);
+			return offset;
+		}
+
+		/// Sets the parent offset of a key node
+		void parent(uint32_t key, uint32_t offset)
+		{
+			std::memcpy(&image[4096 + key + 4 + 16], &offset, 4);
+		}
+
+		/// Points the first entry of a key's subkey list somewhere else
+		void relink(uint32_t key, uint32_t subkey)
+		{
+			uint32_t list = 0;
+			std::memcpy(&list, &image[4096 + key + 4 + 28], 4);
+			std::memcpy(&image[4096 + list + 4 + 4], &subkey, 4);
+		}
+
+		void root(uint32_t offset)
+		{
+			std::memcpy(&image[0x24], &offset, 4);
+		}
+
+		std::string image = std::string(4096, '\0');
+
+	private:
+		static void u16(std::string& out, uint16_t v) { out.append(reinterpret_cast<const char*>(&v), 2); }
+		static void u32(std::string& out, uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); }
+
+		uint32_t add(const std::string& data)
+		{
+			uint32_t offset = static_cast<uint32_t>(image.size() - 4096);
+			size_t length = (data.size() + 4 + 7) & ~size_t(7);
+			u32(image, static_cast<uint32_t>(-static_cast<int32_t>(length)));
+			image += data;
+			image.append(length - 4 - data.size(), '\0');
+			return offset;
+		}
+
+		uint32_t big_data(const std::string& data)
+		{
+			std::string segments;
+			for (size_t i = 0; i < data.size(); i += 16344)
+				u32(segments, add(data.substr(i, 16344)));
+
+			std::string cell = "db";
+			u16(cell, static_cast<uint16_t>(segments.size() / 4));
+			u32(cell, add(segments));
+			return add(cell);
+		}
+	};
+
+	TEST_CLASS(Export)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegFileExport");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegFileExport");
+		}
+
+		TEST_METHOD(Export_Hive_Round_Trip)
+		{
+			std::string text;
+			reg::utf::append_utf16le("C:\\Path \"quoted\"", text);
+			const std::string big(40000, 'z');
+
+			hive_builder builder;
+			uint32_t alpha = builder.key("Alpha", {}, {
+				builder.value("Str", REG_SZ, text),
+				builder.value("Num", REG_DWORD, std::string("\x2a\0\0\0", 4)),
+				builder.value("Big", REG_BINARY, big) });
+			uint32_t beta = builder.key("beta", {}, { builder.value("", REG_EXPAND_SZ, text) });
+			builder.root(builder.key("ROOT", { alpha, beta }, {}));
+
+			reg::hive::file hive(builder.image);
+			Assert::IsTrue(hive.open("ALPHA").has_value());
+			Assert::IsFalse(hive.open("Gamma").has_value());
+
+			for (auto encoding : { reg::file::encoding::UTF8, reg::file::encoding::UTF16LE })
+			{
+				std::ostringstream out;
+				reg::export_reg(hive, "", "HKEY_LOCAL_MACHINE\\SOFTWARE", out, encoding);
+
+				std::istringstream in(out.str());
+				reg::tree tree = reg::file::load(in);
+
+				const reg::tree* key = tree.find("HKEY_LOCAL_MACHINE\\SOFTWARE\\Alpha");
+				Assert::IsNotNull(key);
+				Assert::IsTrue(key->get("Str")->data == text);
+				Assert::IsTrue(key->get("Big")->data == big);
+				Assert::IsTrue(key->get("Num")->data == std::string("\x2a\0\0\0", 4));
+				Assert::AreEqual(tree.find("HKEY_LOCAL_MACHINE\\SOFTWARE\\beta")->get("")->type, reg::types::expand_sz);
+			}
+		}
+
+		TEST_METHOD(Control_Characters_Round_Trip)
+		{
+			std::string data;
+			reg::utf::append_utf16le("first\r\nsecond", data);
+			const std::string name("Line\nBreak \"and\" \r\\ null\0", 25);
+
+			for (auto encoding : { reg::file::encoding::UTF8, reg::file::encoding::UTF16LE })
+			{
+				std::string text;
+				auto sink = [&text](std::string_view bytes) { text.append(bytes.data(), bytes.size()); };
+				reg::file::writer<decltype(sink)> writer(sink, encoding);
+				writer.key("HKEY_CURRENT_USER\\RegFileKey");
+				writer.value(name, reg::types::sz, data);
+				writer.value("Plain", reg::types::sz, data);
+				writer.flush();
+
+				std::istringstream in(text);
+				reg::tree tree = reg::file::load(in);
+				const reg::tree* key = tree.find("HKEY_CURRENT_USER\\RegFileKey");
+				Assert::IsNotNull(key);
+				Assert::IsNotNull(key->get(name));
+				Assert::IsTrue(key->get(name)->data == data);
+				Assert::AreEqual(key->get("Plain")->type, reg::types::sz);
+				Assert::IsTrue(key->get("Plain")->data == data);
+			}
+		}
+
+		TEST_METHOD(Looping_Hive_Is_Rejected)
+		{
+			auto rejected = [](const std::string& image) {
+				Assert::ExpectException<reg::except::hive_error>([&image]() {
+					std::ostringstream ignored;
+					reg::export_reg(reg::hive::file(image), "", "HKEY_LOCAL_MACHINE", ignored);
+					});
+			};
+
+			hive_builder builder;
+			uint32_t placeholder = builder.key("Placeholder", {}, {});
+			uint32_t leaf = builder.key("Leaf", { placeholder }, {});
+			uint32_t child = builder.key("Child", { leaf }, {});
+			uint32_t root = builder.key("ROOT", { child }, {});
+			builder.root(root);
+
+			std::ostringstream out;
+			reg::export_reg(reg::hive::file(builder.image), "", "HKEY_LOCAL_MACHINE", out);
+
+			// the leaf lists one of its ancestors as a subkey
+			for (uint32_t ancestor : { root, child, leaf })
+			{
+				hive_builder looped = builder;
+				looped.relink(leaf, ancestor);
+				rejected(looped.image);
+			}
+
+			// the same key listed twice would be walked twice
+			hive_builder twice;
+			uint32_t once = twice.key("Once", {}, {});
+			twice.root(twice.key("ROOT", { once, once }, {}));
+			rejected(twice.image);
+		}
+
+		TEST_METHOD(Export_Registry_Round_Trip)
+		{
+			reg::create::string(HKEY_CURRENT_USER, "RegFileExport\\Child", "Name", "Some \"text\"");
+			reg::create::number(HKEY_CURRENT_USER, "RegFileExport", "Number", 7);
+
+			std::ostringstream out;
+			reg::export_reg(HKEY_CURRENT_USER, "RegFileExport", out);
+
+			std::istringstream in(out.str());
+			reg::tree tree = reg::file::load(in);
+
+			const reg::tree* key = tree.find("HKEY_CURRENT_USER\\RegFileExport");
+			Assert::IsNotNull(key);
+			Assert::IsTrue(key->get("Number")->data == std::string("\x07\0\0\0", 4));
+			Assert::AreEqual(reg::utf::from_utf16le(key->find("Child")->get("Name")->data).c_str(), "Some \"text\"");
+
+			Assert::ExpectException<reg::except::key_not_found>([]() {
+				std::ostringstream ignored;
+				reg::export_reg(HKEY_CURRENT_USER, "RegFileExport\\Missing", ignored);
+				});
+		}
+	};
+}
@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry.h"
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+// the Instrumented configuration of the test project defines REG_INSTRUMENT for every file
+#ifdef REG_INSTRUMENT
+namespace RegInstrument
+{
+	using reg::instrument::function;
+
+	TEST_CLASS(Instrumentation)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey");
+		}
+
+		TEST_METHOD(Calls_Are_Attributed_To_Operations)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegInstrumentKey", "Number", 7);
+
+			auto before = reg::instrument::collect();
+			Assert::AreEqual(reg::query::get<DWORD>(HKEY_CURRENT_USER, "RegInstrumentKey", "Number"), static_cast<DWORD>(7));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegInstrumentKey", "Missing"));
+			auto delta = reg::instrument::collect().since(before);
+
+			const auto* get = delta.operation("query::get");
+			Assert::IsNotNull(get);
+			Assert::AreEqual(get->count, static_cast<std::uint64_t>(1));
+			Assert::AreEqual(get->calls, static_cast<std::uint64_t>(1));
+			const auto* exists = delta.operation("value_exists");
+			Assert::IsNotNull(exists);
+			Assert::AreEqual(exists->count, static_cast<std::uint64_t>(1));
+
+			// every call was made from one of the two operations
+			Assert::AreEqual(delta.calls(), get->calls + exists->calls);
+			Assert::IsTrue(delta[function::get_value].calls >= 1);
+			Assert::IsTrue(delta[function::get_value].failures + delta[function::query_value].failures >= 1);
+
+			const std::string text = delta.text();
+			Assert::IsTrue(text.find("get_value") != std::string::npos);
+			Assert::IsTrue(text.find("value_exists") != std::string::npos);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey"));
+		}
+
+		TEST_METHOD(Buffer_Reads_Are_Attributed)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey");
+			reg::create::key(HKEY_CURRENT_USER, "RegInstrumentKey");
+			reg::update::set<std::vector<BYTE>>(HKEY_CURRENT_USER, "RegInstrumentKey", "Blob", { 1, 2, 3 });
+
+			auto before = reg::instrument::collect();
+			BYTE buffer[4] = {};
+			Assert::AreEqual(reg::query::get(HKEY_CURRENT_USER, "RegInstrumentKey", "Blob", buffer, sizeof(buffer)), static_cast<size_t>(3));
+			auto delta = reg::instrument::collect().since(before);
+
+			const auto* get = delta.operation("query::get");
+			Assert::IsNotNull(get);
+			Assert::AreEqual(get->count, static_cast<std::uint64_t>(1));
+			Assert::AreEqual(delta.calls(), get->calls);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey"));
+		}
+
+		TEST_METHOD(Threads_Are_Added_Up)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegInstrumentKey", "Number", 7);
+
+			auto before = reg::instrument::collect();
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+				threads.emplace_back([] {
+				for (int i = 0; i < 100; i++)
+					(void)reg::key_exists(HKEY_CURRENT_USER, "RegInstrumentKey");
+					});
+			for (std::thread& thread : threads)
+				thread.join();
+			auto delta = reg::instrument::collect().since(before);
+
+			// the threads have ended; their counts were kept
+			Assert::AreEqual(delta.operation("key_exists")->count, static_cast<std::uint64_t>(400));
+			Assert::AreEqual(delta[function::open_key].calls, static_cast<std::uint64_t>(400));
+			Assert::AreEqual(delta[function::open_key].latency.total(), static_cast<std::uint64_t>(400));
+			Assert::AreEqual(delta[function::open_key].failures, static_cast<std::uint64_t>(0));
+			Assert::IsTrue(delta[function::open_key].latency.percentile(0.5) <= delta[function::open_key].latency.percentile(0.99));
+			Assert::IsTrue(delta[function::open_key].total_ns > 0);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegInstrumentKey"));
+		}
+
+		TEST_METHOD(Histogram_Buckets)
+		{
+			using reg::instrument::histogram;
+			for (std::uint64_t ticks : { 0ull, 1ull, 7ull, 8ull, 15ull, 16ull, 100ull, 12345ull, 1ull << 40, ~0ull })
+			{
+				const size_t bucket = histogram::bucket(ticks);
+				Assert::IsTrue(bucket < histogram::buckets);
+				Assert::IsTrue(histogram::lowest(bucket) <= ticks);
+				if (bucket + 1 < histogram::buckets)
+					Assert::IsTrue(ticks < histogram::lowest(bucket + 1));
+				// within 1/8 of the true value
+				Assert::IsTrue(ticks - histogram::lowest(bucket) <= ticks / 8);
+			}
+		}
+	};
+}
+#endif
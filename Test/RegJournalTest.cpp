@@ -0,0 +1,252 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_journal.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegJournal
+{
+	const std::string filename = "RegJournalTest.journal";
+
+	void put32(std::string& out, std::uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			out.push_back(static_cast<char>(value >> (8 * i)));
+	}
+
+	std::uint32_t crc32(const std::string& bytes)
+	{
+		std::uint32_t crc = 0xFFFFFFFFu;
+		for (char b : bytes)
+		{
+			crc ^= static_cast<unsigned char>(b);
+			for (int k = 0; k < 8; ++k)
+				crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+		}
+		return ~crc;
+	}
+
+	/// <summary>The record a commit of two DWORD writes leaves in the file before it applies them</summary>
+	std::string pending_record()
+	{
+		std::string payload;
+		put32(payload, 2);
+		const char* names[] = { "First", "Second" };
+		for (std::uint32_t i = 0; i < 2; ++i)
+		{
+			const std::string key = i == 0 ? "RegJournalKey" : "RegJournalKey\\Sub";
+			payload.push_back(0);
+			put32(payload, 0x80000001u); // HKEY_CURRENT_USER
+			put32(payload, REG_DWORD);
+			put32(payload, static_cast<std::uint32_t>(key.size()));
+			put32(payload, static_cast<std::uint32_t>(std::string(names[i]).size()));
+			put32(payload, 4);
+			payload += key;
+			payload += names[i];
+			put32(payload, 10 + i);
+		}
+
+		std::string record = "RGJ1";
+		put32(record, static_cast<std::uint32_t>(payload.size()));
+		put32(record, crc32(payload));
+		return record + payload;
+	}
+
+	void write_file(const std::string& bytes)
+	{
+		std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	size_t file_size()
+	{
+		std::ifstream in(filename, std::ios::binary | std::ios::ate);
+		return static_cast<size_t>(in.tellg());
+	}
+
+	/// <summary>Runs JournalChild.exe, which is built next to this library, and returns its exit code</summary>
+	DWORD run_child(const std::string& arguments)
+	{
+		HMODULE module = nullptr;
+		GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+			reinterpret_cast<LPCSTR>(&run_child), &module);
+		char library[MAX_PATH] = {};
+		GetModuleFileNameA(module, library, MAX_PATH);
+		std::string directory(library);
+		directory.resize(directory.find_last_of('\\') + 1);
+
+		std::string command = "\"" + directory + "JournalChild.exe\" " + arguments;
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		PROCESS_INFORMATION process = {};
+		if (!CreateProcessA(NULL, &command[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup, &process))
+			throw std::runtime_error("Could not start " + command);
+
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD code = 0;
+		GetExitCodeProcess(process.hProcess, &code);
+		CloseHandle(process.hThread);
+		CloseHandle(process.hProcess);
+		return code;
+	}
+
+	TEST_CLASS(Journal)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			std::remove(filename.c_str());
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			std::remove(filename.c_str());
+		}
+
+		TEST_METHOD(Commit_Applies_In_Order)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			std::remove(filename.c_str());
+			reg::create::number(HKEY_CURRENT_USER, "RegJournalKey", "Gone", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Stale", 1);
+
+			{
+				reg::journal journal(filename);
+				Assert::AreEqual(journal.recovered(), static_cast<size_t>(0));
+
+				journal.set<DWORD>(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Early", 1);
+				journal.remove_key(HKEY_CURRENT_USER, "RegJournalKey\\Old");
+				journal.set<DWORD>(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Late", 2);
+				journal.set<std::string>(HKEY_CURRENT_USER, "RegJournalKey", "Text", "journaled");
+				journal.remove_value(HKEY_CURRENT_USER, "RegJournalKey", "Gone");
+				Assert::AreEqual(journal.commit(), static_cast<size_t>(5));
+				Assert::IsTrue(journal.empty());
+				Assert::AreEqual(file_size(), static_cast<size_t>(0));
+			}
+
+			// the key removal came after the first write and before the second
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Early"));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Stale"));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\Old", "Late"), static_cast<DWORD>(2));
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegJournalKey", "Text") == "journaled");
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegJournalKey", "Gone"));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey"));
+			std::remove(filename.c_str());
+		}
+
+		TEST_METHOD(Interrupted_Batch_Is_Replayed)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegJournalKey", "First", 99);
+			write_file(pending_record());
+
+			{
+				reg::journal journal(filename);
+				Assert::AreEqual(journal.recovered(), static_cast<size_t>(2));
+			}
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey", "First"), static_cast<DWORD>(10));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\Sub", "Second"), static_cast<DWORD>(11));
+			Assert::AreEqual(file_size(), static_cast<size_t>(0));
+
+			// replayed once only
+			reg::update::number(HKEY_CURRENT_USER, "RegJournalKey", "First", 99);
+			reg::journal again(filename);
+			Assert::AreEqual(again.recovered(), static_cast<size_t>(0));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey", "First"), static_cast<DWORD>(99));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey"));
+		}
+
+		TEST_METHOD(Killed_Commit_Is_Replayed)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			std::remove(filename.c_str());
+
+			// only the last key may be volatile; every key a single call creates gets the option
+			{
+				HKEY parent = nullptr, handle = nullptr;
+				reg::assert::success(reg::api::create_key(HKEY_CURRENT_USER, "RegJournalKey", KEY_ALL_ACCESS, &parent, NULL));
+				auto closer = reg::self_closing_handle(&parent);
+				reg::assert::success(RegCreateKeyExA(parent, "Volatile", 0, NULL, REG_OPTION_VOLATILE, KEY_ALL_ACCESS, NULL, &handle, NULL));
+				RegCloseKey(handle);
+			}
+
+			// the child writes the A keys, fails below the volatile key and terminates itself
+			Assert::AreEqual(run_child(filename), static_cast<DWORD>(3));
+			Assert::IsTrue(file_size() > 0);
+			for (DWORD i = 0; i < 4; i++)
+			{
+				Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\A" + std::to_string(i), "Value"), i);
+				Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegJournalKey\\Z" + std::to_string(i)));
+			}
+
+			// once the key is out of the way, opening the journal finishes the batch
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey\\Volatile"));
+			{
+				reg::journal journal(filename);
+				Assert::AreEqual(journal.recovered(), static_cast<size_t>(9));
+			}
+			Assert::AreEqual(file_size(), static_cast<size_t>(0));
+			for (DWORD i = 0; i < 4; i++)
+			{
+				Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\A" + std::to_string(i), "Value"), i);
+				Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\Z" + std::to_string(i), "Value"), 5 + i);
+			}
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegJournalKey\\Volatile\\Blocked", "Value"), static_cast<DWORD>(4));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey"));
+			std::remove(filename.c_str());
+		}
+
+		TEST_METHOD(Torn_Record_Is_Rolled_Back)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			std::string record = pending_record();
+			write_file(record.substr(0, record.size() - 3));
+
+			{
+				reg::journal journal(filename);
+				Assert::AreEqual(journal.recovered(), static_cast<size_t>(0));
+			}
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegJournalKey"));
+			Assert::AreEqual(file_size(), static_cast<size_t>(0));
+
+			// a flipped bit fails the checksum
+			record[record.size() - 1] ^= 1;
+			write_file(record);
+			{
+				reg::journal journal(filename);
+				Assert::AreEqual(journal.recovered(), static_cast<size_t>(0));
+			}
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegJournalKey"));
+
+			std::remove(filename.c_str());
+		}
+
+		TEST_METHOD(Only_Root_Keys_Are_Journaled)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegJournalKey", "Value", 1);
+
+			reg::journal journal(filename);
+			HKEY handle = nullptr;
+			reg::assert::success(reg::api::open_key(HKEY_CURRENT_USER, "RegJournalKey", KEY_SET_VALUE, &handle));
+			auto closer = reg::self_closing_handle(&handle);
+			Assert::ExpectException<std::invalid_argument>([&journal, handle] {
+				journal.set<DWORD>(handle, "", "Value", 2);
+				});
+			Assert::ExpectException<std::invalid_argument>([&journal] {
+				journal.remove_key(HKEY_CURRENT_USER, "\\");
+				});
+			Assert::IsTrue(journal.empty());
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegJournalKey"));
+		}
+	};
+}
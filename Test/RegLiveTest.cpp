@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_live.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegLive
+{
+	struct options
+	{
+		DWORD timeout = 30;
+		std::string user = "guest";
+	};
+}
+
+template<>
+struct reg::fields<RegLive::options>
+{
+	static constexpr auto list = std::make_tuple(
+		reg::bind("Timeout", &RegLive::options::timeout),
+		reg::bind("User", &RegLive::options::user));
+};
+
+namespace RegLive
+{
+	/// <summary>Lets the stamps of the last writes fall out of the window in which they are not trusted</summary>
+	void settle()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	}
+
+	TEST_CLASS(LiveConfig)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey");
+		}
+
+		TEST_METHOD(Missing_Key_Gives_Defaults)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey");
+
+			reg::live_config<options> config(HKEY_CURRENT_USER, "RegLiveKey", std::chrono::hours(1));
+			reg::live_config<options>::reader settings(config);
+			Assert::AreEqual(settings->timeout, static_cast<DWORD>(30));
+			Assert::IsTrue(settings->user == "guest");
+
+			reg::create::number(HKEY_CURRENT_USER, "RegLiveKey", "Timeout", 5);
+			Assert::IsTrue(config.refresh());
+			Assert::AreEqual(settings->timeout, static_cast<DWORD>(5));
+			Assert::IsTrue(settings->user == "guest");
+			Assert::AreEqual(config.version(), static_cast<std::uint64_t>(1));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey"));
+		}
+
+		TEST_METHOD(Old_Versions_Wait_For_Readers)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegLiveKey", "Timeout", 1);
+			reg::create::string(HKEY_CURRENT_USER, "RegLiveKey", "User", "first");
+			settle();
+
+			reg::live_config<options> config(HKEY_CURRENT_USER, "RegLiveKey", std::chrono::hours(1));
+			reg::live_config<options>::reader settings(config);
+			const options& first = *settings;
+
+			reg::update::number(HKEY_CURRENT_USER, "RegLiveKey", "Timeout", 2);
+			settle();
+			Assert::IsTrue(config.refresh());
+			Assert::AreEqual(settings->timeout, static_cast<DWORD>(2));
+
+			// the reader may still hold the first version
+			Assert::AreEqual(config.retained(), static_cast<size_t>(1));
+			Assert::AreEqual(first.timeout, static_cast<DWORD>(1));
+			Assert::IsTrue(first.user == "first");
+
+			// nothing written since the last load
+			settings.quiescent();
+			Assert::IsFalse(config.refresh());
+			Assert::AreEqual(config.retained(), static_cast<size_t>(0));
+			Assert::AreEqual(config.version(), static_cast<std::uint64_t>(1));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey"));
+		}
+
+		TEST_METHOD(Background_Refresh)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegLiveKey", "Timeout", 1);
+
+			reg::live_config<options> config(HKEY_CURRENT_USER, "RegLiveKey", std::chrono::milliseconds(10));
+			reg::live_config<options>::reader settings(config);
+			reg::update::number(HKEY_CURRENT_USER, "RegLiveKey", "Timeout", 2);
+
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (settings->timeout != 2 && std::chrono::steady_clock::now() < deadline)
+			{
+				settings.quiescent();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			Assert::AreEqual(settings->timeout, static_cast<DWORD>(2));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegLiveKey"));
+		}
+	};
+}
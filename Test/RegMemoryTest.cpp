@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_memory.h"
+#include "../registry_source.h"
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegMemory
+{
+	TEST_CLASS(Store)
+	{
+	public:
+		TEST_METHOD(Names_Are_Case_Insensitive)
+		{
+			reg::memory::store store;
+			auto key = store.create("Software\\Example");
+
+			Assert::IsTrue(store.open("SOFTWARE\\example") == key);
+			Assert::AreEqual(std::string(store.name(key)).c_str(), "Example");
+
+			store.set(key, "Value", reg::types::sz, std::string("a\0\0\0", 4));
+			store.set(key, "VALUE", reg::types::dword, std::string("\1\0\0\0", 4));
+			Assert::AreEqual(store.value_count(key), static_cast<size_t>(1));
+			Assert::AreEqual(store.get(key, "value")->type, reg::types::dword);
+			Assert::AreEqual(std::string(store.get(key, "value")->name).c_str(), "Value");
+
+			bool created = true;
+			Assert::IsTrue(store.create("software\\EXAMPLE", &created) == key);
+			Assert::IsFalse(created);
+		}
+
+		TEST_METHOD(Enumerate_By_Index)
+		{
+			reg::memory::store store;
+			auto key = store.create("Many");
+			for (int i = 0; i < 100; i++)
+			{
+				store.create(key, "Key" + std::to_string(i));
+				store.set(key, "Value" + std::to_string(i), reg::types::binary, std::string(i, 'x'));
+			}
+
+			Assert::AreEqual(store.subkey_count(key), static_cast<size_t>(100));
+			Assert::AreEqual(std::string(store.name(*store.subkey(key, 42))).c_str(), "Key42");
+			Assert::IsFalse(store.subkey(key, 100).has_value());
+			Assert::AreEqual(store.value(key, 42)->data.size(), static_cast<size_t>(42));
+			Assert::IsFalse(store.value(key, 100).has_value());
+
+			// removing an entry shifts the ones after it, like the registry does
+			Assert::IsTrue(store.remove(key, "key10"));
+			Assert::IsTrue(store.unset(key, "value10"));
+			Assert::AreEqual(std::string(store.name(*store.subkey(key, 10))).c_str(), "Key11");
+			Assert::AreEqual(std::string(store.value(key, 10)->name).c_str(), "Value11");
+			Assert::IsTrue(store.open("Many\\Key99").has_value());
+			Assert::IsTrue(store.get(key, "VALUE99").has_value());
+			Assert::IsFalse(store.get(key, "Value10").has_value());
+		}
+
+		TEST_METHOD(Removals_Keep_Order_And_Lookups)
+		{
+			reg::memory::store store;
+			auto key = store.create("Many");
+			std::vector<std::string> keys;
+			std::vector<std::string> values;
+
+			// a fixed pseudo-random mix of additions and removals, checked against plain vectors
+			std::uint32_t seed = 12345;
+			auto next = [&seed](std::uint32_t range) {
+				seed = seed * 1103515245u + 12345u;
+				return (seed >> 8) % range;
+			};
+			for (int step = 0, created = 0; step < 3000; step++)
+			{
+				if (keys.empty() || next(3) != 0)
+				{
+					const std::string name = "Entry" + std::to_string(created++);
+					store.create(key, name);
+					store.set(key, name, reg::types::binary, name);
+					keys.push_back(name);
+					values.push_back(name);
+				}
+				else
+				{
+					const size_t k = next(static_cast<std::uint32_t>(keys.size()));
+					Assert::IsTrue(store.remove(key, keys[k]));
+					Assert::IsFalse(store.child(key, keys[k]).has_value());
+					keys.erase(keys.begin() + k);
+					const size_t v = next(static_cast<std::uint32_t>(values.size()));
+					Assert::IsTrue(store.unset(key, values[v]));
+					Assert::IsFalse(store.get(key, values[v]).has_value());
+					values.erase(values.begin() + v);
+				}
+
+				if (step % 97 == 0 || keys.size() < 12)
+				{
+					Assert::AreEqual(store.subkey_count(key), keys.size());
+					Assert::AreEqual(store.value_count(key), values.size());
+					for (size_t i = 0; i < keys.size(); i++)
+					{
+						Assert::AreEqual(std::string(store.name(*store.subkey(key, i))).c_str(), keys[i].c_str());
+						Assert::IsTrue(store.child(key, keys[i]).has_value());
+					}
+					for (size_t i = 0; i < values.size(); i++)
+					{
+						Assert::AreEqual(std::string(store.value(key, i)->name).c_str(), values[i].c_str());
+						Assert::IsTrue(store.get(key, values[i])->data == values[i]);
+					}
+				}
+			}
+
+			Assert::IsFalse(store.subkey(key, keys.size()).has_value());
+			Assert::IsFalse(store.value(key, values.size()).has_value());
+		}
+
+		TEST_METHOD(Remove_Subtree)
+		{
+			reg::memory::store store;
+			store.create("A\\B\\C");
+			store.set(store.create("A\\B"), "Data", reg::types::binary, std::string(1000, 'd'));
+			store.create("A\\D");
+
+			Assert::AreEqual(store.size(), static_cast<size_t>(5));
+			Assert::IsTrue(store.remove("a\\b"));
+			Assert::IsFalse(store.remove("A\\B"));
+			Assert::IsFalse(store.remove(""));
+			Assert::AreEqual(store.size(), static_cast<size_t>(3));
+			Assert::IsFalse(store.open("A\\B\\C").has_value());
+
+			// ids of removed keys are reused
+			auto again = store.create("A\\B");
+			Assert::IsFalse(store.get(again, "Data").has_value());
+			Assert::AreEqual(store.subkey_count(again), static_cast<size_t>(0));
+		}
+
+		TEST_METHOD(Overwritten_Data_Is_Reclaimed)
+		{
+			reg::memory::store store;
+			auto key = store.create("Key");
+			const std::string big(1 << 16, 'b');
+			for (int i = 0; i < 100; i++)
+				store.set(key, "Big", reg::types::binary, big + std::to_string(i));
+
+			Assert::IsTrue(store.get(key, "big")->data == big + "99");
+		}
+
+		TEST_METHOD(Last_Write_Moves_Forward)
+		{
+			reg::memory::store store;
+			auto key = store.create("Key");
+			auto before = store.last_write(key);
+
+			store.set(key, "Value", reg::types::binary, "x");
+			Assert::IsTrue(store.last_write(key) > before);
+
+			auto parent = store.last_write(store.root());
+			store.create("Other");
+			Assert::IsTrue(store.last_write(store.root()) > parent);
+		}
+
+		TEST_METHOD(Walk_As_Tree_Source)
+		{
+			reg::memory::store store;
+			store.set(store.create("b"), "v", reg::types::binary, "1");
+			store.create("A\\C");
+
+			struct collector
+			{
+				std::vector<std::string> keys;
+				void key(std::string_view path) { keys.emplace_back(path); }
+				void value(std::string_view, std::uint32_t, std::string_view) {}
+			} handler;
+
+			reg::source::walk(store, store.root(), "Root", handler);
+			Assert::AreEqual(handler.keys.size(), static_cast<size_t>(4));
+			Assert::AreEqual(handler.keys[1].c_str(), "Root\\A");
+			Assert::AreEqual(handler.keys[2].c_str(), "Root\\A\\C");
+			Assert::AreEqual(handler.keys[3].c_str(), "Root\\b");
+		}
+	};
+}
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_merkle.h"
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegMerkle
+{
+	using changes = std::vector<std::pair<std::string, reg::merkle::change>>;
+
+	reg::tree sample()
+	{
+		reg::tree root;
+		for (int i = 0; i < 50; i++)
+		{
+			reg::tree& key = root.create("Group" + std::to_string(i % 5) + "\\Key" + std::to_string(i));
+			key.set("Index", reg::types::dword, std::string(reinterpret_cast<const char*>(&i), 4));
+			key.set("Name", reg::types::binary, "key" + std::to_string(i));
+		}
+		return root;
+	}
+
+	reg::merkle::index hash(const reg::tree& root)
+	{
+		reg::source::tree source(root);
+		reg::merkle::index index;
+		index.update(source, &root);
+		return index;
+	}
+
+	changes compare(const reg::merkle::index& a, const reg::merkle::index& b)
+	{
+		changes found;
+		reg::merkle::compare(a, b, [&found](std::string_view path, reg::merkle::change kind) {
+			found.emplace_back(std::string(path), kind);
+			});
+		return found;
+	}
+
+	TEST_CLASS(Hashing)
+	{
+	public:
+		TEST_METHOD(Equal_Trees_Have_Equal_Hashes)
+		{
+			reg::tree a = sample();
+			reg::tree b = sample();
+			Assert::AreEqual(hash(a).root(), hash(b).root());
+			Assert::IsTrue(compare(hash(a), hash(b)).empty());
+
+			// value order does not matter, value contents do
+			b.find("Group1\\Key1")->unset("Index");
+			Assert::AreNotEqual(hash(a).root(), hash(b).root());
+			int one = 1;
+			b.find("Group1\\Key1")->set("Index", reg::types::dword, std::string(reinterpret_cast<const char*>(&one), 4));
+			Assert::AreEqual(hash(a).root(), hash(b).root());
+		}
+
+		TEST_METHOD(Compare_Descends_Into_Changes_Only)
+		{
+			reg::tree a = sample();
+			reg::tree b = sample();
+			b.find("Group2\\Key7")->set("Name", reg::types::binary, "changed");
+			b.remove("Group3\\Key8");
+			b.create("Group4\\Key99\\Deep");
+
+			changes found = compare(hash(a), hash(b));
+			Assert::AreEqual(found.size(), static_cast<size_t>(3));
+			Assert::AreEqual(found[0].first.c_str(), "Group2\\Key7");
+			Assert::IsTrue(found[0].second == reg::merkle::change::modified);
+			Assert::AreEqual(found[1].first.c_str(), "Group3\\Key8");
+			Assert::IsTrue(found[1].second == reg::merkle::change::removed);
+			Assert::AreEqual(found[2].first.c_str(), "Group4\\Key99");
+			Assert::IsTrue(found[2].second == reg::merkle::change::added);
+		}
+
+		TEST_METHOD(Update_Tracks_Changes)
+		{
+			reg::tree root = sample();
+			reg::source::tree source(root);
+			reg::merkle::index index;
+			index.update(source, &root);
+			reg::merkle::index before = index;
+
+			root.remove("Group0");
+			index.update(source, &root);
+			Assert::AreEqual(index.root(), hash(root).root());
+			Assert::IsNull(index.find("Group0"));
+			Assert::IsNotNull(index.find("group1\\KEY1"));
+			Assert::AreEqual(compare(before, index).size(), static_cast<size_t>(1));
+		}
+
+		TEST_METHOD(Save_And_Load)
+		{
+			reg::merkle::index index = hash(sample());
+
+			std::stringstream stream;
+			index.save(stream);
+			reg::merkle::index loaded = reg::merkle::index::load(stream);
+
+			Assert::AreEqual(loaded.root(), index.root());
+			Assert::AreEqual(loaded.find("Group3\\Key13")->subtree, index.find("Group3\\Key13")->subtree);
+
+			std::istringstream truncated(stream.str().substr(0, 40));
+			Assert::ExpectException<std::runtime_error>([&truncated]() { reg::merkle::index::load(truncated); });
+		}
+
+		TEST_METHOD(Corrupt_Counts_Are_Truncation)
+		{
+			std::stringstream stream;
+			hash(sample()).save(stream);
+			const std::string bytes = stream.str();
+
+			// the root name length follows the 16 byte header, its child count ends the root entry
+			std::string name = bytes;
+			name.replace(16, 4, "\xF0\xFF\xFF\xFF");
+			std::istringstream bad_name(name);
+			Assert::ExpectException<std::runtime_error>([&bad_name]() { reg::merkle::index::load(bad_name); });
+
+			std::string children = bytes;
+			children.replace(16 + 4 + 24, 4, "\xF0\xFF\xFF\xFF");
+			std::istringstream bad_children(children);
+			Assert::ExpectException<std::runtime_error>([&bad_children]() { reg::merkle::index::load(bad_children); });
+		}
+	};
+
+	TEST_CLASS(Registry)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMerkleKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMerkleKey");
+		}
+
+		TEST_METHOD(Detect_Drift)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegMerkleKey\\A", "Number", 1);
+			reg::create::string(HKEY_CURRENT_USER, "RegMerkleKey\\B", "Name", "text");
+
+			reg::merkle::index index;
+			index.update(HKEY_CURRENT_USER, "RegMerkleKey");
+			reg::merkle::index baseline = index;
+
+			index.update(HKEY_CURRENT_USER, "RegMerkleKey");
+			Assert::AreEqual(index.root(), baseline.root());
+
+			reg::update::number(HKEY_CURRENT_USER, "RegMerkleKey\\A", "Number", 2);
+			index.update(HKEY_CURRENT_USER, "RegMerkleKey");
+
+			changes found = compare(baseline, index);
+			Assert::AreEqual(found.size(), static_cast<size_t>(1));
+			Assert::AreEqual(found[0].first.c_str(), "A");
+			Assert::IsTrue(found[0].second == reg::merkle::change::modified);
+		}
+	};
+}
@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_mirror.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegMirror
+{
+	/// <summary>Lets the stamps of the last writes fall out of the window in which they are not trusted</summary>
+	void settle()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	}
+
+	TEST_CLASS(Mirror)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey");
+		}
+
+		TEST_METHOD(Details)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegMirrorKey", "Number", 1);
+			reg::create::string(HKEY_CURRENT_USER, "RegMirrorKey", "Name", "twelve bytes");
+			reg::create::number(HKEY_CURRENT_USER, "RegMirrorKey\\Sub", "Number", 1);
+
+			reg::key_details details = reg::query::details(HKEY_CURRENT_USER, "RegMirrorKey");
+			Assert::AreEqual(details.subkeys, static_cast<DWORD>(1));
+			Assert::AreEqual(details.max_subkey_length, static_cast<DWORD>(3));
+			Assert::AreEqual(details.values, static_cast<DWORD>(2));
+			Assert::AreEqual(details.max_value_name_length, static_cast<DWORD>(6));
+			Assert::AreEqual(details.max_data_size, static_cast<DWORD>(26)); // UTF-16 with the terminator
+			Assert::IsTrue(details.class_name.empty());
+			Assert::AreNotEqual(details.last_write, static_cast<std::uint64_t>(0));
+
+			// writing a value moves the stamp
+			reg::update::number(HKEY_CURRENT_USER, "RegMirrorKey", "Number", 2);
+			Assert::IsTrue(reg::query::details(HKEY_CURRENT_USER, "RegMirrorKey").last_write >= details.last_write);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey"));
+		}
+
+		TEST_METHOD(Refresh_Reads_Changed_Keys_Only)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegMirrorKey\\A", "Number", 1);
+			reg::create::string(HKEY_CURRENT_USER, "RegMirrorKey\\B\\Deep", "Name", "text");
+			settle();
+
+			reg::mirror copy;
+			Assert::AreEqual(copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey"), static_cast<size_t>(4));
+			Assert::IsNotNull(copy.tree().find("A")->get("number"));
+			Assert::IsNotNull(copy.tree().find("b\\deep"));
+
+			// nothing written since: every stamp is trusted
+			Assert::AreEqual(copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey"), static_cast<size_t>(0));
+
+			reg::update::number(HKEY_CURRENT_USER, "RegMirrorKey\\A", "Number", 2);
+			reg::create::number(HKEY_CURRENT_USER, "RegMirrorKey\\A", "Added", 3);
+			settle();
+			Assert::AreEqual(copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey"), static_cast<size_t>(1));
+			const reg::value* number = copy.tree().find("A")->get("Number");
+			Assert::IsNotNull(number);
+			Assert::AreEqual(number->data[0], '\x02');
+			Assert::IsNotNull(copy.tree().find("A")->get("Added"));
+
+			// a value deleted and subkeys added and removed
+			reg::remove::value(HKEY_CURRENT_USER, "RegMirrorKey\\A", "Added");
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey\\B");
+			reg::create::number(HKEY_CURRENT_USER, "RegMirrorKey\\C", "Number", 4);
+			settle();
+			Assert::AreEqual(copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey"), static_cast<size_t>(3));
+			Assert::IsNull(copy.tree().find("A")->get("Added"));
+			Assert::IsNotNull(copy.tree().find("A")->get("Number"));
+			Assert::IsNull(copy.tree().find("B"));
+			Assert::IsNotNull(copy.tree().find("C")->get("Number"));
+
+			// the copy is dropped and read again
+			copy.clear();
+			Assert::AreEqual(copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey"), static_cast<size_t>(3));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegMirrorKey"));
+			Assert::ExpectException<reg::except::key_not_found>([&copy] {
+				copy.refresh(HKEY_CURRENT_USER, "RegMirrorKey");
+				});
+		}
+	};
+}
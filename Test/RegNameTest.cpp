@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_name.h"
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegName
+{
+	static_assert(reg::ihash("Software") == reg::ihash("SOFTWARE"), "the hash is usable at compile time");
+	static_assert(reg::upcase(U'\u00E4') == U'\u00C4' && reg::upcase(U'\u03C3') == U'\u03A3', "non-ASCII letters are folded");
+
+	TEST_CLASS(Name)
+	{
+	public:
+		TEST_METHOD(Ascii_Ignores_Case)
+		{
+			const std::string clsid = "{8be4df61-93ca-11d2-aa0d-00e098032b8c}";
+			const std::string upper = "{8BE4DF61-93CA-11D2-AA0D-00E098032B8C}";
+
+			Assert::IsTrue(reg::iequals(clsid, upper));
+			Assert::AreEqual(reg::icompare(clsid, upper), 0);
+			Assert::AreEqual(reg::ihash(clsid), reg::ihash(upper));
+			Assert::IsFalse(reg::iequals(clsid, upper.substr(0, 37) + "]"));
+
+			// every position of a long name, so both the blocks and the partial block are covered
+			for (size_t i = 0; i < clsid.size(); i++)
+			{
+				std::string other = upper;
+				other[i] = '_';
+				Assert::IsFalse(reg::iequals(clsid, other));
+				Assert::AreEqual(reg::icompare(clsid, other) < 0, clsid[i] != '_' && reg::fold(clsid[i]) < '_');
+			}
+
+			Assert::IsTrue(reg::icompare("Run", "RunOnce") < 0);
+			Assert::IsTrue(reg::icompare("b", "A") > 0);
+			Assert::IsTrue(reg::icompare("Z", "_") < 0); // compared upper case, like the registry
+		}
+
+		TEST_METHOD(Unicode_Ignores_Case)
+		{
+			const std::string lower = u8"stra\u00DFe \u00E4\u00F6\u00FC \u03B5\u03BB\u03BB\u03AC\u03B4\u03B1 \u043A\u043B\u044E\u0447 \uFF41";
+			const std::string upper = u8"STRA\u00DFE \u00C4\u00D6\u00DC \u0395\u039B\u039B\u0386\u0394\u0391 \u041A\u041B\u042E\u0427 \uFF21";
+
+			Assert::IsTrue(reg::iequals(lower, upper));
+			Assert::AreEqual(reg::icompare(lower, upper), 0);
+			Assert::AreEqual(reg::ihash(lower), reg::ihash(upper));
+			Assert::IsFalse(reg::iequals(lower, u8"stra\u00DFe \u00E4\u00F6\u00FC \u03B5\u03BB\u03BB\u03AC\u03B4\u03B1 \u043A\u043B\u044E\u0447 \uFF42"));
+			Assert::IsTrue(reg::icompare(u8"\u00E4", "z") > 0);
+
+			std::string folded;
+			reg::upcase(lower, folded);
+			Assert::IsTrue(folded == upper);
+		}
+
+		TEST_METHOD(Utf16_Matches_Utf8)
+		{
+			const std::u16string lower = u"{8be4df61-93ca-11d2} \u00E4\u03C3\u0436 \U0001F600 tail";
+			const std::u16string upper = u"{8BE4DF61-93CA-11D2} \u00C4\u03A3\u0416 \U0001F600 TAIL";
+			const std::string utf8 = u8"{8be4df61-93ca-11d2} \u00E4\u03C3\u0436 \U0001F600 tail";
+
+			Assert::IsTrue(reg::iequals(std::u16string_view(lower), std::u16string_view(upper)));
+			Assert::IsFalse(reg::iequals(std::u16string_view(lower), std::u16string_view(u"{8be4df61-93ca-11d2} \u00E4\u03C3\u0436 \U0001F600 tailx")));
+			Assert::AreEqual(reg::ihash(std::u16string_view(lower)), reg::ihash(std::u16string_view(upper)));
+			Assert::AreEqual(reg::ihash(std::u16string_view(lower)), reg::ihash(utf8));
+
+			for (size_t length = 0; length <= 20; length++)
+				Assert::AreEqual(reg::ihash(std::u16string_view(upper).substr(0, length)), reg::ihash(std::string_view(utf8).substr(0, length)));
+
+			std::u16string folded;
+			reg::upcase(std::u16string_view(lower), folded);
+			Assert::IsTrue(folded == upper);
+		}
+
+		TEST_METHOD(Invalid_Utf8_Is_Compared_As_Bytes)
+		{
+			const std::string a = "key\xFF\xC3";
+			Assert::IsTrue(reg::iequals(a, "KEY\xFF\xC3"));
+			Assert::IsFalse(reg::iequals(a, "KEY\xFE\xC3"));
+			Assert::AreEqual(reg::ihash(a), reg::ihash("KEY\xFF\xC3"));
+		}
+	};
+}
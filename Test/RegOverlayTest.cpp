@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_overlay.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegOverlay
+{
+	TEST_CLASS(Overlay)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey");
+		}
+
+		TEST_METHOD(Reads_See_The_Delta_First)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey", "Kept", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey", "Changed", 1);
+
+			reg::overlay sandbox;
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey", "Changed", 2);
+			sandbox.set<std::string>(HKEY_CURRENT_USER, "RegOverlayKey\\New", "Text", "fresh");
+
+			Assert::AreEqual(sandbox.number(HKEY_CURRENT_USER, "RegOverlayKey", "Kept"), static_cast<DWORD>(1));
+			Assert::AreEqual(sandbox.number(HKEY_CURRENT_USER, "regoverlaykey", "CHANGED"), static_cast<DWORD>(2));
+			Assert::IsTrue(sandbox.string(HKEY_CURRENT_USER, "\\RegOverlayKey\\New\\", "Text") == "fresh");
+			Assert::IsTrue(sandbox.key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\New"));
+
+			// the registry itself is untouched
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegOverlayKey", "Changed"), static_cast<DWORD>(1));
+			Assert::IsFalse(reg::key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\New"));
+
+			Assert::ExpectException<reg::except::type_error>([&sandbox] {
+				sandbox.string(HKEY_CURRENT_USER, "RegOverlayKey", "Changed");
+				});
+			Assert::ExpectException<reg::except::value_not_found>([&sandbox] {
+				sandbox.number(HKEY_CURRENT_USER, "RegOverlayKey\\New", "Missing");
+				});
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey"));
+		}
+
+		TEST_METHOD(Tombstones_Hide_The_Registry)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey", "Gone", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey", "Stays", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey\\Old\\Deep", "Stale", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey\\Other", "Value", 1);
+
+			reg::overlay sandbox;
+			sandbox.remove_value(HKEY_CURRENT_USER, "RegOverlayKey", "Gone");
+			sandbox.remove_key(HKEY_CURRENT_USER, "RegOverlayKey\\Old");
+
+			Assert::IsFalse(sandbox.value_exists(HKEY_CURRENT_USER, "RegOverlayKey", "Gone"));
+			Assert::IsTrue(sandbox.value_exists(HKEY_CURRENT_USER, "RegOverlayKey", "Stays"));
+			Assert::IsFalse(sandbox.key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\Old"));
+			Assert::IsFalse(sandbox.key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\Old\\Deep"));
+			Assert::ExpectException<reg::except::key_not_found>([&sandbox] {
+				sandbox.number(HKEY_CURRENT_USER, "RegOverlayKey\\Old\\Deep", "Stale");
+				});
+
+			Assert::IsTrue(sandbox.value_names(HKEY_CURRENT_USER, "RegOverlayKey") == std::vector<std::string>{ "Stays" });
+			Assert::IsTrue(sandbox.keys(HKEY_CURRENT_USER, "RegOverlayKey") == std::vector<std::string>{ "Other" });
+
+			// writing under the removed key starts a fresh key
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey\\Old", "Fresh", 2);
+			Assert::IsTrue(sandbox.key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\Old"));
+			Assert::IsFalse(sandbox.key_exists(HKEY_CURRENT_USER, "RegOverlayKey\\Old\\Deep"));
+			Assert::IsTrue(sandbox.value_names(HKEY_CURRENT_USER, "RegOverlayKey\\Old") == std::vector<std::string>{ "Fresh" });
+
+			auto keys = sandbox.keys(HKEY_CURRENT_USER, "RegOverlayKey");
+			std::sort(keys.begin(), keys.end());
+			Assert::IsTrue(keys == std::vector<std::string>{ "Old", "Other" });
+
+			Assert::ExpectException<std::invalid_argument>([&sandbox] {
+				sandbox.remove_key(HKEY_CURRENT_USER, "\\");
+				});
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey"));
+		}
+
+		TEST_METHOD(Commit_Applies_And_Discard_Drops)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey", "Gone", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegOverlayKey\\Reset", "Stale", 1);
+
+			reg::overlay sandbox;
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey", "Added", 1);
+			sandbox.discard();
+			Assert::IsTrue(sandbox.empty());
+			Assert::IsFalse(sandbox.value_exists(HKEY_CURRENT_USER, "RegOverlayKey", "Added"));
+
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey", "Added", 1);
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey", "Added", 2);
+			sandbox.remove_value(HKEY_CURRENT_USER, "RegOverlayKey", "Gone");
+			sandbox.remove_key(HKEY_CURRENT_USER, "RegOverlayKey\\Reset");
+			sandbox.set<DWORD>(HKEY_CURRENT_USER, "RegOverlayKey\\Reset", "Fresh", 3);
+			Assert::AreEqual(sandbox.size(), static_cast<size_t>(4));
+
+			Assert::AreEqual(sandbox.commit(), static_cast<size_t>(4));
+			Assert::IsTrue(sandbox.empty());
+
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegOverlayKey", "Added"), static_cast<DWORD>(2));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegOverlayKey", "Gone"));
+			Assert::IsFalse(reg::value_exists(HKEY_CURRENT_USER, "RegOverlayKey\\Reset", "Stale"));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegOverlayKey\\Reset", "Fresh"), static_cast<DWORD>(3));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegOverlayKey"));
+		}
+	};
+}
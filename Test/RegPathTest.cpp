@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry.h"
+#include "../registry_path.h"
+#include <unordered_map>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegPath
+{
+	constexpr reg::static_path run("Software\\Microsoft\\Windows\\CurrentVersion\\Run");
+	static_assert(run.size() == 5, "segments are counted at compile time");
+	static_assert(run.hash() == reg::ihash("SOFTWARE\\MICROSOFT\\WINDOWS\\CURRENTVERSION\\RUN"), "the hash ignores case");
+	static_assert(run.offsets()[1] == 9, "segment offsets are computed at compile time");
+
+#define REG_PATH_TEN u8"\u0416\u0416\u0416\u0416\u0416\u0416\u0416\u0416\u0416\u0416"
+	// 200 Cyrillic letters: 400 bytes, but within the limit of 255 UTF-16 code units
+	constexpr reg::static_path cyrillic(REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN
+		REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN
+		REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN REG_PATH_TEN);
+	static_assert(cyrillic.size() == 1 && cyrillic.str().size() == 400, "key names are measured in UTF-16");
+#undef REG_PATH_TEN
+
+	TEST_CLASS(Path)
+	{
+	public:
+		TEST_METHOD(Normalized_On_Construction)
+		{
+			reg::path p("\\Software\\\\Example\\Key\\");
+
+			Assert::AreEqual(p.c_str(), "Software\\Example\\Key");
+			Assert::AreEqual(p.size(), static_cast<size_t>(3));
+			Assert::AreEqual(std::string(p[1]).c_str(), "Example");
+			Assert::AreEqual(std::string(p.name()).c_str(), "Key");
+			Assert::AreEqual(p.parent().c_str(), "Software\\Example");
+			Assert::AreEqual(p.hash(), reg::ihash("software\\example\\key"));
+
+			Assert::IsTrue(reg::path("").empty());
+			Assert::IsTrue(reg::path("\\\\").empty());
+			Assert::IsTrue(reg::path("Single").parent().empty());
+		}
+
+		TEST_METHOD(Invalid_Paths_Are_Rejected)
+		{
+			Assert::ExpectException<std::invalid_argument>([]() { reg::path(std::string(256, 'a')); });
+			Assert::ExpectException<std::invalid_argument>([]() { reg::path(std::string_view("a\0b", 3)); });
+
+			std::string deep;
+			for (int i = 0; i < 513; i++)
+				deep += "k\\";
+			Assert::ExpectException<std::invalid_argument>([&deep]() { reg::path{ deep }; });
+		}
+
+		TEST_METHOD(Name_Length_Is_Counted_In_UTF16)
+		{
+			// 200 Cyrillic letters take 400 bytes but 200 code units
+			std::string cyrillic;
+			for (int i = 0; i < 200; i++)
+				cyrillic += u8"\u0416";
+			reg::path p("Software\\" + cyrillic);
+			Assert::AreEqual(p.size(), static_cast<size_t>(2));
+			Assert::AreEqual((reg::path("Software") / reg::path(cyrillic)).size(), static_cast<size_t>(2));
+
+			// 128 characters outside the BMP take 256 code units
+			std::string emoji;
+			for (int i = 0; i < 127; i++)
+				emoji += u8"\U0001F600";
+			Assert::AreEqual(reg::path(emoji + "a").size(), static_cast<size_t>(1));
+			Assert::ExpectException<std::invalid_argument>([&emoji]() { reg::path(emoji + u8"\U0001F600"); });
+			Assert::ExpectException<std::invalid_argument>([&cyrillic]() { reg::path(cyrillic + cyrillic); });
+		}
+
+		TEST_METHOD(Compare_And_Hash)
+		{
+			reg::path a("Software\\Example");
+			reg::path b("SOFTWARE\\example\\");
+			Assert::IsTrue(a == b);
+			Assert::IsTrue(a != reg::path("Software\\Other"));
+
+			std::unordered_map<reg::path, int> cache;
+			cache[a] = 1;
+			Assert::AreEqual(cache.at(b), 1);
+
+			reg::path literal = run;
+			Assert::AreEqual(literal.hash(), run.hash());
+			Assert::AreEqual(std::string(literal[4]).c_str(), "Run");
+			Assert::IsTrue(literal.parent() / reg::path("Run") == literal);
+		}
+	};
+
+	TEST_CLASS(Registry)
+	{
+	public:
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPathKey");
+		}
+
+		TEST_METHOD(Paths_Are_Accepted_By_Every_Function)
+		{
+			const reg::path key("RegPathKey\\\\Child\\");
+			reg::create::string(HKEY_CURRENT_USER, key, "Name", "text");
+
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, key));
+			Assert::AreEqual(reg::query::string(HKEY_CURRENT_USER, key, "Name").c_str(), "text");
+			Assert::AreEqual(reg::query::keys(HKEY_CURRENT_USER, key.parent()).size(), static_cast<size_t>(1));
+
+			// a view into the middle of a string is not null terminated; a path is
+			std::string_view prefix = std::string_view("RegPathKey\\Child\\Name").substr(0, 10);
+			Assert::IsTrue(reg::key_exists(HKEY_CURRENT_USER, reg::path(prefix)));
+		}
+	};
+}
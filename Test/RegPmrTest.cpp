@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegPmr
+{
+	// counts what is taken from the upstream resource and what is given back
+	class counting_resource : public std::pmr::memory_resource
+	{
+	public:
+		explicit counting_resource(std::pmr::memory_resource* upstream) noexcept : upstream(upstream) {}
+
+		size_t allocations = 0;
+		size_t deallocations = 0;
+		size_t largest = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			++allocations;
+			largest = (std::max)(largest, bytes);
+			return upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			++deallocations;
+			upstream->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		std::pmr::memory_resource* upstream;
+	};
+
+	// makes the default resource fail for the lifetime of the object
+	struct default_resource_guard
+	{
+		counting_resource refused{ std::pmr::null_memory_resource() };
+		std::pmr::memory_resource* previous = std::pmr::set_default_resource(&refused);
+		~default_resource_guard() { std::pmr::set_default_resource(previous); }
+	};
+
+	// global heap allocations, counted only on a thread inside a global_heap_counter,
+	// so the other tests in the module are not affected
+	thread_local bool counting = false;
+	thread_local size_t global_allocations = 0;
+
+	struct global_heap_counter
+	{
+		global_heap_counter() noexcept { global_allocations = 0; counting = true; }
+		~global_heap_counter() { counting = false; }
+		size_t allocations() const noexcept { return global_allocations; }
+	};
+}
+
+void* operator new(std::size_t size)
+{
+	if (RegPmr::counting)
+		++RegPmr::global_allocations;
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace RegPmr
+{
+	TEST_CLASS(Resource)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey");
+		}
+
+		TEST_METHOD(Enumeration_Does_Not_Touch_The_Global_Heap)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey");
+			for (const char* key : { "Alpha", "Beta", u8"Gr\u00FC\u00DFe" })
+			{
+				const std::string path = std::string("RegPmrKey\\") + key;
+				reg::create::string(HKEY_CURRENT_USER, path, "Name", key);
+				reg::create::string(HKEY_CURRENT_USER, path, "Long", std::string(500, 'x'));
+				reg::create::string(HKEY_CURRENT_USER, path, "Empty", "");
+			}
+
+			alignas(std::max_align_t) static char storage[1 << 16];
+			std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage), std::pmr::null_memory_resource());
+			counting_resource counter(&arena);
+
+			size_t strings = 0;
+			size_t characters = 0;
+			size_t global = 0;
+			size_t refused = 0;
+			{
+				default_resource_guard guard;
+				global_heap_counter heap;
+				auto keys = reg::query::keys(HKEY_CURRENT_USER, "RegPmrKey", &counter);
+				for (const auto& key : keys)
+				{
+					std::pmr::string path("RegPmrKey\\", &counter);
+					path += key;
+
+					for (const auto& name : reg::query::value_names(HKEY_CURRENT_USER, path, &counter))
+					{
+						characters += reg::query::string(HKEY_CURRENT_USER, path, name, &counter).size();
+						++strings;
+					}
+				}
+				global = heap.allocations();
+				refused = guard.refused.allocations;
+			}
+
+			Assert::AreEqual(global, static_cast<size_t>(0));
+			Assert::AreEqual(refused, static_cast<size_t>(0));
+
+			// the key vector, the paths, three name vectors and the long strings at the least
+			Assert::IsTrue(counter.allocations >= 1 + 3 + 3 + 3);
+			Assert::AreEqual(counter.deallocations, counter.allocations);
+			Assert::AreEqual(strings, static_cast<size_t>(9));
+			Assert::AreEqual(characters, static_cast<size_t>(5 + 4 + 7 + 3 * 500));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey"));
+		}
+
+		TEST_METHOD(Results_Live_In_The_Resource)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey");
+			const std::string name(300, 'n');
+			reg::create::string(HKEY_CURRENT_USER, "RegPmrKey\\Sub", name, "data");
+
+			std::pmr::monotonic_buffer_resource arena;
+			auto keys = reg::query::keys(HKEY_CURRENT_USER, "RegPmrKey", &arena);
+			Assert::AreEqual(keys.size(), static_cast<size_t>(1));
+			Assert::IsTrue(keys.get_allocator().resource() == &arena);
+			Assert::IsTrue(keys[0].get_allocator().resource() == &arena);
+			Assert::IsTrue(keys[0] == "Sub");
+
+			// the buffer for a name too long for the stack comes from the resource as well
+			alignas(std::max_align_t) static char storage[1 << 12];
+			std::pmr::monotonic_buffer_resource fixed(storage, sizeof(storage), std::pmr::null_memory_resource());
+			counting_resource counter(&fixed);
+			size_t global = 0;
+			std::pmr::vector<std::pmr::string> names(&counter);
+			{
+				global_heap_counter heap;
+				names = reg::query::value_names(HKEY_CURRENT_USER, "RegPmrKey\\Sub", &counter);
+				global = heap.allocations();
+			}
+			Assert::AreEqual(global, static_cast<size_t>(0));
+			Assert::IsTrue(counter.largest >= name.size() * sizeof(char16_t));
+			Assert::AreEqual(names.size(), static_cast<size_t>(1));
+			Assert::IsTrue(std::string_view(names[0]) == name);
+
+			auto data = reg::query::get<std::pmr::string>(HKEY_CURRENT_USER, "RegPmrKey\\Sub", name);
+			Assert::IsTrue(data == "data");
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey"));
+		}
+
+		TEST_METHOD(Missing_Keys_Still_Throw)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey");
+			std::pmr::monotonic_buffer_resource arena;
+
+			Assert::ExpectException<reg::except::key_not_found>([&arena] {
+				reg::query::keys(HKEY_CURRENT_USER, "RegPmrKey", &arena);
+				});
+			Assert::ExpectException<reg::except::key_not_found>([&arena] {
+				reg::query::value_names(HKEY_CURRENT_USER, "RegPmrKey", &arena);
+				});
+
+			reg::create::string(HKEY_CURRENT_USER, "RegPmrKey", "Present", "");
+			Assert::ExpectException<reg::except::value_not_found>([&arena] {
+				reg::query::string(HKEY_CURRENT_USER, "RegPmrKey", "Missing", &arena);
+				});
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPmrKey"));
+		}
+	};
+}
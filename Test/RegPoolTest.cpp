@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_pool.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegPool
+{
+	TEST_CLASS(HandlePool)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+		}
+
+		TEST_METHOD(Handles_Are_Reused)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegPoolKey\\A", "Number", 1);
+
+			reg::handle_pool pool;
+			auto first = pool.acquire(HKEY_CURRENT_USER, "RegPoolKey\\A", KEY_QUERY_VALUE);
+			auto second = pool.acquire(HKEY_CURRENT_USER, "regpoolkey\\a", KEY_QUERY_VALUE);
+			Assert::IsTrue(first.get() == second.get());
+			auto other = pool.acquire(HKEY_CURRENT_USER, "RegPoolKey\\A", KEY_READ);
+			Assert::IsTrue(first.get() != other.get());
+			Assert::AreEqual(pool.size(), static_cast<size_t>(2));
+			Assert::AreEqual(pool.hits(), static_cast<size_t>(1));
+			Assert::AreEqual(pool.misses(), static_cast<size_t>(2));
+
+			Assert::AreEqual(pool.get<DWORD>(HKEY_CURRENT_USER, "RegPoolKey\\A", "Number"), static_cast<DWORD>(1));
+			Assert::AreEqual(pool.hits(), static_cast<size_t>(2));
+
+			Assert::ExpectException<reg::except::key_not_found>([&pool] {
+				pool.acquire(HKEY_CURRENT_USER, "RegPoolKey\\Missing", KEY_QUERY_VALUE);
+				});
+			Assert::ExpectException<reg::except::value_not_found>([&pool] {
+				pool.get<DWORD>(HKEY_CURRENT_USER, "RegPoolKey\\A", "Missing");
+				});
+
+			Assert::AreEqual(pool.evict(HKEY_CURRENT_USER, "REGPOOLKEY\\A"), static_cast<size_t>(2));
+			Assert::AreEqual(pool.size(), static_cast<size_t>(0));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey"));
+		}
+
+		TEST_METHOD(Eviction_Takes_The_Subtree)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+			for (const char* key : { "RegPoolKey\\A", "RegPoolKey\\A\\B", "RegPoolKey\\A\\B\\C", "RegPoolKey\\AB", "RegPoolKey\\Other" })
+				reg::create::key(HKEY_CURRENT_USER, key);
+
+			reg::handle_pool pool;
+			for (const char* key : { "RegPoolKey\\A", "RegPoolKey\\a\\b", "RegPoolKey\\A\\B\\C", "RegPoolKey\\AB", "RegPoolKey\\Other" })
+				(void)pool.acquire(HKEY_CURRENT_USER, key, KEY_QUERY_VALUE);
+			Assert::AreEqual(pool.size(), static_cast<size_t>(5));
+
+			// AB only shares a prefix with A, not a path
+			Assert::AreEqual(pool.evict(HKEY_CURRENT_USER, "REGPOOLKEY\\A\\"), static_cast<size_t>(3));
+			Assert::AreEqual(pool.size(), static_cast<size_t>(2));
+			Assert::AreEqual(pool.evict(HKEY_CURRENT_USER, "RegPoolKey\\A"), static_cast<size_t>(0));
+
+			Assert::AreEqual(pool.evict(HKEY_CURRENT_USER, ""), static_cast<size_t>(2));
+			Assert::AreEqual(pool.size(), static_cast<size_t>(0));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey"));
+		}
+
+		TEST_METHOD(Evicted_Handles_Stay_Open_While_Leased)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegPoolKey\\A", "Number", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegPoolKey\\B", "Number", 2);
+
+			reg::handle_pool pool(1, 1);
+			auto a = pool.acquire(HKEY_CURRENT_USER, "RegPoolKey\\A", KEY_QUERY_VALUE);
+			auto b = pool.acquire(HKEY_CURRENT_USER, "RegPoolKey\\B", KEY_QUERY_VALUE);
+			Assert::AreEqual(pool.size(), static_cast<size_t>(1));
+
+			// A was evicted, but the lease keeps its handle open
+			Assert::AreEqual(reg::query::get<DWORD>(a.get(), "", "Number"), static_cast<DWORD>(1));
+			Assert::AreEqual(reg::query::get<DWORD>(b.get(), "", "Number"), static_cast<DWORD>(2));
+
+			pool.clear();
+			Assert::AreEqual(pool.size(), static_cast<size_t>(0));
+			Assert::AreEqual(reg::query::get<DWORD>(b.get(), "", "Number"), static_cast<DWORD>(2));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey"));
+		}
+
+		TEST_METHOD(Concurrent_Reads)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey");
+			for (DWORD i = 0; i < 20; i++)
+				reg::create::number(HKEY_CURRENT_USER, "RegPoolKey\\Key" + std::to_string(i), "Number", i);
+
+			reg::handle_pool pool(8, 4);
+			std::atomic<size_t> wrong{ 0 };
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 8; t++)
+				threads.emplace_back([&pool, &wrong, t] {
+				for (DWORD i = 0; i < 1000; i++)
+				{
+					const DWORD k = (i * 7 + t) % 20;
+					if (pool.get<DWORD>(HKEY_CURRENT_USER, "RegPoolKey\\Key" + std::to_string(k), "Number") != k)
+						++wrong;
+				}
+					});
+			for (std::thread& thread : threads)
+				thread.join();
+
+			Assert::AreEqual(wrong.load(), static_cast<size_t>(0));
+			Assert::AreEqual(pool.hits() + pool.misses(), static_cast<size_t>(8000));
+			Assert::IsTrue(pool.size() <= 8);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolKey"));
+		}
+	};
+}
@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_probe.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegProbe
+{
+	TEST_CLASS(NegativeCache)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey");
+		}
+
+		TEST_METHOD(Misses_Skip_The_Registry)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey\\Present", "Value", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey", "Own", 1);
+
+			reg::negative_cache cache(HKEY_CURRENT_USER, "RegProbeKey");
+			Assert::IsTrue(cache.key_exists(""));
+			Assert::IsTrue(cache.key_exists("PRESENT"));
+			Assert::IsTrue(cache.value_exists("Present", "Value"));
+			Assert::IsTrue(cache.value_exists("", "own"));
+			const size_t answered = cache.answered();
+
+			// not among the enumerated names: answered on the spot
+			for (int i = 0; i < 100; i++)
+			{
+				Assert::IsFalse(cache.key_exists("Plugin" + std::to_string(i)));
+				Assert::IsFalse(cache.value_exists("Plugin" + std::to_string(i) + "\\Sub", "Path"));
+			}
+			Assert::AreEqual(cache.answered(), answered + 200);
+
+			// the parent is there, so the registry is asked once and the miss remembered
+			Assert::IsFalse(cache.value_exists("Present", "Missing"));
+			Assert::IsFalse(cache.key_exists("Present\\Missing"));
+			Assert::AreEqual(cache.answered(), answered + 200);
+			Assert::IsFalse(cache.value_exists("present", "MISSING"));
+			Assert::IsFalse(cache.key_exists("Present\\Missing"));
+			Assert::AreEqual(cache.answered(), answered + 202);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey"));
+		}
+
+		TEST_METHOD(Changes_Are_Noticed)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey", "Own", 1);
+
+			reg::negative_cache cache(HKEY_CURRENT_USER, "RegProbeKey");
+			Assert::IsFalse(cache.key_exists("Later"));
+			Assert::IsFalse(cache.value_exists("", "Later"));
+
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey\\Later", "Value", 1);
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey", "Later", 1);
+
+			// the notification arrives on a pool thread
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (!cache.key_exists("Later") && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			Assert::IsTrue(cache.key_exists("Later"));
+			Assert::IsTrue(cache.value_exists("", "Later"));
+			Assert::IsTrue(cache.value_exists("Later", "Value"));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey"));
+		}
+
+		TEST_METHOD(Missing_Key_Until_Refreshed)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey");
+
+			reg::negative_cache cache(HKEY_CURRENT_USER, "RegProbeKey", std::chrono::hours(1), false);
+			Assert::IsFalse(cache.key_exists(""));
+			Assert::IsFalse(cache.value_exists("", "Value"));
+
+			// without notifications nor an expired time to live, the cache is not rebuilt
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey", "Value", 1);
+			Assert::IsFalse(cache.value_exists("", "Value"));
+
+			cache.invalidate();
+			Assert::IsTrue(cache.key_exists(""));
+			Assert::IsTrue(cache.value_exists("", "Value"));
+
+			// a time to live of zero rebuilds on every probe
+			reg::negative_cache fresh(HKEY_CURRENT_USER, "RegProbeKey", std::chrono::seconds(0), false);
+			reg::create::number(HKEY_CURRENT_USER, "RegProbeKey", "Second", 2);
+			Assert::IsTrue(fresh.value_exists("", "Second"));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegProbeKey"));
+		}
+	};
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_setting.h"
+#include <string>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegSetting
+{
+	constexpr reg::setting<DWORD> timeout(reg::hive::current_user, "RegSettingKey\\Options", "Timeout");
+	constexpr reg::setting<ULONGLONG> stamp(reg::hive::current_user, "RegSettingKey\\Options", "Stamp");
+	constexpr reg::setting<std::string> title(reg::hive::current_user, "RegSettingKey\\Options", "Title");
+
+	static_assert(timeout.hash() == reg::ihash("regsettingkey\\OPTIONS"), "the path is hashed at compile time");
+	static_assert(timeout.name() == "Timeout");
+	static_assert(reg::setting<DWORD>::type() == REG_DWORD);
+	static_assert(reg::setting<ULONGLONG>::type() == REG_QWORD);
+	static_assert(reg::setting<std::string>::type() == REG_SZ);
+
+	TEST_CLASS(Setting)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+		}
+
+		TEST_METHOD(Hive_Converts_To_The_Predefined_Handle)
+		{
+			Assert::IsTrue(reg::to_hkey(reg::hive::classes_root) == HKEY_CLASSES_ROOT);
+			Assert::IsTrue(reg::to_hkey(reg::hive::current_user) == HKEY_CURRENT_USER);
+			Assert::IsTrue(reg::to_hkey(reg::hive::local_machine) == HKEY_LOCAL_MACHINE);
+			Assert::IsTrue(reg::to_hkey(reg::hive::users) == HKEY_USERS);
+			Assert::IsTrue(reg::to_hkey(reg::hive::current_config) == HKEY_CURRENT_CONFIG);
+		}
+
+		TEST_METHOD(Ensure_Creates_Then_Keeps)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+			Assert::AreEqual(timeout.ensure(30), static_cast<DWORD>(30));
+			Assert::AreEqual(timeout.ensure(60), static_cast<DWORD>(30));
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegSettingKey\\Options", "Timeout"), static_cast<DWORD>(30));
+
+			Assert::IsTrue(title.ensure("first") == "first");
+			Assert::IsTrue(title.ensure("second") == "first");
+		}
+
+		TEST_METHOD(Set_Then_Get)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+			reg::create::key(HKEY_CURRENT_USER, "RegSettingKey\\Options");
+
+			timeout.set(5);
+			stamp.set(0x123456789ABCDEF0ull);
+			title.set(u8"Gr\u00FC\u00DFe");
+
+			Assert::AreEqual(timeout.get(), static_cast<DWORD>(5));
+			Assert::IsTrue(stamp.get() == 0x123456789ABCDEF0ull);
+			Assert::IsTrue(title.get() == u8"Gr\u00FC\u00DFe");
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegSettingKey\\Options", "Title") == u8"Gr\u00FC\u00DFe");
+		}
+
+		TEST_METHOD(Missing_Key_And_Value_Throw)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+			Assert::ExpectException<reg::except::key_not_found>([] { timeout.get(); });
+			Assert::ExpectException<reg::except::key_not_found>([] { timeout.set(1); });
+
+			reg::create::key(HKEY_CURRENT_USER, "RegSettingKey\\Options");
+			Assert::ExpectException<reg::except::value_not_found>([] { timeout.get(); });
+		}
+
+		TEST_METHOD(Wrong_Type_Throws)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSettingKey");
+			reg::create::string(HKEY_CURRENT_USER, "RegSettingKey\\Options", "Timeout", "thirty");
+
+			Assert::ExpectException<reg::except::type_error>([] { timeout.get(); });
+			Assert::ExpectException<reg::except::type_error>([] { timeout.ensure(30); });
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegSettingKey\\Options", "Timeout") == "thirty");
+		}
+
+		TEST_METHOD(Malformed_Paths_Are_Rejected)
+		{
+			Assert::ExpectException<std::invalid_argument>([] { reg::setting<DWORD>(reg::hive::current_user, "Software\\\\X", "Name"); });
+			Assert::ExpectException<std::invalid_argument>([] { reg::setting<DWORD>(reg::hive::current_user, "\\Software", "Name"); });
+		}
+	};
+}
@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_snapshot.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegSnapshot
+{
+	std::string utf16(std::string_view text)
+	{
+		std::string data;
+		reg::utf::append_utf16le(text, data);
+		return data;
+	}
+
+	reg::tree sample()
+	{
+		reg::tree root;
+		reg::tree& app = root.create("Software\\App");
+		app.set("", reg::types::sz, utf16("default"));
+		app.set("Count", reg::types::dword, std::string("\x2a\0\0\0", 4));
+		app.set("Small", reg::types::qword, std::string("\x07\0\0\0\0\0\0\0", 8));
+		app.set("Large", reg::types::qword, std::string("\0\0\0\0\x01\0\0\0", 8));
+		app.set("Blob", reg::types::binary, std::string("\1\2\3", 3));
+		app.set("Unterminated", reg::types::sz, std::string("A\0B\0", 4));
+		app.set("Surrogate", reg::types::sz, std::string("\0\xd8\0\0", 4));
+		for (char c = 'a'; c <= 'z'; c++)
+			root.create(std::string("Software\\Many\\") + c + "key").set("Name", reg::types::sz, utf16(std::string(1, c)));
+		return root;
+	}
+
+	std::string write(const reg::tree& root)
+	{
+		reg::source::tree source(root);
+		std::ostringstream out;
+		reg::snapshot::write(source, &root, out);
+		return out.str();
+	}
+
+	TEST_CLASS(Format)
+	{
+	public:
+		TEST_METHOD(Values_Round_Trip)
+		{
+			reg::tree root = sample();
+			std::string image = write(root);
+			reg::snapshot::file snapshot(image);
+
+			auto app = snapshot.open("SOFTWARE\\app");
+			Assert::IsTrue(app.has_value());
+			Assert::AreEqual(std::string(snapshot.name(*app)).c_str(), "App");
+
+			for (const auto& [name, value] : root.find("Software\\App")->values())
+			{
+				std::optional<reg::value> stored = snapshot.get(*app, name);
+				Assert::IsTrue(stored.has_value());
+				Assert::IsTrue(*stored == value);
+			}
+			Assert::IsFalse(snapshot.get(*app, "Missing").has_value());
+		}
+
+		TEST_METHOD(Lookup_In_Place)
+		{
+			std::string image = write(sample());
+			reg::snapshot::file snapshot(image);
+
+			for (char c = 'a'; c <= 'z'; c++)
+			{
+				auto key = snapshot.open(std::string("Software\\Many\\") + static_cast<char>(c - 'a' + 'A') + "KEY");
+				Assert::IsTrue(key.has_value());
+				Assert::IsTrue(snapshot.get(*key, "name")->data == utf16(std::string(1, c)));
+			}
+			Assert::IsFalse(snapshot.open("Software\\Many\\zzz").has_value());
+
+			std::vector<std::string> names;
+			snapshot.keys(*snapshot.open("Software"), names);
+			Assert::AreEqual(names.size(), static_cast<size_t>(2));
+			Assert::AreEqual(names[0].c_str(), "App");
+		}
+
+		TEST_METHOD(Snapshot_Of_Snapshot_Is_Identical)
+		{
+			std::string image = write(sample());
+			reg::snapshot::file snapshot(image);
+
+			std::ostringstream out;
+			reg::snapshot::write(snapshot, snapshot.root(), out);
+			Assert::IsTrue(out.str() == image);
+		}
+
+		TEST_METHOD(Corruption_Is_Detected)
+		{
+			std::string image = write(sample());
+
+			Assert::ExpectException<reg::except::snapshot_error>([&]() { reg::snapshot::file(std::string_view(image).substr(0, image.size() - 1)); });
+			Assert::ExpectException<reg::except::snapshot_error>([&]() { reg::snapshot::file(std::string_view("RSNP")); });
+
+			std::string corrupt = image;
+			corrupt[corrupt.size() - 9] = '\x7f'; // root offset past the keys
+			Assert::ExpectException<reg::except::snapshot_error>([&]() { reg::snapshot::file{ std::string_view(corrupt) }; });
+		}
+	};
+
+	TEST_CLASS(Registry)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSnapshotKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegSnapshotKey");
+			std::remove("RegSnapshotTest.snap");
+		}
+
+		TEST_METHOD(Snapshot_Live_Key)
+		{
+			reg::create::string(HKEY_CURRENT_USER, "RegSnapshotKey\\Child", "Name", "text");
+			reg::create::number(HKEY_CURRENT_USER, "RegSnapshotKey", "Number", 7);
+
+			{
+				std::ofstream out("RegSnapshotTest.snap", std::ios::binary);
+				reg::snapshot::write(HKEY_CURRENT_USER, "RegSnapshotKey", out);
+			}
+
+			reg::snapshot::mapping mapped("RegSnapshotTest.snap");
+			reg::snapshot::file snapshot(mapped.bytes());
+
+			Assert::IsTrue(snapshot.get(snapshot.root(), "Number")->data == std::string("\x07\0\0\0", 4));
+			Assert::IsTrue(snapshot.get(*snapshot.open("child"), "Name")->data == utf16("text"));
+
+			Assert::ExpectException<reg::except::key_not_found>([]() {
+				std::ostringstream ignored;
+				reg::snapshot::write(HKEY_CURRENT_USER, "RegSnapshotKey\\Missing", ignored);
+				});
+		}
+	};
+}
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry_struct.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegStruct
+{
+	enum class level : int { quiet, normal, chatty };
+
+	struct options
+	{
+		DWORD timeout = 30;
+		std::string user = "guest";
+		bool verbose = false;
+		level logging = level::normal;
+		std::chrono::milliseconds delay{ 250 };
+		ULONGLONG quota = 0;
+		std::vector<std::string> paths;
+		reg::expand_string home{ "%USERPROFILE%" };
+		std::vector<BYTE> token;
+	};
+}
+
+template<>
+struct reg::fields<RegStruct::options>
+{
+	static constexpr auto list = std::make_tuple(
+		reg::bind("Timeout", &RegStruct::options::timeout),
+		reg::bind("User", &RegStruct::options::user),
+		REG_FIELD(RegStruct::options, verbose),
+		REG_FIELD(RegStruct::options, logging),
+		REG_FIELD(RegStruct::options, delay),
+		REG_FIELD(RegStruct::options, quota),
+		REG_FIELD(RegStruct::options, paths),
+		REG_FIELD(RegStruct::options, home),
+		REG_FIELD(RegStruct::options, token));
+};
+
+namespace RegStruct
+{
+	TEST_CLASS(Binding)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+		}
+
+		TEST_METHOD(Store_Then_Load_Round_Trips)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+
+			options written;
+			written.timeout = 90;
+			written.user = u8"J\u00F6rg";
+			written.verbose = true;
+			written.logging = level::chatty;
+			written.delay = std::chrono::milliseconds(1500);
+			written.quota = 0x100000000ull;
+			written.paths = { "C:\\one", "D:\\two" };
+			written.home.text = "%TEMP%\\x";
+			written.token = { 1, 2, 3 };
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", written), static_cast<size_t>(9));
+
+			options read;
+			Assert::AreEqual(reg::load(HKEY_CURRENT_USER, "RegStructKey", read), static_cast<size_t>(9));
+			Assert::AreEqual(read.timeout, static_cast<DWORD>(90));
+			Assert::IsTrue(read.user == written.user);
+			Assert::IsTrue(read.verbose);
+			Assert::IsTrue(read.logging == level::chatty);
+			Assert::IsTrue(read.delay == std::chrono::milliseconds(1500));
+			Assert::IsTrue(read.quota == 0x100000000ull);
+			Assert::IsTrue(read.paths == written.paths);
+			Assert::IsTrue(read.home.text == "%TEMP%\\x");
+			Assert::IsTrue(read.token == written.token);
+
+			// the values are the ones the single-value functions see
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegStructKey", "Timeout"), static_cast<DWORD>(90));
+			Assert::IsTrue(reg::query::string(HKEY_CURRENT_USER, "RegStructKey", "User") == written.user);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey"));
+		}
+
+		TEST_METHOD(Store_Skips_Unchanged_Fields)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+
+			options data;
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(9));
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(0));
+
+			data.user = "admin";
+			data.paths.push_back("E:\\three");
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(2));
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(0));
+
+			// a value stored with another type is rewritten even if the bytes match
+			reg::update::set<std::vector<BYTE>>(HKEY_CURRENT_USER, "RegStructKey", "Timeout", std::vector<BYTE>{ 30, 0, 0, 0 });
+			Assert::AreEqual(reg::store(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(1));
+			Assert::AreEqual(std::get<0>(reg::peekvalue(HKEY_CURRENT_USER, "RegStructKey", "Timeout")), static_cast<DWORD>(REG_DWORD));
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey"));
+		}
+
+		TEST_METHOD(Load_Keeps_Fields_Without_A_Value)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+			reg::create::number(HKEY_CURRENT_USER, "RegStructKey", "Timeout", 5);
+			reg::create::string(HKEY_CURRENT_USER, "RegStructKey", "User", "root");
+
+			options data;
+			Assert::AreEqual(reg::load(HKEY_CURRENT_USER, "RegStructKey", data), static_cast<size_t>(2));
+			Assert::AreEqual(data.timeout, static_cast<DWORD>(5));
+			Assert::IsTrue(data.user == "root");
+			Assert::IsFalse(data.verbose);
+			Assert::IsTrue(data.delay == std::chrono::milliseconds(250));
+			Assert::IsTrue(data.home.text == "%USERPROFILE%");
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey"));
+		}
+
+		TEST_METHOD(Load_Checks_Types)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey");
+			options data;
+
+			Assert::ExpectException<reg::except::key_not_found>([&data] {
+				reg::load(HKEY_CURRENT_USER, "RegStructKey", data);
+				});
+
+			reg::create::string(HKEY_CURRENT_USER, "RegStructKey", "Timeout", "30");
+			Assert::ExpectException<reg::except::type_error>([&data] {
+				reg::load(HKEY_CURRENT_USER, "RegStructKey", data);
+				});
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegStructKey"));
+		}
+	};
+}
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+// the Instrumented configuration of the test project defines REG_INSTRUMENT for every file
+#ifdef REG_INSTRUMENT
+#include "../registry_trace.h"
+
+namespace RegTrace
+{
+	using reg::instrument::function;
+
+	class memory_sink : public reg::trace::sink
+	{
+	public:
+		void write(const reg::trace::event* events, size_t count) override
+		{
+			recorded.insert(recorded.end(), events, events + count);
+		}
+
+		std::vector<reg::trace::event> recorded;
+	};
+
+	std::string read_file(const std::string& filename)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		std::stringstream text;
+		text << in.rdbuf();
+		return text.str();
+	}
+
+	TEST_CLASS(Tracing)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::trace::stop();
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey");
+		}
+
+		TEST_METHOD(Records_Every_Call)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegTraceKey\\Sub", "Number", 1);
+
+			memory_sink sink;
+			reg::trace::start(sink);
+			Assert::IsTrue(reg::trace::enabled());
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey"));
+			reg::trace::stop();
+			Assert::IsFalse(reg::trace::enabled());
+
+			// not recorded
+			reg::create::number(HKEY_CURRENT_USER, "RegTraceKey", "Number", 1);
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey"));
+
+			size_t trees = 0;
+			for (const auto& e : sink.recorded)
+			{
+				Assert::IsTrue(e.end >= e.start);
+				Assert::IsTrue(e.start >= sink.origin);
+				if (e.api == static_cast<std::uint32_t>(function::delete_tree))
+					++trees;
+			}
+			Assert::IsTrue(trees >= 1);
+
+			// remove::cluster starts by checking that the key exists
+			const reg::trace::event& first = sink.recorded.front();
+			Assert::AreEqual(first.api, static_cast<std::uint32_t>(function::open_key));
+			Assert::AreEqual(first.key, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(HKEY_CURRENT_USER)));
+			Assert::AreEqual(first.subject, reg::ihash("regtracekey"));
+			Assert::AreEqual(first.result, static_cast<std::int32_t>(ERROR_SUCCESS));
+			Assert::IsTrue(sink.ns_per_tick > 0);
+		}
+
+		TEST_METHOD(Full_Rings_Drop_Calls)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegTraceKey", "Number", 1);
+			const std::uint64_t dropped = reg::trace::dropped();
+
+			// rings are only moved to the sink when tracing stops
+			memory_sink sink;
+			reg::trace::start(sink, std::chrono::hours(1), 10);
+			std::thread worker([] {
+				for (int i = 0; i < 100; i++)
+					(void)reg::key_exists(HKEY_CURRENT_USER, "RegTraceKey");
+				});
+			worker.join();
+			reg::trace::stop();
+
+			// each key_exists opens and closes the key; the ring holds 16 calls
+			Assert::AreEqual(sink.recorded.size(), static_cast<size_t>(16));
+			Assert::AreEqual(reg::trace::dropped() - dropped, static_cast<std::uint64_t>(184));
+			for (const auto& e : sink.recorded)
+				Assert::AreEqual(e.thread, sink.recorded[0].thread);
+
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey"));
+		}
+
+		TEST_METHOD(File_Sinks)
+		{
+			reg::create::number(HKEY_CURRENT_USER, "RegTraceKey", "Number", 1);
+
+			{
+				reg::trace::chrome_sink chrome("RegTraceTest.json");
+				reg::trace::start(chrome);
+				(void)reg::key_exists(HKEY_CURRENT_USER, "RegTraceKey");
+				reg::trace::stop();
+			}
+			const std::string json = read_file("RegTraceTest.json");
+			Assert::AreEqual(json.find("{\"traceEvents\":["), static_cast<size_t>(0));
+			Assert::IsTrue(json.find("\"name\":\"open_key\"") != std::string::npos);
+			Assert::IsTrue(json.find("\"name\":\"close_key\"") != std::string::npos);
+			Assert::IsTrue(json.find("]}") != std::string::npos);
+
+			{
+				reg::trace::binary_file_sink binary("RegTraceTest.bin");
+				reg::trace::start(binary);
+				(void)reg::key_exists(HKEY_CURRENT_USER, "RegTraceKey");
+				reg::trace::stop();
+			}
+			const std::string bytes = read_file("RegTraceTest.bin");
+			Assert::AreEqual(bytes.substr(0, 4).c_str(), "RGT1");
+			Assert::AreEqual(bytes.size(), static_cast<size_t>(24 + 2 * sizeof(reg::trace::event)));
+
+			std::remove("RegTraceTest.json");
+			std::remove("RegTraceTest.bin");
+			Assert::IsTrue(reg::remove::cluster(HKEY_CURRENT_USER, "RegTraceKey"));
+		}
+	};
+}
+#endif
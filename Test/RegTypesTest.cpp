@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "../registry.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RegTypes
+{
+	enum class mode : int { off, on, automatic };
+	enum class big : ULONGLONG { value = 0x1122334455667788ull };
+
+	static_assert(reg::value_traits<DWORD>::type == REG_DWORD);
+	static_assert(reg::value_traits<int>::type == REG_DWORD);
+	static_assert(reg::value_traits<ULONGLONG>::type == REG_QWORD);
+	static_assert(reg::value_traits<LONGLONG>::type == REG_QWORD);
+	static_assert(reg::value_traits<bool>::type == REG_DWORD);
+	static_assert(reg::value_traits<mode>::type == REG_DWORD);
+	static_assert(reg::value_traits<big>::type == REG_QWORD);
+	static_assert(reg::value_traits<std::chrono::seconds>::type == REG_QWORD);
+	static_assert(reg::value_traits<std::chrono::duration<DWORD, std::milli>>::type == REG_DWORD);
+	static_assert(reg::value_traits<reg::dword_big_endian>::type == REG_DWORD_BIG_ENDIAN);
+	static_assert(reg::value_traits<std::string>::type == REG_SZ);
+	static_assert(reg::value_traits<reg::expand_string>::type == REG_EXPAND_SZ);
+	static_assert(reg::value_traits<std::vector<std::string>>::type == REG_MULTI_SZ);
+	static_assert(reg::value_traits<std::vector<BYTE>>::type == REG_BINARY);
+	static_assert(reg::value_traits<reg::multi_string>::type == REG_MULTI_SZ);
+	static_assert(!reg::value_traits<double>::supported);
+	static_assert(!reg::value_traits<std::chrono::duration<double>>::supported);
+
+	TEST_CLASS(Typed)
+	{
+	public:
+		TEST_CLASS_INITIALIZE(class_setup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegTypesKey");
+		}
+		TEST_CLASS_CLEANUP(class_cleanup) {
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegTypesKey");
+		}
+
+		TEST_METHOD(Numbers_Round_Trip)
+		{
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+
+			reg::update::set<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Qword", 0x123456789ABCDEF0ull);
+			reg::update::set<int>(HKEY_CURRENT_USER, "RegTypesKey", "Negative", -5);
+			reg::update::set<bool>(HKEY_CURRENT_USER, "RegTypesKey", "Flag", true);
+			reg::update::set<mode>(HKEY_CURRENT_USER, "RegTypesKey", "Mode", mode::automatic);
+			reg::update::set<big>(HKEY_CURRENT_USER, "RegTypesKey", "Big", big::value);
+
+			Assert::IsTrue(reg::query::get<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Qword") == 0x123456789ABCDEF0ull);
+			Assert::AreEqual(reg::query::get<int>(HKEY_CURRENT_USER, "RegTypesKey", "Negative"), -5);
+			Assert::IsTrue(reg::query::get<bool>(HKEY_CURRENT_USER, "RegTypesKey", "Flag"));
+			Assert::IsTrue(reg::query::get<mode>(HKEY_CURRENT_USER, "RegTypesKey", "Mode") == mode::automatic);
+			Assert::IsTrue(reg::query::get<big>(HKEY_CURRENT_USER, "RegTypesKey", "Big") == big::value);
+
+			// values written as DWORD stay readable with the older function
+			Assert::AreEqual(reg::query::number(HKEY_CURRENT_USER, "RegTypesKey", "Flag"), static_cast<DWORD>(1));
+		}
+
+		TEST_METHOD(Durations_Read_Either_Size)
+		{
+			using namespace std::chrono;
+			reg::create::number(HKEY_CURRENT_USER, "RegTypesKey", "TimeoutMs", 1500);
+			reg::update::set<seconds>(HKEY_CURRENT_USER, "RegTypesKey", "Interval", seconds(90));
+
+			Assert::IsTrue(reg::query::get<milliseconds>(HKEY_CURRENT_USER, "RegTypesKey", "TimeoutMs") == milliseconds(1500));
+			Assert::IsTrue(reg::query::get<seconds>(HKEY_CURRENT_USER, "RegTypesKey", "Interval") == seconds(90));
+			Assert::AreEqual(std::get<0>(reg::peekvalue(HKEY_CURRENT_USER, "RegTypesKey", "Interval")), static_cast<DWORD>(REG_QWORD));
+		}
+
+		TEST_METHOD(Big_Endian_Is_Stored_Most_Significant_First)
+		{
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			reg::update::set<reg::dword_big_endian>(HKEY_CURRENT_USER, "RegTypesKey", "Network", reg::dword_big_endian{ 0x01020304 });
+
+			BYTE bytes[4] = {};
+			DWORD size = sizeof(bytes);
+			DWORD code = reg::api::get_value(HKEY_CURRENT_USER, "RegTypesKey", "Network", RRF_RT_ANY, NULL, bytes, &size);
+			Assert::AreEqual(code, static_cast<DWORD>(ERROR_SUCCESS));
+			Assert::AreEqual(static_cast<int>(bytes[0]), 1);
+			Assert::AreEqual(static_cast<int>(bytes[3]), 4);
+
+			Assert::AreEqual(reg::query::get<reg::dword_big_endian>(HKEY_CURRENT_USER, "RegTypesKey", "Network").value, static_cast<DWORD>(0x01020304));
+			reg::update::set<DWORD>(HKEY_CURRENT_USER, "RegTypesKey", "Little", 0x01020304);
+			Assert::ExpectException<reg::except::type_error>([] { reg::query::get<reg::dword_big_endian>(HKEY_CURRENT_USER, "RegTypesKey", "Little"); });
+		}
+
+		TEST_METHOD(Strings_Are_Strictly_Typed)
+		{
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			reg::update::set<std::string>(HKEY_CURRENT_USER, "RegTypesKey", "Plain", "text");
+			reg::update::set<reg::expand_string>(HKEY_CURRENT_USER, "RegTypesKey", "Expand", reg::expand_string{ "%TEMP%\\x" });
+
+			Assert::IsTrue(reg::query::get<std::string>(HKEY_CURRENT_USER, "RegTypesKey", "Plain") == "text");
+			Assert::IsTrue(reg::query::get<reg::expand_string>(HKEY_CURRENT_USER, "RegTypesKey", "Expand").text == "%TEMP%\\x");
+			Assert::AreEqual(std::get<0>(reg::peekvalue(HKEY_CURRENT_USER, "RegTypesKey", "Expand")), static_cast<DWORD>(REG_EXPAND_SZ));
+			// the size is that of the text as stored, not of its expansion
+			Assert::AreEqual(std::get<1>(reg::peekvalue(HKEY_CURRENT_USER, "RegTypesKey", "Expand")), static_cast<size_t>(9));
+
+			Assert::ExpectException<reg::except::type_error>([] { reg::query::get<std::string>(HKEY_CURRENT_USER, "RegTypesKey", "Expand"); });
+			Assert::ExpectException<reg::except::type_error>([] { reg::query::get<reg::expand_string>(HKEY_CURRENT_USER, "RegTypesKey", "Plain"); });
+		}
+
+		TEST_METHOD(Multi_Strings_Round_Trip)
+		{
+			const std::vector<std::string> list = { "first", u8"zw\u00F6lf", "third" };
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			reg::update::set<std::vector<std::string>>(HKEY_CURRENT_USER, "RegTypesKey", "List", list);
+			reg::update::set<std::vector<std::string>>(HKEY_CURRENT_USER, "RegTypesKey", "Empty", {});
+
+			std::vector<std::string> read = { "stale", "stale", "stale", "stale" };
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "List", read);
+			Assert::IsTrue(read == list);
+
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Empty", read);
+			Assert::IsTrue(read.empty());
+		}
+
+		TEST_METHOD(Multi_String_View_Reuses_Its_Buffers)
+		{
+			const std::vector<std::string> list = { "C:\\Tools", u8"D:\\\u00DCbung", "E:\\Bin" };
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			reg::update::set<reg::multi_string>(HKEY_CURRENT_USER, "RegTypesKey", "Paths", reg::multi_string(list));
+
+			// readable as a vector too
+			Assert::IsTrue(reg::query::get<std::vector<std::string>>(HKEY_CURRENT_USER, "RegTypesKey", "Paths") == list);
+
+			reg::multi_string paths;
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Paths", paths);
+			Assert::AreEqual(paths.size(), list.size());
+			Assert::IsTrue(std::vector<std::string>(paths.begin(), paths.end()) == list);
+
+			const char* block = paths.block().data();
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Paths", paths);
+			Assert::IsTrue(paths.block().data() == block);
+			Assert::IsTrue(*paths.begin() == "C:\\Tools");
+
+			reg::update::set<std::vector<std::string>>(HKEY_CURRENT_USER, "RegTypesKey", "Paths", {});
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Paths", paths);
+			Assert::IsTrue(paths.empty());
+			Assert::IsTrue(paths.begin() == paths.end());
+		}
+
+		TEST_METHOD(Multi_String_Stops_At_The_First_Empty_Entry)
+		{
+			const char16_t stored[] = u"one\0two\0\0three\0\0";
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			auto handle = reg::self_closing_handle(reg::open(HKEY_CURRENT_USER, "RegTypesKey", KEY_SET_VALUE));
+			reg::api::set_value(*handle, "Odd", REG_MULTI_SZ, reinterpret_cast<const BYTE*>(stored), sizeof(stored));
+
+			reg::multi_string read;
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Odd", read);
+			Assert::AreEqual(read.size(), static_cast<size_t>(2));
+			Assert::IsTrue(read.block() == std::string_view("one\0two\0", 8));
+
+			// written without any terminator
+			reg::api::set_value(*handle, "Odd", REG_MULTI_SZ, reinterpret_cast<const BYTE*>(u"solo"), 8);
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Odd", read);
+			Assert::AreEqual(read.size(), static_cast<size_t>(1));
+			Assert::IsTrue(*read.begin() == "solo");
+		}
+
+		TEST_METHOD(Multi_String_Builder)
+		{
+			reg::multi_string list;
+			list.push_back("a");
+			list.push_back("bc");
+			Assert::AreEqual(list.size(), static_cast<size_t>(2));
+			Assert::IsTrue(list.block() == std::string_view("a\0bc\0", 5));
+
+			list.assign(std::vector<std::string_view>{ "x" });
+			Assert::AreEqual(list.size(), static_cast<size_t>(1));
+			Assert::IsTrue(*list.begin() == "x");
+		}
+
+		TEST_METHOD(String_Reads_Reuse_The_Callers_Buffer)
+		{
+			// two- three- and four-byte characters take the most room when narrowed in place
+			const std::string text = u8"\u00E9t\u00E9 \u6570\u636E \U0001F600 plain";
+			const std::string longer(1000, 'x');
+			reg::create::string(HKEY_CURRENT_USER, "RegTypesKey", "Text", text);
+			reg::create::string(HKEY_CURRENT_USER, "RegTypesKey", "Longer", longer);
+
+			std::string read;
+			reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Text", read);
+			Assert::IsTrue(read == text);
+
+			reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Longer", read);
+			Assert::IsTrue(read == longer);
+
+			const char* storage = read.data();
+			reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Text", read);
+			Assert::IsTrue(read == text);
+			reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Longer", read);
+			Assert::IsTrue(read == longer);
+			Assert::IsTrue(read.data() == storage);
+
+			reg::create::number(HKEY_CURRENT_USER, "RegTypesKey", "Number", 1);
+			Assert::ExpectException<reg::except::type_error>([&read] { reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Number", read); });
+			Assert::ExpectException<reg::except::value_not_found>([&read] { reg::query::string(HKEY_CURRENT_USER, "RegTypesKey", "Missing", read); });
+		}
+
+		TEST_METHOD(Binary_Reuses_The_Callers_Buffer)
+		{
+			const std::vector<BYTE> blob = { 0, 1, 2, 3, 250, 255 };
+			reg::create::key(HKEY_CURRENT_USER, "RegTypesKey");
+			reg::update::set<std::vector<BYTE>>(HKEY_CURRENT_USER, "RegTypesKey", "Blob", blob);
+
+			std::vector<BYTE> read;
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Blob", read);
+			Assert::IsTrue(read == blob);
+
+			read.reserve(64);
+			const BYTE* storage = read.data();
+			reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Blob", read);
+			Assert::IsTrue(read == blob);
+			Assert::IsTrue(read.data() == storage);
+
+			BYTE buffer[16] = {};
+			Assert::AreEqual(reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Blob", buffer, sizeof(buffer)), blob.size());
+			Assert::AreEqual(static_cast<int>(buffer[5]), 255);
+			Assert::ExpectException<std::exception>([] { BYTE small[2]; reg::query::get(HKEY_CURRENT_USER, "RegTypesKey", "Blob", small, sizeof(small)); });
+		}
+
+		TEST_METHOD(Failures_Name_The_Cause)
+		{
+			reg::remove::cluster(HKEY_CURRENT_USER, "RegTypesKey");
+			Assert::ExpectException<reg::except::key_not_found>([] { reg::query::get<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Qword"); });
+			Assert::ExpectException<reg::except::key_not_found>([] { reg::update::set<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Qword", 1); });
+
+			reg::create::number(HKEY_CURRENT_USER, "RegTypesKey", "Dword", 1);
+			Assert::ExpectException<reg::except::value_not_found>([] { reg::query::get<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Qword"); });
+			Assert::ExpectException<reg::except::type_error>([] { reg::query::get<ULONGLONG>(HKEY_CURRENT_USER, "RegTypesKey", "Dword"); });
+		}
+	};
+}
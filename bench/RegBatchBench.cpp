@@ -0,0 +1,39 @@
+#include "bench.h"
+#include "../registry.h"
+#include "../registry_batch.h"
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+/// <summary>5000 DWORD writes, 50 keys with 20 values each rewritten five times,
+/// made one call at a time and through a write_batch</summary>
+BENCHMARK(write_batch)
+{
+	std::vector<std::string> keys;
+	std::vector<std::string> values;
+	for (int i = 0; i < 50; i++)
+		keys.push_back("RegBatchBenchKey\\Key" + std::to_string(i));
+	for (int j = 0; j < 20; j++)
+		values.push_back("Value" + std::to_string(j));
+	for (const std::string& key : keys)
+		for (const std::string& value : values)
+			reg::create::number(HKEY_CURRENT_USER, key, value, 0);
+
+	bench::report("5000 update::number calls", bench::measure(1, [&](size_t) {
+		for (DWORD round = 0; round < 5; round++)
+			for (const std::string& key : keys)
+				for (const std::string& value : values)
+					reg::update::number(HKEY_CURRENT_USER, key, value, round);
+		}, 5) / 1e6, "ms");
+
+	bench::report("5000 writes in a write_batch, one commit", bench::measure(1, [&](size_t) {
+		reg::write_batch batch;
+		for (DWORD round = 0; round < 5; round++)
+			for (const std::string& key : keys)
+				for (const std::string& value : values)
+					batch.set<DWORD>(HKEY_CURRENT_USER, key, value, round);
+		bench::keep(batch.commit());
+		}, 5) / 1e6, "ms");
+
+	reg::remove::cluster(HKEY_CURRENT_USER, "RegBatchBenchKey");
+}
@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "../registry_file.h"
+#include <cstring>
+#include <string>
+#include <Windows.h>
+
+namespace
+{
+	const int sample_keys = 200000;
+
+	/// <summary>Parser handler that only counts what it is given</summary>
+	struct counter
+	{
+		size_t entries = 0;
+
+		void key(std::string_view) { ++entries; }
+		void remove_key(std::string_view) { ++entries; }
+		void value(std::string_view, std::uint32_t, std::string_view) { ++entries; }
+		void remove_value(std::string_view) { ++entries; }
+	};
+
+	/// <summary>A .reg file with one key per program, each holding a path, a DWORD and a small blob</summary>
+	/// <param name='name'>The last segment of every key path, followed by its number</param>
+	std::string sample(reg::file::encoding encoding, const std::string& name)
+	{
+		std::string out;
+		auto sink = [&out](std::string_view bytes) { out.append(bytes.data(), bytes.size()); };
+		reg::file::writer<decltype(sink)> writer(sink, encoding);
+
+		std::string text;
+		std::string dword(4, '\0');
+		const std::string blob(40, '\x5A');
+		for (int i = 0; i < sample_keys; i++)
+		{
+			const std::string number = std::to_string(i);
+			writer.key("HKEY_CURRENT_USER\\Software\\RegFileBench\\" + name + number);
+			text.clear();
+			reg::utf::append_utf16le("C:\\Program Files\\Vendor\\Product " + number + "\\bin\\app.exe", text);
+			writer.value("Path", REG_SZ, text);
+			std::memcpy(&dword[0], &i, sizeof(i));
+			writer.value("Count", REG_DWORD, dword);
+			writer.value("Blob", REG_BINARY, blob);
+		}
+		writer.flush();
+		return out;
+	}
+
+	void run(const char* label, const std::string& file)
+	{
+		const size_t chunk = 1 << 16;
+		const double ns = bench::measure(1, [&file, chunk](size_t) {
+			counter handler;
+			reg::file::parser<counter> parser(handler);
+			for (size_t offset = 0; offset < file.size(); offset += chunk)
+				parser.feed(std::string_view(file).substr(offset, chunk));
+			parser.finish();
+			bench::keep(handler.entries);
+			}, 3);
+		bench::report(label, static_cast<double>(file.size()) / ns * 1e3, "MB/s");
+	}
+}
+
+/// <summary>Parsing a generated .reg file of 200k keys, fed in 64 KB chunks</summary>
+BENCHMARK(reg_file_parse)
+{
+	run("version 5.00, UTF-16LE", sample(reg::file::encoding::UTF16LE, "Key"));
+	run("version 5.00, UTF-8", sample(reg::file::encoding::UTF8, "Key"));
+
+	// every key line is converted from the ANSI code page before it is tokenized
+	std::string ansi = sample(reg::file::encoding::UTF8, "Cl\xE9");
+	ansi.replace(0, ansi.find('\r'), "REGEDIT4");
+	run("REGEDIT4, non-ASCII key names", ansi);
+}
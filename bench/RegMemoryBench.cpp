@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "../registry_memory.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const size_t sample_keys = 100000;
+	const size_t values_per_key = 100;
+
+	std::string key_path(size_t i)
+	{
+		return "Group" + std::to_string(i % 100) + "\\Key" + std::to_string(i);
+	}
+}
+
+/// <summary>A store of 100k keys with 100 values each: building it, looking values up,
+/// enumerating and removing them one by one</summary>
+BENCHMARK(memory_store)
+{
+	std::vector<std::string> names;
+	for (size_t j = 0; j < values_per_key; j++)
+		names.push_back("Value" + std::to_string(j));
+
+	reg::memory::store store;
+	std::vector<reg::memory::store::node> keys(sample_keys);
+	const double insert = bench::measure(sample_keys, [&](size_t i) {
+		keys[i] = store.create(key_path(i));
+		for (size_t j = 0; j < values_per_key; j++)
+		{
+			const std::uint32_t data = static_cast<std::uint32_t>(i * values_per_key + j);
+			store.set(keys[i], names[j], reg::types::dword, std::string_view(reinterpret_cast<const char*>(&data), sizeof(data)));
+		}
+		}, 1);
+	bench::report("insert, per value", insert / values_per_key);
+
+	std::mt19937 random(31);
+	std::vector<std::pair<size_t, size_t>> picks(1 << 16);
+	for (auto& pick : picks)
+		pick = { random() % sample_keys, random() % values_per_key };
+	bench::report("get a value of a resolved key", bench::measure(1 << 22, [&](size_t i) {
+		const auto& [key, value] = picks[i % picks.size()];
+		bench::keep(store.get(keys[key], names[value])->data.size());
+		}));
+
+	std::vector<std::string> paths;
+	for (const auto& pick : picks)
+		paths.push_back(key_path(pick.first));
+	bench::report("open a path and get a value, random", bench::measure(1 << 20, [&](size_t i) {
+		const auto& pick = picks[i % picks.size()];
+		bench::keep(store.get(*store.open(paths[i % paths.size()]), names[pick.second])->data.size());
+		}));
+	bench::report("open a path and get a value, in order", bench::measure(sample_keys, [&](size_t i) {
+		const std::string path = key_path(i);
+		bench::keep(store.get(*store.open(path), names[i % values_per_key])->data.size());
+		}, 3));
+
+	const double enumerate = bench::measure(sample_keys, [&](size_t i) {
+		std::uint64_t bytes = 0;
+		for (size_t j = 0; j < values_per_key; j++)
+			bytes += store.value(keys[i], j)->data.size();
+		bench::keep(bytes);
+		}, 3);
+	bench::report("enumerate values by index, per value", enumerate / values_per_key);
+
+	// first value to last, so every removal shifts the indices of all the values after it
+	const double unset = bench::measure(1000, [&](size_t i) {
+		for (size_t j = 0; j < values_per_key; j++)
+			store.unset(keys[i], names[j]);
+		}, 1);
+	bench::report("remove values one by one, per value", unset / values_per_key);
+
+	bench::report("remove a group of 1000 keys", bench::measure(10, [&](size_t i) {
+		bench::keep(store.remove("Group" + std::to_string(i)));
+		}, 1) / 1e6, "ms");
+}
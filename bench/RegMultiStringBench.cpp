@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../registry.h"
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+/// <summary>A REG_MULTI_SZ list of 100k host names read into a reused vector and a reused multi_string</summary>
+BENCHMARK(multi_string)
+{
+	std::vector<std::string> list;
+	for (int i = 0; i < 100000; i++)
+		list.push_back("host-" + std::to_string(i) + ".example.internal");
+
+	const char* key = "RegMultiStringBenchKey";
+	reg::create::key(HKEY_CURRENT_USER, key);
+	reg::update::set<std::vector<std::string>>(HKEY_CURRENT_USER, key, "List", list);
+
+	std::vector<std::string> strings;
+	bench::report("read into a reused vector<string>", bench::measure(1, [&](size_t) {
+		reg::query::get(HKEY_CURRENT_USER, key, "List", strings);
+		bench::keep(strings.size());
+		}, 20) / 1e6, "ms");
+
+	reg::multi_string entries;
+	bench::report("read into a reused multi_string", bench::measure(1, [&](size_t) {
+		reg::query::get(HKEY_CURRENT_USER, key, "List", entries);
+		bench::keep(entries.size());
+		}, 20) / 1e6, "ms");
+
+	bench::report("iterate the multi_string", bench::measure(1, [&](size_t) {
+		size_t bytes = 0;
+		for (std::string_view entry : entries)
+			bytes += entry.size();
+		bench::keep(bytes);
+		}, 20) / 1e6, "ms");
+
+	reg::multi_string built;
+	bench::report("assign 100k strings to a reused multi_string", bench::measure(1, [&](size_t) {
+		built.assign(list);
+		bench::keep(built.size());
+		}, 20) / 1e6, "ms");
+
+	// the registry call itself may allocate; the count includes it
+	bench::allocations = 0;
+	reg::query::get(HKEY_CURRENT_USER, key, "List", strings);
+	bench::report("allocations, reading into the vector again", static_cast<double>(bench::allocations), "");
+	bench::allocations = 0;
+	reg::query::get(HKEY_CURRENT_USER, key, "List", entries);
+	bench::report("allocations, reading into the multi_string again", static_cast<double>(bench::allocations), "");
+	bench::allocations = 0;
+	built.assign(list);
+	bench::report("allocations, assigning again", static_cast<double>(bench::allocations), "");
+
+	reg::remove::cluster(HKEY_CURRENT_USER, key);
+}
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "../registry.h"
+#include "../registry_name.h"
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+namespace
+{
+	const size_t sample_size = 1000;
+
+	/// <summary>Names of the keys below HKEY_CLASSES_ROOT\CLSID, or random CLSIDs where there are none</summary>
+	std::vector<std::string> clsids()
+	{
+		std::vector<std::string> names;
+		try
+		{
+			names = reg::query::keys(HKEY_CLASSES_ROOT, "CLSID");
+		}
+		catch (const std::exception&) {}
+		if (names.size() > sample_size)
+			names.resize(sample_size);
+
+		std::mt19937 random(33);
+		while (names.size() < sample_size)
+		{
+			unsigned part[6];
+			for (unsigned& p : part)
+				p = static_cast<unsigned>(random());
+			char text[39];
+			std::snprintf(text, sizeof(text), "{%08X-%04X-%04X-%04X-%04X%08X}",
+				part[0], part[1] & 0xFFFF, part[2] & 0xFFFF, part[3] & 0xFFFF, part[4] & 0xFFFF, part[5]);
+			names.push_back(text);
+		}
+		return names;
+	}
+
+	/// <summary>Names of the keys one and two levels below HKEY_LOCAL_MACHINE\SOFTWARE,
+	/// topped up with common vendor and product key names</summary>
+	std::vector<std::string> software()
+	{
+		std::vector<std::string> names;
+		try
+		{
+			for (const std::string& vendor : reg::query::keys(HKEY_LOCAL_MACHINE, "SOFTWARE"))
+			{
+				names.push_back(vendor);
+				try
+				{
+					for (const std::string& product : reg::query::keys(HKEY_LOCAL_MACHINE, "SOFTWARE\\" + vendor))
+						names.push_back(product);
+				}
+				catch (const std::exception&) {}
+			}
+		}
+		catch (const std::exception&) {}
+		if (names.size() > sample_size)
+			names.resize(sample_size);
+
+		const char* common[] = { "Microsoft", "Windows", "CurrentVersion", "Explorer", "Policies", "Classes",
+			"Run", "Uninstall", "Internet Settings", "Shell Extensions", "Approved", "Wow6432Node", "Google",
+			"Chrome", "Mozilla", "Firefox", "Adobe", "Intel", "NVIDIA Corporation", "Clients", "StartMenuInternet",
+			"RegisteredApplications", "Capabilities", "FileAssociations", "App Paths", "Installer", "UserData" };
+		for (size_t i = 0; names.size() < sample_size; i++)
+			names.push_back(common[i % (sizeof(common) / sizeof(common[0]))]);
+		return names;
+	}
+
+	std::string lower(std::string text)
+	{
+		for (char& c : text)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return text;
+	}
+
+	void run(const char* set, const std::vector<std::string>& names)
+	{
+		std::vector<std::string> folded;
+		std::vector<std::u16string> wide, wide_folded;
+		for (const std::string& name : names)
+		{
+			folded.push_back(lower(name));
+			wide.push_back(reg::utf::to_utf16(name));
+			wide_folded.push_back(reg::utf::to_utf16(folded.back()));
+		}
+
+		const size_t n = names.size();
+		std::printf(" %s\n", set);
+		bench::report("ihash", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(reg::ihash(names[i % n]));
+			}));
+		bench::report("iequals, other case", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(reg::iequals(names[i % n], folded[i % n]));
+			}));
+		bench::report("icompare, other case", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(static_cast<std::uint64_t>(reg::icompare(names[i % n], folded[i % n])));
+			}));
+		bench::report("icompare, next name", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(static_cast<std::uint64_t>(reg::icompare(names[i % n], folded[(i + 1) % n])));
+			}));
+		bench::report("iequals UTF-16, other case", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(reg::iequals(wide[i % n], wide_folded[i % n]));
+			}));
+		bench::report("ihash UTF-16", bench::measure(100 * n, [&](size_t i) {
+			bench::keep(reg::ihash(wide[i % n]));
+			}));
+	}
+}
+
+/// <summary>The case-insensitive name kernels over CLSIDs and the key names found under Software</summary>
+BENCHMARK(names)
+{
+	run("CLSID", clsids());
+	run("Software", software());
+}
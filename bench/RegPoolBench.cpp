@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../registry.h"
+#include "../registry_pool.h"
+#include <string>
+#include <thread>
+#include <vector>
+#include <Windows.h>
+
+namespace
+{
+	const size_t reads = 400000;
+
+	/// <summary>Splits the reads over the threads and returns the wall time per read</summary>
+	template<typename F>
+	double spread(size_t threads, F read)
+	{
+		return bench::measure(1, [threads, &read](size_t) {
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; t++)
+				workers.emplace_back([t, threads, &read] {
+					for (size_t i = t; i < reads; i += threads)
+						read(i);
+					});
+			for (std::thread& worker : workers)
+				worker.join();
+			}, 3) / reads;
+	}
+}
+
+/// <summary>400k reads of 300 keys split over 1 to 64 threads, opening and closing each key
+/// per read and reading through a shared handle_pool.
+/// Times are wall clock per read, so they show contention, not the cost on one thread.</summary>
+BENCHMARK(handle_pool)
+{
+	std::vector<std::string> keys;
+	for (int i = 0; i < 300; i++)
+	{
+		keys.push_back("RegPoolBenchKey\\Key" + std::to_string(i));
+		reg::create::number(HKEY_CURRENT_USER, keys.back(), "Value", static_cast<DWORD>(i));
+	}
+
+	reg::handle_pool pool;
+	for (size_t threads : { 1, 4, 16, 64 })
+	{
+		std::printf(" %zu threads\n", threads);
+		bench::report("query::number, open/get/close", spread(threads, [&keys](size_t i) {
+			bench::keep(reg::query::number(HKEY_CURRENT_USER, keys[i % keys.size()], "Value"));
+			}));
+		bench::report("handle_pool::get", spread(threads, [&keys, &pool](size_t i) {
+			bench::keep(pool.get<DWORD>(HKEY_CURRENT_USER, keys[i % keys.size()], "Value"));
+			}));
+	}
+
+	reg::remove::cluster(HKEY_CURRENT_USER, "RegPoolBenchKey");
+}
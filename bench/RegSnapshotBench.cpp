@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "../registry_file.h"
+#include "../registry_snapshot.h"
+#include "../registry_source.h"
+#include <random>
+#include <sstream>
+#include <string>
+#include <Windows.h>
+
+namespace
+{
+	const int sample_keys = 200000;
+
+	/// <summary>200k product keys spread over 100 vendors, each with six values of the common types</summary>
+	reg::tree sample()
+	{
+		reg::tree root;
+		std::string text;
+		for (int i = 0; i < sample_keys; i++)
+		{
+			const std::string number = std::to_string(i);
+			reg::tree& key = root.create("Vendor" + std::to_string(i % 100) + "\\Product" + number);
+			text.clear();
+			reg::utf::append_utf16le("C:\\Program Files\\Vendor\\Product " + number, text);
+			key.set("InstallLocation", reg::types::sz, text);
+			text.clear();
+			reg::utf::append_utf16le("Product " + number, text);
+			key.set("DisplayName", reg::types::sz, text);
+			text.clear();
+			reg::utf::append_utf16le("1." + std::to_string(i % 10) + ".0", text);
+			key.set("DisplayVersion", reg::types::sz, text);
+			key.set("EstimatedSize", reg::types::dword, std::string(reinterpret_cast<const char*>(&i), 4));
+			key.set("NoModify", reg::types::dword, std::string("\1\0\0\0", 4));
+			key.set("Signature", reg::types::binary, std::string(16, static_cast<char>(i)));
+		}
+		return root;
+	}
+}
+
+/// <summary>Snapshot size, open and lookup against the same tree exported as a UTF-16 .reg file</summary>
+BENCHMARK(snapshot)
+{
+	const reg::tree root = sample();
+	reg::source::tree source(root);
+
+	std::string image;
+	const double written = bench::measure(1, [&](size_t) {
+		image.clear();
+		reg::snapshot::write(source, &root, [&image](std::string_view block) { image.append(block.data(), block.size()); });
+		}, 3);
+
+	std::string text;
+	auto sink = [&text](std::string_view bytes) { text.append(bytes.data(), bytes.size()); };
+	reg::file::writer<decltype(sink)> writer(sink);
+	reg::source::walk(source, &root, "HKEY_CURRENT_USER\\Software", writer);
+	writer.flush();
+
+	bench::report("snapshot size", static_cast<double>(image.size()) / (1 << 20), "MB");
+	bench::report(".reg size (UTF-16LE)", static_cast<double>(text.size()) / (1 << 20), "MB");
+	bench::report("write snapshot", written / 1e6, "ms");
+
+	bench::report("open snapshot", bench::measure(1000, [&image](size_t) {
+		reg::snapshot::file snapshot(image);
+		bench::keep(snapshot.root());
+		}));
+	bench::report("parse .reg into a tree", bench::measure(1, [&text](size_t) {
+		std::istringstream in(text);
+		bench::keep(reg::file::load(in).find("HKEY_CURRENT_USER") != nullptr);
+		}, 3) / 1e6, "ms");
+
+	const reg::snapshot::file snapshot(image);
+	std::vector<std::string> paths;
+	std::mt19937 random(28);
+	for (int i = 0; i < 1000; i++)
+	{
+		const int product = static_cast<int>(random() % sample_keys);
+		paths.push_back("VENDOR" + std::to_string(product % 100) + "\\product" + std::to_string(product));
+	}
+	bench::report("open path and get a value, in place", bench::measure(100 * paths.size(), [&](size_t i) {
+		std::optional<reg::snapshot::file::node> key = snapshot.open(paths[i % paths.size()]);
+		bench::keep(key ? snapshot.get(*key, "DisplayName")->data.size() : 0);
+		}));
+}
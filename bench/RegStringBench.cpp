@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "../registry.h"
+#include <string>
+#include <Windows.h>
+
+namespace
+{
+	const char* key = "RegStringBenchKey";
+
+	void run(const char* value, size_t characters)
+	{
+		reg::create::string(HKEY_CURRENT_USER, key, value, std::string(characters, 'v'));
+		std::printf(" %zu characters\n", characters);
+
+		bench::report("query::string", bench::measure(100000, [value](size_t) {
+			bench::keep(reg::query::string(HKEY_CURRENT_USER, key, value).size());
+			}));
+		bench::allocations = 0;
+		bench::keep(reg::query::string(HKEY_CURRENT_USER, key, value).size());
+		bench::report("  allocations per call", static_cast<double>(bench::allocations), "");
+
+		std::string data;
+		bench::report("query::string into a reused string", bench::measure(100000, [value, &data](size_t) {
+			reg::query::string(HKEY_CURRENT_USER, key, value, data);
+			bench::keep(data.size());
+			}));
+		bench::allocations = 0;
+		reg::query::string(HKEY_CURRENT_USER, key, value, data);
+		bench::report("  allocations per call", static_cast<double>(bench::allocations), "");
+	}
+}
+
+/// <summary>Polling one REG_SZ value, returned by value and read into the caller's string.
+/// The allocation counts include any the registry call itself makes.</summary>
+BENCHMARK(string_poll)
+{
+	reg::create::key(HKEY_CURRENT_USER, key);
+	run("Short", 52);
+	run("Long", 2000);
+	reg::remove::cluster(HKEY_CURRENT_USER, key);
+}
@@ -0,0 +1,95 @@
+#include "bench.h"
+#include "../registry.h"
+#include "../registry_utf.h"
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include <Windows.h>
+
+namespace
+{
+	/// <summary>Counts the allocations made through it</summary>
+	class counting_resource : public std::pmr::memory_resource
+	{
+	public:
+		size_t allocations = 0;
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			++allocations;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+
+	/// <summary>500 names, half of them CLSIDs and half common key names</summary>
+	std::vector<std::string> names()
+	{
+		const char* common[] = { "Software", "Microsoft", "Windows", "CurrentVersion", "Explorer", "Policies",
+			"Run", "Uninstall", "Internet Settings", "Shell Extensions", "InprocServer32", "ThreadingModel" };
+		std::vector<std::string> result;
+		std::mt19937 random(34);
+		for (size_t i = 0; i < 250; i++)
+		{
+			char text[39];
+			std::snprintf(text, sizeof(text), "{%08X-%04X-%04X-%04X-%04X%08X}", static_cast<unsigned>(random()),
+				static_cast<unsigned>(random() & 0xFFFF), static_cast<unsigned>(random() & 0xFFFF),
+				static_cast<unsigned>(random() & 0xFFFF), static_cast<unsigned>(random() & 0xFFFF), static_cast<unsigned>(random()));
+			result.push_back(text);
+			result.push_back(common[i % (sizeof(common) / sizeof(common[0]))]);
+		}
+		return result;
+	}
+}
+
+/// <summary>Converting names and value data between UTF-8 and UTF-16</summary>
+BENCHMARK(utf)
+{
+	const std::vector<std::string> narrow = names();
+	std::vector<std::u16string> wide;
+	for (const std::string& name : narrow)
+		wide.push_back(reg::utf::to_utf16(name));
+
+	counting_resource heap;
+	reg::utf::small_buffer<char16_t> units(&heap);
+	bench::report("UTF-8 -> UTF-16 name, into a small_buffer", bench::measure(1000 * narrow.size(), [&](size_t i) {
+		bench::keep(reg::utf::to_utf16(narrow[i % narrow.size()], units));
+		}));
+	bench::report("  heap allocations", static_cast<double>(heap.allocations), "");
+
+	std::string out;
+	bench::report("UTF-16 -> UTF-8 name", bench::measure(1000 * wide.size(), [&](size_t i) {
+		const std::u16string& name = wide[i % wide.size()];
+		out.clear();
+		reg::utf::append_utf8(name.data(), name.size(), out);
+		bench::keep(out.size());
+		}));
+
+	// 4 KB of text with an accented letter every 64 characters
+	std::string text;
+	while (text.size() < 4096)
+		text += std::string(62, 'x') + "\xC3\xA9";
+	const std::u16string data = reg::utf::to_utf16(text);
+	std::vector<char16_t> buffer(text.size());
+	bench::report("UTF-8 -> UTF-16, 4 KB mostly ASCII", static_cast<double>(text.size()) / bench::measure(100000, [&](size_t) {
+		bench::keep(reg::utf::to_utf16(text, buffer.data()));
+		}), "GB/s");
+	bench::report("UTF-16 -> UTF-8, 4 KB mostly ASCII", static_cast<double>(text.size()) / bench::measure(100000, [&](size_t) {
+		out.clear();
+		reg::utf::append_utf8(data.data(), data.size(), out);
+		bench::keep(out.size());
+		}), "GB/s");
+
+	// every call converts the key and value name on the stack for the wide API
+	reg::create::number(HKEY_CURRENT_USER, "RegUtfBenchKey\\Sub", "Value", 34);
+	bench::report("query::number, key and value name converted", bench::measure(100000, [](size_t) {
+		bench::keep(reg::query::number(HKEY_CURRENT_USER, "RegUtfBenchKey\\Sub", "Value"));
+		}));
+	reg::remove::cluster(HKEY_CURRENT_USER, "RegUtfBenchKey");
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A small harness for the benchmarks in this directory. They are built by Bench.vcxproj,
+// outside the test project, and are meant to be run from a Release build.
+// Each benchmark registers itself with BENCHMARK(name); main runs all of them, or only
+// those whose name contains the first command line argument.
+
+namespace bench
+{
+	struct benchmark
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	inline std::vector<benchmark>& all()
+	{
+		static std::vector<benchmark> list;
+		return list;
+	}
+
+	struct registration
+	{
+		registration(const char* name, void (*run)()) { all().push_back({ name, run }); }
+	};
+
+	inline thread_local volatile std::uint64_t sink;
+
+	/// <summary>Global heap allocations made by the current thread, counted by the operator new in main.cpp</summary>
+	inline thread_local size_t allocations = 0;
+
+	/// <summary>Stores a result where the optimizer cannot see it go unused</summary>
+	inline void keep(std::uint64_t value)
+	{
+		sink = value;
+	}
+
+	/// <summary>Times a loop several times over and returns the fastest round</summary>
+	/// <param name='iterations'>How often one round calls the body</param>
+	/// <param name='body'>Called with the iteration index</param>
+	/// <param name='rounds'>How many rounds to run</param>
+	/// <returns>Nanoseconds per iteration</returns>
+	template<typename F>
+	double measure(size_t iterations, F&& body, int rounds = 5)
+	{
+		double best = 0;
+		for (int round = 0; round < rounds; round++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < iterations; i++)
+				body(i);
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			const double each = elapsed.count() / static_cast<double>(iterations);
+			best = round == 0 ? each : std::min(best, each);
+		}
+		return best;
+	}
+
+	/// <summary>Prints one result line</summary>
+	inline void report(const char* label, double value, const char* unit = "ns")
+	{
+		std::printf("  %-48s %12.1f %s\n", label, value, unit);
+	}
+}
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static const bench::registration name##_registration(#name, &name); \
+	static void name()
@@ -0,0 +1,34 @@
+#include "bench.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+void* operator new(std::size_t size)
+{
+	++bench::allocations;
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+	for (const bench::benchmark& b : bench::all())
+	{
+		if (argc > 1 && std::strstr(b.name, argv[1]) == nullptr)
+			continue;
+		std::printf("%s\n", b.name);
+		b.run();
+	}
+	return 0;
+}
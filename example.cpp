@@ -1,5 +1,6 @@
 #include <Windows.h>
 #include "./registry.h"
+#include "./registry_apply.h"
 
 class voidbuff : public std::streambuf {};
 voidbuff nostreambuff;
@@ -116,5 +117,12 @@ int main()
 
     // Example sets Windows Explorer to open by default to "This PC" rather than "Quick Explorer"
     ChangeRegirtyNumber(HKEY_CURRENT_USER, EXPLORER_REGISTER_PATH, EXPLORER_THISPC, 1);
-    
+
+    // The same changes described as a desired state: each key is opened once
+    // and only the values that differ are written
+    reg::spec desired;
+    desired.set<std::string>(HKEY_CLASSES_ROOT, NOTEPAD_ADDON, "", NOTEPAD_EXEC);
+    desired.set<DWORD>(HKEY_CURRENT_USER, EXPLORER_REGISTER_PATH, EXPLORER_THISPC, 1);
+    reg::apply_result result = reg::apply(desired);
+    log(4) << result.created << " created, " << result.updated << " updated, " << result.unchanged << " unchanged\n";
 }
\ No newline at end of file
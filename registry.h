@@ -1,5 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <tuple>
 #include <functional>
@@ -7,7 +13,11 @@
 #include <string_view>
 #include <string>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 #include <Windows.h>
+#include "registry_utf.h"
+#include "registry_instrument.h"
 
 namespace reg
 {
@@ -173,6 +183,132 @@ namespace reg
 		}
 	}
 
+	/// <summary>The calls the library makes into the registry.<para/>
+	/// Every function reaches the registry through this namespace, which uses the wide
+	/// (UTF-16) entry points: names keep every character regardless of the system code
+	/// page, and the kernel does not convert them a second time. Names and paths are
+	/// taken as UTF-8 and converted on the stack; those shorter than 256 bytes are
+	/// converted without allocating. Error codes are returned as the API returns them.</summary>
+	namespace api
+	{
+		static_assert(sizeof(wchar_t) == sizeof(char16_t), "the registry expects UTF-16 names");
+
+		namespace
+		{
+			using _wide = reg::utf::small_buffer<char16_t>;
+
+			inline LPCWSTR _convert(std::string_view utf8, _wide& buffer)
+			{
+				reg::utf::to_utf16(utf8, buffer);
+				return reinterpret_cast<LPCWSTR>(buffer.data());
+			}
+		}
+
+		inline LSTATUS open_key(HKEY parent, std::string_view path, REGSAM rights, PHKEY handle)
+		{
+			_wide wide_path;
+			return REG_API_CALL(open_key, parent, path, RegOpenKeyExW(parent, reg::api::_convert(path, wide_path), NULL, rights, handle));
+		}
+
+		inline LSTATUS create_key(HKEY parent, std::string_view path, REGSAM rights, PHKEY handle, LPDWORD disposition)
+		{
+			_wide wide_path;
+			return REG_API_CALL(create_key, parent, path, RegCreateKeyExW(parent, reg::api::_convert(path, wide_path), NULL, NULL,
+				REG_OPTION_NON_VOLATILE, rights, NULL, handle, disposition));
+		}
+
+		inline LSTATUS close_key(HKEY handle)
+		{
+			return REG_API_CALL(close_key, handle, {}, RegCloseKey(handle));
+		}
+
+		inline LSTATUS query_value(HKEY handle, std::string_view name, LPDWORD type, LPBYTE data, LPDWORD size)
+		{
+			_wide wide_name;
+			return REG_API_CALL(query_value, handle, name, RegQueryValueExW(handle, reg::api::_convert(name, wide_name), NULL, type, data, size));
+		}
+
+		/// <summary>RegGetValueW; string data is returned as UTF-16</summary>
+		inline LSTATUS get_value(HKEY parent, std::string_view path, std::string_view name, DWORD flags, LPDWORD type, PVOID data, LPDWORD size)
+		{
+			_wide wide_path;
+			_wide wide_name;
+			return REG_API_CALL(get_value, parent, path, RegGetValueW(parent, reg::api::_convert(path, wide_path), reg::api::_convert(name, wide_name),
+				flags, type, data, size));
+		}
+
+		/// <summary>RegSetValueExW; string data must be UTF-16</summary>
+		inline LSTATUS set_value(HKEY handle, std::string_view name, DWORD type, const BYTE* data, DWORD size)
+		{
+			_wide wide_name;
+			return REG_API_CALL(set_value, handle, name, RegSetValueExW(handle, reg::api::_convert(name, wide_name), NULL, type, data, size));
+		}
+
+		inline LSTATUS delete_value(HKEY handle, std::string_view name)
+		{
+			_wide wide_name;
+			return REG_API_CALL(delete_value, handle, name, RegDeleteValueW(handle, reg::api::_convert(name, wide_name)));
+		}
+
+		inline LSTATUS delete_key(HKEY parent, std::string_view path, REGSAM view)
+		{
+			_wide wide_path;
+			return REG_API_CALL(delete_key, parent, path, RegDeleteKeyExW(parent, reg::api::_convert(path, wide_path), view, NULL));
+		}
+
+		inline LSTATUS delete_tree(HKEY parent, std::string_view path)
+		{
+			_wide wide_path;
+			return REG_API_CALL(delete_tree, parent, path, RegDeleteTreeW(parent, reg::api::_convert(path, wide_path)));
+		}
+
+		/// <summary>RegQueryInfoKeyW; name lengths are in UTF-16 code units, without the terminator</summary>
+		inline LSTATUS query_info(HKEY handle, LPDWORD subkeys, LPDWORD max_key_name, LPDWORD values,
+			LPDWORD max_value_name, LPDWORD max_data, PFILETIME last_write)
+		{
+			return REG_API_CALL(query_info, handle, {}, RegQueryInfoKeyW(handle, NULL, NULL, NULL, subkeys, max_key_name, NULL, values,
+				max_value_name, max_data, NULL, last_write));
+		}
+
+		/// <summary>RegQueryInfoKeyW including the class name, which is returned as UTF-16</summary>
+		inline LSTATUS query_info(HKEY handle, char16_t* class_name, LPDWORD class_length, LPDWORD subkeys, LPDWORD max_key_name,
+			LPDWORD values, LPDWORD max_value_name, LPDWORD max_data, PFILETIME last_write)
+		{
+			return REG_API_CALL(query_info, handle, {}, RegQueryInfoKeyW(handle, reinterpret_cast<LPWSTR>(class_name), class_length, NULL, subkeys, max_key_name, NULL,
+				values, max_value_name, max_data, NULL, last_write));
+		}
+
+		/// <summary>RegEnumKeyExW; the name is returned as UTF-16</summary>
+		inline LSTATUS enum_key(HKEY handle, DWORD index, char16_t* name, LPDWORD length)
+		{
+			return REG_API_CALL(enum_key, handle, {}, RegEnumKeyExW(handle, index, reinterpret_cast<LPWSTR>(name), length, NULL, NULL, NULL, NULL));
+		}
+
+		/// <summary>RegEnumValueW; the name is returned as UTF-16</summary>
+		inline LSTATUS enum_value(HKEY handle, DWORD index, char16_t* name, LPDWORD length, LPDWORD type, LPBYTE data, LPDWORD size)
+		{
+			return REG_API_CALL(enum_value, handle, {}, RegEnumValueW(handle, index, reinterpret_cast<LPWSTR>(name), length, NULL, type, data, size));
+		}
+
+		/// <summary>RegQueryMultipleValuesW; the names in the list must be null-terminated UTF-16</summary>
+		inline LSTATUS query_values(HKEY handle, PVALENTW list, DWORD count, LPBYTE data, LPDWORD size)
+		{
+			return REG_API_CALL(query_values, handle, {}, RegQueryMultipleValuesW(handle, list, count, reinterpret_cast<LPWSTR>(data), size));
+		}
+
+		inline LSTATUS get_key_security(HKEY handle, SECURITY_INFORMATION information, PSECURITY_DESCRIPTOR descriptor, LPDWORD size)
+		{
+			return REG_API_CALL(get_key_security, handle, {}, RegGetKeySecurity(handle, information, descriptor, size));
+		}
+
+		/// <summary>RegNotifyChangeKeyValue, asynchronous: the event is signaled once, on the
+		/// next matching change, and the notification has to be requested again after that</summary>
+		inline LSTATUS notify_change(HKEY handle, bool subtree, DWORD filter, HANDLE event)
+		{
+			return REG_API_CALL(notify_change, handle, {}, RegNotifyChangeKeyValue(handle, subtree ? TRUE : FALSE, filter, event, TRUE));
+		}
+	}
+
 	template<typename T>
 	using deleted_unique_ptr = std::unique_ptr<T, std::function<void(T*)>>;
 
@@ -180,7 +316,7 @@ namespace reg
 	/// that will close the registry key upon deletion.</summary>
 	[[nodiscard]]
 	inline deleted_unique_ptr<HKEY> self_closing_handle() {
-		return deleted_unique_ptr<HKEY>(new HKEY, [](HKEY* handle) {RegCloseKey(*handle); });
+		return deleted_unique_ptr<HKEY>(new HKEY, [](HKEY* handle) {reg::api::close_key(*handle); });
 	}
 
 	/// <summary>Creates a unique_ptr from the given HKEY
@@ -188,7 +324,7 @@ namespace reg
 	/// <param name='handle'>A handle to an open registry key as returned by RegCreateKey(...) or RegOpenKey(...)</param>
 	[[nodiscard]]
 	inline deleted_unique_ptr<HKEY> self_closing_handle(HKEY* handle) {
-		return deleted_unique_ptr<HKEY>(handle, [](HKEY* h) {RegCloseKey(*h); });
+		return deleted_unique_ptr<HKEY>(handle, [](HKEY* h) {reg::api::close_key(*h); });
 	}
 
 	/// <summary>Opens a registry key with the desired access rights (e.g. KEY_READ or KEY_WRITE)
@@ -203,13 +339,13 @@ namespace reg
 		PHKEY handle = new HKEY;
 		DWORD result = NULL;
 
-		// RegOpenKeyEx(HKEY hkey, LPCSTR lpSubKey, DWORD ulOptions, REGSAM samDesired, PHKEY phkResult)
+		// RegOpenKeyExW(HKEY hkey, LPCWSTR lpSubKey, DWORD ulOptions, REGSAM samDesired, PHKEY phkResult)
 		// hkey			- main hierarchical key
 		// lpSubKey		- subkey in the tree
 		// ulOptions	- option to open key as a symbolic link
 		// samDesired	- desired access rights
 		// phkResult	- handle to the opened key
-		result = RegOpenKeyEx(machine, key.data(), NULL, rights, handle);
+		result = reg::api::open_key(machine, key, rights, handle);
 
 		reg::assert::success(result);
 
@@ -224,10 +360,11 @@ namespace reg
 	[[nodiscard]]
 	inline bool key_exists(HKEY machine, std::string_view key) noexcept
 	{
+		REG_OPERATION("key_exists");
 		auto handle = self_closing_handle();
 
 		DWORD result = NULL;
-		result = RegOpenKeyEx(machine, key.data(), NULL, KEY_QUERY_VALUE, handle.get());
+		result = reg::api::open_key(machine, key, KEY_QUERY_VALUE, handle.get());
 
 		return result == ERROR_SUCCESS;
 	}
@@ -241,10 +378,11 @@ namespace reg
 	[[nodiscard]]
 	inline bool value_exists(HKEY machine, std::string_view key, std::string_view value) noexcept
 	{
+		REG_OPERATION("value_exists");
 		auto handle = self_closing_handle();
 
 		DWORD result = NULL;
-		result = RegOpenKeyEx(machine, key.data(), NULL, KEY_QUERY_VALUE, handle.get());
+		result = reg::api::open_key(machine, key, KEY_QUERY_VALUE, handle.get());
 		if (result == ERROR_SUCCESS)
 		{
 			// RegQueryValueEx(HKEY hKey, LPCWSTR lpValueName, LPDWORD lpReserved, LPDWORD lpType, LPBYTE lpData, LPDWORD lpcbData)
@@ -254,7 +392,7 @@ namespace reg
 			// lpType		- type of data associated with the specified value (can be NULL)
 			// lpData		- buffer that receives the values data (can be NULL)
 			// lpcbData		- variable that specifies the size, in bytes, of the buffer
-			result = RegQueryValueEx(*handle, value.data(), NULL, NULL, NULL, NULL);
+			result = reg::api::query_value(*handle, value, NULL, NULL, NULL);
 			return result == ERROR_SUCCESS;
 		}
 		else
@@ -270,7 +408,7 @@ namespace reg
 	inline bool value_exists(HKEY handle, std::string_view value) noexcept
 	{
 		DWORD result = NULL;
-		result = RegQueryValueEx(handle, value.data(), NULL, NULL, NULL, NULL);
+		result = reg::api::query_value(handle, value, NULL, NULL, NULL);
 		return result == ERROR_SUCCESS;
 	}
 
@@ -285,6 +423,22 @@ namespace reg
 				throw reg::except::key_not_found(machine, key);
 		}
 
+		/// <summary>Opens a key that is expected to exist with a single call.<para/>
+		/// Throws an exception if the key does not exist or cannot be opened</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='rights'>Access rights the key is opened with</param>
+		/// <returns>The open key, to be closed by the caller</returns>
+		inline HKEY _open_existing(HKEY machine, std::string_view key, REGSAM rights)
+		{
+			HKEY handle = nullptr;
+			DWORD code = reg::api::open_key(machine, key, rights, &handle);
+			if (code == ERROR_FILE_NOT_FOUND)
+				throw reg::except::key_not_found(machine, key);
+			reg::assert::success(code);
+			return handle;
+		}
+
 		/// <summary>Throws an exception if the value does not exist</summary>
 		/// <param name='machine'>Root key in the hierarchy</param>
 		/// <param name='key'>Subkey to the desired node</param>
@@ -308,7 +462,56 @@ namespace reg
 		}
 	}
 
+	namespace
+	{
+		/// <summary>Reads string data as UTF-16, growing the buffer if the data does not fit</summary>
+		/// <param name='flags'>The RRF_RT_* types that are accepted</param>
+		/// <returns>The error code and the number of code units read, terminators included</returns>
+		inline std::tuple<DWORD, size_t> _read_units(HKEY machine, std::string_view key, std::string_view value,
+			DWORD flags, reg::utf::small_buffer<char16_t>& units)
+		{
+			DWORD size = static_cast<DWORD>(units.capacity() * sizeof(char16_t));
+			DWORD code = reg::api::get_value(machine, key, value, flags, NULL, units.data(), &size);
+			while (code == ERROR_MORE_DATA)
+			{
+				units.reserve(size / sizeof(char16_t) + 1);
+				size = static_cast<DWORD>(units.capacity() * sizeof(char16_t));
+				code = reg::api::get_value(machine, key, value, flags, NULL, units.data(), &size);
+			}
+			return { code, size / sizeof(char16_t) };
+		}
+
+		/// <summary>Retrieves the type and size of a value, with the size of string
+		/// data measured in UTF-8, the form the library hands it out in</summary>
+		inline std::tuple<DWORD, size_t> _peek(HKEY machine, std::string_view key, std::string_view value)
+		{
+			DWORD type = -1;
+			DWORD size = -1;
+			DWORD result = NULL;
+
+			// RegGetValueW(HKEY hkey, LPCWSTR lpSubKey, LPCWSTR lpValue, DWORD dwFlags, LPDWORD pdwType, PVOID pvData, LPDWORD pcbData)
+			// hkey		- main hierarchical key
+			// lpSubKey	- subkey in the tree
+			// lpValue	- name of the value to query
+			// dwFlags	- type restriction (RRF_RT_ANY = No type restriction), REG_EXPAND_SZ data is measured as stored
+			// pdwType	- variable that receives a code indicating the type of data stored in the specified value
+			// pvData	- buffer that receives the value's data (can be NULL)
+			// pcbData	- variable that specifies the size of the buffer
+			result = reg::api::get_value(machine, key, value, RRF_RT_ANY | RRF_NOEXPAND, &type, NULL, &size);
+			reg::assert::success(result);
+
+			if (type != REG_SZ && type != REG_EXPAND_SZ && type != REG_MULTI_SZ)
+				return { type, size };
+
+			reg::utf::small_buffer<char16_t> units;
+			auto [code, count] = reg::_read_units(machine, key, value, RRF_RT_ANY | RRF_NOEXPAND, units);
+			reg::assert::success(code);
+			return { type, reg::utf::utf8_size(units.data(), count) };
+		}
+	}
+
 	/// <summary>Retrieves the type and size of the registry value.<para/>
+	/// The size of string values is the size of their UTF-8 text, null terminator included.<para/>
 	/// Throws an exception if
 	/// the key does not exist
 	/// or the value does not exist.<para/>
@@ -320,34 +523,15 @@ namespace reg
 	[[nodiscard]]
 	inline std::tuple<DWORD, size_t> peekvalue(HKEY machine, std::string_view key, std::string_view value)
 	{
+		REG_OPERATION("peekvalue");
 		reg::_check_key(machine, key);
 		reg::_check_value(machine, key, value);
 
-		DWORD type = -1;
-		DWORD size = -1;
-		DWORD result = NULL;
-
-		// RegGetValueA(HKEY hkey, LPCSTR lpSubKey, LPCSTR lpValue, DWORD dwFlags, LPDWORD pdwType, PVOID pvData, LPDWORD pcbData)
-		// hkey		- main hierarchical key
-		// lpSubKey	- subkey in the tree
-		// lpValue	- name of the value to query
-		// dwFlags	- type restriction (RRF_RT_ANY = No type restriction)
-		// pdwType	- variable that receives a code indicating the type of data stored in the specified value
-		// pvData	- buffer that receives the value's data (can be NULL)
-		// pcbData	- variable that specifies the size of the buffer
-		result = RegGetValue(machine, key.data(), value.data(), RRF_RT_ANY, &type, NULL, &size);
-		reg::assert::success(result);
-
-		// probably a bug in RegGetValue.
-		// Registry uses wchars to store strings. Normal characters are counted
-		// correctly, but the null termination is counted twice
-		if (type == REG_SZ)
-			--size;
-
-		return { type, size };
+		return reg::_peek(machine, key, value);
 	}
 
 	/// <summary>Retrieves the type and size of the registry value.<para/>
+	/// The size of string values is the size of their UTF-8 text, null terminator included.<para/>
 	/// Throws an exception if
 	/// the value does not exist.<para/>
 	/// To check if a value exists, use <see cref="value_exists"/></summary>
@@ -358,14 +542,7 @@ namespace reg
 	{
 		reg::_check_value(handle, value);
 
-		DWORD type = -1;
-		DWORD size = -1;
-		DWORD result = NULL;
-		result = RegGetValue(handle, "", value.data(), RRF_RT_ANY, &type, NULL, &size);
-
-		reg::assert::success(result);
-
-		return { type, size };
+		return reg::_peek(handle, "", value);
 	}
 
 	namespace
@@ -387,6 +564,737 @@ namespace reg
 		}
 	}
 
+	/// <summary>REG_EXPAND_SZ text. The %VARIABLE% references are kept as stored;
+	/// call <see cref="expanded"/> to replace them with the environment.</summary>
+	struct expand_string
+	{
+		std::string text;
+
+		/// <summary>The text with every environment variable reference replaced by its value</summary>
+		std::string expanded() const
+		{
+			reg::utf::small_buffer<char16_t> source;
+			reg::utf::to_utf16(text, source);
+
+			reg::utf::small_buffer<char16_t> target;
+			DWORD count = ExpandEnvironmentStringsW(reinterpret_cast<LPCWSTR>(source.data()),
+				reinterpret_cast<LPWSTR>(target.data()), static_cast<DWORD>(target.capacity()));
+			if (count > target.capacity())
+				count = ExpandEnvironmentStringsW(reinterpret_cast<LPCWSTR>(source.data()),
+					reinterpret_cast<LPWSTR>(target.reserve(count)), count);
+			if (count == 0)
+				reg::assert::success(GetLastError());
+
+			std::string result;
+			reg::utf::append_utf8(target.data(), count - 1, result); // count includes the terminator
+			return result;
+		}
+	};
+
+	/// <summary>A REG_DWORD_BIG_ENDIAN number, held in native byte order</summary>
+	struct dword_big_endian
+	{
+		DWORD value = 0;
+	};
+
+	namespace
+	{
+		template<typename T>
+		struct _is_duration : std::false_type {};
+
+		template<typename Rep, typename Period>
+		struct _is_duration<std::chrono::duration<Rep, Period>> : std::is_integral<Rep> {};
+
+		/// <summary>The description of a value type used in exception messages</summary>
+		inline std::string_view _type_name(DWORD type)
+		{
+			auto it = reg::str_type.find(type);
+			return it == reg::str_type.end() ? std::string_view("Unknown type") : it->second;
+		}
+
+		/// <summary>Turns the error code of a typed read into the library's exceptions.
+		/// Keys and types are only looked up once the read has failed.</summary>
+		/// <param name='code'>The code returned by the read</param>
+		/// <param name='type'>The type the value was expected to have</param>
+		inline void _check_read(DWORD code, HKEY machine, std::string_view key, std::string_view value, DWORD type)
+		{
+			if (code == ERROR_SUCCESS)
+				return;
+
+			if (code == ERROR_FILE_NOT_FOUND)
+			{
+				reg::_check_key(machine, key);
+				throw reg::except::value_not_found(machine, key, value);
+			}
+
+			if (code == ERROR_UNSUPPORTED_TYPE)
+			{
+				auto [found, size] = reg::_peek(machine, key, value);
+				throw reg::except::type_error(machine, key, value, reg::_type_name(type), reg::_type_name(found));
+			}
+
+			reg::assert::success(code);
+		}
+
+		/// <summary>The memory resource a string allocates from, so that scratch space
+		/// for it comes from the same place</summary>
+		template<typename String>
+		std::pmr::memory_resource* _resource_of(const String&) noexcept
+		{
+			return std::pmr::new_delete_resource();
+		}
+
+		inline std::pmr::memory_resource* _resource_of(const std::pmr::string& text) noexcept
+		{
+			return text.get_allocator().resource();
+		}
+
+		/// <summary>Reads string data into a caller's string, reusing its capacity.<para/>
+		/// The read is tried with room for as many characters as the string can already
+		/// hold, and is only repeated if the registry reports ERROR_MORE_DATA, so reading
+		/// a value of the same size again needs no size probe and does not grow the string.</summary>
+		template<typename String>
+		DWORD _read_string(HKEY root, std::string_view path, std::string_view name, DWORD flags, String& data)
+		{
+			// the UTF-16 scratch stays on the stack for short values and otherwise comes
+			// from the string's own memory resource
+			reg::utf::small_buffer<char16_t> units(reg::_resource_of(data));
+			units.reserve(data.capacity() + 1);
+
+			auto [code, count] = reg::_read_units(root, path, name, flags, units);
+			if (code != ERROR_SUCCESS)
+			{
+				data.clear();
+				return code;
+			}
+
+			// RegGetValue guarantees the terminator
+			if (count != 0 && units.data()[count - 1] == u'\0')
+				--count;
+
+			// sized exactly, so a string that held the value before is not reallocated
+			data.resize(reg::utf::utf8_size(units.data(), count));
+			reg::utf::to_utf8(units.data(), count, &data[0]);
+			return code;
+		}
+
+		/// <summary>Writes text as null-terminated UTF-16 with the given string type</summary>
+		inline void _write_string(HKEY handle, std::string_view name, DWORD type, std::string_view data)
+		{
+			reg::utf::small_buffer<char16_t> units;
+			const size_t count = reg::utf::to_utf16(data, units);
+
+			DWORD code = reg::api::set_value(handle, name, type, reinterpret_cast<const BYTE*>(units.data()),
+				static_cast<DWORD>((count + 1) * sizeof(char16_t)));
+			reg::assert::success(code);
+		}
+
+		/// <summary>Copies raw UTF-16 data into an aligned buffer</summary>
+		/// <returns>The number of code units</returns>
+		inline size_t _copy_units(std::string_view bytes, reg::utf::small_buffer<char16_t>& units)
+		{
+			const size_t count = bytes.size() / sizeof(char16_t);
+			if (count != 0)
+				std::memcpy(units.reserve(count), bytes.data(), count * sizeof(char16_t));
+			return count;
+		}
+
+		/// <summary>Converts raw string data of the given type to UTF-8, dropping the terminator</summary>
+		template<typename String>
+		DWORD _decode_string(DWORD expected, DWORD found, std::string_view bytes, String& data)
+		{
+			if (found != expected)
+				return ERROR_UNSUPPORTED_TYPE;
+
+			reg::utf::small_buffer<char16_t> units;
+			size_t count = reg::_copy_units(bytes, units);
+			if (count != 0 && units.data()[count - 1] == u'\0')
+				--count;
+
+			data.clear();
+			reg::utf::append_utf8(units.data(), count, data);
+			return ERROR_SUCCESS;
+		}
+
+		/// <summary>Traits of the types stored as a DWORD or QWORD: integers, enums,
+		/// bools and durations. Durations are read from either size, so that a
+		/// value written as a DWORD can be read into a 64-bit duration.</summary>
+		template<typename T, typename Stored>
+		struct _number_traits
+		{
+			static constexpr bool supported = true;
+			static constexpr DWORD type = sizeof(Stored) == sizeof(DWORD) ? REG_DWORD : REG_QWORD;
+			static constexpr DWORD flags = reg::_is_duration<T>::value ? (RRF_RT_REG_DWORD | RRF_RT_REG_QWORD)
+				: sizeof(Stored) == sizeof(DWORD) ? RRF_RT_REG_DWORD : RRF_RT_REG_QWORD;
+			using argument = T;
+
+			static DWORD read(HKEY root, std::string_view path, std::string_view name, T& data)
+			{
+				// zero-extended if a DWORD is read into a QWORD
+				Stored stored = 0;
+				DWORD size = sizeof(stored);
+				DWORD code = reg::api::get_value(root, path, name, flags, NULL, &stored, &size);
+				if (code == ERROR_SUCCESS)
+				{
+					if constexpr (reg::_is_duration<T>::value)
+						data = T(static_cast<typename T::rep>(stored));
+					else
+						data = static_cast<T>(stored);
+				}
+				return code;
+			}
+
+			static void write(HKEY handle, std::string_view name, T data)
+			{
+				Stored stored = 0;
+				if constexpr (reg::_is_duration<T>::value)
+					stored = static_cast<Stored>(data.count());
+				else
+					stored = static_cast<Stored>(data);
+
+				DWORD code = reg::api::set_value(handle, name, type, reinterpret_cast<const BYTE*>(&stored), sizeof(stored));
+				reg::assert::success(code);
+			}
+
+			static DWORD decode(DWORD found, std::string_view bytes, T& data)
+			{
+				if (found != type && !(reg::_is_duration<T>::value && (found == REG_DWORD || found == REG_QWORD)))
+					return ERROR_UNSUPPORTED_TYPE;
+				if (bytes.size() != (found == REG_DWORD ? sizeof(DWORD) : sizeof(ULONGLONG)))
+					return ERROR_INVALID_DATA;
+
+				ULONGLONG stored = 0;
+				std::memcpy(&stored, bytes.data(), bytes.size());
+				if constexpr (reg::_is_duration<T>::value)
+					data = T(static_cast<typename T::rep>(stored));
+				else
+					data = static_cast<T>(static_cast<Stored>(stored));
+				return ERROR_SUCCESS;
+			}
+
+			static void encode(T data, std::string& bytes)
+			{
+				Stored stored = 0;
+				if constexpr (reg::_is_duration<T>::value)
+					stored = static_cast<Stored>(data.count());
+				else
+					stored = static_cast<Stored>(data);
+				bytes.assign(reinterpret_cast<const char*>(&stored), sizeof(stored));
+			}
+		};
+
+		template<typename T>
+		using _stored_number = std::conditional_t<sizeof(T) <= sizeof(DWORD), DWORD, ULONGLONG>;
+	}
+
+	/// <summary>Maps a C++ type to the registry type it is stored as, and reads and writes it.<para/>
+	/// - integers and enums of up to 32 bits, and bool: REG_DWORD<para/>
+	/// - 64-bit integers and enums: REG_QWORD<para/>
+	/// - std::chrono::duration with an integral count: REG_DWORD or REG_QWORD by the size of the count<para/>
+	/// - <see cref="reg::dword_big_endian"/>: REG_DWORD_BIG_ENDIAN<para/>
+	/// - std::string: REG_SZ<para/>
+	/// - <see cref="reg::expand_string"/>: REG_EXPAND_SZ<para/>
+	/// - std::vector&lt;std::string&gt; and <see cref="reg::multi_string"/>: REG_MULTI_SZ<para/>
+	/// - std::vector&lt;BYTE&gt;: REG_BINARY<para/>
+	/// Reads are a single call restricted to the stored type, and write into the caller's
+	/// object, reusing the capacity of strings and vectors.<para/>
+	/// Besides read and write, every specialization converts between T and the raw data the
+	/// registry holds: decode(type, bytes, data) returns ERROR_UNSUPPORTED_TYPE if the type
+	/// does not match, and encode(data, bytes) replaces bytes with the data as it is stored.
+	/// These let several values be read or compared in one batch.</summary>
+	template<typename T, typename = void>
+	struct value_traits
+	{
+		static constexpr bool supported = false;
+	};
+
+	template<typename T>
+	struct value_traits<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+		: reg::_number_traits<T, reg::_stored_number<T>> {};
+
+	template<typename T>
+	struct value_traits<T, std::enable_if_t<std::is_enum_v<T>>>
+		: reg::_number_traits<T, reg::_stored_number<T>> {};
+
+	template<>
+	struct value_traits<bool>
+		: reg::_number_traits<bool, DWORD> {};
+
+	template<typename T>
+	struct value_traits<T, std::enable_if_t<reg::_is_duration<T>::value>>
+		: reg::_number_traits<T, reg::_stored_number<typename T::rep>> {};
+
+	template<>
+	struct value_traits<reg::dword_big_endian>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_DWORD_BIG_ENDIAN;
+		// there is no RRF_RT_* flag for big-endian numbers; the type is checked after the read
+		static constexpr DWORD flags = RRF_RT_ANY;
+		using argument = reg::dword_big_endian;
+
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, reg::dword_big_endian& data)
+		{
+			BYTE bytes[sizeof(DWORD)] = {};
+			DWORD found = REG_NONE;
+			DWORD size = sizeof(bytes);
+			DWORD code = reg::api::get_value(root, path, name, flags, &found, bytes, &size);
+			if ((code == ERROR_SUCCESS || code == ERROR_MORE_DATA) && found != type)
+				return ERROR_UNSUPPORTED_TYPE;
+			if (code == ERROR_SUCCESS)
+				data.value = (DWORD(bytes[0]) << 24) | (DWORD(bytes[1]) << 16) | (DWORD(bytes[2]) << 8) | DWORD(bytes[3]);
+			return code;
+		}
+
+		static void write(HKEY handle, std::string_view name, reg::dword_big_endian data)
+		{
+			const BYTE bytes[sizeof(DWORD)] = {
+				BYTE(data.value >> 24), BYTE(data.value >> 16), BYTE(data.value >> 8), BYTE(data.value) };
+			DWORD code = reg::api::set_value(handle, name, type, bytes, sizeof(bytes));
+			reg::assert::success(code);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, reg::dword_big_endian& data)
+		{
+			if (found != type)
+				return ERROR_UNSUPPORTED_TYPE;
+			if (bytes.size() != sizeof(DWORD))
+				return ERROR_INVALID_DATA;
+
+			const auto* b = reinterpret_cast<const BYTE*>(bytes.data());
+			data.value = (DWORD(b[0]) << 24) | (DWORD(b[1]) << 16) | (DWORD(b[2]) << 8) | DWORD(b[3]);
+			return ERROR_SUCCESS;
+		}
+
+		static void encode(reg::dword_big_endian data, std::string& bytes)
+		{
+			const char stored[sizeof(DWORD)] = {
+				char(data.value >> 24), char(data.value >> 16), char(data.value >> 8), char(data.value) };
+			bytes.assign(stored, sizeof(stored));
+		}
+	};
+
+	template<>
+	struct value_traits<std::string>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_SZ;
+		// without RRF_NOEXPAND, REG_EXPAND_SZ values would be expanded and accepted
+		static constexpr DWORD flags = RRF_RT_REG_SZ | RRF_NOEXPAND;
+		using argument = std::string_view;
+
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, std::string& data)
+		{
+			return reg::_read_string(root, path, name, flags, data);
+		}
+
+		static void write(HKEY handle, std::string_view name, std::string_view data)
+		{
+			reg::_write_string(handle, name, type, data);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, std::string& data)
+		{
+			return reg::_decode_string(type, found, bytes, data);
+		}
+
+		static void encode(std::string_view data, std::string& bytes)
+		{
+			bytes.clear();
+			reg::utf::append_utf16le(data, bytes);
+		}
+	};
+
+	template<>
+	struct value_traits<std::pmr::string> : value_traits<std::string>
+	{
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, std::pmr::string& data)
+		{
+			return reg::_read_string(root, path, name, flags, data);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, std::pmr::string& data)
+		{
+			return reg::_decode_string(type, found, bytes, data);
+		}
+	};
+
+	template<>
+	struct value_traits<reg::expand_string>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_EXPAND_SZ;
+		static constexpr DWORD flags = RRF_RT_REG_EXPAND_SZ | RRF_NOEXPAND;
+		using argument = const reg::expand_string&;
+
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, reg::expand_string& data)
+		{
+			return reg::_read_string(root, path, name, flags, data.text);
+		}
+
+		static void write(HKEY handle, std::string_view name, const reg::expand_string& data)
+		{
+			reg::_write_string(handle, name, type, data.text);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, reg::expand_string& data)
+		{
+			return reg::_decode_string(type, found, bytes, data.text);
+		}
+
+		static void encode(const reg::expand_string& data, std::string& bytes)
+		{
+			bytes.clear();
+			reg::utf::append_utf16le(data.text, bytes);
+		}
+	};
+
+	template<>
+	struct value_traits<std::vector<std::string>>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_MULTI_SZ;
+		static constexpr DWORD flags = RRF_RT_REG_MULTI_SZ;
+		using argument = const std::vector<std::string>&;
+
+		/// <remarks>The list ends at the first empty string</remarks>
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, std::vector<std::string>& data)
+		{
+			reg::utf::small_buffer<char16_t> units;
+			auto [code, count] = reg::_read_units(root, path, name, flags, units);
+			if (code == ERROR_SUCCESS)
+				_assign(units.data(), count, data);
+			return code;
+		}
+
+		/// <remarks>Empty strings cannot be stored; they would end the list</remarks>
+		static void write(HKEY handle, std::string_view name, const std::vector<std::string>& data)
+		{
+			// UTF-16 never needs more units than UTF-8 needs bytes
+			size_t capacity = 1;
+			for (const std::string& text : data)
+				capacity += text.size() + 1;
+
+			reg::utf::small_buffer<char16_t> units;
+			char16_t* out = units.reserve(capacity);
+			size_t count = 0;
+			for (const std::string& text : data)
+			{
+				count += reg::utf::to_utf16(text, out + count);
+				out[count++] = u'\0';
+			}
+			out[count++] = u'\0';
+
+			DWORD code = reg::api::set_value(handle, name, type, reinterpret_cast<const BYTE*>(out),
+				static_cast<DWORD>(count * sizeof(char16_t)));
+			reg::assert::success(code);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, std::vector<std::string>& data)
+		{
+			if (found != type)
+				return ERROR_UNSUPPORTED_TYPE;
+
+			reg::utf::small_buffer<char16_t> units;
+			const size_t count = reg::_copy_units(bytes, units);
+			_assign(units.data(), count, data);
+			return ERROR_SUCCESS;
+		}
+
+		static void encode(const std::vector<std::string>& data, std::string& bytes)
+		{
+			bytes.clear();
+			for (const std::string& text : data)
+				reg::utf::append_utf16le(text, bytes);
+			bytes.append(sizeof(char16_t), '\0');
+		}
+
+	private:
+		static void _assign(const char16_t* text, size_t count, std::vector<std::string>& data)
+		{
+			// assign into the existing strings so their capacity is reused
+			size_t strings = 0;
+			const char16_t* end = text + count;
+			while (text != end && *text != u'\0')
+			{
+				const char16_t* terminator = std::find(text, end, u'\0');
+				if (strings == data.size())
+					data.emplace_back();
+				data[strings].clear();
+				reg::utf::append_utf8(text, terminator - text, data[strings++]);
+				text = terminator == end ? end : terminator + 1;
+			}
+			data.resize(strings);
+		}
+	};
+
+	template<>
+	struct value_traits<std::vector<BYTE>>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_BINARY;
+		static constexpr DWORD flags = RRF_RT_REG_BINARY;
+		using argument = const std::vector<BYTE>&;
+
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, std::vector<BYTE>& data)
+		{
+			// read straight into the vector, growing it only if the data does not fit
+			data.resize(data.capacity());
+			BYTE empty = 0;
+			DWORD size = static_cast<DWORD>(data.size());
+			DWORD code = reg::api::get_value(root, path, name, flags, NULL, data.empty() ? &empty : data.data(), &size);
+			while (code == ERROR_MORE_DATA)
+			{
+				data.resize(size);
+				code = reg::api::get_value(root, path, name, flags, NULL, data.data(), &size);
+			}
+			data.resize(code == ERROR_SUCCESS ? size : 0);
+			return code;
+		}
+
+		static void write(HKEY handle, std::string_view name, const std::vector<BYTE>& data)
+		{
+			DWORD code = reg::api::set_value(handle, name, type, data.data(), static_cast<DWORD>(data.size()));
+			reg::assert::success(code);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, std::vector<BYTE>& data)
+		{
+			if (found != type)
+				return ERROR_UNSUPPORTED_TYPE;
+			data.assign(bytes.begin(), bytes.end());
+			return ERROR_SUCCESS;
+		}
+
+		static void encode(const std::vector<BYTE>& data, std::string& bytes)
+		{
+			bytes.assign(data.begin(), data.end());
+		}
+	};
+
+	/// <summary>A REG_MULTI_SZ list kept as one block of UTF-8 text, each entry followed by
+	/// a null character.<para/>
+	/// Reading a value converts the whole payload in one pass into buffers the list keeps,
+	/// and iterating yields std::string_view entries pointing into that block, so reading
+	/// a large list into the same object again allocates nothing. Building a list from a
+	/// range sizes the block once. Entries cannot be empty or contain null characters;
+	/// the registry would read such an entry as the end of the list.</summary>
+	/// <example><code>reg::multi_string paths;
+	/// reg::query::get(HKEY_LOCAL_MACHINE, key, "Paths", paths);
+	/// for (std::string_view path : paths) { ... }</code></example>
+	class multi_string
+	{
+	public:
+		/// <summary>A forward iterator over the entries of a list</summary>
+		class iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const std::string_view*;
+			using reference = const std::string_view&;
+
+			iterator() = default;
+			iterator(const char* position, const char* end) noexcept : _end(end) { _at(position); }
+
+			reference operator*() const noexcept { return _entry; }
+			pointer operator->() const noexcept { return &_entry; }
+
+			iterator& operator++() noexcept
+			{
+				_at(_entry.data() + _entry.size() + 1);
+				return *this;
+			}
+
+			iterator operator++(int) noexcept
+			{
+				iterator previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const iterator& other) const noexcept { return _entry.data() == other._entry.data(); }
+			bool operator!=(const iterator& other) const noexcept { return !(*this == other); }
+
+		private:
+			void _at(const char* position) noexcept
+			{
+				const void* terminator = position == _end ? nullptr : std::memchr(position, '\0', _end - position);
+				_entry = terminator ? std::string_view(position, static_cast<const char*>(terminator) - position)
+					: std::string_view(_end, 0);
+			}
+
+			std::string_view _entry;
+			const char* _end = nullptr;
+		};
+
+		using const_iterator = iterator;
+
+		multi_string() = default;
+
+		/// <summary>Builds a list from a range of strings</summary>
+		template<typename Range>
+		explicit multi_string(const Range& strings)
+		{
+			assign(strings);
+		}
+
+		/// <summary>Replaces the entries with a range of strings, sizing the block once</summary>
+		template<typename Range>
+		void assign(const Range& strings)
+		{
+			size_t size = 0;
+			size_t count = 0;
+			for (const auto& text : strings)
+			{
+				size += std::string_view(text).size() + 1;
+				++count;
+			}
+
+			clear();
+			_grow(size);
+			for (const auto& text : strings)
+				_append(std::string_view(text));
+			_count = count;
+		}
+
+		/// <summary>Appends an entry</summary>
+		void push_back(std::string_view text)
+		{
+			_grow(_size + text.size() + 1);
+			_append(text);
+			++_count;
+		}
+
+		void clear() noexcept
+		{
+			_size = 0;
+			_count = 0;
+		}
+
+		iterator begin() const noexcept { return iterator(_text.data(), _text.data() + _size); }
+		iterator end() const noexcept { return iterator(_text.data() + _size, _text.data() + _size); }
+
+		/// <summary>The number of entries</summary>
+		size_t size() const noexcept { return _count; }
+		bool empty() const noexcept { return _count == 0; }
+
+		/// <summary>The entries, each followed by a null character</summary>
+		std::string_view block() const noexcept { return std::string_view(_text.data(), _size); }
+
+	private:
+		friend struct reg::value_traits<multi_string>;
+
+		/// <summary>Makes room for the given number of bytes. The block never shrinks,
+		/// so a list read again into the same object is not cleared and refilled.</summary>
+		char* _grow(size_t size)
+		{
+			if (_text.size() < size)
+				_text.resize(std::max(size, _text.size() * 2));
+			return _text.data();
+		}
+
+		void _append(std::string_view text) noexcept
+		{
+			std::memcpy(_text.data() + _size, text.data(), text.size());
+			_size += text.size();
+			_text[_size++] = '\0';
+		}
+
+		std::string _text;
+		size_t _size = 0;
+		std::vector<char16_t> _units;
+		size_t _count = 0;
+	};
+
+	template<>
+	struct value_traits<reg::multi_string>
+	{
+		static constexpr bool supported = true;
+		static constexpr DWORD type = REG_MULTI_SZ;
+		static constexpr DWORD flags = RRF_RT_REG_MULTI_SZ;
+		using argument = const reg::multi_string&;
+
+		static DWORD read(HKEY root, std::string_view path, std::string_view name, reg::multi_string& data)
+		{
+			std::vector<char16_t>& units = data._units;
+			if (units.size() < units.capacity())
+				units.resize(units.capacity());
+			if (units.empty())
+				units.resize(256);
+
+			DWORD size = static_cast<DWORD>(units.size() * sizeof(char16_t));
+			DWORD code = reg::api::get_value(root, path, name, flags, NULL, units.data(), &size);
+			while (code == ERROR_MORE_DATA)
+			{
+				units.resize(size / sizeof(char16_t) + 1);
+				size = static_cast<DWORD>(units.size() * sizeof(char16_t));
+				code = reg::api::get_value(root, path, name, flags, NULL, units.data(), &size);
+			}
+			if (code == ERROR_SUCCESS)
+				_assign(units.data(), size / sizeof(char16_t), data);
+			return code;
+		}
+
+		static void write(HKEY handle, std::string_view name, const reg::multi_string& data)
+		{
+			// the null characters between the entries convert like any other character;
+			// UTF-16 never needs more units than UTF-8 needs bytes
+			reg::utf::small_buffer<char16_t> units;
+			char16_t* out = units.reserve(data._size + 1);
+			size_t count = reg::utf::to_utf16(data.block(), out);
+			out[count++] = u'\0';
+
+			DWORD code = reg::api::set_value(handle, name, type, reinterpret_cast<const BYTE*>(out),
+				static_cast<DWORD>(count * sizeof(char16_t)));
+			reg::assert::success(code);
+		}
+
+		static DWORD decode(DWORD found, std::string_view bytes, reg::multi_string& data)
+		{
+			if (found != type)
+				return ERROR_UNSUPPORTED_TYPE;
+
+			reg::utf::small_buffer<char16_t> units;
+			const size_t count = reg::_copy_units(bytes, units);
+			_assign(units.data(), count, data);
+			return ERROR_SUCCESS;
+		}
+
+		static void encode(const reg::multi_string& data, std::string& bytes)
+		{
+			bytes.clear();
+			reg::utf::append_utf16le(data.block(), bytes);
+		}
+
+	private:
+		static void _assign(const char16_t* units, size_t count, reg::multi_string& data)
+		{
+			// one byte more in case the stored data lacked its last terminator
+			char* text = data._grow(count * 3 + 1);
+			char* end = text + reg::utf::to_utf8(units, count, text);
+
+			// count the entries up to the first empty one, which ends the list
+			size_t entries = 0;
+			char* entry = text;
+			while (entry != end && *entry != '\0')
+			{
+				char* terminator = static_cast<char*>(std::memchr(entry, '\0', end - entry));
+				if (terminator == nullptr)
+				{
+					terminator = end++;
+					*terminator = '\0';
+				}
+				entry = terminator + 1;
+				++entries;
+			}
+
+			data._size = entry - text;
+			data._count = entries;
+		}
+	};
+
 	namespace security
 	{
 		/// <summary>Retrieves the <see cref="SECURITY_DESCRIPTOR"/> protecting the specified
@@ -399,7 +1307,7 @@ namespace reg
 			DWORD code = NULL;
 			DWORD size = 0;
 			// Query how much space we need to allocate for the security descriptor
-			code = RegGetKeySecurity(
+			code = reg::api::get_key_security(
 				handle,
 				DACL_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION,
 				NULL,
@@ -411,7 +1319,7 @@ namespace reg
 			SECURITY_DESCRIPTOR* buff = reinterpret_cast<SECURITY_DESCRIPTOR*>(operator new(size));
 
 			// Fill the structure
-			code = RegGetKeySecurity(
+			code = reg::api::get_key_security(
 				handle,
 				DACL_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION,
 				buff,
@@ -456,6 +1364,24 @@ namespace reg
 		}
 	}
 
+	/// <summary>What the registry reports about a key, as returned by <see cref="reg::query::details"/></summary>
+	struct key_details
+	{
+		DWORD subkeys = 0;
+		/// <summary>Length of the longest subkey name in UTF-16 code units, without the terminator</summary>
+		DWORD max_subkey_length = 0;
+		DWORD values = 0;
+		/// <summary>Length of the longest value name in UTF-16 code units, without the terminator</summary>
+		DWORD max_value_name_length = 0;
+		/// <summary>Size in bytes of the largest value data</summary>
+		DWORD max_data_size = 0;
+		/// <summary>The class of the key; almost always empty</summary>
+		std::string class_name;
+		/// <summary>The last time the key, one of its values or the list of its subkeys
+		/// was written, as a FILETIME</summary>
+		std::uint64_t last_write = 0;
+	};
+
 	namespace query
 	{
 		namespace {
@@ -479,31 +1405,7 @@ namespace reg
 				DWORD code = NULL;
 				DWORD data = NULL;
 				DWORD buff_size = sizeof(DWORD);
-				code = RegGetValue(machine, key.data(), value.data(), RRF_RT_REG_DWORD, NULL, &data, &buff_size);
-
-				reg::assert::success(code);
-
-				return data;
-			}
-
-			/// <summary>Retrieves a string from the specified registry value<para/>
-			/// Throws an exception if it fails</summary>
-			/// <param name='machine'>Root key in the hierarchy</param>
-			/// <param name='key'>Subkey to the desired node</param>
-			/// <param name='value'>Name of the value to be queried</param>
-			/// <returns>The data found in the registry value</returns>
-			template<>
-			std::string _get_data(HKEY machine, std::string_view key, std::string_view value)
-			{
-				auto handle = self_closing_handle(open(machine, key, KEY_QUERY_VALUE));
-
-				// get the size of the string to be able to allocate
-				auto [type, size] = peekvalue(machine, key, value);
-
-				std::string data(size, '\0');
-				DWORD code = NULL;
-				DWORD buff_size = static_cast<DWORD>(size);
-				code = RegGetValue(machine, key.data(), value.data(), RRF_RT_REG_SZ, NULL, data.data(), &buff_size);
+				code = reg::api::get_value(machine, key, value, RRF_RT_REG_DWORD, NULL, &data, &buff_size);
 
 				reg::assert::success(code);
 
@@ -523,12 +1425,34 @@ namespace reg
 		/// <returns>The data found in the registry value</returns>
 		inline DWORD number(HKEY machine, std::string_view key, std::string_view value)
 		{
+			REG_OPERATION("query::number");
 			reg::_check_type(machine, key, value, REG_DWORD);
 
 			DWORD result = _get_data<DWORD>(machine, key, value);
 			return result;
 		}
 
+		/// <summary>Retrieves a string from the specified registry value into a caller's string,
+		/// reusing its capacity.<para/>
+		/// The read is tried with the capacity the string already has and the string only grows
+		/// if the data does not fit, so reading the same value repeatedly into the same string
+		/// takes a single registry call and does not allocate once the string is large enough.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value is not a string
+		/// or the function fails to retrieve the data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		/// <param name='data'>Receives the data found in the registry value</param>
+		inline void string(HKEY machine, std::string_view key, std::string_view value, std::string& data)
+		{
+			REG_OPERATION("query::string");
+			DWORD code = reg::value_traits<std::string>::read(machine, key, value, data);
+			reg::_check_read(code, machine, key, value, REG_SZ);
+		}
+
 		/// <summary>Retrieves a string from the specified registry value.<para/>
 		/// Throws an exception if
 		/// the key does not exist,
@@ -541,9 +1465,32 @@ namespace reg
 		/// <returns>The data found in the registry value</returns>
 		inline std::string string(HKEY machine, std::string_view key, std::string_view value)
 		{
-			reg::_check_type(machine, key, value, REG_SZ);
+			REG_OPERATION("query::string");
+			// room for 64 characters, so that short strings are read with a single call
+			std::string result(3 * 64, '\0');
+			reg::query::string(machine, key, value, result);
+			return result;
+		}
 
-			std::string result = _get_data<std::string>(machine, key, value);
+		/// <summary>Retrieves a string from the specified registry value into memory
+		/// taken from the given resource. Paths and value names longer than 255 bytes are
+		/// converted on the global heap, and so are the messages of exceptions thrown on failure.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value is not a string
+		/// or the function fails to retrieve the data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		/// <param name='resource'>Memory resource the result is allocated from</param>
+		/// <returns>The data found in the registry value</returns>
+		inline std::pmr::string string(HKEY machine, std::string_view key, std::string_view value, std::pmr::memory_resource* resource)
+		{
+			REG_OPERATION("query::string");
+			std::pmr::string result(3 * 64, '\0', resource);
+			DWORD code = reg::value_traits<std::pmr::string>::read(machine, key, value, result);
+			reg::_check_read(code, machine, key, value, REG_SZ);
 			return result;
 		}
 
@@ -567,18 +1514,13 @@ namespace reg
 			DWORD maxvaluenamelen = 0;
 
 			DWORD code = NULL;
-			code = RegQueryInfoKey(
+			code = reg::api::query_info(
 				handle,
-				NULL,
-				NULL,
-				NULL,
 				&subkeys,
 				&maxkeynamelen,
-				NULL,
 				&subvalues,
 				&maxvaluenamelen,
 				NULL,
-				NULL,
 				NULL
 			);
 
@@ -601,39 +1543,114 @@ namespace reg
 		/// length of the longest value</returns>
 		inline std::tuple<DWORD, DWORD, DWORD, DWORD> key_info(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("query::key_info");
 			reg::_check_key(machine, key);
 
 			auto handle = reg::self_closing_handle(reg::open(machine, key, KEY_QUERY_VALUE));
 			return reg::query::key_info(*handle);
 		}
 
-		/// <summary>For a given handle to an open registry key, retrieves the names of all its subkeys.</summary>
+		/// <summary>For a given handle to an open registry key, retrieves everything
+		/// RegQueryInfoKey reports about it, in a single call unless the class is long.<para/>
+		/// Throws an exception if the key cannot be queried.</summary>
 		/// <param name='handle'>Handle to an open registry key.<para/>
-		/// The key must have been opened with the KEY_ENUMERATE_SUB_KEYS access right.</param>
-		inline std::vector<std::string> keys(HKEY handle)
+		/// The key must have been opened with the KEY_QUERY_VALUE access right.</param>
+		inline reg::key_details details(HKEY handle)
 		{
-			std::vector<std::string> enum_keys;
+			reg::key_details result;
+			reg::utf::small_buffer<char16_t> class_name;
+			FILETIME last_write = {};
 
-			const auto [subkeys, maxkeynamelen, subvalues, maxvaluenamelen] = reg::query::key_info(handle);
-			enum_keys.reserve(subkeys);
-			std::unique_ptr<char[]> buffer = std::make_unique<char[]>(maxkeynamelen);
-
-			DWORD i = 0;
 			DWORD code = NULL;
-			do
+			for (;;)
+			{
+				DWORD class_length = static_cast<DWORD>(class_name.capacity());
+				code = reg::api::query_info(handle, class_name.data(), &class_length, &result.subkeys, &result.max_subkey_length,
+					&result.values, &result.max_value_name_length, &result.max_data_size, &last_write);
+				if (code == ERROR_MORE_DATA)
+				{
+					class_name.reserve(class_name.capacity() * 2);
+					continue;
+				}
+				reg::assert::success(code);
+				reg::utf::append_utf8(class_name.data(), class_length, result.class_name);
+				break;
+			}
+
+			result.last_write = static_cast<std::uint64_t>(last_write.dwLowDateTime)
+				| (static_cast<std::uint64_t>(last_write.dwHighDateTime) << 32);
+			return result;
+		}
+
+		/// <summary>For an arbitrary registry key, retrieves everything RegQueryInfoKey reports about it.<para/>
+		/// Throws an exception if the key does not exist or cannot be queried.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		inline reg::key_details details(HKEY machine, std::string_view key)
+		{
+			REG_OPERATION("query::details");
+			HKEY handle = reg::_open_existing(machine, key, KEY_QUERY_VALUE);
+			auto closer = reg::self_closing_handle(&handle);
+			return reg::query::details(handle);
+		}
+
+		namespace
+		{
+			/// <summary>Appends the names of the subkeys or of the values of an open key to a vector.
+			/// The strings are constructed by the vector, so a std::pmr vector gives them its own memory resource.</summary>
+			/// <param name='handle'>Handle to an open registry key</param>
+			/// <param name='values'>Whether to enumerate the values instead of the subkeys</param>
+			/// <param name='names'>Receives the names</param>
+			/// <param name='resource'>Backs the conversion buffer if a name does not fit on the stack</param>
+			template<typename Names>
+			void _enum_names(HKEY handle, bool values, Names& names, std::pmr::memory_resource* resource)
 			{
-				DWORD characters_read = maxkeynamelen;
-				code = RegEnumKeyEx(handle, i++, buffer.get(), &characters_read, NULL, NULL, NULL, NULL);
+				const auto [subkeys, maxkeynamelen, subvalues, maxvaluenamelen] = reg::query::key_info(handle);
+				const DWORD longest = values ? maxvaluenamelen : maxkeynamelen;
+				names.reserve(names.size() + (values ? subvalues : subkeys));
+				reg::utf::small_buffer<char16_t> buffer(resource);
+				buffer.reserve(longest);
 
-				if (code == ERROR_NO_MORE_ITEMS)
-					break;
+				DWORD i = 0;
+				DWORD code = NULL;
+				for (;;)
+				{
+					DWORD characters_read = longest;
+					code = values
+						? reg::api::enum_value(handle, i++, buffer.data(), &characters_read, NULL, NULL, NULL)
+						: reg::api::enum_key(handle, i++, buffer.data(), &characters_read);
 
-				enum_keys.emplace_back(buffer.get(), characters_read);
+					if (code != ERROR_SUCCESS)
+						break;
 
-			} while (code == ERROR_SUCCESS);
+					names.emplace_back();
+					reg::utf::append_utf8(buffer.data(), characters_read, names.back());
+				}
 
-			reg::assert::equal(code, ERROR_NO_MORE_ITEMS);
+				reg::assert::equal(code, ERROR_NO_MORE_ITEMS);
+			}
+		}
 
+		/// <summary>For a given handle to an open registry key, retrieves the names of all its subkeys.</summary>
+		/// <param name='handle'>Handle to an open registry key.<para/>
+		/// The key must have been opened with the KEY_ENUMERATE_SUB_KEYS access right.</param>
+		inline std::vector<std::string> keys(HKEY handle)
+		{
+			std::vector<std::string> enum_keys;
+			reg::query::_enum_names(handle, false, enum_keys, std::pmr::new_delete_resource());
+			return enum_keys;
+		}
+
+		/// <summary>For a given handle to an open registry key, retrieves the names of all its subkeys.<para/>
+		/// The vector, the names and any scratch space come from the given memory resource;
+		/// only an exception thrown on failure uses the global heap.</summary>
+		/// <param name='handle'>Handle to an open registry key.<para/>
+		/// The key must have been opened with the KEY_ENUMERATE_SUB_KEYS access right.</param>
+		/// <param name='resource'>Memory resource the result is allocated from</param>
+		inline std::pmr::vector<std::pmr::string> keys(HKEY handle, std::pmr::memory_resource* resource)
+		{
+			std::pmr::vector<std::pmr::string> enum_keys(resource);
+			reg::query::_enum_names(handle, false, enum_keys, resource);
 			return enum_keys;
 		}
 
@@ -643,39 +1660,49 @@ namespace reg
 		/// <returns>A vector containing the name of every subkey found.</returns>
 		inline std::vector<std::string> keys(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("query::keys");
 			reg::_check_key(machine, key);
 
 			auto handle = self_closing_handle(reg::open(machine, key, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS));
 			return reg::query::keys(*handle);
 		}
 
+		/// <summary>For an arbitrary registry key, retrieves the names of all its subkeys.<para/>
+		/// The vector, the names and any scratch space come from the given memory resource.
+		/// Paths longer than 255 bytes are converted on the global heap, and so are the
+		/// messages of exceptions thrown on failure.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='resource'>Memory resource the result is allocated from</param>
+		/// <returns>A vector containing the name of every subkey found.</returns>
+		inline std::pmr::vector<std::pmr::string> keys(HKEY machine, std::string_view key, std::pmr::memory_resource* resource)
+		{
+			REG_OPERATION("query::keys");
+			HKEY handle = reg::_open_existing(machine, key, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS);
+			auto closer = reg::self_closing_handle(&handle);
+			return reg::query::keys(handle, resource);
+		}
+
 		/// <summary>For a given handle to an open registry key, retrieves all of its underlying values.</summary>
 		/// <param name='handle'>Handle to an open registry key.</param>
 		/// <returns>A vector containing the name of every value found.</returns>
 		inline std::vector<std::string> value_names(HKEY handle)
 		{
 			std::vector<std::string> enum_values;
+			reg::query::_enum_names(handle, true, enum_values, std::pmr::new_delete_resource());
+			return enum_values;
+		}
 
-			const auto [subkeys, maxkeynamelen, subvalues, maxvaluenamelen] = reg::query::key_info(handle);
-			enum_values.reserve(subvalues);
-			std::unique_ptr<char[]> buffer = std::make_unique<char[]>(maxvaluenamelen);
-
-			DWORD i = 0;
-			DWORD code = NULL;
-			do
-			{
-				DWORD characters_read = maxvaluenamelen;
-				code = RegEnumValue(handle, i++, buffer.get(), &characters_read, NULL, NULL, NULL, NULL);
-
-				if (code == ERROR_NO_MORE_ITEMS)
-					break;
-
-				enum_values.emplace_back(buffer.get(), characters_read);
-
-			} while (code == ERROR_SUCCESS);
-
-			reg::assert::equal(code, ERROR_NO_MORE_ITEMS);
-
+		/// <summary>For a given handle to an open registry key, retrieves all of its underlying values.<para/>
+		/// The vector, the names and any scratch space come from the given memory resource;
+		/// only an exception thrown on failure uses the global heap.</summary>
+		/// <param name='handle'>Handle to an open registry key.</param>
+		/// <param name='resource'>Memory resource the result is allocated from</param>
+		/// <returns>A vector containing the name of every value found.</returns>
+		inline std::pmr::vector<std::pmr::string> value_names(HKEY handle, std::pmr::memory_resource* resource)
+		{
+			std::pmr::vector<std::pmr::string> enum_values(resource);
+			reg::query::_enum_names(handle, true, enum_values, resource);
 			return enum_values;
 		}
 
@@ -685,11 +1712,91 @@ namespace reg
 		/// <returns>A vector containing the name of every value found.</returns>
 		inline std::vector<std::string> value_names(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("query::value_names");
 			reg::_check_key(machine, key);
 
 			auto handle = self_closing_handle(reg::open(machine, key, KEY_QUERY_VALUE));
 			return value_names(*handle);
 		}
+
+		/// <summary>For an arbitrary registry key, retrieves all of its underlying values.<para/>
+		/// The vector, the names and any scratch space come from the given memory resource.
+		/// Paths longer than 255 bytes are converted on the global heap, and so are the
+		/// messages of exceptions thrown on failure.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='resource'>Memory resource the result is allocated from</param>
+		/// <returns>A vector containing the name of every value found.</returns>
+		inline std::pmr::vector<std::pmr::string> value_names(HKEY machine, std::string_view key, std::pmr::memory_resource* resource)
+		{
+			REG_OPERATION("query::value_names");
+			HKEY handle = reg::_open_existing(machine, key, KEY_QUERY_VALUE);
+			auto closer = reg::self_closing_handle(&handle);
+			return reg::query::value_names(handle, resource);
+		}
+
+		/// <summary>Reads a value into a caller's object.<para/>
+		/// The registry type follows from T (see <see cref="reg::value_traits"/>) and the data
+		/// is read with a single call restricted to that type. Strings and vectors keep their
+		/// capacity, so reading repeatedly into the same object does not allocate once it
+		/// has grown to fit, and fixed-size types never allocate.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value has a different type
+		/// or the function fails to retrieve the data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		/// <param name='data'>Receives the data found in the registry value</param>
+		template<typename T>
+		void get(HKEY machine, std::string_view key, std::string_view value, T& data)
+		{
+			REG_OPERATION("query::get");
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+
+			DWORD code = reg::value_traits<T>::read(machine, key, value, data);
+			reg::_check_read(code, machine, key, value, reg::value_traits<T>::type);
+		}
+
+		/// <summary>Reads a value of the registry type that follows from T.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value has a different type
+		/// or the function fails to retrieve the data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		/// <returns>The data found in the registry value</returns>
+		template<typename T>
+		T get(HKEY machine, std::string_view key, std::string_view value)
+		{
+			T data{};
+			reg::query::get(machine, key, value, data);
+			return data;
+		}
+
+		/// <summary>Reads REG_BINARY data into a caller's buffer.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value is not binary
+		/// or the data does not fit in the buffer</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		/// <param name='buffer'>Receives the data</param>
+		/// <param name='capacity'>Size of the buffer in bytes</param>
+		/// <returns>The number of bytes written to the buffer</returns>
+		inline size_t get(HKEY machine, std::string_view key, std::string_view value, void* buffer, size_t capacity)
+		{
+			REG_OPERATION("query::get");
+			DWORD size = static_cast<DWORD>(capacity);
+			DWORD code = reg::api::get_value(machine, key, value, RRF_RT_REG_BINARY, NULL, buffer, &size);
+			reg::_check_read(code, machine, key, value, REG_BINARY);
+			return size;
+		}
 	}
 
 	namespace update
@@ -703,7 +1810,7 @@ namespace reg
 			void _set_data(HKEY handle, std::string_view value, DWORD data)
 			{
 				DWORD code = NULL;
-				code = RegSetValueEx(handle, value.data(), NULL, REG_DWORD, (const BYTE*)&data, sizeof(data));
+				code = reg::api::set_value(handle, value, REG_DWORD, (const BYTE*)&data, sizeof(data));
 
 				reg::assert::success(code);
 			}
@@ -727,10 +1834,14 @@ namespace reg
 			/// <param name='data'>The new value</param>
 			void _set_data(HKEY handle, std::string_view value, std::string_view data)
 			{
+				// the registry stores strings as UTF-16
+				reg::utf::small_buffer<char16_t> units;
+				const size_t count = reg::utf::to_utf16(data, units);
+
 				DWORD code = NULL;
-				const DWORD data_size = static_cast<DWORD>(data.size() + 1); // +1 to account for null ending
-				const BYTE* data_ptr = reinterpret_cast<const BYTE*>(data.data());
-				code = RegSetValueEx(handle, value.data(), NULL, REG_SZ, data_ptr, data_size);
+				const DWORD data_size = static_cast<DWORD>((count + 1) * sizeof(char16_t)); // +1 to account for null ending
+				const BYTE* data_ptr = reinterpret_cast<const BYTE*>(units.data());
+				code = reg::api::set_value(handle, value, REG_SZ, data_ptr, data_size);
 
 				reg::assert::success(code);
 			}
@@ -760,6 +1871,7 @@ namespace reg
 		/// <param name='data'>The new value</param>
 		inline void number(HKEY machine, std::string_view key, std::string_view value, DWORD data)
 		{
+			REG_OPERATION("update::number");
 			reg::_check_type(machine, key, value, REG_DWORD);
 
 			reg::update::_set_data(machine, key, value, data);
@@ -777,10 +1889,45 @@ namespace reg
 		/// <param name='data'>The new value</param>
 		inline void string(HKEY machine, std::string_view key, std::string_view value, std::string_view data)
 		{
+			REG_OPERATION("update::string");
 			reg::_check_type(machine, key, value, REG_SZ);
 
 			reg::update::_set_data(machine, key, value, data);
 		}
+		/// <summary>Writes a value under an open key, creating it or replacing it
+		/// whatever its previous type. The registry type follows from T
+		/// (see <see cref="reg::value_traits"/>).<para/>
+		/// Throws an exception if the function fails to set the new data</summary>
+		/// <param name='handle'>Handle to a registry key opened with the KEY_SET_VALUE access right</param>
+		/// <param name='value'>Name of the value to be written</param>
+		/// <param name='data'>The new value</param>
+		template<typename T>
+		void set(HKEY handle, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+
+			reg::value_traits<T>::write(handle, value, data);
+		}
+
+		/// <summary>Writes a value, creating it or replacing it whatever its previous type.
+		/// Unlike <see cref="number"/> and <see cref="string"/>, the existing value is not
+		/// checked, so the write takes a single call once the key is open.
+		/// The registry type follows from T (see <see cref="reg::value_traits"/>).<para/>
+		/// Throws an exception if
+		/// the key does not exist
+		/// or the function fails to set the new data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be written</param>
+		/// <param name='data'>The new value</param>
+		template<typename T>
+		void set(HKEY machine, std::string_view key, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			REG_OPERATION("update::set");
+			HKEY handle = reg::_open_existing(machine, key, KEY_SET_VALUE);
+			auto closer = reg::self_closing_handle(&handle);
+			reg::update::set<T>(handle, value, data);
+		}
 	}
 
 	namespace create {
@@ -814,23 +1961,20 @@ namespace reg
 				{
 					handle = new HKEY;
 					DWORD result = NULL;
-					// RegCreateKeyEx(
+					// RegCreateKeyExW(
 					//		HKEY hKey									- main hierarchical key
 					//		LPCWSTR lpSubKey							- subkey in the tree
 					//		DWORD Reserved								- must be NULL
 					//		LPWSTR lpClass								- user-defined class type of this key (can be NULL)
-					//		DWORD dwOptions								- type of key
+					//		DWORD dwOptions								- type of key (REG_OPTION_NON_VOLATILE)
 					//		REGSAM samDesired							- mask that specifies the access rights for the key
 					//		LPSECURITY_ATTRIBUTES lpSecurityAttributes	- a SECURITY_ATTRIBUTES structure (can be NULL)
 					//		PHKEY phkResult								- handle to the opened or created key
 					//		LPDWORD lpdwDisposition						- variable that receives disposition value
 					// )
-					result = RegCreateKeyEx(
-						machine, key.data(),
-						NULL, NULL,
-						REG_OPTION_NON_VOLATILE,
+					result = reg::api::create_key(
+						machine, key,
 						KEY_READ | KEY_WRITE,
-						NULL,
 						handle, &disposition);
 
 					reg::assert::success(result);
@@ -918,6 +2062,7 @@ namespace reg
 		/// <param name='machine'>Root key in the hierarchy</param>
 		/// <param name='key'>Subkey to the desired node</param>
 		inline std::tuple<PHKEY, Disposition> key(HKEY machine, std::string_view key) {
+			REG_OPERATION("create::key");
 			return reg::create::_create_key(machine, key);
 		}
 
@@ -931,6 +2076,7 @@ namespace reg
 		/// <param name='value'>Name of the value to be created</param>
 		/// <param name='data'>Data to be assigned to value</param>
 		inline std::tuple<PHKEY, Disposition> number(HKEY machine, std::string_view key, std::string_view value, DWORD data = 0) {
+			REG_OPERATION("create::number");
 			return reg::create::item<DWORD>(machine, key, value, data);
 		}
 
@@ -944,6 +2090,7 @@ namespace reg
 		/// <param name='value'>Name of the value to be created</param>
 		/// <param name='data'>Data to be assigned to value</param>
 		inline std::tuple<PHKEY, Disposition> string(HKEY machine, std::string_view key, std::string_view value, std::string_view data = "") {
+			REG_OPERATION("create::string");
 			return reg::create::item<std::string_view>(machine, key, value, data);
 		}
 	}
@@ -959,7 +2106,7 @@ namespace reg
 			void _remove_key(HKEY handle)
 			{
 				DWORD code = NULL;
-				code = RegDeleteKeyEx(handle, "", KEY_WOW64_64KEY, NULL);
+				code = reg::api::delete_key(handle, "", KEY_WOW64_64KEY);
 
 				reg::assert::success(code);
 			}
@@ -979,7 +2126,7 @@ namespace reg
 			void _remove_children(HKEY handle)
 			{
 				DWORD code = NULL;
-				code = RegDeleteTree(handle, "");
+				code = reg::api::delete_tree(handle, "");
 				reg::assert::success(code);
 			}
 
@@ -1006,7 +2153,7 @@ namespace reg
 			void _remove_value(HKEY handle, std::string_view value)
 			{
 				DWORD code = NULL;
-				code = RegDeleteValue(handle, value.data());
+				code = reg::api::delete_value(handle, value);
 
 				reg::assert::success(code);
 			}
@@ -1030,6 +2177,7 @@ namespace reg
 		/// <returns>True, if the key was removed. False otherwise</returns>
 		inline bool key(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("remove::key");
 			if (key_exists(machine, key))
 			{
 				reg::remove::_remove_key(machine, key);
@@ -1047,6 +2195,7 @@ namespace reg
 		/// False, if no subkeys were removed or the given key does not exist.</returns>
 		inline bool subkeys(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("remove::subkeys");
 			if (key_exists(machine, key))
 			{
 				auto handle = self_closing_handle(reg::open(machine, key, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS));
@@ -1071,6 +2220,7 @@ namespace reg
 		/// False if no values were removed or the given key does not exist.</returns>
 		inline bool values(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("remove::values");
 			if (key_exists(machine, key))
 			{
 				auto handle = reg::self_closing_handle(reg::open(machine, key, KEY_SET_VALUE | KEY_QUERY_VALUE));
@@ -1092,6 +2242,7 @@ namespace reg
 		/// <returns>True, if the key was removed. False otherwise</returns>
 		inline bool cluster(HKEY machine, std::string_view key)
 		{
+			REG_OPERATION("remove::cluster");
 			if (key_exists(machine, key))
 			{
 				reg::remove::_remove_children(machine, key);
@@ -1111,6 +2262,7 @@ namespace reg
 		/// <returns>True, if the value was removed. False otherwise</returns>
 		inline bool value(HKEY machine, std::string_view key, std::string_view value)
 		{
+			REG_OPERATION("remove::value");
 			if (key_exists(machine, key))
 				if (value_exists(machine, key, value))
 				{
@@ -0,0 +1,331 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "registry.h"
+#include "registry_name.h"
+#include "registry_struct.h"
+
+namespace reg
+{
+	/// <summary>The desired state of a set of keys and values, brought about by <see cref="reg::apply"/>.<para/>
+	/// Typed data is encoded when it is added, so the spec holds exactly the bytes each
+	/// value should have. Keys and value names are compared case-insensitively; if the
+	/// same value is named more than once, the last entry wins.</summary>
+	/// <example><code>reg::spec desired;
+	/// desired.set&lt;DWORD&gt;(HKEY_CURRENT_USER, "Software\\X", "Timeout", 30);
+	/// desired.unset(HKEY_CURRENT_USER, "Software\\X", "Legacy");
+	/// reg::apply_result result = reg::apply(desired);</code></example>
+	class spec
+	{
+	public:
+		enum class action
+		{
+			/// <summary>The value exists with the given type and data</summary>
+			set,
+			/// <summary>The value does not exist</summary>
+			unset,
+			/// <summary>The key exists</summary>
+			ensure_key,
+			/// <summary>The key does not exist; it is removed with its whole subtree</summary>
+			remove_key,
+		};
+
+		struct entry
+		{
+			HKEY machine;
+			std::string key;
+			std::string name;
+			spec::action what;
+			DWORD type = REG_NONE;
+			/// <summary>The data exactly as stored in the registry</summary>
+			std::string data = {};
+		};
+
+		/// <summary>The value must exist with the given data, stored as the type T maps to
+		/// (see <see cref="reg::value_traits"/>). Missing keys are created.</summary>
+		template<typename T>
+		spec& set(HKEY machine, std::string_view key, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+			entry& e = _add(machine, key, value, action::set);
+			e.type = reg::value_traits<T>::type;
+			reg::value_traits<T>::encode(data, e.data);
+			return *this;
+		}
+
+		/// <summary>The value must not exist</summary>
+		spec& unset(HKEY machine, std::string_view key, std::string_view value)
+		{
+			_add(machine, key, value, action::unset);
+			return *this;
+		}
+
+		/// <summary>The key must exist, even if no value is set in it</summary>
+		spec& ensure_key(HKEY machine, std::string_view key)
+		{
+			_add(machine, key, "", action::ensure_key);
+			return *this;
+		}
+
+		/// <summary>The key must not exist. Removals are applied before anything else,
+		/// so values set under a removed key are written to a fresh key.<para/>
+		/// Throws an exception if the key is empty; a root key cannot be removed</summary>
+		spec& remove_key(HKEY machine, std::string_view key)
+		{
+			if (key.find_first_not_of('\\') == std::string_view::npos)
+				throw std::invalid_argument("A root key cannot be removed");
+			_add(machine, key, "", action::remove_key);
+			return *this;
+		}
+
+		const std::vector<entry>& entries() const noexcept { return _entries; }
+		size_t size() const noexcept { return _entries.size(); }
+		bool empty() const noexcept { return _entries.empty(); }
+
+	private:
+		entry& _add(HKEY machine, std::string_view key, std::string_view name, spec::action action)
+		{
+			_entries.push_back({ machine, std::string(key), std::string(name), action });
+			return _entries.back();
+		}
+
+		std::vector<entry> _entries;
+	};
+
+	/// <summary>What <see cref="reg::apply"/> did. Keys count as items along with values.</summary>
+	struct apply_result
+	{
+		/// <summary>Values written where none existed, and keys created</summary>
+		size_t created = 0;
+		/// <summary>Values rewritten because their type or data differed</summary>
+		size_t updated = 0;
+		/// <summary>Values and keys deleted</summary>
+		size_t removed = 0;
+		/// <summary>Items already in the desired state</summary>
+		size_t unchanged = 0;
+
+		apply_result& operator+=(const apply_result& other) noexcept
+		{
+			created += other.created;
+			updated += other.updated;
+			removed += other.removed;
+			unchanged += other.unchanged;
+			return *this;
+		}
+	};
+
+	namespace
+	{
+		/// <summary>Orders entries by root key, then by key path</summary>
+		inline int _compare_target(const reg::spec::entry& a, const reg::spec::entry& b) noexcept
+		{
+			if (a.machine != b.machine)
+				return a.machine < b.machine ? -1 : 1;
+			return reg::icompare(a.key, b.key);
+		}
+
+		/// <summary>Brings one key in line with its entries: the key is opened once, its
+		/// current values are read in one batch, and only the differences are written.</summary>
+		inline void _apply_key(const reg::spec::entry* const* first, const reg::spec::entry* const* last,
+			reg::_value_batch& batch, std::vector<std::string_view>& names, reg::apply_result& result)
+		{
+			const reg::spec::entry& head = **first;
+			bool create = false;
+			for (auto it = first; it != last; ++it)
+				create |= (*it)->what != reg::spec::action::unset;
+
+			HKEY handle = nullptr;
+			DWORD disposition = REG_OPENED_EXISTING_KEY;
+			DWORD code = create
+				? reg::api::create_key(head.machine, head.key, KEY_QUERY_VALUE | KEY_SET_VALUE, &handle, &disposition)
+				: reg::api::open_key(head.machine, head.key, KEY_QUERY_VALUE | KEY_SET_VALUE, &handle);
+			if (code == ERROR_FILE_NOT_FOUND && !create)
+			{
+				// nothing to unset in a key that does not exist
+				result.unchanged += last - first;
+				return;
+			}
+			reg::assert::success(code);
+			auto closer = reg::self_closing_handle(&handle);
+
+			const bool fresh = disposition == REG_CREATED_NEW_KEY;
+			if (fresh)
+				++result.created;
+
+			names.clear();
+			for (auto it = first; it != last; ++it)
+				if ((*it)->what == reg::spec::action::set || (*it)->what == reg::spec::action::unset)
+					names.push_back((*it)->name);
+			if (!fresh && !names.empty())
+				batch.read(handle, names.data(), names.size());
+
+			size_t i = 0;
+			for (auto it = first; it != last; ++it)
+			{
+				const reg::spec::entry& e = **it;
+				if (e.what == reg::spec::action::ensure_key)
+				{
+					if (!fresh)
+						++result.unchanged;
+					continue;
+				}
+
+				const bool found = !fresh && batch[i].found;
+				if (e.what == reg::spec::action::unset)
+				{
+					if (found)
+					{
+						reg::assert::success(reg::api::delete_value(handle, e.name));
+						++result.removed;
+					}
+					else
+						++result.unchanged;
+				}
+				else if (found && batch[i].type == e.type && batch[i].data == e.data)
+					++result.unchanged;
+				else
+				{
+					code = reg::api::set_value(handle, e.name, e.type,
+						reinterpret_cast<const BYTE*>(e.data.data()), static_cast<DWORD>(e.data.size()));
+					reg::assert::success(code);
+					++(found ? result.updated : result.created);
+				}
+				++i;
+			}
+		}
+
+		/// <summary>Removes a key and its subtree if it exists</summary>
+		inline void _apply_removal(const reg::spec::entry& e, reg::apply_result& result)
+		{
+			// given a subkey, RegDeleteTree removes the subkey itself as well
+			DWORD code = reg::api::delete_tree(e.machine, e.key);
+			if (code == ERROR_FILE_NOT_FOUND)
+			{
+				++result.unchanged;
+				return;
+			}
+			reg::assert::success(code);
+			++result.removed;
+		}
+	}
+
+	/// <summary>Brings the registry to the state described by a spec, writing only what differs.<para/>
+	/// Entries are grouped by key. Each key is opened once, its current values are read
+	/// in a single batch, and only missing or different values are written; a value that
+	/// already holds the desired type and data is not touched. Key removals are applied
+	/// first, in order; the remaining keys are independent and are processed in parallel.<para/>
+	/// Throws the first exception raised for any key. Keys processed before the failure keep
+	/// their changes.</summary>
+	/// <param name='desired'>The desired state</param>
+	/// <param name='threads'>Number of threads working on keys; zero uses one per processor</param>
+	/// <returns>How many items were created, updated, removed or already in the desired state</returns>
+	inline reg::apply_result apply(const reg::spec& desired, unsigned threads = 0)
+	{
+		// sort pointers, so that the last of several entries for the same value is kept
+		std::vector<const reg::spec::entry*> order;
+		order.reserve(desired.size());
+		for (const reg::spec::entry& e : desired.entries())
+			order.push_back(&e);
+		std::stable_sort(order.begin(), order.end(), [](const reg::spec::entry* a, const reg::spec::entry* b) {
+			int c = reg::_compare_target(*a, *b);
+			if (c != 0)
+				return c < 0;
+			const bool a_key = a->what == reg::spec::action::ensure_key || a->what == reg::spec::action::remove_key;
+			const bool b_key = b->what == reg::spec::action::ensure_key || b->what == reg::spec::action::remove_key;
+			if (a_key != b_key)
+				return a_key;
+			return reg::icompare(a->name, b->name) < 0;
+			});
+
+		// drop all but the last entry for each value and key-level action
+		std::vector<const reg::spec::entry*> unique;
+		unique.reserve(order.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			const reg::spec::entry& e = *order[i];
+			if (i + 1 < order.size())
+			{
+				const reg::spec::entry& next = *order[i + 1];
+				const bool same_kind = (e.what == next.what) ||
+					((e.what == reg::spec::action::set || e.what == reg::spec::action::unset) &&
+					(next.what == reg::spec::action::set || next.what == reg::spec::action::unset));
+				if (same_kind && reg::_compare_target(e, next) == 0 && reg::iequals(e.name, next.name))
+					continue;
+			}
+			unique.push_back(&e);
+		}
+
+		reg::apply_result total;
+		std::vector<const reg::spec::entry*> entries;
+		entries.reserve(unique.size());
+		for (const reg::spec::entry* e : unique)
+		{
+			if (e->what == reg::spec::action::remove_key)
+				reg::_apply_removal(*e, total);
+			else
+				entries.push_back(e);
+		}
+
+		// the start of each key's run of entries
+		std::vector<size_t> groups;
+		for (size_t i = 0; i < entries.size(); ++i)
+			if (i == 0 || reg::_compare_target(*entries[i - 1], *entries[i]) != 0)
+				groups.push_back(i);
+		groups.push_back(entries.size());
+		const size_t keys = groups.size() - 1;
+
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = static_cast<unsigned>(std::min<size_t>(threads, keys));
+
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+		std::mutex lock;
+
+		auto work = [&]() {
+			reg::_value_batch batch;
+			std::vector<std::string_view> names;
+			reg::apply_result result;
+			try
+			{
+				for (size_t g = next++; g < keys && !failed; g = next++)
+					reg::_apply_key(entries.data() + groups[g], entries.data() + groups[g + 1], batch, names, result);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (!error)
+					error = std::current_exception();
+				failed = true;
+			}
+			std::lock_guard<std::mutex> guard(lock);
+			total += result;
+		};
+
+		if (threads <= 1)
+			work();
+		else
+		{
+			std::vector<std::thread> pool;
+			pool.reserve(threads - 1);
+			for (unsigned t = 1; t < threads; ++t)
+				pool.emplace_back(work);
+			work();
+			for (std::thread& t : pool)
+				t.join();
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+		return total;
+	}
+}
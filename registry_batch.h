@@ -0,0 +1,179 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "registry.h"
+#include "registry_name.h"
+
+namespace reg
+{
+	/// <summary>Records value writes and deletions in memory and flushes them in one go.<para/>
+	/// Writing a value that already has a pending operation replaces that operation, so a
+	/// value rewritten many times is written once, with the last data. On commit the
+	/// operations are grouped by key and sorted by name, and each key is opened exactly
+	/// once. Keys and value names are compared case-insensitively, like the registry does.</summary>
+	/// <example><code>reg::write_batch batch;
+	/// batch.set&lt;DWORD&gt;(HKEY_CURRENT_USER, "Software\\X", "Count", 1);
+	/// batch.set&lt;DWORD&gt;(HKEY_CURRENT_USER, "Software\\X", "Count", 2);	// replaces the first
+	/// batch.remove(HKEY_CURRENT_USER, "Software\\X", "Legacy");
+	/// batch.commit();</code></example>
+	class write_batch
+	{
+	public:
+		/// <summary>Records a write of the value, stored as the type T maps to
+		/// (see <see cref="reg::value_traits"/>). The key is created on commit if needed.</summary>
+		template<typename T>
+		write_batch& set(HKEY machine, std::string_view key, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+			_operation& op = _find(machine, key, value);
+			op.remove = false;
+			op.type = reg::value_traits<T>::type;
+			reg::value_traits<T>::encode(data, op.data);
+			return *this;
+		}
+
+		/// <summary>Records a write of data that is already encoded the way the registry
+		/// stores it, such as the data of a <see cref="reg::value"/></summary>
+		write_batch& set(HKEY machine, std::string_view key, std::string_view value, DWORD type, std::string_view data)
+		{
+			_operation& op = _find(machine, key, value);
+			op.remove = false;
+			op.type = type;
+			op.data.assign(data);
+			return *this;
+		}
+
+		/// <summary>Records a deletion of the value. Deleting a value or key that
+		/// does not exist is not an error.</summary>
+		write_batch& remove(HKEY machine, std::string_view key, std::string_view value)
+		{
+			_operation& op = _find(machine, key, value);
+			op.remove = true;
+			op.type = REG_NONE;
+			op.data.clear();
+			return *this;
+		}
+
+		/// <summary>The number of pending operations, one per distinct value</summary>
+		size_t size() const noexcept { return _operations.size(); }
+		bool empty() const noexcept { return _operations.empty(); }
+
+		/// <summary>Drops every pending operation</summary>
+		void clear() noexcept
+		{
+			_operations.clear();
+			_index.clear();
+		}
+
+		/// <summary>Applies the pending operations, one handle per key, and empties the batch.<para/>
+		/// Throws an exception if a key cannot be opened or created, or a value cannot be
+		/// written or deleted. The operations applied before the failure stay applied and
+		/// the batch keeps all of its operations.</summary>
+		/// <returns>The number of keys written to</returns>
+		size_t commit()
+		{
+			std::vector<const _operation*> order;
+			order.reserve(_operations.size());
+			for (const _operation& op : _operations)
+				order.push_back(&op);
+			std::sort(order.begin(), order.end(), [](const _operation* a, const _operation* b) {
+				int c = _compare_key(*a, *b);
+				return c != 0 ? c < 0 : reg::icompare(a->name, b->name) < 0;
+				});
+
+			size_t keys = 0;
+			for (size_t first = 0; first < order.size(); )
+			{
+				size_t last = first + 1;
+				while (last < order.size() && _compare_key(*order[first], *order[last]) == 0)
+					++last;
+				keys += _flush(order.data() + first, order.data() + last);
+				first = last;
+			}
+
+			clear();
+			return keys;
+		}
+
+	private:
+		struct _operation
+		{
+			HKEY machine;
+			std::string key;
+			std::string name;
+			bool remove = false;
+			DWORD type = REG_NONE;
+			/// <summary>The data exactly as stored in the registry</summary>
+			std::string data = {};
+		};
+
+		static int _compare_key(const _operation& a, const _operation& b) noexcept
+		{
+			if (a.machine != b.machine)
+				return a.machine < b.machine ? -1 : 1;
+			return reg::icompare(a.key, b.key);
+		}
+
+		/// <summary>The pending operation for a value, added if there is none</summary>
+		_operation& _find(HKEY machine, std::string_view key, std::string_view name)
+		{
+			const std::uint64_t hash = reg::ihash(key) * 0x9E3779B97F4A7C15ull
+				^ reg::ihash(name) ^ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(machine));
+
+			auto [first, last] = _index.equal_range(hash);
+			for (auto it = first; it != last; ++it)
+			{
+				_operation& op = _operations[it->second];
+				if (op.machine == machine && reg::iequals(op.key, key) && reg::iequals(op.name, name))
+					return op;
+			}
+
+			_index.emplace(hash, _operations.size());
+			_operations.push_back({ machine, std::string(key), std::string(name) });
+			return _operations.back();
+		}
+
+		/// <summary>Applies the operations of one key through a single handle</summary>
+		/// <returns>1 if the key was opened, 0 if it did not exist and only had deletions</returns>
+		static size_t _flush(const _operation* const* first, const _operation* const* last)
+		{
+			const _operation& head = **first;
+			const bool writes = std::any_of(first, last, [](const _operation* op) { return !op->remove; });
+
+			HKEY handle = nullptr;
+			DWORD code = writes
+				? reg::api::create_key(head.machine, head.key, KEY_SET_VALUE, &handle, NULL)
+				: reg::api::open_key(head.machine, head.key, KEY_SET_VALUE, &handle);
+			if (code == ERROR_FILE_NOT_FOUND && !writes)
+				return 0; // nothing to delete
+			reg::assert::success(code);
+			auto closer = reg::self_closing_handle(&handle);
+
+			for (auto it = first; it != last; ++it)
+			{
+				const _operation& op = **it;
+				if (op.remove)
+				{
+					code = reg::api::delete_value(handle, op.name);
+					if (code != ERROR_FILE_NOT_FOUND)
+						reg::assert::success(code);
+				}
+				else
+				{
+					code = reg::api::set_value(handle, op.name, op.type,
+						reinterpret_cast<const BYTE*>(op.data.data()), static_cast<DWORD>(op.data.size()));
+					reg::assert::success(code);
+				}
+			}
+			return 1;
+		}
+
+		std::vector<_operation> _operations;
+		std::unordered_multimap<std::uint64_t, size_t> _index;
+	};
+}
@@ -0,0 +1,354 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "registry_file.h"
+#include "registry_source.h"
+#include "registry_tree.h"
+
+namespace reg
+{
+	/// <summary>One difference between two trees, as reported by <see cref="reg::diff"/>.<para/>
+	/// The views are only valid for the duration of the call.</summary>
+	struct difference
+	{
+		enum kind_t
+		{
+			/// <summary>The key exists only in the second tree. Reported for every key of an added subtree</summary>
+			key_added,
+			/// <summary>The key exists only in the first tree. Reported once for a removed subtree</summary>
+			key_removed,
+			/// <summary>The value exists only in the second tree</summary>
+			value_added,
+			/// <summary>The value exists only in the first tree</summary>
+			value_removed,
+			/// <summary>The value exists in both trees with a different type or data</summary>
+			value_modified,
+		};
+
+		kind_t kind = key_added;
+		/// <summary>Path of the key, starting with the root path passed to reg::diff</summary>
+		std::string_view path = {};
+		/// <summary>Name of the value; empty for key changes</summary>
+		std::string_view name = {};
+		/// <summary>The value in the second tree (added and modified values)</summary>
+		std::uint32_t type = reg::types::none;
+		std::string_view data = {};
+		/// <summary>The value in the first tree (removed and modified values)</summary>
+		std::uint32_t old_type = reg::types::none;
+		std::string_view old_data = {};
+	};
+
+	namespace
+	{
+		/// <summary>The values of one key, copied out of a source and sorted by name,
+		/// in storage that is reused from key to key</summary>
+		class _value_list
+		{
+		public:
+			struct item
+			{
+				size_t name;
+				size_t name_length;
+				std::uint32_t type;
+				size_t data;
+				size_t data_length;
+			};
+
+			template<typename Source>
+			void read(Source& source, const typename Source::node& n)
+			{
+				_bytes.clear();
+				_items.clear();
+				source.values(n, [this](std::string_view name, std::uint32_t type, std::string_view data) {
+					item i = { _bytes.size(), name.size(), type, _bytes.size() + name.size(), data.size() };
+					_bytes.append(name.data(), name.size());
+					_bytes.append(data.data(), data.size());
+					_items.push_back(i);
+					});
+
+				std::sort(_items.begin(), _items.end(), [this](const item& a, const item& b) {
+					return reg::icompare(name(a), name(b)) < 0;
+					});
+			}
+
+			std::string_view name(const item& i) const { return std::string_view(_bytes).substr(i.name, i.name_length); }
+			std::string_view data(const item& i) const { return std::string_view(_bytes).substr(i.data, i.data_length); }
+			const std::vector<item>& items() const noexcept { return _items; }
+
+		private:
+			std::string _bytes;
+			std::vector<item> _items;
+		};
+
+		template<typename A, typename B, typename F>
+		class _differ
+		{
+		public:
+			_differ(A& a, B& b, F& visit) : _a(a), _b(b), _visit(visit) {}
+
+			void both(const typename A::node& x, const typename B::node& y, std::string& path, size_t depth)
+			{
+				_values(x, y, path);
+
+				if (_levels.size() <= depth)
+					_levels.emplace_back();
+				std::vector<std::string>& left = _levels[depth].first;
+				std::vector<std::string>& right = _levels[depth].second;
+				_a.keys(x, left);
+				_b.keys(y, right);
+
+				const size_t length = path.size();
+				auto i = left.begin();
+				auto j = right.begin();
+				while (i != left.end() || j != right.end())
+				{
+					int order = i == left.end() ? 1 : j == right.end() ? -1 : reg::icompare(*i, *j);
+					_append(path, order > 0 ? *j : *i);
+
+					if (order < 0)
+						_key(difference::key_removed, path);
+					else if (order > 0)
+					{
+						if (auto child = _b.child(y, *j))
+							added(*child, path, depth + 1);
+					}
+					else
+					{
+						auto first = _a.child(x, *i);
+						auto second = _b.child(y, *j);
+						if (first && second)
+							both(*first, *second, path, depth + 1);
+						else if (first)
+							_key(difference::key_removed, path);
+						else if (second)
+							added(*second, path, depth + 1);
+					}
+
+					path.resize(length);
+					if (order <= 0)
+						++i;
+					if (order >= 0)
+						++j;
+				}
+			}
+
+			void added(const typename B::node& y, std::string& path, size_t depth)
+			{
+				_key(difference::key_added, path);
+				_b.values(y, [this, &path](std::string_view name, std::uint32_t type, std::string_view data) {
+					difference d{ difference::value_added, path, name, type, data };
+					_visit(static_cast<const difference&>(d));
+					});
+
+				if (_levels.size() <= depth)
+					_levels.emplace_back();
+				std::vector<std::string>& names = _levels[depth].second;
+				_b.keys(y, names);
+
+				const size_t length = path.size();
+				for (const std::string& name : names)
+				{
+					_append(path, name);
+					if (auto child = _b.child(y, name))
+						added(*child, path, depth + 1);
+					path.resize(length);
+				}
+			}
+
+		private:
+			void _values(const typename A::node& x, const typename B::node& y, const std::string& path)
+			{
+				_left.read(_a, x);
+				_right.read(_b, y);
+
+				auto i = _left.items().begin();
+				auto j = _right.items().begin();
+				while (i != _left.items().end() || j != _right.items().end())
+				{
+					int order = i == _left.items().end() ? 1 : j == _right.items().end() ? -1 :
+						reg::icompare(_left.name(*i), _right.name(*j));
+
+					difference d{ difference::value_modified, path };
+					if (order < 0)
+					{
+						d.kind = difference::value_removed;
+						d.name = _left.name(*i);
+						d.old_type = i->type;
+						d.old_data = _left.data(*i);
+						_visit(static_cast<const difference&>(d));
+						++i;
+						continue;
+					}
+					if (order > 0)
+					{
+						d.kind = difference::value_added;
+						d.name = _right.name(*j);
+						d.type = j->type;
+						d.data = _right.data(*j);
+						_visit(static_cast<const difference&>(d));
+						++j;
+						continue;
+					}
+
+					if (i->type != j->type || _left.data(*i) != _right.data(*j))
+					{
+						d.name = _right.name(*j);
+						d.type = j->type;
+						d.data = _right.data(*j);
+						d.old_type = i->type;
+						d.old_data = _left.data(*i);
+						_visit(static_cast<const difference&>(d));
+					}
+					++i;
+					++j;
+				}
+			}
+
+			void _key(difference::kind_t kind, const std::string& path)
+			{
+				difference d{ kind, path };
+				_visit(static_cast<const difference&>(d));
+			}
+
+			static void _append(std::string& path, const std::string& name)
+			{
+				if (!path.empty())
+					path.push_back('\\');
+				path.append(name);
+			}
+
+			A& _a;
+			B& _b;
+			F& _visit;
+			_value_list _left;
+			_value_list _right;
+			std::deque<std::pair<std::vector<std::string>, std::vector<std::string>>> _levels;
+		};
+	}
+
+	/// <summary>Computes the differences between two subtrees of any two tree sources,
+	/// such as a live key and a tree loaded from an earlier .reg export.<para/>
+	/// Subkey lists are merge-joined in name order, so the running time is linear in
+	/// the size of the trees. Only the keys on the current path are open at a time, and
+	/// only the values of the current key are held, so memory does not grow with the tree.</summary>
+	/// <param name='a'>Source of the first (old) tree</param>
+	/// <param name='a_root'>The node the first tree starts at</param>
+	/// <param name='b'>Source of the second (new) tree</param>
+	/// <param name='b_root'>The node the second tree starts at</param>
+	/// <param name='root_path'>The path reported for the two roots</param>
+	/// <param name='visit'>Called with a <see cref="reg::difference"/> for each change, in tree order</param>
+	template<typename A, typename B, typename F>
+	void diff(A& a, const typename A::node& a_root, B& b, const typename B::node& b_root, std::string_view root_path, F&& visit)
+	{
+		std::string path(root_path);
+		reg::_differ<A, B, std::remove_reference_t<F>> differ(a, b, visit);
+		differ.both(a_root, b_root, path, 0);
+	}
+
+	/// <summary>Turns differences into the calls of a .reg parser handler (key, remove_key,
+	/// value and remove_value), so a diff can be written with <see cref="reg::file::writer"/>,
+	/// applied to the registry with <see cref="reg::file::importer"/> or to a
+	/// <see cref="reg::tree"/> with <see cref="reg::file::tree_builder"/>.<para/>
+	/// A key is only announced when it has changes, so the patch stays minimal.</summary>
+	template<typename Handler>
+	class patch
+	{
+	public:
+		explicit patch(Handler& out) : _out(out) {}
+
+		void operator()(const reg::difference& d)
+		{
+			switch (d.kind)
+			{
+			case reg::difference::key_added:
+				_out.key(d.path);
+				_current.assign(d.path.data(), d.path.size());
+				break;
+			case reg::difference::key_removed:
+				_out.remove_key(d.path);
+				_current.clear();
+				break;
+			case reg::difference::value_removed:
+				_enter(d.path);
+				_out.remove_value(d.name);
+				break;
+			default:
+				_enter(d.path);
+				_out.value(d.name, d.type, d.data);
+				break;
+			}
+		}
+
+	private:
+		void _enter(std::string_view path)
+		{
+			if (_current == path)
+				return;
+			_out.key(path);
+			_current.assign(path.data(), path.size());
+		}
+
+		Handler& _out;
+		std::string _current;
+	};
+
+	/// <summary>Writes the differences between two subtrees as a .reg file that turns
+	/// the first tree into the second when imported</summary>
+	/// <param name='root_path'>Path of the roots in the file, starting with the hive name</param>
+	/// <param name='sink'>Callable receiving std::string_view blocks of output</param>
+	/// <param name='encoding'>UTF16LE for files regedit can read, or UTF8</param>
+	template<typename A, typename B, typename Sink,
+		typename = std::enable_if_t<std::is_invocable_v<Sink&, std::string_view>>>
+	void diff_reg(A& a, const typename A::node& a_root, B& b, const typename B::node& b_root, std::string_view root_path,
+		Sink&& sink, reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		reg::file::writer<std::remove_reference_t<Sink>> out(sink, encoding);
+		reg::patch<reg::file::writer<std::remove_reference_t<Sink>>> changes(out);
+		reg::diff(a, a_root, b, b_root, root_path, changes);
+		out.flush();
+	}
+
+	/// <summary>Writes the differences between two subtrees as a .reg file to a stream</summary>
+	/// <param name='out'>Stream opened in binary mode</param>
+	template<typename A, typename B>
+	void diff_reg(A& a, const typename A::node& a_root, B& b, const typename B::node& b_root, std::string_view root_path,
+		std::ostream& out, reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		reg::file::stream_sink sink{ out };
+		reg::diff_reg(a, a_root, b, b_root, root_path, sink, encoding);
+	}
+
+#if __has_include(<Windows.h>)
+	/// <summary>Changes a registry key and its subkeys to match a tree source, writing
+	/// only the values and keys that differ.<para/>
+	/// Throws an exception if the key does not exist or cannot be written.</summary>
+	/// <param name='machine'>Root key in the hierarchy</param>
+	/// <param name='key'>Subkey to the desired node</param>
+	/// <param name='desired'>Source of the desired state</param>
+	/// <param name='desired_root'>The node of the source the key should match</param>
+	template<typename Source>
+	void apply_diff(HKEY machine, std::string_view key, Source& desired, const typename Source::node& desired_root)
+	{
+		reg::source::live live(machine);
+		auto root = live.open(key);
+		if (!root)
+			throw reg::except::key_not_found(machine, key);
+
+		std::string path(reg::str_hkey.at(machine));
+		for (std::string_view rest = key, segment = reg::next_segment(rest); !segment.empty(); segment = reg::next_segment(rest))
+		{
+			path.push_back('\\');
+			path.append(segment.data(), segment.size());
+		}
+
+		reg::file::importer importer;
+		reg::patch<reg::file::importer> changes(importer);
+		reg::diff(live, *root, desired, desired_root, path, changes);
+	}
+#endif
+}
@@ -0,0 +1,1105 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "registry_hive.h"
+#include "registry_source.h"
+#include "registry_tree.h"
+#include "registry_utf.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define REG_SCAN_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REG_SCAN_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if __has_include(<Windows.h>)
+#include "registry.h"
+#endif
+
+namespace reg
+{
+	namespace except
+	{
+		class parse_error : public std::runtime_error {
+		public:
+			parse_error(size_t line, std::string_view message)
+				: std::runtime_error("Line " + std::to_string(line) + ": " + std::string(message)),
+				_line(line)
+			{}
+
+			/// <summary>The line of the file on which the error was found</summary>
+			size_t line() const noexcept { return _line; }
+
+		private:
+			size_t _line;
+		};
+	}
+
+	namespace file
+	{
+		namespace
+		{
+			/// <summary>Index of the lowest set bit of a non-zero mask</summary>
+			inline unsigned _lowest_bit(unsigned mask) noexcept
+			{
+#if defined(_MSC_VER)
+				unsigned long index = 0;
+				_BitScanForward(&index, mask);
+				return static_cast<unsigned>(index);
+#else
+				return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+			}
+
+			/// <summary>Finds the first occurrence of either character in [first, last)</summary>
+			/// <returns>A pointer to the character found, or last if there is none</returns>
+			inline const char* _scan(const char* first, const char* last, char a, char b) noexcept
+			{
+#if defined(REG_SCAN_AVX2)
+				const __m256i wide_a = _mm256_set1_epi8(a);
+				const __m256i wide_b = _mm256_set1_epi8(b);
+				for (; last - first >= 32; first += 32)
+				{
+					const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+					const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+						_mm256_or_si256(_mm256_cmpeq_epi8(block, wide_a), _mm256_cmpeq_epi8(block, wide_b))));
+					if (mask)
+						return first + _lowest_bit(mask);
+				}
+#endif
+#if defined(REG_SCAN_SSE2)
+				const __m128i needle_a = _mm_set1_epi8(a);
+				const __m128i needle_b = _mm_set1_epi8(b);
+				for (; last - first >= 16; first += 16)
+				{
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+					const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+						_mm_or_si128(_mm_cmpeq_epi8(block, needle_a), _mm_cmpeq_epi8(block, needle_b))));
+					if (mask)
+						return first + _lowest_bit(mask);
+				}
+#endif
+				for (; first != last; ++first)
+					if (*first == a || *first == b)
+						return first;
+				return last;
+			}
+
+			/// <summary>Finds the first occurrence of a character in [first, last)</summary>
+			/// <returns>A pointer to the character found, or last if there is none</returns>
+			inline const char* _scan(const char* first, const char* last, char c) noexcept
+			{
+				return _scan(first, last, c, c);
+			}
+
+			inline bool _is_blank(char c) noexcept
+			{
+				return c == ' ' || c == '\t' || c == '\r';
+			}
+
+			inline std::string_view _trim(std::string_view text) noexcept
+			{
+				while (!text.empty() && _is_blank(text.front()))
+					text.remove_prefix(1);
+				while (!text.empty() && _is_blank(text.back()))
+					text.remove_suffix(1);
+				return text;
+			}
+
+			inline int _hex_digit(char c) noexcept
+			{
+				if (c >= '0' && c <= '9') return c - '0';
+				if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+				if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+				return -1;
+			}
+
+			constexpr std::string_view _header_v4 = "REGEDIT4";
+			constexpr std::string_view _header_v5 = "Windows Registry Editor Version 5.00";
+		}
+
+		/// <summary>Text encodings .reg files are saved with</summary>
+		enum class encoding {
+			UNKNOWN,
+			UTF8,		// also covers ANSI files that only use ASCII
+			UTF16LE		// what regedit writes, preceded by a byte order mark
+		};
+
+		/// <summary>The two flavours of .reg files</summary>
+		enum class format {
+			UNKNOWN,
+			REGEDIT4,	// ANSI file; text and hex(2) and hex(7) data are in the ANSI code page
+			REGEDIT5	// usually UTF-16LE; hex(n) data is stored exactly as in the registry
+		};
+
+		/// <summary>Streaming parser for .reg files.<para/>
+		/// Data is fed in arbitrary chunks and every complete entry is reported to the
+		/// handler as soon as it is read, so memory use does not depend on the file size.<para/>
+		/// The handler must provide the following member functions:<para/>
+		/// - key(std::string_view path) for [path]<para/>
+		/// - remove_key(std::string_view path) for [-path]<para/>
+		/// - value(std::string_view name, std::uint32_t type, std::string_view data) for "name"=data<para/>
+		/// - remove_value(std::string_view name) for "name"=-<para/>
+		/// Paths include the hive name. Value data is passed in its registry form
+		/// (strings are null terminated little-endian UTF-16).
+		/// The views are only valid for the duration of the call.</summary>
+		template<typename Handler>
+		class parser
+		{
+		public:
+			explicit parser(Handler& handler) : _handler(handler) {}
+
+			/// <summary>The flavour of the file, known once its header has been read</summary>
+			reg::file::format format() const noexcept { return _format; }
+
+			/// <summary>Parses the next chunk of the file.<para/>
+			/// Throws a <see cref="reg::except::parse_error"/> if the content is malformed.</summary>
+			/// <param name='chunk'>Raw bytes of the file, in any encoding .reg files are saved with</param>
+			void feed(std::string_view chunk)
+			{
+				if (_encoding == encoding::UNKNOWN)
+				{
+					_carry.append(chunk.data(), chunk.size());
+					if (_carry.size() < 3)
+						return;
+
+					std::string head;
+					head.swap(_carry);
+					_detect(head);
+					return;
+				}
+
+				if (_encoding == encoding::UTF16LE)
+					_feed_utf16(chunk);
+				else
+					_feed_text(chunk);
+			}
+
+			/// <summary>Signals the end of the input and parses anything left over.<para/>
+			/// Throws a <see cref="reg::except::parse_error"/> if the file ended unexpectedly.</summary>
+			void finish()
+			{
+				if (_encoding == encoding::UNKNOWN)
+				{
+					std::string head;
+					head.swap(_carry);
+					_detect(head);
+				}
+
+				if (!_line.empty())
+				{
+					std::string last;
+					last.swap(_line);
+					_continued = false;
+					_dispatch(last);
+				}
+
+				if (_format == reg::file::format::UNKNOWN)
+					throw reg::except::parse_error(_line_number, "The file does not start with a .reg header");
+			}
+
+		private:
+			void _detect(std::string_view head)
+			{
+				if (head.size() >= 2 && head[0] == '\xFF' && head[1] == '\xFE')
+				{
+					_encoding = encoding::UTF16LE;
+					_feed_utf16(head.substr(2));
+				}
+				else if (head.size() >= 2 && head[1] == '\0')
+				{
+					_encoding = encoding::UTF16LE;
+					_feed_utf16(head);
+				}
+				else
+				{
+					_encoding = encoding::UTF8;
+					if (head.size() >= 3 && head.substr(0, 3) == "\xEF\xBB\xBF")
+					{
+						head.remove_prefix(3);
+						_bom = true;
+					}
+					_feed_text(head);
+				}
+			}
+
+			/// <summary>Transcodes a UTF-16LE chunk and parses the result.
+			/// An odd trailing byte or a dangling high surrogate is kept for the next chunk.</summary>
+			void _feed_utf16(std::string_view chunk)
+			{
+				_carry.append(chunk.data(), chunk.size());
+
+				size_t count = _carry.size() / 2;
+				_units.resize(count);
+				if (count)
+					std::memcpy(_units.data(), _carry.data(), count * 2);
+
+				if (count && _units[count - 1] >= 0xD800 && _units[count - 1] <= 0xDBFF)
+					--count;
+
+				_text.clear();
+				reg::utf::append_utf8(_units.data(), count, _text);
+				_carry.erase(0, count * 2);
+
+				_feed_text(_text);
+			}
+
+			/// <summary>Splits UTF-8 text into logical lines, joining continuation lines.
+			/// Lines that lie entirely inside the chunk are dispatched without being copied.</summary>
+			void _feed_text(std::string_view text)
+			{
+				const char* position = text.data();
+				const char* const end = text.data() + text.size();
+
+				while (position != end)
+				{
+					const char* newline = reg::file::_scan(position, end, '\n');
+					std::string_view piece(position, static_cast<size_t>(newline - position));
+
+					// leading whitespace on a continuation line only indents the data
+					if (_continued && _line_start)
+						while (!piece.empty() && (piece.front() == ' ' || piece.front() == '\t'))
+							piece.remove_prefix(1);
+
+					if (newline == end)
+					{
+						_line.append(piece.data(), piece.size());
+						_line_start = _line_start && piece.empty();
+						return;
+					}
+
+					position = newline + 1;
+					_line_start = true;
+
+					std::string_view line = piece;
+					if (!_line.empty())
+					{
+						_line.append(piece.data(), piece.size());
+						line = _line;
+					}
+
+					size_t length = _continuation(line);
+					if (length != std::string_view::npos)
+					{
+						if (_line.empty())
+							_line.assign(line.data(), length);
+						else
+							_line.resize(length);
+						_continued = true;
+						++_line_number;
+						continue;
+					}
+
+					_continued = false;
+					_dispatch(line);
+					_line.clear();
+					++_line_number;
+				}
+			}
+
+			/// <summary>A value line ending in a backslash continues on the next line</summary>
+			/// <returns>The length of the line without the backslash,
+			/// or npos if the line does not continue</returns>
+			size_t _continuation(std::string_view line) const noexcept
+			{
+				size_t length = line.size();
+				while (length && _is_blank(line[length - 1]))
+					--length;
+				if (!length || line[length - 1] != '\\')
+					return std::string_view::npos;
+
+				std::string_view start = reg::file::_trim(line);
+				if (start.front() == '[' || start.front() == ';')
+					return std::string_view::npos;
+
+				return length - 1;
+			}
+
+			void _dispatch(std::string_view line)
+			{
+				line = reg::file::_trim(line);
+				if (line.empty() || line.front() == ';')
+					return;
+
+				if (_format == reg::file::format::UNKNOWN)
+				{
+					if (line == _header_v4)
+					{
+						_format = reg::file::format::REGEDIT4;
+						// a byte order mark says the text is UTF-8 after all
+						_ansi = _encoding == encoding::UTF8 && !_bom;
+					}
+					else if (line == _header_v5)
+						_format = reg::file::format::REGEDIT5;
+					else
+						throw reg::except::parse_error(_line_number, "The file does not start with a .reg header");
+					return;
+				}
+
+				if (_ansi && !_is_ascii(line))
+				{
+					// names, paths and strings are all in the ANSI code page
+					_widen_ansi(line);
+					_decoded.clear();
+					reg::utf::append_utf8(_wide.data(), _wide.size(), _decoded);
+					line = _decoded;
+				}
+
+				if (line.front() == '[')
+				{
+					size_t close = line.rfind(']');
+					if (close == std::string_view::npos)
+						throw reg::except::parse_error(_line_number, "Missing ']' after key path");
+
+					std::string_view path = line.substr(1, close - 1);
+					_in_key = true;
+					if (!path.empty() && path.front() == '-')
+					{
+						_handler.remove_key(path.substr(1));
+						_in_key = false;
+					}
+					else
+						_handler.key(path);
+					return;
+				}
+
+				_value_line(line);
+			}
+
+			void _value_line(std::string_view line)
+			{
+				if (!_in_key)
+					throw reg::except::parse_error(_line_number, "Value found outside of a key");
+
+				const char* position = line.data();
+				const char* const end = line.data() + line.size();
+
+				_name.clear();
+				if (*position == '@')
+					++position;
+				else if (*position == '"')
+					position = _quoted(position + 1, end, _name);
+				else
+					throw reg::except::parse_error(_line_number, "Expected a value name");
+
+				while (position != end && _is_blank(*position))
+					++position;
+				if (position == end || *position != '=')
+					throw reg::except::parse_error(_line_number, "Expected '=' after value name");
+				++position;
+				while (position != end && _is_blank(*position))
+					++position;
+
+				std::string_view data(position, static_cast<size_t>(end - position));
+				if (data == "-")
+				{
+					_handler.remove_value(_name);
+					return;
+				}
+
+				_data.clear();
+				if (!data.empty() && data.front() == '"')
+				{
+					_scratch.clear();
+					const char* after = _quoted(data.data() + 1, end, _scratch);
+					if (!reg::file::_trim(std::string_view(after, static_cast<size_t>(end - after))).empty())
+						throw reg::except::parse_error(_line_number, "Unexpected characters after string");
+
+					reg::utf::append_utf16le(_scratch, _data);
+					_handler.value(_name, reg::types::sz, _data);
+				}
+				else if (data.substr(0, 6) == "dword:")
+				{
+					std::string_view digits = data.substr(6);
+					if (digits.empty() || digits.size() > 8)
+						throw reg::except::parse_error(_line_number, "Malformed dword");
+
+					std::uint32_t number = 0;
+					for (char c : digits)
+					{
+						int digit = _hex_digit(c);
+						if (digit < 0)
+							throw reg::except::parse_error(_line_number, "Malformed dword");
+						number = (number << 4) | static_cast<std::uint32_t>(digit);
+					}
+
+					for (int i = 0; i < 4; i++)
+						_data.push_back(static_cast<char>((number >> (8 * i)) & 0xFF));
+					_handler.value(_name, reg::types::dword, _data);
+				}
+				else if (data.substr(0, 3) == "hex")
+				{
+					std::uint32_t type = reg::types::binary;
+					data.remove_prefix(3);
+					if (!data.empty() && data.front() == '(')
+					{
+						size_t close = data.find(')');
+						if (close == std::string_view::npos || close == 1 || close > 9)
+							throw reg::except::parse_error(_line_number, "Malformed hex type");
+
+						type = 0;
+						for (char c : data.substr(1, close - 1))
+						{
+							int digit = _hex_digit(c);
+							if (digit < 0)
+								throw reg::except::parse_error(_line_number, "Malformed hex type");
+							type = (type << 4) | static_cast<std::uint32_t>(digit);
+						}
+						data.remove_prefix(close + 1);
+					}
+
+					if (data.empty() || data.front() != ':')
+						throw reg::except::parse_error(_line_number, "Expected ':' after hex");
+					data.remove_prefix(1);
+
+					_hex_bytes(data, _data);
+
+					if (_format == reg::file::format::REGEDIT4 && (type == reg::types::expand_sz || type == reg::types::multi_sz))
+					{
+						// REGEDIT4 stores these as 8-bit text; the registry wants UTF-16
+						_widen_ansi(_data);
+						_data.resize(_wide.size() * sizeof(char16_t));
+						if (!_wide.empty())
+							std::memcpy(&_data[0], _wide.data(), _data.size());
+					}
+
+					_handler.value(_name, type, _data);
+				}
+				else
+					throw reg::except::parse_error(_line_number, "Unrecognized value data");
+			}
+
+			/// <summary>Reads a quoted string, resolving escape sequences</summary>
+			/// <returns>A pointer past the closing quote</returns>
+			const char* _quoted(const char* position, const char* end, std::string& out)
+			{
+				for (;;)
+				{
+					const char* special = reg::file::_scan(position, end, '"', '\\');
+					out.append(position, static_cast<size_t>(special - position));
+
+					if (special == end)
+						throw reg::except::parse_error(_line_number, "Unterminated string");
+					if (*special == '"')
+						return special + 1;
+
+					if (special + 1 == end)
+						throw reg::except::parse_error(_line_number, "Unterminated string");
+
+					switch (special[1])
+					{
+					case 'n': out.push_back('\n'); break;
+					case 'r': out.push_back('\r'); break;
+					case '0': out.push_back('\0'); break;
+					default: out.push_back(special[1]); break;
+					}
+					position = special + 2;
+				}
+			}
+
+			static bool _is_ascii(std::string_view text) noexcept
+			{
+				for (char c : text)
+					if (static_cast<unsigned char>(c) >= 0x80)
+						return false;
+				return true;
+			}
+
+			/// <summary>Converts text in the ANSI code page to UTF-16, left in _wide.
+			/// Without Windows there is no code page to consult and the bytes are read as Latin-1.</summary>
+			void _widen_ansi(std::string_view text)
+			{
+#if __has_include(<Windows.h>)
+				const int length = static_cast<int>(text.size());
+				const int count = length ? MultiByteToWideChar(CP_ACP, 0, text.data(), length, NULL, 0) : 0;
+				_wide.resize(static_cast<size_t>(count));
+				if (count)
+					MultiByteToWideChar(CP_ACP, 0, text.data(), length, reinterpret_cast<LPWSTR>(&_wide[0]), count);
+#else
+				_wide.resize(text.size());
+				for (size_t i = 0; i < text.size(); i++)
+					_wide[i] = static_cast<unsigned char>(text[i]);
+#endif
+			}
+
+			/// <summary>Decodes a comma-separated list of hex bytes</summary>
+			void _hex_bytes(std::string_view text, std::string& out)
+			{
+				const char* position = text.data();
+				const char* const end = text.data() + text.size();
+				while (position != end)
+				{
+					while (position != end && (_is_blank(*position) || *position == ','))
+						++position;
+					if (position == end)
+						break;
+
+					int high = _hex_digit(*position);
+					int low = position + 1 != end ? _hex_digit(position[1]) : -1;
+					if (high < 0 || low < 0)
+						throw reg::except::parse_error(_line_number, "Malformed hex data");
+
+					out.push_back(static_cast<char>((high << 4) | low));
+					position += 2;
+				}
+			}
+
+			Handler& _handler;
+			reg::file::format _format = reg::file::format::UNKNOWN;
+			encoding _encoding = encoding::UNKNOWN;
+			size_t _line_number = 1;
+			bool _in_key = false;
+			bool _continued = false;
+			bool _line_start = true;
+			bool _bom = false;
+			bool _ansi = false;
+
+			std::string _carry;
+			std::u16string _units;
+			std::u16string _wide;
+			std::string _text;
+			std::string _decoded;
+			std::string _line;
+			std::string _name;
+			std::string _data;
+			std::string _scratch;
+		};
+
+		/// <summary>Parses .reg content held in memory</summary>
+		/// <param name='content'>The whole file</param>
+		/// <param name='handler'>Receives every entry; see <see cref="parser"/></param>
+		template<typename Handler>
+		void parse(std::string_view content, Handler& handler)
+		{
+			reg::file::parser<Handler> p(handler);
+			p.feed(content);
+			p.finish();
+		}
+
+		/// <summary>Parses .reg content from a stream, reading it in fixed-size chunks</summary>
+		/// <param name='in'>Stream opened in binary mode</param>
+		/// <param name='handler'>Receives every entry; see <see cref="parser"/></param>
+		/// <param name='chunk_size'>Number of bytes read at a time</param>
+		template<typename Handler>
+		void parse(std::istream& in, Handler& handler, size_t chunk_size = 1 << 16)
+		{
+			reg::file::parser<Handler> p(handler);
+			std::unique_ptr<char[]> buffer = std::make_unique<char[]>(chunk_size);
+
+			while (in)
+			{
+				in.read(buffer.get(), static_cast<std::streamsize>(chunk_size));
+				std::streamsize count = in.gcount();
+				if (count <= 0)
+					break;
+				p.feed(std::string_view(buffer.get(), static_cast<size_t>(count)));
+			}
+
+			p.finish();
+		}
+
+		/// <summary>Parser handler that builds an in-memory <see cref="reg::tree"/>.
+		/// Top-level keys of the tree are the hive names used in the file.</summary>
+		class tree_builder
+		{
+		public:
+			explicit tree_builder(reg::tree& root) : _root(root) {}
+
+			void key(std::string_view path) { _current = &_root.create(path); }
+			void remove_key(std::string_view path) { _root.remove(path); _current = nullptr; }
+
+			void value(std::string_view name, std::uint32_t type, std::string_view data)
+			{
+				if (_current)
+					_current->set(name, type, data);
+			}
+
+			void remove_value(std::string_view name)
+			{
+				if (_current)
+					_current->unset(name);
+			}
+
+		private:
+			reg::tree& _root;
+			reg::tree* _current = nullptr;
+		};
+
+		/// <summary>Loads a .reg file from a stream into memory</summary>
+		/// <param name='in'>Stream opened in binary mode</param>
+		/// <returns>A tree whose top-level keys are the hives named in the file</returns>
+		inline reg::tree load(std::istream& in)
+		{
+			reg::tree root;
+			reg::file::tree_builder builder(root);
+			reg::file::parse(in, builder);
+			return root;
+		}
+
+		/// <summary>Loads a .reg file into memory.<para/>
+		/// Throws an exception if the file cannot be opened or is malformed.</summary>
+		/// <param name='filename'>Path to the .reg file</param>
+		/// <returns>A tree whose top-level keys are the hives named in the file</returns>
+		inline reg::tree load_file(const std::string& filename)
+		{
+			std::ifstream in(filename, std::ios::binary);
+			if (!in)
+				throw std::runtime_error("Could not open \"" + filename + "\"");
+			return reg::file::load(in);
+		}
+
+		/// <summary>Formats registry content as version 5.00 .reg text and streams it to a sink.<para/>
+		/// Text is collected in a block of fixed size and handed to the sink whenever
+		/// the block fills up, so memory use does not depend on how much is written.<para/>
+		/// Names are quoted, with line breaks and nulls escaped as \r, \n and \0. REG_SZ data is
+		/// quoted unless it holds such characters, in which case it is written as hex(1):. DWORDs are written as dword:
+		/// and every other type as hex(n): bytes wrapped at 80 columns, as regedit does.<para/>
+		/// The writer has the same member functions as a parser handler, so it can
+		/// be fed by <see cref="parse"/> or <see cref="reg::source::walk"/>.</summary>
+		/// <typeparam name='Sink'>A callable taking a std::string_view of output bytes</typeparam>
+		template<typename Sink>
+		class writer
+		{
+		public:
+			/// <param name='sink'>Receives the output in blocks</param>
+			/// <param name='encoding'>UTF16LE, for files regedit can read, or UTF8, for compact files</param>
+			/// <param name='block_size'>Number of bytes collected before calling the sink</param>
+			explicit writer(Sink& sink, reg::file::encoding encoding = reg::file::encoding::UTF16LE, size_t block_size = 1 << 16)
+				: _sink(sink), _encoding(encoding), _block_size(block_size)
+			{
+				_text.reserve(block_size + 256);
+				_text.append(_header_v5.data(), _header_v5.size());
+				_text += "\r\n";
+			}
+
+			void key(std::string_view path)
+			{
+				_text += "\r\n[";
+				_text.append(path.data(), path.size());
+				_text += "]\r\n";
+				_next();
+			}
+
+			void remove_key(std::string_view path)
+			{
+				_text += "\r\n[-";
+				_text.append(path.data(), path.size());
+				_text += "]\r\n";
+				_next();
+			}
+
+			void value(std::string_view name, std::uint32_t type, std::string_view data)
+			{
+				const size_t line_start = _text.size();
+				_name(name);
+
+				if (type == reg::types::sz && _plain_string(data))
+				{
+					_text.push_back('"');
+					_escape(_scratch);
+					_text.push_back('"');
+				}
+				else if (type == reg::types::dword && data.size() == 4)
+				{
+					std::uint32_t number = 0;
+					std::memcpy(&number, data.data(), 4);
+
+					_text += "dword:";
+					for (int shift = 28; shift >= 0; shift -= 4)
+						_text.push_back(_digits[(number >> shift) & 0xF]);
+				}
+				else
+				{
+					if (type == reg::types::binary)
+						_text += "hex:";
+					else
+					{
+						_text += "hex(";
+						bool leading = true;
+						for (int shift = 28; shift >= 0; shift -= 4)
+						{
+							unsigned digit = (type >> shift) & 0xF;
+							if (digit == 0 && leading && shift != 0)
+								continue;
+							leading = false;
+							_text.push_back(_digits[digit]);
+						}
+						_text += "):";
+					}
+					_hex(data, _text.size() - line_start);
+				}
+
+				_text += "\r\n";
+				_next();
+			}
+
+			void remove_value(std::string_view name)
+			{
+				_name(name);
+				_text += "-\r\n";
+				_next();
+			}
+
+			/// <summary>Hands everything written so far to the sink.
+			/// Must be called once writing is done.</summary>
+			void flush()
+			{
+				if (_encoding == reg::file::encoding::UTF16LE)
+				{
+					if (!_bom_written)
+					{
+						_sink(std::string_view("\xFF\xFE", 2));
+						_bom_written = true;
+					}
+
+					_wide.clear();
+					reg::utf::append_utf16le(_text, _wide, false);
+					_sink(std::string_view(_wide));
+				}
+				else
+					_sink(std::string_view(_text));
+
+				_text.clear();
+			}
+
+		private:
+			static constexpr char _digits[] = "0123456789abcdef";
+
+			void _next()
+			{
+				if (_text.size() >= _block_size)
+					flush();
+			}
+
+			void _name(std::string_view name)
+			{
+				if (name.empty())
+					_text.push_back('@');
+				else
+				{
+					_text.push_back('"');
+					if (name.find_first_of(std::string_view("\r\n\0", 3)) == std::string_view::npos)
+						_escape(name);
+					else
+						_escape_controls(name);
+					_text.push_back('"');
+				}
+				_text.push_back('=');
+			}
+
+			void _escape(std::string_view text)
+			{
+				const char* position = text.data();
+				const char* const end = text.data() + text.size();
+				for (;;)
+				{
+					const char* special = reg::file::_scan(position, end, '"', '\\');
+					_text.append(position, static_cast<size_t>(special - position));
+					if (special == end)
+						return;
+					_text.push_back('\\');
+					_text.push_back(*special);
+					position = special + 1;
+				}
+			}
+
+			/// <summary>Escapes text that contains line breaks or nulls, which the parser reads back as \r, \n and \0</summary>
+			void _escape_controls(std::string_view text)
+			{
+				for (char c : text)
+				{
+					switch (c)
+					{
+					case '"': _text += "\\\""; break;
+					case '\\': _text += "\\\\"; break;
+					case '\r': _text += "\\r"; break;
+					case '\n': _text += "\\n"; break;
+					case '\0': _text += "\\0"; break;
+					default: _text.push_back(c); break;
+					}
+				}
+			}
+
+			/// <summary>Checks whether REG_SZ data can be written as a quoted string:
+			/// it must be null terminated UTF-16 without embedded nulls or line breaks.
+			/// On success the UTF-8 text is left in _scratch.</summary>
+			bool _plain_string(std::string_view data)
+			{
+				if (data.size() < 2 || data.size() % 2 != 0)
+					return false;
+
+				const size_t count = data.size() / 2 - 1;
+				_units.resize(count + 1);
+				std::memcpy(_units.data(), data.data(), data.size());
+				if (_units[count] != u'\0')
+					return false;
+
+				for (size_t i = 0; i < count; i++)
+					if (_units[i] == u'\0' || _units[i] == u'\r' || _units[i] == u'\n')
+						return false;
+
+				_scratch.clear();
+				reg::utf::append_utf8(_units.data(), count, _scratch);
+				return true;
+			}
+
+			/// <summary>Writes comma separated hex bytes, continuing on a new line
+			/// whenever the current one would pass 80 columns</summary>
+			void _hex(std::string_view data, size_t column)
+			{
+				for (size_t i = 0; i < data.size(); i++)
+				{
+					unsigned char byte = static_cast<unsigned char>(data[i]);
+					_text.push_back(_digits[byte >> 4]);
+					_text.push_back(_digits[byte & 0xF]);
+					column += 2;
+
+					if (i + 1 == data.size())
+						break;
+
+					_text.push_back(',');
+					++column;
+					if (column >= 77)
+					{
+						_text += "\\\r\n  ";
+						column = 2;
+					}
+				}
+			}
+
+			Sink& _sink;
+			reg::file::encoding _encoding;
+			size_t _block_size;
+			bool _bom_written = false;
+
+			std::string _text;
+			std::string _wide;
+			std::string _scratch;
+			std::u16string _units;
+		};
+
+		/// <summary>Sink that writes to an output stream</summary>
+		struct stream_sink
+		{
+			std::ostream& out;
+
+			void operator()(std::string_view bytes)
+			{
+				out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+			}
+		};
+	}
+
+	/// <summary>Exports a key of a hive file and all of its subkeys as .reg text.<para/>
+	/// Works on any platform; no registry is involved.<para/>
+	/// Throws an exception if the key does not exist or the hive is malformed.</summary>
+	/// <param name='hive'>The hive to read from</param>
+	/// <param name='key'>Path of the key to export, relative to the hive root</param>
+	/// <param name='prefix'>Path the hive root is written as (e.g. HKEY_LOCAL_MACHINE\SOFTWARE)</param>
+	/// <param name='sink'>A callable taking a std::string_view of output bytes</param>
+	/// <param name='encoding'>Encoding of the output</param>
+	template<typename Sink, std::enable_if_t<std::is_invocable_v<Sink&, std::string_view>, int> = 0>
+	void export_reg(const reg::hive::file& hive, std::string_view key, std::string_view prefix, Sink&& sink,
+		reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		auto root = hive.open(key);
+		if (!root)
+			throw std::invalid_argument("The hive does not contain \"" + std::string(key) + "\"");
+
+		std::string path(prefix);
+		for (std::string_view rest = key, segment = reg::next_segment(rest); !segment.empty(); segment = reg::next_segment(rest))
+		{
+			if (!path.empty())
+				path.push_back('\\');
+			path.append(segment.data(), segment.size());
+		}
+
+		reg::file::writer<std::remove_reference_t<Sink>> out(sink, encoding);
+		reg::source::walk(hive, *root, path, out);
+		out.flush();
+	}
+
+	/// <summary>Exports a key of a hive file and all of its subkeys as .reg text to a stream.</summary>
+	inline void export_reg(const reg::hive::file& hive, std::string_view key, std::string_view prefix, std::ostream& out,
+		reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		reg::file::stream_sink sink{ out };
+		reg::export_reg(hive, key, prefix, sink, encoding);
+	}
+
+#if __has_include(<Windows.h>)
+	namespace file
+	{
+		/// <summary>Splits a path as written in .reg files into its hive and subkey.<para/>
+		/// Accepts both the full hive names and the HKCU-style abbreviations.<para/>
+		/// Throws an exception if the hive is not recognized.</summary>
+		/// <param name='path'>A path such as HKEY_CURRENT_USER\Software\Example</param>
+		/// <returns>The predefined hive handle and the remaining path</returns>
+		inline std::tuple<HKEY, std::string_view> split_hive(std::string_view path)
+		{
+			std::string_view rest = path;
+			std::string_view root = reg::next_segment(rest);
+			while (!rest.empty() && rest.front() == '\\')
+				rest.remove_prefix(1);
+
+			for (const auto& [machine, name] : reg::str_hkey)
+				if (reg::iequals(root, name))
+					return { machine, rest };
+
+			static const std::pair<std::string_view, HKEY> short_names[] = {
+				{ "HKCR", HKEY_CLASSES_ROOT },
+				{ "HKCU", HKEY_CURRENT_USER },
+				{ "HKLM", HKEY_LOCAL_MACHINE },
+				{ "HKU", HKEY_USERS },
+				{ "HKCC", HKEY_CURRENT_CONFIG },
+			};
+			for (const auto& [name, machine] : short_names)
+				if (reg::iequals(root, name))
+					return { machine, rest };
+
+			throw std::invalid_argument("Unknown registry hive in \"" + std::string(path) + "\"");
+		}
+
+		/// <summary>Parser handler that applies the file to the live registry.<para/>
+		/// The handle of the key being filled is kept open until the next key starts,
+		/// so values are written without reopening their key.</summary>
+		class importer
+		{
+		public:
+			void key(std::string_view path)
+			{
+				_handle.reset();
+				auto [machine, key] = reg::file::split_hive(path);
+				_path.assign(key.data(), key.size());
+				_handle = reg::self_closing_handle(std::get<0>(reg::create::key(machine, _path)));
+			}
+
+			/// <summary>Throws an exception if the path names a hive; a root key cannot be removed</summary>
+			void remove_key(std::string_view path)
+			{
+				_handle.reset();
+				auto [machine, key] = reg::file::split_hive(path);
+				if (key.find_first_not_of('\\') == std::string_view::npos)
+					throw std::invalid_argument("A root key cannot be removed: \"" + std::string(path) + "\"");
+				_path.assign(key.data(), key.size());
+				reg::remove::cluster(machine, _path);
+			}
+
+			void value(std::string_view name, std::uint32_t type, std::string_view data)
+			{
+				if (!_handle)
+					return;
+
+				DWORD code = NULL;
+				code = reg::api::set_value(
+					*_handle,
+					name,
+					type,
+					reinterpret_cast<const BYTE*>(data.data()),
+					static_cast<DWORD>(data.size()));
+
+				reg::assert::success(code);
+			}
+
+			void remove_value(std::string_view name)
+			{
+				if (!_handle)
+					return;
+
+				_path.assign(name.data(), name.size());
+				if (reg::value_exists(*_handle, _path))
+					reg::remove::_remove_value(*_handle, _path);
+			}
+
+		private:
+			reg::deleted_unique_ptr<HKEY> _handle;
+			std::string _path;
+		};
+	}
+
+	/// <summary>Applies a .reg file read from a stream to the registry.<para/>
+	/// Keys are created as needed, [-key] entries remove whole subtrees and
+	/// "name"=- entries remove single values.<para/>
+	/// Throws an exception if the file is malformed or a change cannot be applied;
+	/// entries before the failing one remain applied.</summary>
+	/// <param name='in'>Stream opened in binary mode</param>
+	inline void import_reg(std::istream& in)
+	{
+		reg::file::importer handler;
+		reg::file::parse(in, handler);
+	}
+
+	/// <summary>Applies a .reg file to the registry.<para/>
+	/// Throws an exception if the file cannot be opened, is malformed
+	/// or a change cannot be applied.</summary>
+	/// <param name='filename'>Path to the .reg file</param>
+	inline void import_reg(const std::string& filename)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("Could not open \"" + filename + "\"");
+		reg::import_reg(in);
+	}
+
+	/// <summary>Exports a registry key and all of its subkeys as .reg text.<para/>
+	/// The subtree is walked with one open handle per key on the current path and
+	/// enumeration buffers shared by all keys; the text is streamed to the sink in
+	/// blocks, so memory use does not grow with the size of the subtree.<para/>
+	/// Subkeys that deny read access are left out of the export.<para/>
+	/// Throws an exception if the key does not exist or cannot be read.</summary>
+	/// <param name='machine'>Root key in the hierarchy</param>
+	/// <param name='key'>Subkey to the desired node</param>
+	/// <param name='sink'>A callable taking a std::string_view of output bytes</param>
+	/// <param name='encoding'>UTF16LE for files regedit can read, or UTF8</param>
+	/// <returns>The number of subkeys left out because access to them was denied</returns>
+	template<typename Sink, std::enable_if_t<std::is_invocable_v<Sink&, std::string_view>, int> = 0>
+	size_t export_reg(HKEY machine, std::string_view key, Sink&& sink,
+		reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		reg::source::live source(machine);
+		auto root = source.open(key);
+		if (!root)
+			throw reg::except::key_not_found(machine, key);
+
+		std::string path(reg::str_hkey.at(machine));
+		for (std::string_view rest = key, segment = reg::next_segment(rest); !segment.empty(); segment = reg::next_segment(rest))
+		{
+			path.push_back('\\');
+			path.append(segment.data(), segment.size());
+		}
+
+		reg::file::writer<std::remove_reference_t<Sink>> out(sink, encoding);
+		reg::source::walk(source, *root, path, out);
+		out.flush();
+		return source.denied();
+	}
+
+	/// <summary>Exports a registry key and all of its subkeys as .reg text to a stream.<para/>
+	/// Subkeys that deny read access are left out of the export.<para/>
+	/// Throws an exception if the key does not exist or cannot be read.</summary>
+	/// <param name='machine'>Root key in the hierarchy</param>
+	/// <param name='key'>Subkey to the desired node</param>
+	/// <param name='out'>Stream opened in binary mode</param>
+	/// <param name='encoding'>UTF16LE for files regedit can read, or UTF8</param>
+	/// <returns>The number of subkeys left out because access to them was denied</returns>
+	inline size_t export_reg(HKEY machine, std::string_view key, std::ostream& out,
+		reg::file::encoding encoding = reg::file::encoding::UTF16LE)
+	{
+		reg::file::stream_sink sink{ out };
+		return reg::export_reg(machine, key, sink, encoding);
+	}
+#endif
+}
@@ -0,0 +1,416 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry_tree.h"
+#include "registry_utf.h"
+
+namespace reg
+{
+	namespace except
+	{
+		class hive_error : public std::runtime_error {
+		public:
+			hive_error(std::string_view message)
+				: std::runtime_error("Malformed hive: " + std::string(message))
+			{}
+		};
+	}
+
+	namespace hive
+	{
+		namespace
+		{
+			constexpr size_t _base_block_size = 4096;
+			constexpr size_t _big_data_segment = 16344;
+			constexpr std::uint16_t _key_compressed_name = 0x0020;
+			constexpr std::uint16_t _value_compressed_name = 0x0001;
+			constexpr std::uint32_t _data_inline = 0x80000000u;
+			constexpr std::uint32_t _no_cell = 0xFFFFFFFFu;
+			constexpr size_t _cached_lists = 64;
+			/// <summary>The registry allows keys to be nested 512 levels deep</summary>
+			constexpr size_t _max_depth = 512;
+		}
+
+		/// <summary>Read-only view of a registry hive file (regf), as written by
+		/// RegSaveKey or found in Windows\System32\config.<para/>
+		/// Only the cells needed to walk keys and values are decoded: key nodes (nk),
+		/// subkey lists (lf, lh, li, ri), value lists, values (vk) and big data (db).
+		/// Class names, security cells and the transaction logs are ignored.<para/>
+		/// Subkey lists are checked against the parent offset of each key, so a malformed
+		/// hive cannot make a walk loop or visit a key twice.<para/>
+		/// The view works on any platform and satisfies the tree source interface
+		/// (see registry_source.h), so hives can be exported or compared without a registry.</summary>
+		class file
+		{
+		public:
+			/// <summary>The offset of a key node cell</summary>
+			using node = std::uint32_t;
+
+			/// <summary>Views a hive already in memory. The memory must outlive the view.<para/>
+			/// Throws a <see cref="reg::except::hive_error"/> if the base block is invalid.</summary>
+			/// <param name='image'>The bytes of the whole hive file</param>
+			explicit file(std::string_view image) : _image(image)
+			{
+				_validate();
+			}
+
+			/// <summary>Reads a hive file into memory.<para/>
+			/// Throws an exception if the file cannot be read or is not a hive.</summary>
+			/// <param name='filename'>Path to the hive file</param>
+			static file load(const std::string& filename)
+			{
+				std::ifstream in(filename, std::ios::binary | std::ios::ate);
+				if (!in)
+					throw std::runtime_error("Could not open \"" + filename + "\"");
+
+				std::string bytes(static_cast<size_t>(in.tellg()), '\0');
+				in.seekg(0);
+				in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+				return file(std::move(bytes));
+			}
+
+			file(file&& other) noexcept { *this = std::move(other); }
+			file& operator=(file&& other) noexcept
+			{
+				bool owning = other._image.data() == other._owned.data();
+				_owned = std::move(other._owned);
+				_image = owning ? std::string_view(_owned) : other._image;
+				_root = other._root;
+				_lists.clear();
+				return *this;
+			}
+
+			/// <summary>The key node of the hive root</summary>
+			node root() const noexcept { return _root; }
+
+			/// <summary>Finds a key by its path relative to the hive root</summary>
+			std::optional<node> open(std::string_view path) const
+			{
+				node current = _root;
+				for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+				{
+					std::optional<node> next = child(current, segment);
+					if (!next)
+						return std::nullopt;
+					current = *next;
+				}
+				return current;
+			}
+
+			/// <summary>Finds a direct subkey by name.<para/>
+			/// Subkey lists are sorted by upper-cased name, so they are binary searched;
+			/// a linear scan is used if the search misses, to cover names whose
+			/// UTF-16 order differs from their UTF-8 order.</summary>
+			std::optional<node> child(const node& parent, std::string_view name) const
+			{
+				const std::vector<node>& offsets = _collect_subkeys(parent);
+
+				size_t low = 0;
+				size_t high = offsets.size();
+				while (low < high)
+				{
+					size_t middle = low + (high - low) / 2;
+					_key_name(offsets[middle], _name);
+					int order = reg::icompare(_name, name);
+					if (order == 0)
+						return offsets[middle];
+					if (order < 0)
+						low = middle + 1;
+					else
+						high = middle;
+				}
+
+				for (node candidate : offsets)
+				{
+					_key_name(candidate, _name);
+					if (reg::iequals(_name, name))
+						return candidate;
+				}
+
+				return std::nullopt;
+			}
+
+			void keys(const node& n, std::vector<std::string>& names) const
+			{
+				const std::vector<node>& offsets = _collect_subkeys(n);
+
+				names.resize(offsets.size());
+				for (size_t i = 0; i < offsets.size(); i++)
+					_key_name(offsets[i], names[i]);
+
+				std::sort(names.begin(), names.end(), reg::iless());
+			}
+
+			template<typename F>
+			void values(const node& n, F&& visit) const
+			{
+				const char* key = _cell(n, 76);
+				std::uint32_t count = _u32(key + 36);
+				std::uint32_t list = _u32(key + 40);
+				if (count == 0 || list == _no_cell)
+					return;
+
+				const char* offsets = _cell(list, 4 * static_cast<size_t>(count));
+				for (std::uint32_t i = 0; i < count; i++)
+				{
+					const char* value = _cell(_u32(offsets + 4 * i), 20);
+					if (value[0] != 'v' || value[1] != 'k')
+						throw reg::except::hive_error("expected a value cell");
+
+					std::uint16_t name_length = _u16(value + 2);
+					std::uint32_t size = _u32(value + 4);
+					std::uint32_t data = _u32(value + 8);
+					std::uint32_t type = _u32(value + 12);
+					std::uint16_t flags = _u16(value + 16);
+
+					_cell(_u32(offsets + 4 * i), 20 + static_cast<size_t>(name_length));
+					_decode_name(value + 20, name_length, (flags & _value_compressed_name) != 0, _name);
+
+					std::string_view bytes;
+					if (size & _data_inline)
+					{
+						size &= ~_data_inline;
+						if (size > 4)
+							throw reg::except::hive_error("inline data larger than 4 bytes");
+						bytes = std::string_view(value + 8, size);
+					}
+					else
+						bytes = _value_data(data, size);
+
+					visit(std::string_view(_name), type, bytes);
+				}
+			}
+
+			/// <summary>The last time the key was written, as a FILETIME</summary>
+			std::uint64_t last_write(const node& n) const
+			{
+				const char* key = _cell(n, 76);
+				return static_cast<std::uint64_t>(_u32(key + 4)) | (static_cast<std::uint64_t>(_u32(key + 8)) << 32);
+			}
+
+		private:
+			explicit file(std::string&& bytes) : _owned(std::move(bytes)), _image(_owned)
+			{
+				_validate();
+			}
+
+			static std::uint16_t _u16(const char* p) noexcept
+			{
+				std::uint16_t v;
+				std::memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			static std::uint32_t _u32(const char* p) noexcept
+			{
+				std::uint32_t v;
+				std::memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			void _validate()
+			{
+				if (_image.size() < _base_block_size || _image.substr(0, 4) != "regf")
+					throw reg::except::hive_error("missing regf signature");
+
+				_root = _u32(_image.data() + 0x24);
+				const char* root = _cell(_root, 76);
+				if (root[0] != 'n' || root[1] != 'k')
+					throw reg::except::hive_error("root cell is not a key");
+			}
+
+			/// <summary>Returns a pointer to the data of the cell at the given offset,
+			/// checking that at least the given number of bytes are available</summary>
+			const char* _cell(std::uint32_t offset, size_t needed) const
+			{
+				size_t start = _base_block_size + static_cast<size_t>(offset);
+				if (offset == _no_cell || start + 4 > _image.size())
+					throw reg::except::hive_error("cell offset out of range");
+
+				std::int32_t size = static_cast<std::int32_t>(_u32(_image.data() + start));
+				size_t length = static_cast<size_t>(size < 0 ? -static_cast<std::int64_t>(size) : size);
+				if (length < 4 || start + length > _image.size() || needed > length - 4)
+					throw reg::except::hive_error("cell exceeds its bounds");
+
+				return _image.data() + start + 4;
+			}
+
+			/// <summary>Returns the subkey offsets of a key.<para/>
+			/// The lists of the most recently used keys are cached, because a walk
+			/// looks up every child of a key right after listing it, and returns to
+			/// the parent after descending into each child.</summary>
+			const std::vector<node>& _collect_subkeys(node n) const
+			{
+				for (size_t i = 0; i < _lists.size(); i++)
+					if (_lists[i].first == n)
+					{
+						if (i + 1 != _lists.size())
+							std::rotate(_lists.begin() + i, _lists.begin() + i + 1, _lists.end());
+						return _lists.back().second;
+					}
+
+				if (_lists.size() == _cached_lists)
+					_lists.erase(_lists.begin());
+
+				std::vector<node> offsets;
+				const char* key = _cell(n, 76);
+				std::uint32_t count = _u32(key + 20);
+				std::uint32_t list = _u32(key + 28);
+				if (count != 0 && list != _no_cell)
+				{
+					offsets.reserve(count);
+					_collect_list(list, offsets, 0);
+					_check_subkeys(n, offsets);
+				}
+
+				_lists.emplace_back(n, std::move(offsets));
+				return _lists.back().second;
+			}
+
+			void _collect_list(std::uint32_t offset, std::vector<node>& out, int depth) const
+			{
+				if (depth > 2)
+					throw reg::except::hive_error("subkey lists nested too deeply");
+
+				const char* list = _cell(offset, 4);
+				std::uint16_t count = _u16(list + 2);
+
+				if ((list[0] == 'l' && list[1] == 'f') || (list[0] == 'l' && list[1] == 'h'))
+				{
+					_cell(offset, 4 + 8 * static_cast<size_t>(count));
+					for (std::uint16_t i = 0; i < count; i++)
+						out.push_back(_u32(list + 4 + 8 * i));
+				}
+				else if (list[0] == 'l' && list[1] == 'i')
+				{
+					_cell(offset, 4 + 4 * static_cast<size_t>(count));
+					for (std::uint16_t i = 0; i < count; i++)
+						out.push_back(_u32(list + 4 + 4 * i));
+				}
+				else if (list[0] == 'r' && list[1] == 'i')
+				{
+					_cell(offset, 4 + 4 * static_cast<size_t>(count));
+					for (std::uint16_t i = 0; i < count; i++)
+						_collect_list(_u32(list + 4 + 4 * i), out, depth + 1);
+				}
+				else
+					throw reg::except::hive_error("unknown subkey list");
+			}
+
+			/// <summary>Checks that the key is reached from the root in at most _max_depth levels, and that
+			/// every listed subkey names the key as its parent, is listed once and is not the root.
+			/// Together these rule out cycles and shared subtrees.</summary>
+			void _check_subkeys(node n, const std::vector<node>& offsets) const
+			{
+				node ancestor = n;
+				for (size_t depth = 0; ancestor != _root; depth++)
+				{
+					if (depth == _max_depth)
+						throw reg::except::hive_error("key is nested too deeply or not connected to the root");
+					ancestor = _parent(ancestor);
+				}
+
+				for (node subkey : offsets)
+					if (subkey == _root || _parent(subkey) != n)
+						throw reg::except::hive_error("subkey list refers to a key of another parent");
+
+				_sorted.assign(offsets.begin(), offsets.end());
+				std::sort(_sorted.begin(), _sorted.end());
+				if (std::adjacent_find(_sorted.begin(), _sorted.end()) != _sorted.end())
+					throw reg::except::hive_error("subkey listed twice");
+			}
+
+			node _parent(node n) const
+			{
+				const char* key = _cell(n, 76);
+				if (key[0] != 'n' || key[1] != 'k')
+					throw reg::except::hive_error("expected a key cell");
+				return _u32(key + 16);
+			}
+
+			void _key_name(node n, std::string& out) const
+			{
+				const char* key = _cell(n, 76);
+				if (key[0] != 'n' || key[1] != 'k')
+					throw reg::except::hive_error("expected a key cell");
+
+				std::uint16_t length = _u16(key + 72);
+				_cell(n, 76 + static_cast<size_t>(length));
+				_decode_name(key + 76, length, (_u16(key + 2) & _key_compressed_name) != 0, out);
+			}
+
+			/// <summary>Names are stored either as Latin-1 ("compressed") or as UTF-16LE</summary>
+			static void _decode_name(const char* bytes, size_t length, bool compressed, std::string& out)
+			{
+				out.clear();
+				if (compressed)
+				{
+					for (size_t i = 0; i < length; i++)
+					{
+						unsigned char c = static_cast<unsigned char>(bytes[i]);
+						if (c < 0x80)
+							out.push_back(static_cast<char>(c));
+						else
+						{
+							out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+							out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+						}
+					}
+					return;
+				}
+
+				char16_t units[128];
+				for (size_t done = 0; done < length / 2;)
+				{
+					size_t count = std::min<size_t>(length / 2 - done, 128);
+					std::memcpy(units, bytes + 2 * done, 2 * count);
+					reg::utf::append_utf8(units, count, out);
+					done += count;
+				}
+			}
+
+			/// <summary>Locates the data of a value, assembling big data (db) segments
+			/// into a reused buffer when the value spans more than one cell</summary>
+			std::string_view _value_data(std::uint32_t offset, std::uint32_t size) const
+			{
+				if (size == 0)
+					return std::string_view();
+
+				const char* cell = _cell(offset, 4);
+				if (size > _big_data_segment && cell[0] == 'd' && cell[1] == 'b')
+				{
+					std::uint16_t count = _u16(cell + 2);
+					const char* segments = _cell(_u32(cell + 4), 4 * static_cast<size_t>(count));
+
+					_big.clear();
+					for (std::uint16_t i = 0; i < count && _big.size() < size; i++)
+					{
+						size_t part = std::min<size_t>(_big_data_segment, size - _big.size());
+						_big.append(_cell(_u32(segments + 4 * i), part), part);
+					}
+					if (_big.size() != size)
+						throw reg::except::hive_error("big data is truncated");
+					return _big;
+				}
+
+				return std::string_view(_cell(offset, size), size);
+			}
+
+			std::string _owned;
+			std::string_view _image;
+			node _root = 0;
+
+			mutable std::vector<std::pair<node, std::vector<node>>> _lists;
+			mutable std::vector<node> _sorted;
+			mutable std::string _name;
+			mutable std::string _big;
+		};
+	}
+}
@@ -0,0 +1,539 @@
+#pragma once
+
+// Instrumentation of the calls the library makes into the registry. It is compiled in only
+// when REG_INSTRUMENT is defined before the first registry header is included; otherwise the
+// macros below expand to the bare calls and nothing else in this file is compiled.
+
+#ifndef REG_INSTRUMENT
+
+/// <summary>Makes a call into the registry, timing and counting it when instrumentation is on</summary>
+#define REG_API_CALL(name, key, subject, call) (call)
+/// <summary>Attributes the registry calls made until the end of the scope to a wrapper operation</summary>
+#define REG_OPERATION(name)
+
+#else
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define REG_INSTRUMENT_TSC() __rdtsc()
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define REG_INSTRUMENT_TSC() __rdtsc()
+#endif
+
+#define REG_API_CALL(name, key, subject, call) reg::instrument::_record(reg::instrument::function::name, key, subject, [&] { return call; })
+#define REG_OPERATION(name) \
+	static reg::instrument::_site _reg_site(name); \
+	reg::instrument::_operation_scope _reg_operation(_reg_site)
+
+namespace reg
+{
+	/// <summary>Counters and latency histograms of the calls the library makes into the registry,
+	/// compiled in when REG_INSTRUMENT is defined.<para/>
+	/// Each thread records its calls in its own slots with plain atomic stores, without locking and
+	/// without sharing a cache line with another thread; collect() adds up the slots of all threads,
+	/// including those that have ended. Every call is also attributed to the outermost wrapper
+	/// operation it was made from (query::number, remove::cluster...), which shows how many calls
+	/// each operation costs. Latencies are kept in log-linear buckets with a relative error under
+	/// 1/8, as in HDR histograms.</summary>
+	/// <example><code>#define REG_INSTRUMENT
+	/// #include "registry.h"
+	/// ...
+	/// auto before = reg::instrument::collect();
+	/// reg::query::number(HKEY_CURRENT_USER, "Software\\X", "Value");
+	/// std::cout &lt;&lt; reg::instrument::collect().since(before).text();</code></example>
+	namespace instrument
+	{
+		/// <summary>The functions of reg::api, one counter set each</summary>
+		enum class function : std::uint8_t
+		{
+			open_key,
+			create_key,
+			close_key,
+			query_value,
+			get_value,
+			set_value,
+			delete_value,
+			delete_key,
+			delete_tree,
+			query_info,
+			enum_key,
+			enum_value,
+			query_values,
+			get_key_security,
+			notify_change,
+			count
+		};
+
+		constexpr std::array<std::string_view, static_cast<size_t>(function::count)> function_names = {
+			"open_key", "create_key", "close_key", "query_value", "get_value", "set_value", "delete_value",
+			"delete_key", "delete_tree", "query_info", "enum_key", "enum_value", "query_values",
+			"get_key_security", "notify_change"
+		};
+
+		/// <summary>Latencies in log-linear buckets: 8 per power of two</summary>
+		struct histogram
+		{
+			static constexpr size_t sub_buckets = 8;
+			/// <summary>Exact buckets below 8 ticks, then 8 for each power of two up to 2^63</summary>
+			static constexpr size_t buckets = 62 * sub_buckets;
+
+			/// <summary>The number of calls in each bucket</summary>
+			std::array<std::uint64_t, buckets> counts{};
+			/// <summary>The smallest latency of each bucket in nanoseconds; set by collect</summary>
+			std::array<double, buckets> lower{};
+
+			/// <summary>The bucket of a duration in clock ticks</summary>
+			static size_t bucket(std::uint64_t ticks) noexcept
+			{
+				if (ticks < sub_buckets)
+					return static_cast<size_t>(ticks);
+				// the highest bit set, by halving
+				int exponent = 0;
+				for (int shift = 32; shift != 0; shift /= 2)
+					if ((ticks >> (exponent + shift)) != 0)
+						exponent += shift;
+				const size_t mantissa = static_cast<size_t>(ticks >> (exponent - 3)) & (sub_buckets - 1);
+				return (static_cast<size_t>(exponent) - 2) * sub_buckets + mantissa;
+			}
+
+			/// <summary>The smallest duration in clock ticks that falls in a bucket</summary>
+			static std::uint64_t lowest(size_t bucket) noexcept
+			{
+				if (bucket < sub_buckets)
+					return bucket;
+				const size_t exponent = bucket / sub_buckets + 2;
+				return (static_cast<std::uint64_t>(sub_buckets + bucket % sub_buckets)) << (exponent - 3);
+			}
+
+			std::uint64_t total() const noexcept
+			{
+				std::uint64_t sum = 0;
+				for (std::uint64_t count : counts)
+					sum += count;
+				return sum;
+			}
+
+			/// <summary>The latency in nanoseconds below which the given fraction of the calls fall</summary>
+			/// <param name='fraction'>Between 0 and 1, e.g. 0.99 for the 99th percentile</param>
+			double percentile(double fraction) const noexcept
+			{
+				const std::uint64_t sum = total();
+				if (sum == 0)
+					return 0;
+				const std::uint64_t rank = (std::max)(static_cast<std::uint64_t>(fraction * static_cast<double>(sum) + 0.5), std::uint64_t(1));
+				std::uint64_t seen = 0;
+				for (size_t i = 0; i < buckets; ++i)
+				{
+					seen += counts[i];
+					if (seen >= rank)
+						return lower[i];
+				}
+				return lower[buckets - 1];
+			}
+		};
+
+		struct function_stats
+		{
+			std::string_view name;
+			std::uint64_t calls = 0;
+			/// <summary>Calls that returned anything but ERROR_SUCCESS, such as ERROR_FILE_NOT_FOUND or ERROR_MORE_DATA</summary>
+			std::uint64_t failures = 0;
+			double total_ns = 0;
+			histogram latency;
+		};
+
+		struct operation_stats
+		{
+			std::string_view name;
+			/// <summary>How many times the operation ran</summary>
+			std::uint64_t count = 0;
+			/// <summary>Registry calls made by those runs</summary>
+			std::uint64_t calls = 0;
+			/// <summary>Time spent in those registry calls</summary>
+			double total_ns = 0;
+		};
+
+		/// <summary>The totals of every thread at one point in time</summary>
+		struct snapshot
+		{
+			std::vector<function_stats> functions;
+			std::vector<operation_stats> operations;
+
+			/// <summary>All registry calls made</summary>
+			std::uint64_t calls() const noexcept
+			{
+				std::uint64_t sum = 0;
+				for (const function_stats& f : functions)
+					sum += f.calls;
+				return sum;
+			}
+
+			/// <summary>The stats of one function of reg::api</summary>
+			const function_stats& operator[](function f) const
+			{
+				return functions[static_cast<size_t>(f)];
+			}
+
+			/// <summary>The stats of one operation, or null if it never ran</summary>
+			const operation_stats* operation(std::string_view name) const noexcept
+			{
+				for (const operation_stats& op : operations)
+					if (op.name == name)
+						return &op;
+				return nullptr;
+			}
+
+			/// <summary>What happened between an earlier snapshot and this one</summary>
+			snapshot since(const snapshot& earlier) const
+			{
+				snapshot delta = *this;
+				for (size_t i = 0; i < delta.functions.size() && i < earlier.functions.size(); ++i)
+				{
+					function_stats& f = delta.functions[i];
+					const function_stats& e = earlier.functions[i];
+					f.calls -= e.calls;
+					f.failures -= e.failures;
+					f.total_ns -= e.total_ns;
+					for (size_t b = 0; b < histogram::buckets; ++b)
+						f.latency.counts[b] -= e.latency.counts[b];
+				}
+				for (operation_stats& op : delta.operations)
+					if (const operation_stats* e = earlier.operation(op.name))
+					{
+						op.count -= e->count;
+						op.calls -= e->calls;
+						op.total_ns -= e->total_ns;
+					}
+				return delta;
+			}
+
+			/// <summary>A table of the functions and operations that were used</summary>
+			std::string text() const
+			{
+				std::string out;
+				char line[160];
+				std::snprintf(line, sizeof(line), "%-18s %10s %9s %11s %9s %9s %9s\n",
+					"function", "calls", "failed", "total ms", "p50 ns", "p99 ns", "p99.9 ns");
+				out += line;
+				for (const function_stats& f : functions)
+					if (f.calls != 0)
+					{
+						std::snprintf(line, sizeof(line), "%-18.*s %10llu %9llu %11.3f %9.0f %9.0f %9.0f\n",
+							static_cast<int>(f.name.size()), f.name.data(),
+							static_cast<unsigned long long>(f.calls), static_cast<unsigned long long>(f.failures),
+							f.total_ns / 1e6, f.latency.percentile(0.5), f.latency.percentile(0.99), f.latency.percentile(0.999));
+						out += line;
+					}
+
+				std::snprintf(line, sizeof(line), "\n%-24s %10s %10s %9s %11s\n", "operation", "count", "calls", "calls/op", "api ms");
+				out += line;
+				for (const operation_stats& op : operations)
+					if (op.count != 0)
+					{
+						std::snprintf(line, sizeof(line), "%-24.*s %10llu %10llu %9.1f %11.3f\n",
+							static_cast<int>(op.name.size()), op.name.data(),
+							static_cast<unsigned long long>(op.count), static_cast<unsigned long long>(op.calls),
+							static_cast<double>(op.calls) / static_cast<double>(op.count), op.total_ns / 1e6);
+						out += line;
+					}
+				return out;
+			}
+		};
+
+		/// <summary>One call into the registry, as handed to a tracer</summary>
+		struct call
+		{
+			reg::instrument::function api;
+			/// <summary>The key handle the call was given</summary>
+			const void* key;
+			/// <summary>The path or value name the call was given, if any</summary>
+			std::string_view subject;
+			long result;
+			/// <summary>Clock ticks when the call started and returned</summary>
+			std::uint64_t start;
+			std::uint64_t end;
+		};
+
+		/// <summary>Receives every call while set; see registry_trace.h</summary>
+		inline std::atomic<void(*)(const call&)> _tracer{ nullptr };
+
+		/// <summary>Operations beyond this number are counted under the operation that ran them, if any</summary>
+		constexpr size_t max_operations = 128;
+
+		// not in an anonymous namespace: every translation unit has to count into the same slots
+
+		/// <summary>A counter written by one thread only, so an increment is a load and a store</summary>
+		struct _counter
+		{
+			std::atomic<std::uint64_t> value{ 0 };
+
+			void add(std::uint64_t amount) noexcept
+			{
+				value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+			}
+			std::uint64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+		};
+
+		struct _function_slot
+		{
+			_counter calls;
+			_counter failures;
+			_counter ticks;
+			std::array<_counter, histogram::buckets> latency;
+		};
+
+		struct _operation_slot
+		{
+			_counter count;
+			_counter calls;
+			_counter ticks;
+		};
+
+		/// <summary>The counters of one thread, alone on their cache lines</summary>
+		struct alignas(64) _thread_slots
+		{
+			std::array<_function_slot, static_cast<size_t>(function::count)> functions;
+			std::array<_operation_slot, max_operations> operations;
+		};
+
+		/// <summary>A place in the code that starts an operation</summary>
+		class _site
+		{
+		public:
+			explicit _site(std::string_view name) noexcept;
+			std::string_view name;
+			size_t index;
+		};
+
+		struct _registry
+		{
+			std::mutex mutex;
+			std::vector<_thread_slots*> live;
+			/// <summary>The sums of the threads that ended</summary>
+			_thread_slots departed;
+			std::array<std::string_view, max_operations> operation_names{};
+			size_t operation_count = 0;
+
+			/// <summary>The clock reading and time when instrumentation started, to convert ticks</summary>
+			std::uint64_t start_ticks = 0;
+			std::chrono::steady_clock::time_point start_time;
+		};
+
+		inline std::uint64_t _ticks() noexcept
+		{
+#ifdef REG_INSTRUMENT_TSC
+			return REG_INSTRUMENT_TSC();
+#else
+			return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		inline _registry& _global()
+		{
+			static _registry* registry = [] {
+				auto* r = new _registry(); // never destroyed: threads may end after static destruction
+				r->start_time = std::chrono::steady_clock::now();
+				r->start_ticks = _ticks();
+				return r;
+			}();
+			return *registry;
+		}
+
+		inline void _merge(_thread_slots& into, const _thread_slots& from) noexcept
+		{
+			for (size_t f = 0; f < from.functions.size(); ++f)
+			{
+				into.functions[f].calls.add(from.functions[f].calls.get());
+				into.functions[f].failures.add(from.functions[f].failures.get());
+				into.functions[f].ticks.add(from.functions[f].ticks.get());
+				for (size_t b = 0; b < histogram::buckets; ++b)
+					into.functions[f].latency[b].add(from.functions[f].latency[b].get());
+			}
+			for (size_t o = 0; o < max_operations; ++o)
+			{
+				into.operations[o].count.add(from.operations[o].count.get());
+				into.operations[o].calls.add(from.operations[o].calls.get());
+				into.operations[o].ticks.add(from.operations[o].ticks.get());
+			}
+		}
+
+		/// <summary>Registers the slots of a thread on its first call and folds them into the totals when it ends</summary>
+		class _thread_registration
+		{
+		public:
+			_thread_registration()
+				: slots(new _thread_slots())
+			{
+				_registry& registry = _global();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				registry.live.push_back(slots);
+			}
+			~_thread_registration()
+			{
+				_registry& registry = _global();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				_merge(registry.departed, *slots);
+				registry.live.erase(std::find(registry.live.begin(), registry.live.end(), slots));
+				delete slots;
+			}
+
+			_thread_slots* slots;
+			/// <summary>The operation the thread is in, or max_operations for none</summary>
+			size_t operation = max_operations;
+		};
+
+		inline _thread_registration& _local()
+		{
+			thread_local _thread_registration registration;
+			return registration;
+		}
+
+		inline _site::_site(std::string_view name) noexcept
+			: name(name), index(max_operations)
+		{
+			// overloads of one operation share its counters
+			_registry& registry = _global();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			for (size_t i = 0; i < registry.operation_count; ++i)
+				if (registry.operation_names[i] == name)
+				{
+					index = i;
+					return;
+				}
+			if (registry.operation_count < max_operations)
+			{
+				index = registry.operation_count++;
+				registry.operation_names[index] = name;
+			}
+		}
+
+		/// <summary>Makes a site the current operation of the thread, unless one is already running</summary>
+		class _operation_scope
+		{
+		public:
+			explicit _operation_scope(const _site& site) noexcept
+			{
+				_thread_registration& local = _local();
+				if (local.operation == max_operations && site.index != max_operations)
+				{
+					_local_ = &local;
+					local.operation = site.index;
+					local.slots->operations[site.index].count.add(1);
+				}
+			}
+			_operation_scope(const _operation_scope&) = delete;
+			_operation_scope& operator=(const _operation_scope&) = delete;
+			~_operation_scope()
+			{
+				if (_local_ != nullptr)
+					_local_->operation = max_operations;
+			}
+
+		private:
+			_thread_registration* _local_ = nullptr;
+		};
+
+		template<typename Call>
+		auto _record(function f, const void* key, std::string_view subject, Call&& call)
+		{
+			_thread_registration& local = _local();
+			const std::uint64_t start = _ticks();
+			auto code = call();
+			const std::uint64_t elapsed = _ticks() - start;
+
+			_function_slot& slot = local.slots->functions[static_cast<size_t>(f)];
+			slot.calls.add(1);
+			if (code != 0)
+				slot.failures.add(1);
+			slot.ticks.add(elapsed);
+			slot.latency[histogram::bucket(elapsed)].add(1);
+			if (local.operation != max_operations)
+			{
+				_operation_slot& op = local.slots->operations[local.operation];
+				op.calls.add(1);
+				op.ticks.add(elapsed);
+			}
+			if (auto tracer = _tracer.load(std::memory_order_acquire))
+				tracer({ f, key, subject, static_cast<long>(code), start, start + elapsed });
+			return code;
+		}
+
+		/// <summary>Nanoseconds per clock tick, measured over at least 10ms since instrumentation started</summary>
+		inline double _ns_per_tick()
+		{
+#ifdef REG_INSTRUMENT_TSC
+			_registry& registry = _global();
+			const auto settled = registry.start_time + std::chrono::milliseconds(10);
+			while (std::chrono::steady_clock::now() < settled)
+				std::this_thread::yield();
+			const std::uint64_t ticks = _ticks() - registry.start_ticks;
+			const auto elapsed = std::chrono::steady_clock::now() - registry.start_time;
+			return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ticks);
+#else
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+		}
+
+		/// <summary>Adds up the counters of every thread, the running ones and those that ended.<para/>
+		/// Calls made while collecting may or may not be included.</summary>
+		inline snapshot collect()
+		{
+			_registry& registry = _global();
+			const double ns = _ns_per_tick();
+
+			auto sum = std::make_unique<_thread_slots>();
+			std::array<std::string_view, max_operations> names;
+			size_t operations = 0;
+			{
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				_merge(*sum, registry.departed);
+				for (const _thread_slots* slots : registry.live)
+					_merge(*sum, *slots);
+				names = registry.operation_names;
+				operations = registry.operation_count;
+			}
+
+			snapshot result;
+			result.functions.resize(function_names.size());
+			for (size_t f = 0; f < function_names.size(); ++f)
+			{
+				function_stats& stats = result.functions[f];
+				stats.name = function_names[f];
+				stats.calls = sum->functions[f].calls.get();
+				stats.failures = sum->functions[f].failures.get();
+				stats.total_ns = static_cast<double>(sum->functions[f].ticks.get()) * ns;
+				for (size_t b = 0; b < histogram::buckets; ++b)
+				{
+					stats.latency.counts[b] = sum->functions[f].latency[b].get();
+					stats.latency.lower[b] = static_cast<double>(histogram::lowest(b)) * ns;
+				}
+			}
+
+			for (size_t o = 0; o < operations; ++o)
+			{
+				operation_stats stats;
+				stats.name = names[o];
+				stats.count = sum->operations[o].count.get();
+				stats.calls = sum->operations[o].calls.get();
+				stats.total_ns = static_cast<double>(sum->operations[o].ticks.get()) * ns;
+				result.operations.push_back(stats);
+			}
+			return result;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,340 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry.h"
+#include "registry_batch.h"
+
+namespace reg
+{
+	namespace
+	{
+		/// <summary>CRC-32 (IEEE 802.3) of a run of bytes</summary>
+		inline std::uint32_t _crc32(std::string_view bytes) noexcept
+		{
+			static const std::array<std::uint32_t, 256> table = [] {
+				std::array<std::uint32_t, 256> t{};
+				for (std::uint32_t i = 0; i < 256; ++i)
+				{
+					std::uint32_t c = i;
+					for (int k = 0; k < 8; ++k)
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					t[i] = c;
+				}
+				return t;
+			}();
+
+			std::uint32_t crc = 0xFFFFFFFFu;
+			for (char b : bytes)
+				crc = table[(crc ^ static_cast<unsigned char>(b)) & 0xFF] ^ (crc >> 8);
+			return crc ^ 0xFFFFFFFFu;
+		}
+	}
+
+	/// <summary>A write-ahead journal that makes a batch of changes across keys survive a crash.<para/>
+	/// Changes are gathered in memory. <see cref="commit"/> writes them to the journal file as
+	/// one checksummed record and flushes the file to disk once, then applies them to the
+	/// registry and empties the file. If the process dies while the changes are being applied,
+	/// the record is still in the file, and the next journal opened on the file replays it
+	/// before anything else. A record that was not completely written, because the process
+	/// died while writing it, fails its checksum and is dropped: none of its changes had been
+	/// applied, so the batch is rolled back as a whole.<para/>
+	/// Every change writes or deletes a value or deletes a key outright, so replaying a batch
+	/// that was partly applied already gives the same result. Only the predefined root keys
+	/// such as HKEY_CURRENT_USER can be used, since the handles of opened keys do not outlive
+	/// the process.<para/>
+	/// The file holds one record: the magic "RGJ1", the payload size and the CRC-32 of the
+	/// payload, each 32-bit little-endian, then the payload. The payload is the number of
+	/// changes followed by the changes, each a kind byte (0 set, 1 remove value, 2 remove
+	/// key), the root key, the value type, the sizes of the key, name and data, and then the
+	/// key, name and data bytes themselves.</summary>
+	/// <example><code>reg::journal journal("C:\\ProgramData\\Agent\\registry.journal");	// replays an interrupted batch
+	/// journal.set&lt;DWORD&gt;(HKEY_CURRENT_USER, "Software\\X", "Port", 8080);
+	/// journal.set&lt;std::string&gt;(HKEY_CURRENT_USER, "Software\\X\\Proxy", "Host", "proxy");
+	/// journal.commit();	// both values or neither, even if the process dies</code></example>
+	class journal
+	{
+	public:
+		/// <summary>Opens the journal file, creating it if needed, and replays a batch
+		/// left behind by a commit that did not finish.<para/>
+		/// Throws an exception if the file cannot be opened, or if replaying fails; the
+		/// batch then stays in the file and is tried again the next time.</summary>
+		/// <param name='filename'>Path to the journal file</param>
+		explicit journal(const std::string& filename)
+			: _filename(filename)
+		{
+			_file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (_file == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Could not open \"" + filename + "\"");
+
+			try
+			{
+				_recover();
+			}
+			catch (...)
+			{
+				CloseHandle(_file);
+				throw;
+			}
+		}
+
+		journal(const journal&) = delete;
+		journal& operator=(const journal&) = delete;
+		~journal()
+		{
+			CloseHandle(_file);
+		}
+
+		/// <summary>Records a write of the value, stored as the type T maps to
+		/// (see <see cref="reg::value_traits"/>). The key is created on commit if needed.</summary>
+		template<typename T>
+		journal& set(HKEY machine, std::string_view key, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+			_operation& op = _add(_kind::set, machine, key, value);
+			op.type = reg::value_traits<T>::type;
+			reg::value_traits<T>::encode(data, op.data);
+			return *this;
+		}
+
+		/// <summary>Records a deletion of the value. Deleting a value that does not exist is not an error.</summary>
+		journal& remove_value(HKEY machine, std::string_view key, std::string_view value)
+		{
+			_add(_kind::remove_value, machine, key, value);
+			return *this;
+		}
+
+		/// <summary>Records a deletion of the key and its whole subtree.<para/>
+		/// Throws an exception if the key is empty; a root key cannot be removed</summary>
+		journal& remove_key(HKEY machine, std::string_view key)
+		{
+			if (key.find_first_not_of('\\') == std::string_view::npos)
+				throw std::invalid_argument("A root key cannot be removed");
+			_add(_kind::remove_key, machine, key, "");
+			return *this;
+		}
+
+		/// <summary>The number of changes waiting for <see cref="commit"/></summary>
+		size_t size() const noexcept { return _operations.size(); }
+		bool empty() const noexcept { return _operations.empty(); }
+
+		/// <summary>Drops the changes that were not committed</summary>
+		void clear() noexcept { _operations.clear(); }
+
+		/// <summary>The number of changes replayed when the journal was opened</summary>
+		size_t recovered() const noexcept { return _recovered; }
+
+		/// <summary>Makes the changes durable in the journal with a single flush to disk,
+		/// applies them to the registry in order and empties the journal.<para/>
+		/// Value changes are applied through a <see cref="reg::write_batch"/>, which opens each
+		/// key once. Throws an exception if the journal cannot be written, in which case the
+		/// registry is untouched, or if a change cannot be applied, in which case the record
+		/// stays in the journal and is replayed when the journal is next opened. Either way
+		/// the journal keeps its changes.</summary>
+		/// <returns>The number of changes applied</returns>
+		size_t commit()
+		{
+			if (_operations.empty())
+				return 0;
+
+			_write(_encode(_operations));
+			_apply(_operations);
+			_truncate();
+
+			const size_t count = _operations.size();
+			_operations.clear();
+			return count;
+		}
+
+	private:
+		enum class _kind : std::uint8_t { set, remove_value, remove_key };
+
+		struct _operation
+		{
+			_kind kind;
+			HKEY machine;
+			std::string key = {};
+			std::string name = {};
+			DWORD type = REG_NONE;
+			/// <summary>The data exactly as stored in the registry</summary>
+			std::string data = {};
+		};
+
+		static constexpr char _magic[4] = { 'R', 'G', 'J', '1' };
+		static constexpr size_t _header = 12;
+
+		/// <summary>The 32-bit value a predefined root key is known by</summary>
+		static std::uint32_t _root(HKEY machine)
+		{
+			const std::uint32_t id = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(machine));
+			if (id < 0x80000000u || id > 0x800000FFu || _machine(id) != machine)
+				throw std::invalid_argument("Only predefined root keys can be journaled");
+			return id;
+		}
+
+		/// <summary>The predefined root key a 32-bit value stands for; the handles are sign-extended</summary>
+		static HKEY _machine(std::uint32_t id) noexcept
+		{
+			return reinterpret_cast<HKEY>(static_cast<ULONG_PTR>(static_cast<LONG>(id)));
+		}
+
+		_operation& _add(_kind kind, HKEY machine, std::string_view key, std::string_view name)
+		{
+			_root(machine);
+			_operations.push_back({ kind, machine, std::string(key), std::string(name) });
+			return _operations.back();
+		}
+
+		static void _put32(std::string& out, std::uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+				out.push_back(static_cast<char>(value >> (8 * i)));
+		}
+
+		static std::uint32_t _get32(const char* in) noexcept
+		{
+			std::uint32_t value = 0;
+			for (int i = 0; i < 4; ++i)
+				value |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+			return value;
+		}
+
+		static std::string _encode(const std::vector<_operation>& operations)
+		{
+			std::string record(_magic, sizeof(_magic));
+			record.resize(_header);
+			_put32(record, static_cast<std::uint32_t>(operations.size()));
+			for (const _operation& op : operations)
+			{
+				record.push_back(static_cast<char>(op.kind));
+				_put32(record, _root(op.machine));
+				_put32(record, op.type);
+				_put32(record, static_cast<std::uint32_t>(op.key.size()));
+				_put32(record, static_cast<std::uint32_t>(op.name.size()));
+				_put32(record, static_cast<std::uint32_t>(op.data.size()));
+				record += op.key;
+				record += op.name;
+				record += op.data;
+			}
+
+			std::string_view payload = std::string_view(record).substr(_header);
+			std::string sizes;
+			_put32(sizes, static_cast<std::uint32_t>(payload.size()));
+			_put32(sizes, reg::_crc32(payload));
+			record.replace(sizeof(_magic), sizes.size(), sizes);
+			return record;
+		}
+
+		/// <summary>The changes of a record, or false if the record is torn or corrupt</summary>
+		static bool _decode(std::string_view record, std::vector<_operation>& operations)
+		{
+			if (record.size() < _header || std::memcmp(record.data(), _magic, sizeof(_magic)) != 0)
+				return false;
+			const std::uint32_t size = _get32(record.data() + 4);
+			if (record.size() - _header < size)
+				return false;
+			std::string_view payload = record.substr(_header, size);
+			if (reg::_crc32(payload) != _get32(record.data() + 8) || payload.size() < 4)
+				return false;
+
+			std::uint32_t count = _get32(payload.data());
+			payload.remove_prefix(4);
+			operations.clear();
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				if (payload.size() < 21 || static_cast<std::uint8_t>(payload[0]) > 2)
+					return false;
+				_operation op{ static_cast<_kind>(payload[0]), _machine(_get32(payload.data() + 1)) };
+				op.type = _get32(payload.data() + 5);
+				const size_t key = _get32(payload.data() + 9);
+				const size_t name = _get32(payload.data() + 13);
+				const size_t data = _get32(payload.data() + 17);
+				payload.remove_prefix(21);
+				if (payload.size() < key + name + data)
+					return false;
+				op.key.assign(payload.substr(0, key));
+				op.name.assign(payload.substr(key, name));
+				op.data.assign(payload.substr(key + name, data));
+				payload.remove_prefix(key + name + data);
+				operations.push_back(std::move(op));
+			}
+			return true;
+		}
+
+		/// <summary>Applies changes in order. Runs of value changes go through one batch;
+		/// a key deletion first flushes the changes recorded before it.</summary>
+		static void _apply(const std::vector<_operation>& operations)
+		{
+			reg::write_batch batch;
+			for (const _operation& op : operations)
+			{
+				if (op.kind == _kind::set)
+					batch.set(op.machine, op.key, op.name, op.type, op.data);
+				else if (op.kind == _kind::remove_value)
+					batch.remove(op.machine, op.key, op.name);
+				else
+				{
+					batch.commit();
+					// given a subkey, RegDeleteTree removes the subkey itself as well
+					DWORD code = reg::api::delete_tree(op.machine, op.key);
+					if (code != ERROR_FILE_NOT_FOUND)
+						reg::assert::success(code);
+				}
+			}
+			batch.commit();
+		}
+
+		/// <summary>Replaces the contents of the file with a record and flushes it to disk</summary>
+		void _write(const std::string& record)
+		{
+			LARGE_INTEGER start{};
+			DWORD written = 0;
+			if (!SetFilePointerEx(_file, start, NULL, FILE_BEGIN)
+				|| !WriteFile(_file, record.data(), static_cast<DWORD>(record.size()), &written, NULL)
+				|| written != record.size()
+				|| !FlushFileBuffers(_file))
+				throw std::runtime_error("Could not write the journal \"" + _filename + "\"");
+		}
+
+		/// <summary>Empties the file. This is not flushed: should the old record come back
+		/// after a system crash, replaying it again changes nothing.</summary>
+		void _truncate()
+		{
+			LARGE_INTEGER start{};
+			if (!SetFilePointerEx(_file, start, NULL, FILE_BEGIN) || !SetEndOfFile(_file))
+				throw std::runtime_error("Could not clear the journal \"" + _filename + "\"");
+		}
+
+		void _recover()
+		{
+			LARGE_INTEGER size{};
+			if (!GetFileSizeEx(_file, &size))
+				throw std::runtime_error("Could not read the journal \"" + _filename + "\"");
+			if (size.QuadPart == 0)
+				return;
+
+			std::string record(static_cast<size_t>(size.QuadPart), '\0');
+			DWORD read = 0;
+			if (!ReadFile(_file, record.data(), static_cast<DWORD>(record.size()), &read, NULL) || read != record.size())
+				throw std::runtime_error("Could not read the journal \"" + _filename + "\"");
+
+			std::vector<_operation> operations;
+			if (_decode(record, operations))
+			{
+				_apply(operations);
+				_recovered = operations.size();
+			}
+			_truncate();
+		}
+
+		std::string _filename;
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		std::vector<_operation> _operations;
+		size_t _recovered = 0;
+	};
+}
@@ -0,0 +1,270 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "registry.h"
+#include "registry_struct.h"
+
+namespace reg
+{
+	/// <summary>A struct loaded from one key, shared by many reader threads and refreshed in the background.<para/>
+	/// Every load is published as a new immutable version behind an atomic pointer, so reading the
+	/// current version is a single atomic load and readers never wait for each other nor for the
+	/// registry. Old versions are reclaimed the way read-copy-update does it: each reader thread
+	/// holds a <see cref="reader"/> and calls quiescent() whenever it holds no reference into a
+	/// version, typically between two requests. A version is freed once every reader has done so
+	/// after it was replaced; a reader that never calls quiescent() keeps old versions alive.<para/>
+	/// A background thread checks the key's last write time at every interval and loads the key
+	/// again only if it moved. Fields whose value does not exist keep the default of the struct,
+	/// as with <see cref="reg::load"/>; a missing key gives a default struct. Failed background
+	/// loads leave the current version in place and are retried at the next interval.</summary>
+	/// <example><code>reg::live_config&lt;options&gt; config(HKEY_LOCAL_MACHINE, "Software\\X");
+	/// // on each worker thread
+	/// reg::live_config&lt;options&gt;::reader settings(config);
+	/// for (;;) {
+	///     serve(next_request(), settings->timeout);
+	///     settings.quiescent();
+	/// }</code></example>
+	template<typename Struct>
+	class live_config
+	{
+		/// <summary>The epoch a reader last announced, alone on its cache line</summary>
+		struct alignas(64) _epoch_slot
+		{
+			std::atomic<std::uint64_t> seen{ 0 };
+			bool used = false;
+		};
+
+	public:
+		/// <summary>Reads the current version on one thread. It must not outlive its live_config.</summary>
+		class reader
+		{
+		public:
+			explicit reader(live_config& config)
+				: _config(config), _slot(config._enter())
+			{
+			}
+
+			reader(const reader&) = delete;
+			reader& operator=(const reader&) = delete;
+			~reader()
+			{
+				_config._leave(_slot);
+			}
+
+			/// <summary>The current version; a single atomic load.<para/>
+			/// The reference stays valid until the next call to quiescent().</summary>
+			const Struct& operator*() const noexcept { return *_config._current.load(std::memory_order_acquire); }
+			const Struct* operator->() const noexcept { return _config._current.load(std::memory_order_acquire); }
+
+			/// <summary>Declares that the thread holds no reference into any version it read so far</summary>
+			void quiescent() noexcept
+			{
+				_slot->seen.store(_config._epoch.load(std::memory_order_acquire), std::memory_order_release);
+			}
+
+		private:
+			live_config& _config;
+			_epoch_slot* _slot;
+		};
+
+		/// <summary>Loads the key and starts refreshing it in the background.<para/>
+		/// Throws an exception if a value has a different type than its field or cannot be read</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey holding the values; see <see cref="reg::fields"/></param>
+		/// <param name='interval'>How often the background thread looks for changes</param>
+		live_config(HKEY machine, std::string_view key, std::chrono::milliseconds interval = std::chrono::seconds(1))
+			: _machine(machine), _key(key), _interval(interval)
+		{
+			_current.store(_load().release(), std::memory_order_release);
+			_thread = std::thread(&live_config::_run, this);
+		}
+
+		live_config(const live_config&) = delete;
+		live_config& operator=(const live_config&) = delete;
+		~live_config()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_wake_mutex);
+				_stopping = true;
+			}
+			_wake.notify_one();
+			_thread.join();
+			delete _current.load(std::memory_order_relaxed);
+		}
+
+		/// <summary>Loads the key now if its last write time moved since the previous load.<para/>
+		/// Throws an exception if the key cannot be read, leaving the current version in place</summary>
+		/// <returns>True if a new version was published</returns>
+		bool refresh()
+		{
+			std::lock_guard<std::mutex> lock(_load_mutex);
+			const std::uint64_t stamp = _stamp();
+			// a write in the same tick as the previous load would not have moved the stamp
+			if (stamp == _loaded_stamp && stamp + _racy_window < _loaded_at)
+			{
+				_reclaim();
+				return false;
+			}
+
+			std::unique_ptr<const Struct> loaded = _load();
+			const Struct* previous = _current.exchange(loaded.release(), std::memory_order_acq_rel);
+			const std::uint64_t epoch = _epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+			_retired.emplace_back(epoch, std::unique_ptr<const Struct>(previous));
+			_reclaim();
+			return true;
+		}
+
+		/// <summary>The number of versions published after the first one</summary>
+		std::uint64_t version() const noexcept { return _epoch.load(std::memory_order_acquire); }
+
+		/// <summary>The number of replaced versions some reader may still be using</summary>
+		size_t retained() const
+		{
+			std::lock_guard<std::mutex> lock(_load_mutex);
+			return _retired.size();
+		}
+
+	private:
+		/// <summary>Key stamps this close to the previous load are not trusted</summary>
+		static constexpr std::uint64_t _racy_window = 10000000; // one second in FILETIME units
+		static constexpr std::uint64_t _offline = (std::numeric_limits<std::uint64_t>::max)();
+
+		/// <summary>The current time as a FILETIME, the unit key stamps are kept in</summary>
+		static std::uint64_t _now() noexcept
+		{
+			constexpr std::uint64_t unix_epoch = 116444736000000000ull;
+			auto since = std::chrono::system_clock::now().time_since_epoch();
+			return unix_epoch + static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(since).count()) * 10;
+		}
+
+		/// <summary>The last write time of the key, or 0 if it does not exist</summary>
+		std::uint64_t _stamp() const
+		{
+			HKEY handle = nullptr;
+			DWORD code = reg::api::open_key(_machine, _key, KEY_QUERY_VALUE, &handle);
+			if (code == ERROR_FILE_NOT_FOUND)
+				return 0;
+			reg::assert::success(code);
+			auto closer = reg::self_closing_handle(&handle);
+			return reg::query::details(handle).last_write;
+		}
+
+		std::unique_ptr<const Struct> _load()
+		{
+			_loaded_at = _now();
+			_loaded_stamp = _stamp();
+			auto loaded = std::make_unique<Struct>();
+			if (_loaded_stamp != 0)
+			{
+				try
+				{
+					reg::load(_machine, _key, *loaded);
+				}
+				catch (const reg::except::key_not_found&)
+				{
+					// deleted since the stamp was taken
+					*loaded = Struct();
+					_loaded_stamp = 0;
+				}
+			}
+			return loaded;
+		}
+
+		/// <summary>Frees the replaced versions every reader has moved past. Requires _load_mutex.</summary>
+		void _reclaim()
+		{
+			if (_retired.empty())
+				return;
+
+			std::uint64_t oldest = _offline;
+			{
+				std::lock_guard<std::mutex> lock(_slots_mutex);
+				for (const auto& slot : _slots)
+					oldest = (std::min)(oldest, slot->seen.load(std::memory_order_acquire));
+			}
+
+			// a reader that announced epoch e has not kept the version replaced when the epoch became e
+			_retired.erase(std::remove_if(_retired.begin(), _retired.end(), [oldest](const auto& retired) {
+				return retired.first <= oldest;
+				}), _retired.end());
+		}
+
+		_epoch_slot* _enter()
+		{
+			std::lock_guard<std::mutex> lock(_slots_mutex);
+			_epoch_slot* slot = nullptr;
+			for (const auto& free : _slots)
+				if (!free->used)
+				{
+					slot = free.get();
+					break;
+				}
+			if (slot == nullptr)
+			{
+				_slots.push_back(std::make_unique<_epoch_slot>());
+				slot = _slots.back().get();
+			}
+			slot->used = true;
+			slot->seen.store(_epoch.load(std::memory_order_acquire), std::memory_order_release);
+			return slot;
+		}
+
+		void _leave(_epoch_slot* slot) noexcept
+		{
+			std::lock_guard<std::mutex> lock(_slots_mutex);
+			slot->seen.store(_offline, std::memory_order_release);
+			slot->used = false;
+		}
+
+		void _run()
+		{
+			std::unique_lock<std::mutex> lock(_wake_mutex);
+			while (!_wake.wait_for(lock, _interval, [this] { return _stopping; }))
+			{
+				lock.unlock();
+				try
+				{
+					refresh();
+				}
+				catch (...)
+				{
+					// keep the current version and try again later
+				}
+				lock.lock();
+			}
+		}
+
+		HKEY _machine;
+		std::string _key;
+		std::chrono::milliseconds _interval;
+
+		std::atomic<const Struct*> _current{ nullptr };
+		/// <summary>Incremented after each publication</summary>
+		std::atomic<std::uint64_t> _epoch{ 0 };
+
+		mutable std::mutex _load_mutex;
+		/// <summary>Replaced versions and the epoch their replacement started</summary>
+		std::vector<std::pair<std::uint64_t, std::unique_ptr<const Struct>>> _retired;
+		std::uint64_t _loaded_stamp = 0;
+		std::uint64_t _loaded_at = 0;
+
+		std::mutex _slots_mutex;
+		std::vector<std::unique_ptr<_epoch_slot>> _slots;
+
+		std::mutex _wake_mutex;
+		std::condition_variable _wake;
+		bool _stopping = false;
+		std::thread _thread;
+	};
+}
@@ -0,0 +1,696 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry_tree.h"
+
+namespace reg
+{
+	namespace memory
+	{
+		namespace
+		{
+			constexpr std::uint32_t _empty = 0xFFFFFFFFu;
+			constexpr std::uint64_t _empty_slot = ~0ull;
+
+			/// <summary>Keys with more subkeys or values than this get a hash table of them;
+			/// smaller ones are scanned, comparing precomputed hashes first</summary>
+			constexpr size_t _indexed = 8;
+
+			/// <summary>Wasted bytes in the data arena before it is compacted</summary>
+			constexpr size_t _compact_threshold = 1 << 20;
+		}
+
+		/// <summary>A value as seen through the store. The views are valid until the store is modified.</summary>
+		struct value_view
+		{
+			std::string_view name;
+			std::uint32_t type;
+			std::string_view data;
+		};
+
+		/// <summary>An in-process registry for tests, simulation and platforms without one.<para/>
+		/// Keys and values are looked up case-insensitively, keep the case they were created
+		/// with, and can be enumerated by index in creation order, as RegEnumKeyEx and
+		/// RegEnumValue do. Removing an entry shifts the indices of the ones after it.<para/>
+		/// Names are interned once with a precomputed case-folded hash. Keys live in one
+		/// contiguous array, subkeys and values of large keys are found through flat
+		/// open-addressing tables, and value data is packed into a single arena.
+		/// A removal leaves a gap in the creation order instead of moving the entries after it,
+		/// and takes its entry out of the table without rebuilding it, so a removal takes
+		/// amortized logarithmic time however many entries the key has.<para/>
+		/// The store satisfies the tree source interface (see registry_source.h).
+		/// Node ids of removed keys are reused by keys created later.</summary>
+		class store
+		{
+		public:
+			/// <summary>The id of a key</summary>
+			using node = std::uint32_t;
+
+			store()
+			{
+				_keys.emplace_back();
+				_keys[0].name = _intern("");
+				_keys[0].hash = _names[_keys[0].name].hash;
+				_keys[0].alive = true;
+				_keys[0].stamp = _tick();
+				_live = 1;
+			}
+
+			/// <summary>The key all paths are relative to</summary>
+			node root() const noexcept { return 0; }
+
+			/// <summary>The number of keys, including the root</summary>
+			size_t size() const noexcept { return _live; }
+
+			/// <summary>Finds a key by its path relative to the root</summary>
+			std::optional<node> open(std::string_view path) const
+			{
+				return open(root(), path);
+			}
+
+			/// <summary>Finds a key by its path relative to another key</summary>
+			std::optional<node> open(node parent, std::string_view path) const
+			{
+				node current = parent;
+				for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+				{
+					current = _find_child(current, segment, reg::ihash(segment));
+					if (current == _empty)
+						return std::nullopt;
+				}
+				return current;
+			}
+
+			std::optional<node> child(const node& parent, std::string_view name) const
+			{
+				node found = _find_child(parent, name, reg::ihash(name));
+				if (found == _empty)
+					return std::nullopt;
+				return found;
+			}
+
+			void keys(const node& n, std::vector<std::string>& names) const
+			{
+				const _order& children = _keys[n].children;
+				names.resize(children.size());
+				size_t i = 0;
+				children.each([this, &names, &i](node child) { names[i++].assign(_text(_keys[child].name)); });
+				std::sort(names.begin(), names.end(), reg::iless());
+			}
+
+			template<typename F>
+			void values(const node& n, F&& visit) const
+			{
+				const _key& k = _keys[n];
+				k.value_order.each([this, &k, &visit](std::uint32_t id) {
+					const _value& v = k.values[id];
+					visit(_text(v.name), v.type, _bytes(v));
+					});
+			}
+
+			/// <summary>The time the key, its values or its list of subkeys last changed,
+			/// as a FILETIME. Stamps strictly increase with every change to the store.</summary>
+			std::uint64_t last_write(const node& n) const
+			{
+				return _keys[n].stamp;
+			}
+
+			/// <summary>Creates the key at the given path, relative to another key,
+			/// along with any missing parents. If the key already exists, it is returned.</summary>
+			/// <param name='parent'>The key the path starts at</param>
+			/// <param name='path'>Path of the key to be created</param>
+			/// <param name='created'>Receives whether the key was created</param>
+			node create(node parent, std::string_view path, bool* created = nullptr)
+			{
+				if (created)
+					*created = false;
+
+				node current = parent;
+				for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+				{
+					const std::uint64_t hash = reg::ihash(segment);
+					node next = _find_child(current, segment, hash);
+					if (next == _empty)
+					{
+						next = _allocate(current, segment);
+						if (created)
+							*created = true;
+					}
+					current = next;
+				}
+				return current;
+			}
+
+			/// <summary>Creates the key at the given path, relative to the root</summary>
+			node create(std::string_view path, bool* created = nullptr)
+			{
+				return create(root(), path, created);
+			}
+
+			/// <summary>Removes the key at the given path and all of its subkeys</summary>
+			/// <returns>True, if the key was removed. False if it does not exist or is the root</returns>
+			bool remove(node parent, std::string_view path)
+			{
+				std::optional<node> found = open(parent, path);
+				if (!found || *found == root())
+					return false;
+
+				const node n = *found;
+				_key& owner = _keys[_keys[n].parent];
+				owner.children.erase(_keys[n].position, [this](node moved, std::uint32_t position) { _keys[moved].position = position; });
+				if (owner.children.size() <= _indexed)
+					owner.child_slots.clear();
+				else
+					_erase_slot(owner.child_slots, n, _keys[n].hash, [this](node child) { return _keys[child].hash; });
+				owner.stamp = _tick();
+
+				std::vector<node> pending = { n };
+				while (!pending.empty())
+				{
+					node current = pending.back();
+					pending.pop_back();
+
+					_key& k = _keys[current];
+					k.children.each([&pending](node child) { pending.push_back(child); });
+					k.value_order.each([this, &k](std::uint32_t id) { _garbage += k.values[id].size; });
+
+					k = _key();
+					_free.push_back(current);
+					--_live;
+				}
+
+				_maybe_compact();
+				return true;
+			}
+
+			/// <summary>Removes the key at the given path, relative to the root</summary>
+			bool remove(std::string_view path)
+			{
+				return remove(root(), path);
+			}
+
+			/// <summary>Creates or overwrites a value of a key</summary>
+			/// <param name='n'>The key</param>
+			/// <param name='name'>Name of the value (empty for the default value)</param>
+			/// <param name='type'>One of the registry value types</param>
+			/// <param name='data'>Raw data of the value</param>
+			void set(node n, std::string_view name, std::uint32_t type, std::string_view data)
+			{
+				const std::uint64_t hash = reg::ihash(name);
+				_key& k = _keys[n];
+				k.stamp = _tick();
+
+				std::uint32_t index = _find_value(k, name, hash);
+				if (index != _empty)
+				{
+					_value& v = k.values[index];
+					v.type = type;
+					if (data.size() <= v.size)
+					{
+						_garbage += v.size - data.size();
+						_data.replace(v.offset, data.size(), data.data(), data.size());
+						v.size = static_cast<std::uint32_t>(data.size());
+					}
+					else
+					{
+						_garbage += v.size;
+						v.offset = _data.size();
+						v.size = static_cast<std::uint32_t>(data.size());
+						_data.append(data.data(), data.size());
+					}
+					_maybe_compact();
+					return;
+				}
+
+				_value v = { _intern(name), type, hash, _data.size(), static_cast<std::uint32_t>(data.size()) };
+				_data.append(data.data(), data.size());
+				if (k.free_values.empty())
+				{
+					index = static_cast<std::uint32_t>(k.values.size());
+					k.values.push_back(v);
+				}
+				else
+				{
+					index = k.free_values.back();
+					k.free_values.pop_back();
+					k.values[index] = v;
+				}
+				k.values[index].position = k.value_order.push(index);
+				_index_values(k);
+			}
+
+			/// <summary>Removes a value of a key</summary>
+			/// <returns>True, if the value was removed. False if it does not exist</returns>
+			bool unset(node n, std::string_view name)
+			{
+				_key& k = _keys[n];
+				std::uint32_t index = _find_value(k, name, reg::ihash(name));
+				if (index == _empty)
+					return false;
+
+				_garbage += k.values[index].size;
+				k.value_order.erase(k.values[index].position, [&k](std::uint32_t moved, std::uint32_t position) { k.values[moved].position = position; });
+				if (k.value_order.size() <= _indexed)
+					k.value_slots.clear();
+				else
+					_erase_slot(k.value_slots, index, k.values[index].hash, [&k](std::uint32_t id) { return k.values[id].hash; });
+				k.values[index].name = _empty;
+				k.free_values.push_back(index);
+				k.stamp = _tick();
+				_maybe_compact();
+				return true;
+			}
+
+			/// <summary>Retrieves a value of a key by name</summary>
+			std::optional<value_view> get(node n, std::string_view name) const
+			{
+				const _key& k = _keys[n];
+				std::uint32_t index = _find_value(k, name, reg::ihash(name));
+				if (index == _empty)
+					return std::nullopt;
+				const _value& v = k.values[index];
+				return value_view{ _text(v.name), v.type, _bytes(v) };
+			}
+
+			/// <summary>The name of a key, with the case it was created with</summary>
+			std::string_view name(node n) const
+			{
+				return _text(_keys[n].name);
+			}
+
+			/// <summary>The number of direct subkeys of a key</summary>
+			size_t subkey_count(node n) const noexcept
+			{
+				return _keys[n].children.size();
+			}
+
+			/// <summary>Retrieves a subkey by its index, as RegEnumKeyEx does</summary>
+			/// <returns>The subkey, or nothing if the index is past the last subkey</returns>
+			std::optional<node> subkey(node n, size_t index) const
+			{
+				const _order& children = _keys[n].children;
+				if (index >= children.size())
+					return std::nullopt;
+				return children[index];
+			}
+
+			/// <summary>The number of values of a key</summary>
+			size_t value_count(node n) const noexcept
+			{
+				return _keys[n].value_order.size();
+			}
+
+			/// <summary>Retrieves a value by its index, as RegEnumValue does</summary>
+			/// <returns>The value, or nothing if the index is past the last value</returns>
+			std::optional<value_view> value(node n, size_t index) const
+			{
+				const _key& k = _keys[n];
+				if (index >= k.value_order.size())
+					return std::nullopt;
+				const _value& v = k.values[k.value_order[index]];
+				return value_view{ _text(v.name), v.type, _bytes(v) };
+			}
+
+		private:
+			struct _name
+			{
+				size_t offset;
+				std::uint32_t length;
+				std::uint64_t hash;
+			};
+
+			struct _value
+			{
+				std::uint32_t name;
+				std::uint32_t type;
+				std::uint64_t hash;
+				size_t offset;
+				std::uint32_t size;
+				/// <summary>Where the value is in the creation order of its key</summary>
+				std::uint32_t position = 0;
+			};
+
+			/// <summary>Ids in creation order. A removed id leaves a gap, so the positions of the
+			/// others stay the same. While there are gaps, the ids left are counted in a Fenwick
+			/// tree to find the one at an index in logarithmic time; the gaps are closed once
+			/// they make up half of the list.</summary>
+			class _order
+			{
+			public:
+				size_t size() const noexcept { return _ids.size() - _removed; }
+
+				/// <summary>The id at an index, counting only the ids left</summary>
+				std::uint32_t operator[](size_t index) const noexcept
+				{
+					if (_removed == 0)
+						return _ids[index];
+
+					size_t position = 0;
+					size_t remaining = index + 1;
+					size_t step = 1;
+					while (step * 2 <= _ids.size())
+						step *= 2;
+					for (; step; step /= 2)
+						if (position + step <= _ids.size() && _live[position + step] < remaining)
+						{
+							position += step;
+							remaining -= _live[position];
+						}
+					return _ids[position];
+				}
+
+				/// <summary>The id added last</summary>
+				std::uint32_t back() const noexcept { return _ids.back(); }
+
+				template<typename F>
+				void each(F&& visit) const
+				{
+					for (std::uint32_t id : _ids)
+						if (id != _empty)
+							visit(id);
+				}
+
+				/// <returns>The position of the new id</returns>
+				std::uint32_t push(std::uint32_t id)
+				{
+					_ids.push_back(id);
+					if (!_live.empty())
+					{
+						// the new node covers itself and the nodes below it
+						const size_t i = _ids.size();
+						std::uint32_t count = 1;
+						for (size_t k = i - 1; k > i - (i & (0 - i)); k -= k & (0 - k))
+							count += _live[k];
+						_live.push_back(count);
+					}
+					return static_cast<std::uint32_t>(_ids.size() - 1);
+				}
+
+				/// <summary>Removes the id at a position</summary>
+				/// <param name='moved'>Called with every id that moves and its new position
+				/// when the gaps are closed</param>
+				template<typename Moved>
+				void erase(std::uint32_t position, Moved&& moved)
+				{
+					_ids[position] = _empty;
+					++_removed;
+
+					if (_removed * 2 >= _ids.size())
+					{
+						size_t kept = 0;
+						for (std::uint32_t id : _ids)
+							if (id != _empty)
+							{
+								moved(id, static_cast<std::uint32_t>(kept));
+								_ids[kept++] = id;
+							}
+						_ids.resize(kept);
+						_live.clear();
+						_removed = 0;
+						return;
+					}
+
+					if (_live.empty())
+					{
+						_live.assign(_ids.size() + 1, 0);
+						for (size_t i = 1; i <= _ids.size(); i++)
+						{
+							_live[i] += _ids[i - 1] != _empty ? 1 : 0;
+							const size_t parent = i + (i & (0 - i));
+							if (parent <= _ids.size())
+								_live[parent] += _live[i];
+						}
+					}
+					else
+						for (size_t i = position + 1; i <= _ids.size(); i += i & (0 - i))
+							--_live[i];
+				}
+
+			private:
+				std::vector<std::uint32_t> _ids;
+				size_t _removed = 0;
+				/// <summary>1-based Fenwick tree of the ids left; empty while there are no gaps</summary>
+				std::vector<std::uint32_t> _live;
+			};
+
+			struct _key
+			{
+				std::uint32_t name = _empty;
+				node parent = _empty;
+				bool alive = false;
+				std::uint64_t hash = 0;
+				std::uint64_t stamp = 0;
+				/// <summary>Where the key is in the creation order of its parent</summary>
+				std::uint32_t position = 0;
+				_order children;
+				std::vector<std::uint64_t> child_slots;
+				/// <summary>Values by id; ids of removed values are reused</summary>
+				std::vector<_value> values;
+				std::vector<std::uint32_t> free_values;
+				_order value_order;
+				std::vector<std::uint64_t> value_slots;
+			};
+
+			std::string_view _text(std::uint32_t name) const noexcept
+			{
+				return std::string_view(_name_bytes).substr(_names[name].offset, _names[name].length);
+			}
+
+			std::string_view _bytes(const _value& v) const noexcept
+			{
+				return std::string_view(_data).substr(v.offset, v.size);
+			}
+
+			std::uint64_t _tick()
+			{
+				constexpr std::uint64_t unix_epoch = 116444736000000000ull;
+				auto since = std::chrono::system_clock::now().time_since_epoch();
+				std::uint64_t now = unix_epoch + static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(since).count()) * 10;
+				_clock = std::max(_clock + 1, now);
+				return _clock;
+			}
+
+			/// <summary>Finds an entry in an open-addressing table.<para/>
+			/// Each slot holds the upper half of the hash of its entry next to the entry,
+			/// so most mismatches are rejected without touching the entry itself.</summary>
+			template<typename Match>
+			static std::uint32_t _probe(const std::vector<std::uint64_t>& slots, std::uint64_t hash, Match&& match)
+			{
+				const size_t mask = slots.size() - 1;
+				for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask)
+				{
+					std::uint64_t slot = slots[i];
+					if (slot == _empty_slot)
+						return _empty;
+					if ((slot >> 32) == (hash >> 32) && match(static_cast<std::uint32_t>(slot)))
+						return static_cast<std::uint32_t>(slot);
+				}
+			}
+
+			static void _insert_slot(std::vector<std::uint64_t>& slots, std::uint32_t entry, std::uint64_t hash)
+			{
+				const size_t mask = slots.size() - 1;
+				size_t i = static_cast<size_t>(hash) & mask;
+				while (slots[i] != _empty_slot)
+					i = (i + 1) & mask;
+				slots[i] = (hash & 0xFFFFFFFF00000000ull) | entry;
+			}
+
+			/// <summary>Removes an entry from a table, moving the entries after it in the same
+			/// run back into the gap, so that no tombstones are left for lookups to skip</summary>
+			/// <param name='hash_of'>Returns the hash of an entry</param>
+			template<typename Hash>
+			static void _erase_slot(std::vector<std::uint64_t>& slots, std::uint32_t entry, std::uint64_t hash, Hash&& hash_of)
+			{
+				const size_t mask = slots.size() - 1;
+				size_t i = static_cast<size_t>(hash) & mask;
+				while (static_cast<std::uint32_t>(slots[i]) != entry)
+					i = (i + 1) & mask;
+
+				for (size_t j = (i + 1) & mask; slots[j] != _empty_slot; j = (j + 1) & mask)
+				{
+					// an entry can fill the gap unless its home slot lies after the gap
+					const size_t home = static_cast<size_t>(hash_of(static_cast<std::uint32_t>(slots[j]))) & mask;
+					if (((j - home) & mask) >= ((j - i) & mask))
+					{
+						slots[i] = slots[j];
+						i = j;
+					}
+				}
+				slots[i] = _empty_slot;
+			}
+
+			/// <summary>Makes sure a table can take one more entry, building it from
+			/// all entries once the key has enough of them for a table to pay off</summary>
+			/// <param name='count'>The number of entries, including the one being added</param>
+			/// <param name='each'>Calls its argument with every entry and its hash</param>
+			/// <returns>True, if the new entry still has to be inserted</returns>
+			template<typename Each>
+			static bool _reserve_slot(std::vector<std::uint64_t>& slots, size_t count, Each&& each)
+			{
+				if (count <= _indexed)
+				{
+					slots.clear();
+					return false;
+				}
+				if (!slots.empty() && count * 2 <= slots.size())
+					return true;
+
+				size_t capacity = 16;
+				while (capacity < count * 4)
+					capacity *= 2;
+				slots.assign(capacity, _empty_slot);
+				each([&slots](std::uint32_t entry, std::uint64_t hash) { _insert_slot(slots, entry, hash); });
+				return false;
+			}
+
+			void _index_children(_key& k)
+			{
+				auto each = [this, &k](auto&& insert) {
+					k.children.each([this, &insert](node child) { insert(child, _keys[child].hash); });
+				};
+				if (_reserve_slot(k.child_slots, k.children.size(), each))
+					_insert_slot(k.child_slots, k.children.back(), _keys[k.children.back()].hash);
+			}
+
+			static void _index_values(_key& k)
+			{
+				auto each = [&k](auto&& insert) {
+					k.value_order.each([&k, &insert](std::uint32_t id) { insert(id, k.values[id].hash); });
+				};
+				if (_reserve_slot(k.value_slots, k.value_order.size(), each))
+					_insert_slot(k.value_slots, k.value_order.back(), k.values[k.value_order.back()].hash);
+			}
+
+			node _find_child(node parent, std::string_view name, std::uint64_t hash) const
+			{
+				const _key& k = _keys[parent];
+				if (k.child_slots.empty())
+				{
+					node found = _empty;
+					k.children.each([&](node child) {
+						if (found == _empty && _keys[child].hash == hash && reg::iequals(_text(_keys[child].name), name))
+							found = child;
+						});
+					return found;
+				}
+
+				return _probe(k.child_slots, hash, [&](node child) {
+					return _keys[child].hash == hash && reg::iequals(_text(_keys[child].name), name);
+					});
+			}
+
+			std::uint32_t _find_value(const _key& k, std::string_view name, std::uint64_t hash) const
+			{
+				if (k.value_slots.empty())
+				{
+					std::uint32_t found = _empty;
+					k.value_order.each([&](std::uint32_t id) {
+						if (found == _empty && k.values[id].hash == hash && reg::iequals(_text(k.values[id].name), name))
+							found = id;
+						});
+					return found;
+				}
+
+				return _probe(k.value_slots, hash, [&](std::uint32_t i) {
+					return k.values[i].hash == hash && reg::iequals(_text(k.values[i].name), name);
+					});
+			}
+
+			node _allocate(node parent, std::string_view name)
+			{
+				node n;
+				if (_free.empty())
+				{
+					n = static_cast<node>(_keys.size());
+					_keys.emplace_back();
+				}
+				else
+				{
+					n = _free.back();
+					_free.pop_back();
+				}
+
+				_key& k = _keys[n];
+				k.name = _intern(name);
+				k.hash = _names[k.name].hash;
+				k.parent = parent;
+				k.alive = true;
+				k.stamp = _tick();
+				++_live;
+
+				_key& owner = _keys[parent];
+				k.position = owner.children.push(n);
+				owner.stamp = k.stamp;
+				_index_children(owner);
+				return n;
+			}
+
+			/// <summary>Returns the id of a name, adding it to the name table if it is new.
+			/// Names are interned exactly; differently cased names share a hash but not an id.</summary>
+			std::uint32_t _intern(std::string_view name)
+			{
+				const std::uint64_t hash = reg::ihash(name);
+				if (!_name_slots.empty())
+				{
+					std::uint32_t found = _probe(_name_slots, hash, [&](std::uint32_t id) {
+						return _names[id].hash == hash && _text(id) == name;
+						});
+					if (found != _empty)
+						return found;
+				}
+
+				std::uint32_t id = static_cast<std::uint32_t>(_names.size());
+				_names.push_back({ _name_bytes.size(), static_cast<std::uint32_t>(name.size()), hash });
+				_name_bytes.append(name.data(), name.size());
+
+				if (_names.size() * 2 > _name_slots.size())
+				{
+					_name_slots.assign(std::max<size_t>(64, _name_slots.size() * 2), _empty_slot);
+					for (std::uint32_t i = 0; i < _names.size(); i++)
+						_insert_slot(_name_slots, i, _names[i].hash);
+				}
+				else
+					_insert_slot(_name_slots, id, hash);
+				return id;
+			}
+
+			/// <summary>Copies the live value data into a new arena once enough of the
+			/// current one is taken up by overwritten or removed values</summary>
+			void _maybe_compact()
+			{
+				if (_garbage < _compact_threshold || _garbage * 2 < _data.size())
+					return;
+
+				std::string packed;
+				packed.reserve(_data.size() - _garbage);
+				for (_key& k : _keys)
+					k.value_order.each([this, &packed, &k](std::uint32_t id) {
+						_value& v = k.values[id];
+						size_t offset = packed.size();
+						packed.append(_data, v.offset, v.size);
+						v.offset = offset;
+						});
+				_data.swap(packed);
+				_garbage = 0;
+			}
+
+			std::vector<_key> _keys;
+			std::vector<node> _free;
+			size_t _live = 0;
+			std::uint64_t _clock = 0;
+
+			std::vector<_name> _names;
+			std::string _name_bytes;
+			std::vector<std::uint64_t> _name_slots;
+
+			std::string _data;
+			size_t _garbage = 0;
+		};
+	}
+}
@@ -0,0 +1,490 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "registry_source.h"
+#include "registry_tree.h"
+
+#if __has_include(<Windows.h>)
+#include "registry.h"
+#endif
+
+namespace reg
+{
+	namespace merkle
+	{
+		/// <summary>A 64-bit hash of a value, a key or a whole subtree</summary>
+		using digest = std::uint64_t;
+
+		namespace
+		{
+			constexpr std::uint64_t _p1 = 11400714785074694791ull;
+			constexpr std::uint64_t _p2 = 14029467366897019727ull;
+			constexpr std::uint64_t _p3 = 1609587929392839161ull;
+			constexpr std::uint64_t _p4 = 9650029242287828579ull;
+			constexpr std::uint64_t _p5 = 2870177450012600261ull;
+
+			constexpr char _magic[4] = { 'R', 'M', 'K', 'L' };
+			constexpr std::uint32_t _version = 1;
+
+			/// <summary>Key stamps this close to the previous update are not trusted, because
+			/// a write in the same timer tick would not have changed the stamp</summary>
+			constexpr std::uint64_t _racy_window = 10000000; // one second in FILETIME units
+
+			constexpr std::uint64_t _rotate_left(std::uint64_t v, int bits) noexcept
+			{
+				return (v << bits) | (v >> (64 - bits));
+			}
+
+			constexpr std::uint64_t _round(std::uint64_t acc, std::uint64_t input) noexcept
+			{
+				return _rotate_left(acc + input * _p2, 31) * _p1;
+			}
+
+			constexpr std::uint64_t _merge(std::uint64_t acc, std::uint64_t v) noexcept
+			{
+				return (acc ^ _round(0, v)) * _p1 + _p4;
+			}
+
+			constexpr std::uint64_t _avalanche(std::uint64_t h) noexcept
+			{
+				h ^= h >> 33;
+				h *= _p2;
+				h ^= h >> 29;
+				h *= _p3;
+				h ^= h >> 32;
+				return h;
+			}
+
+			/// <summary>Folds a 64-bit word into a running hash</summary>
+			constexpr std::uint64_t _combine(std::uint64_t h, std::uint64_t v) noexcept
+			{
+				return _rotate_left(h ^ _round(0, v), 27) * _p1 + _p4;
+			}
+
+			inline std::uint64_t _read64(const char* p) noexcept
+			{
+				std::uint64_t v;
+				std::memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			inline std::uint32_t _read32(const char* p) noexcept
+			{
+				std::uint32_t v;
+				std::memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			/// <summary>The current time as a FILETIME, the unit key stamps are kept in</summary>
+			inline std::uint64_t _now() noexcept
+			{
+				constexpr std::uint64_t unix_epoch = 116444736000000000ull;
+				auto since = std::chrono::system_clock::now().time_since_epoch();
+				return unix_epoch + static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(since).count()) * 10;
+			}
+
+			template<typename Source, typename = void>
+			struct _has_last_write : std::false_type {};
+
+			template<typename Source>
+			struct _has_last_write<Source, std::void_t<decltype(std::declval<Source&>().last_write(
+				std::declval<const typename Source::node&>()))>> : std::true_type {};
+		}
+
+		/// <summary>Hashes a block of bytes (XXH64)</summary>
+		/// <param name='bytes'>The bytes to be hashed</param>
+		/// <param name='seed'>Distinguishes otherwise equal inputs</param>
+		inline digest hash(std::string_view bytes, std::uint64_t seed = 0) noexcept
+		{
+			const char* p = bytes.data();
+			const char* const end = p + bytes.size();
+			std::uint64_t h;
+
+			if (bytes.size() >= 32)
+			{
+				std::uint64_t v1 = seed + _p1 + _p2;
+				std::uint64_t v2 = seed + _p2;
+				std::uint64_t v3 = seed;
+				std::uint64_t v4 = seed - _p1;
+				for (; end - p >= 32; p += 32)
+				{
+					v1 = _round(v1, _read64(p));
+					v2 = _round(v2, _read64(p + 8));
+					v3 = _round(v3, _read64(p + 16));
+					v4 = _round(v4, _read64(p + 24));
+				}
+				h = _rotate_left(v1, 1) + _rotate_left(v2, 7) + _rotate_left(v3, 12) + _rotate_left(v4, 18);
+				h = _merge(h, v1);
+				h = _merge(h, v2);
+				h = _merge(h, v3);
+				h = _merge(h, v4);
+			}
+			else
+				h = seed + _p5;
+
+			h += bytes.size();
+			for (; end - p >= 8; p += 8)
+				h = _combine(h, _read64(p));
+			if (end - p >= 4)
+			{
+				h = _rotate_left(h ^ (static_cast<std::uint64_t>(_read32(p)) * _p1), 23) * _p2 + _p3;
+				p += 4;
+			}
+			for (; p < end; p++)
+				h = _rotate_left(h ^ (static_cast<unsigned char>(*p) * _p5), 11) * _p1;
+
+			return _avalanche(h);
+		}
+
+		/// <summary>The hashes kept for one key</summary>
+		struct entry
+		{
+			/// <summary>Name of the key (empty for the root of the index)</summary>
+			std::string name;
+			/// <summary>Stamp of the key when its values were hashed, or 0 if the source has none</summary>
+			std::uint64_t last_write = 0;
+			/// <summary>Hash of the names, types and data of the values of the key</summary>
+			digest values = 0;
+			/// <summary>Hash of the values and the names and subtree hashes of all children</summary>
+			digest subtree = 0;
+			/// <summary>Direct subkeys, ordered with reg::iless</summary>
+			std::vector<entry> children;
+		};
+
+		/// <summary>How a key differs between two indexes</summary>
+		enum class change
+		{
+			/// <summary>The key (and its subtree) exists only in the second index</summary>
+			added,
+			/// <summary>The key (and its subtree) exists only in the first index</summary>
+			removed,
+			/// <summary>The key exists in both, but its values differ</summary>
+			modified,
+		};
+
+		/// <summary>A Merkle tree over a registry subtree: every key holds a hash of its values
+		/// combined with the hashes of its children, so equal subtrees are recognized by
+		/// comparing a single hash.<para/>
+		/// Updating an index rehashes the values of a key only if its last write time moved
+		/// (for sources that report one), so a periodic check enumerates keys but reads just
+		/// the values that changed. Indexes can be saved to a file and loaded again.</summary>
+		class index
+		{
+		public:
+			/// <summary>Brings the index up to date with a subtree of a tree source.<para/>
+			/// Keys that disappeared are dropped, new keys are hashed, and the values of
+			/// keys whose stamp is unchanged since the previous update are not read.</summary>
+			/// <param name='source'>Any tree source</param>
+			/// <param name='root'>The node the index describes</param>
+			/// <returns>The hash of the whole subtree</returns>
+			template<typename Source>
+			digest update(Source& source, const typename Source::node& root)
+			{
+				const std::uint64_t started = _now();
+				_update(source, root, _root, 0);
+				_updated = started;
+				return _root.subtree;
+			}
+
+#if __has_include(<Windows.h>)
+			/// <summary>Brings the index up to date with a registry key and all of its subkeys.<para/>
+			/// Throws an exception if the key does not exist or cannot be read.</summary>
+			/// <param name='machine'>Root key in the hierarchy</param>
+			/// <param name='key'>Subkey to the desired node</param>
+			/// <returns>The hash of the whole subtree</returns>
+			digest update(HKEY machine, std::string_view key)
+			{
+				reg::source::live source(machine);
+				auto root = source.open(key);
+				if (!root)
+					throw reg::except::key_not_found(machine, key);
+				return update(source, *root);
+			}
+#endif
+
+			/// <summary>The hash of the whole subtree</summary>
+			digest root() const noexcept { return _root.subtree; }
+
+			/// <summary>Finds the hashes of a key by its path relative to the root</summary>
+			/// <returns>A pointer to the entry, or nullptr if the key is not in the index</returns>
+			const entry* find(std::string_view path) const
+			{
+				const entry* current = &_root;
+				for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+				{
+					current = _child(*current, segment);
+					if (current == nullptr)
+						return nullptr;
+				}
+				return current;
+			}
+
+			/// <summary>The root entry, for walking the whole index</summary>
+			const entry& top() const noexcept { return _root; }
+
+			/// <summary>Writes the index in a compact binary form</summary>
+			/// <param name='out'>Stream opened in binary mode</param>
+			void save(std::ostream& out) const
+			{
+				std::string buffer(_magic, 4);
+				_put(buffer, _version, 4);
+				_put(buffer, _updated, 8);
+				_save(_root, buffer, out);
+				out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				if (!out)
+					throw std::runtime_error("Could not write the index");
+			}
+
+			/// <summary>Writes the index to a file, replacing it</summary>
+			void save(const std::string& filename) const
+			{
+				std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+				if (!out)
+					throw std::runtime_error("Could not open \"" + filename + "\"");
+				save(out);
+			}
+
+			/// <summary>Reads an index written by <see cref="save"/>.<para/>
+			/// Throws an exception if the data is truncated or not an index.</summary>
+			/// <param name='in'>Stream opened in binary mode</param>
+			static index load(std::istream& in)
+			{
+				char header[16];
+				if (!in.read(header, sizeof(header)) || std::memcmp(header, _magic, 4) != 0 || _read32(header + 4) != _version)
+					throw std::runtime_error("Not a registry hash index");
+
+				index result;
+				result._updated = _read64(header + 8);
+				_load(result._root, in, 0);
+				return result;
+			}
+
+			/// <summary>Reads an index from a file written by <see cref="save"/></summary>
+			static index load(const std::string& filename)
+			{
+				std::ifstream in(filename, std::ios::binary);
+				if (!in)
+					throw std::runtime_error("Could not open \"" + filename + "\"");
+				return load(in);
+			}
+
+		private:
+			template<typename Source>
+			void _update(Source& source, const typename Source::node& n, entry& e, size_t depth)
+			{
+				std::uint64_t stamp = 0;
+				if constexpr (_has_last_write<Source>::value)
+					stamp = source.last_write(n);
+
+				bool trusted = stamp != 0 && stamp == e.last_write && stamp + _racy_window < _updated;
+				if (!trusted)
+				{
+					e.values = _hash_values(source, n);
+					e.last_write = stamp;
+				}
+
+				if (_levels.size() <= depth)
+					_levels.emplace_back();
+				std::vector<std::string>& names = _levels[depth];
+				source.keys(n, names);
+
+				// merge the sorted names with the sorted children of the previous update
+				std::vector<entry> children;
+				children.reserve(names.size());
+				auto previous = e.children.begin();
+				for (std::string& name : names)
+				{
+					while (previous != e.children.end() && reg::icompare(previous->name, name) < 0)
+						++previous;
+
+					auto child = source.child(n, name);
+					if (!child)
+						continue; // removed while walking
+
+					if (previous != e.children.end() && reg::iequals(previous->name, name))
+						children.push_back(std::move(*previous++));
+					else
+						children.emplace_back();
+					children.back().name = std::move(name);
+
+					_update(source, *child, children.back(), depth + 1);
+				}
+				e.children = std::move(children);
+
+				digest h = _combine(_p5, e.values);
+				for (const entry& child : e.children)
+				{
+					h = _combine(h, reg::merkle::hash(child.name));
+					h = _combine(h, child.subtree);
+				}
+				e.subtree = _avalanche(h);
+			}
+
+			/// <summary>Values are combined by addition, so the order the source
+			/// enumerates them in does not matter</summary>
+			template<typename Source>
+			static digest _hash_values(Source& source, const typename Source::node& n)
+			{
+				std::uint64_t sum = 0;
+				std::uint64_t count = 0;
+				source.values(n, [&sum, &count](std::string_view name, std::uint32_t type, std::string_view data) {
+					sum += reg::merkle::hash(data, _combine(reg::merkle::hash(name), type));
+					++count;
+					});
+				return _avalanche(_combine(sum, count));
+			}
+
+			static const entry* _child(const entry& parent, std::string_view name)
+			{
+				size_t low = 0;
+				size_t high = parent.children.size();
+				while (low < high)
+				{
+					size_t middle = low + (high - low) / 2;
+					int order = reg::icompare(parent.children[middle].name, name);
+					if (order == 0)
+						return &parent.children[middle];
+					if (order < 0)
+						low = middle + 1;
+					else
+						high = middle;
+				}
+				return nullptr;
+			}
+
+			static void _put(std::string& out, std::uint64_t v, size_t bytes)
+			{
+				for (size_t i = 0; i < bytes; i++)
+					out.push_back(static_cast<char>(v >> (8 * i)));
+			}
+
+			static void _save(const entry& e, std::string& buffer, std::ostream& out)
+			{
+				_put(buffer, e.name.size(), 4);
+				buffer += e.name;
+				_put(buffer, e.last_write, 8);
+				_put(buffer, e.values, 8);
+				_put(buffer, e.subtree, 8);
+				_put(buffer, e.children.size(), 4);
+
+				if (buffer.size() >= (1 << 16))
+				{
+					out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+					buffer.clear();
+				}
+				for (const entry& child : e.children)
+					_save(child, buffer, out);
+			}
+
+			static void _load(entry& e, std::istream& in, size_t depth)
+			{
+				if (depth > 512)
+					throw std::runtime_error("Registry hash index nested too deeply");
+
+				// the counts come from the file, so nothing is sized by them up front:
+				// a corrupt count runs out of data instead of memory
+				char fixed[28];
+				if (!in.read(fixed, 4))
+					throw std::runtime_error("Registry hash index is truncated");
+				e.name.clear();
+				for (size_t left = _read32(fixed); left > 0;)
+				{
+					char chunk[256];
+					const size_t part = left < sizeof(chunk) ? left : sizeof(chunk);
+					if (!in.read(chunk, static_cast<std::streamsize>(part)))
+						throw std::runtime_error("Registry hash index is truncated");
+					e.name.append(chunk, part);
+					left -= part;
+				}
+				if (!in.read(fixed, sizeof(fixed)))
+					throw std::runtime_error("Registry hash index is truncated");
+
+				e.last_write = _read64(fixed);
+				e.values = _read64(fixed + 8);
+				e.subtree = _read64(fixed + 16);
+				const size_t children = _read32(fixed + 24);
+				e.children.clear();
+				for (size_t i = 0; i < children; i++)
+				{
+					e.children.emplace_back();
+					_load(e.children.back(), in, depth + 1);
+				}
+			}
+
+			entry _root;
+			std::uint64_t _updated = 0;
+			std::deque<std::vector<std::string>> _levels;
+		};
+
+		namespace
+		{
+			template<typename F>
+			void _compare(const entry& a, const entry& b, std::string& path, F& visit)
+			{
+				if (a.values != b.values)
+					visit(std::string_view(path), change::modified);
+
+				const size_t length = path.size();
+				auto report = [&](const entry& e, change kind) {
+					if (!path.empty())
+						path.push_back('\\');
+					path.append(e.name);
+					visit(std::string_view(path), kind);
+					path.resize(length);
+				};
+
+				auto x = a.children.begin();
+				auto y = b.children.begin();
+				while (x != a.children.end() || y != b.children.end())
+				{
+					int order = x == a.children.end() ? 1 : y == b.children.end() ? -1 : reg::icompare(x->name, y->name);
+					if (order < 0)
+						report(*x++, change::removed);
+					else if (order > 0)
+						report(*y++, change::added);
+					else
+					{
+						if (x->subtree != y->subtree)
+						{
+							if (!path.empty())
+								path.push_back('\\');
+							path.append(x->name);
+							reg::merkle::_compare(*x, *y, path, visit);
+							path.resize(length);
+						}
+						++x;
+						++y;
+					}
+				}
+			}
+		}
+
+		/// <summary>Reports the keys that differ between two indexes.<para/>
+		/// Subtrees with equal hashes are skipped without being visited, so the cost
+		/// depends on the number of changes rather than on the size of the trees.
+		/// Added and removed keys are reported once, not per descendant.</summary>
+		/// <param name='a'>The baseline</param>
+		/// <param name='b'>The state compared against the baseline</param>
+		/// <param name='visit'>Called with the path relative to the root and the kind of change</param>
+		template<typename F>
+		void compare(const index& a, const index& b, F&& visit)
+		{
+			if (a.root() == b.root())
+				return;
+
+			std::string path;
+			reg::merkle::_compare(a.top(), b.top(), path, visit);
+		}
+	}
+}
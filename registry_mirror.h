@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry_name.h"
+#include "registry_source.h"
+#include "registry_tree.h"
+
+namespace reg
+{
+	/// <summary>A local copy of a registry subtree, kept up to date incrementally.<para/>
+	/// Every refresh visits every key, but reads the values and the subkey list of a key
+	/// only if its last write time moved since the previous refresh. A key's stamp changes
+	/// when one of its values is written or deleted or a direct subkey is added or removed,
+	/// so refreshing an idle subtree costs one stamp query per key and reads no values.
+	/// Stamps are only trusted if they are older than the previous refresh by more than
+	/// the stamp resolution, since a write in the same tick would not have moved them.</summary>
+	/// <example><code>reg::mirror copy;
+	/// copy.refresh(HKEY_LOCAL_MACHINE, "Software\\X");	// reads everything
+	/// ...
+	/// size_t changed = copy.refresh(HKEY_LOCAL_MACHINE, "Software\\X");	// reads only what changed
+	/// const reg::tree&amp; data = copy.tree();</code></example>
+	class mirror
+	{
+	public:
+		/// <summary>Brings the copy up to date with a subtree of a tree source that reports
+		/// last write times. Keys that disappeared are dropped and new keys are read.</summary>
+		/// <param name='source'>Any tree source with last_write</param>
+		/// <param name='root'>The node the copy describes</param>
+		/// <returns>The number of keys whose values and subkeys were read</returns>
+		template<typename Source>
+		size_t refresh(Source& source, const typename Source::node& root)
+		{
+			const std::uint64_t started = _now();
+			size_t read = 0;
+			_refresh(source, root, _tree, _root, 0, read);
+			_updated = started;
+			return read;
+		}
+
+#if __has_include(<Windows.h>)
+		/// <summary>Brings the copy up to date with a registry key and all of its subkeys.<para/>
+		/// Throws an exception if the key does not exist or cannot be read.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <returns>The number of keys whose values and subkeys were read</returns>
+		size_t refresh(HKEY machine, std::string_view key)
+		{
+			reg::source::live source(machine);
+			auto root = source.open(key);
+			if (!root)
+				throw reg::except::key_not_found(machine, key);
+			return refresh(source, *root);
+		}
+#endif
+
+		/// <summary>The copy, as of the last refresh. Paths are relative to the mirrored key.</summary>
+		const reg::tree& tree() const noexcept { return _tree; }
+
+		/// <summary>Forgets the copy, so the next refresh reads everything again</summary>
+		void clear() noexcept
+		{
+			_tree.clear();
+			_root = _entry();
+			_updated = 0;
+		}
+
+	private:
+		/// <summary>The stamp of a key when it was last read, and its subkeys ordered with reg::iless</summary>
+		struct _entry
+		{
+			std::string name;
+			std::uint64_t last_write = 0;
+			std::vector<_entry> children;
+		};
+
+		/// <summary>Key stamps this close to the previous refresh are not trusted</summary>
+		static constexpr std::uint64_t _racy_window = 10000000; // one second in FILETIME units
+
+		/// <summary>The current time as a FILETIME, the unit key stamps are kept in</summary>
+		static std::uint64_t _now() noexcept
+		{
+			constexpr std::uint64_t unix_epoch = 116444736000000000ull;
+			auto since = std::chrono::system_clock::now().time_since_epoch();
+			return unix_epoch + static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(since).count()) * 10;
+		}
+
+		template<typename Source>
+		void _refresh(Source& source, const typename Source::node& n, reg::tree& copy, _entry& e, size_t depth, size_t& read)
+		{
+			const std::uint64_t stamp = source.last_write(n);
+			const bool trusted = stamp != 0 && stamp == e.last_write && stamp + _racy_window < _updated;
+			if (!trusted)
+			{
+				++read;
+				e.last_write = stamp;
+				_read_values(source, n, copy);
+
+				if (_levels.size() <= depth)
+					_levels.emplace_back();
+				std::vector<std::string>& names = _levels[depth];
+				source.keys(n, names);
+
+				// merge the sorted names with the sorted children of the previous refresh
+				std::vector<_entry> children;
+				children.reserve(names.size());
+				auto previous = e.children.begin();
+				for (std::string& name : names)
+				{
+					for (; previous != e.children.end() && reg::icompare(previous->name, name) < 0; ++previous)
+						copy.remove(previous->name);
+
+					if (previous != e.children.end() && reg::iequals(previous->name, name))
+						children.push_back(std::move(*previous++));
+					else
+					{
+						children.emplace_back();
+						children.back().name = std::move(name);
+					}
+				}
+				for (; previous != e.children.end(); ++previous)
+					copy.remove(previous->name);
+				e.children = std::move(children);
+			}
+
+			for (auto it = e.children.begin(); it != e.children.end(); )
+			{
+				auto child = source.child(n, it->name);
+				if (!child)
+				{
+					// removed after the subkeys were listed
+					copy.remove(it->name);
+					it = e.children.erase(it);
+					continue;
+				}
+				_refresh(source, *child, copy.create(it->name), *it, depth + 1, read);
+				++it;
+			}
+		}
+
+		/// <summary>Replaces the values of a key in the copy with the ones the source has</summary>
+		template<typename Source>
+		void _read_values(Source& source, const typename Source::node& n, reg::tree& copy)
+		{
+			_seen.clear();
+			source.values(n, [this, &copy](std::string_view name, std::uint32_t type, std::string_view data) {
+				copy.set(name, type, data);
+				_seen.emplace_back(name);
+				});
+
+			// every value seen is in the copy, so any extra one was deleted
+			if (copy.values().size() == _seen.size())
+				return;
+			std::sort(_seen.begin(), _seen.end(), reg::iless());
+			_stale.clear();
+			for (const auto& [name, value] : copy.values())
+				if (!std::binary_search(_seen.begin(), _seen.end(), name, reg::iless()))
+					_stale.push_back(name);
+			for (const std::string& name : _stale)
+				copy.unset(name);
+		}
+
+		reg::tree _tree;
+		_entry _root;
+		/// <summary>When the previous refresh started, as a FILETIME</summary>
+		std::uint64_t _updated = 0;
+		/// <summary>Subkey names of each depth, reused between siblings</summary>
+		std::deque<std::vector<std::string>> _levels;
+		std::vector<std::string> _seen;
+		std::vector<std::string> _stale;
+	};
+}
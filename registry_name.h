@@ -0,0 +1,667 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define REG_NAME_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REG_NAME_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define REG_NAME_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#if !defined(REG_NAME_CONSTANT_EVALUATED) && ((defined(_MSC_VER) && _MSC_VER >= 1925) || (defined(__GNUC__) && __GNUC__ >= 9))
+#define REG_NAME_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+// Registry names compare case-insensitively. Names are folded to upper case, one code
+// point at a time, and compared or hashed as the UTF-8 encoding of the folded code points.
+// Every mapping below keeps the length of the UTF-8 encoding, so names that compare
+// equal always have the same length in bytes.
+// The kernels fold whole blocks of ASCII at once (AVX2, SSE2 or 64-bit words) and drop
+// to the per-code-point path only from the first block that is not pure ASCII.
+
+namespace reg
+{
+	/// <summary>Folds a character the way the registry compares names (upper case).
+	/// Only ASCII letters are changed; see <see cref="reg::upcase"/> for other characters.</summary>
+	constexpr char fold(char c) noexcept
+	{
+		return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+	}
+
+	/// <summary>Maps a code point to upper case, following the simple one-to-one mappings of
+	/// Latin-1, Latin Extended-A and Additional, Greek, Cyrillic, Armenian and fullwidth Latin.
+	/// Other code points are returned unchanged.</summary>
+	constexpr char32_t upcase(char32_t c) noexcept
+	{
+		if (c < 0x80)
+			return (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+		if (c < 0x100)
+		{
+			if (c == 0xB5)
+				return 0x39C;
+			if (c == 0xFF)
+				return 0x178;
+			return (c >= 0xE0 && c <= 0xFE && c != 0xF7) ? c - 0x20 : c;
+		}
+		if (c < 0x180)
+		{
+			// pairs of upper and lower case letters; the dotless i keeps its own case
+			if (c <= 0x137)
+				return ((c & 1) && c != 0x131) ? c - 1 : c;
+			if (c >= 0x139 && c <= 0x148)
+				return (c & 1) ? c : c - 1;
+			if (c >= 0x14A && c <= 0x177)
+				return (c & 1) ? c - 1 : c;
+			if (c >= 0x17A && c <= 0x17E)
+				return (c & 1) ? c : c - 1;
+			return c;
+		}
+		if (c >= 0x370 && c < 0x400)
+		{
+			if (c == 0x3AC)
+				return 0x386;
+			if (c >= 0x3AD && c <= 0x3AF)
+				return c - 0x25;
+			if (c == 0x3C2)
+				return 0x3A3;
+			if (c >= 0x3B1 && c <= 0x3CB)
+				return c - 0x20;
+			if (c == 0x3CC)
+				return 0x38C;
+			if (c == 0x3CD || c == 0x3CE)
+				return c - 0x3F;
+			return c;
+		}
+		if (c >= 0x400 && c < 0x530)
+		{
+			if (c >= 0x430 && c <= 0x44F)
+				return c - 0x20;
+			if (c >= 0x450 && c <= 0x45F)
+				return c - 0x50;
+			if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) || (c >= 0x4D0 && c <= 0x52F))
+				return (c & 1) ? c - 1 : c;
+			if (c >= 0x4C1 && c <= 0x4CE)
+				return (c & 1) ? c : c - 1;
+			return c;
+		}
+		if (c >= 0x561 && c <= 0x586)
+			return c - 0x30;
+		if (c >= 0x1E00 && c <= 0x1EFF && (c < 0x1E96 || c > 0x1E9F))
+			return (c & 1) ? c - 1 : c;
+		if (c >= 0xFF41 && c <= 0xFF5A)
+			return c - 0x20;
+		return c;
+	}
+
+	namespace
+	{
+		/// <summary>Decodes one code point of UTF-8. A byte that does not start a valid
+		/// sequence is returned as 0xDC00 plus the byte, which no valid sequence produces.</summary>
+		constexpr char32_t _decode(const char*& p, const char* end) noexcept
+		{
+			const unsigned char lead = static_cast<unsigned char>(*p);
+			if (lead < 0x80)
+			{
+				++p;
+				return lead;
+			}
+
+			int length = lead >= 0xF0 && lead <= 0xF4 ? 4 : lead >= 0xE0 ? (lead <= 0xEF ? 3 : 0) : lead >= 0xC2 ? 2 : 0;
+			if (length == 0 || end - p < length)
+			{
+				++p;
+				return 0xDC00 + lead;
+			}
+
+			char32_t c = lead & (0x7F >> length);
+			for (int i = 1; i < length; i++)
+			{
+				const unsigned char next = static_cast<unsigned char>(p[i]);
+				if ((next & 0xC0) != 0x80)
+				{
+					++p;
+					return 0xDC00 + lead;
+				}
+				c = (c << 6) | (next & 0x3F);
+			}
+
+			const char32_t smallest[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+			if (c < smallest[length] || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+			{
+				++p;
+				return 0xDC00 + lead;
+			}
+			p += length;
+			return c;
+		}
+
+		/// <summary>Decodes one code point of UTF-16. An unpaired surrogate is returned as is.</summary>
+		constexpr char32_t _decode(const char16_t*& p, const char16_t* end) noexcept
+		{
+			char32_t c = *p++;
+			if (c >= 0xD800 && c <= 0xDBFF && p != end && *p >= 0xDC00 && *p <= 0xDFFF)
+				c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+			return c;
+		}
+
+		/// <summary>Streams the UTF-8 bytes of folded code points into a 64-bit hash,
+		/// eight bytes at a time</summary>
+		struct _name_hasher
+		{
+			std::uint64_t h = 0x6A09E667F3BCC908ull;
+			std::uint64_t word = 0;
+			unsigned fill = 0;
+			std::uint64_t length = 0;
+
+			constexpr void mix(std::uint64_t w) noexcept
+			{
+				w *= 0x9E3779B97F4A7C15ull;
+				h = (h ^ (w ^ (w >> 29))) * 0xBF58476D1CE4E5B9ull;
+				h = (h << 31) | (h >> 33);
+				length += 8;
+			}
+
+			constexpr void byte(unsigned char b) noexcept
+			{
+				word |= static_cast<std::uint64_t>(b) << (8 * fill);
+				if (++fill == 8)
+				{
+					mix(word);
+					word = 0;
+					fill = 0;
+				}
+			}
+
+			/// <summary>Adds the UTF-8 encoding of a folded code point</summary>
+			constexpr void code_point(char32_t c) noexcept
+			{
+				if (c < 0x80)
+					byte(static_cast<unsigned char>(c));
+				else if (c < 0x800)
+				{
+					byte(static_cast<unsigned char>(0xC0 | (c >> 6)));
+					byte(static_cast<unsigned char>(0x80 | (c & 0x3F)));
+				}
+				else if (c < 0x10000)
+				{
+					byte(static_cast<unsigned char>(0xE0 | (c >> 12)));
+					byte(static_cast<unsigned char>(0x80 | ((c >> 6) & 0x3F)));
+					byte(static_cast<unsigned char>(0x80 | (c & 0x3F)));
+				}
+				else
+				{
+					byte(static_cast<unsigned char>(0xF0 | (c >> 18)));
+					byte(static_cast<unsigned char>(0x80 | ((c >> 12) & 0x3F)));
+					byte(static_cast<unsigned char>(0x80 | ((c >> 6) & 0x3F)));
+					byte(static_cast<unsigned char>(0x80 | (c & 0x3F)));
+				}
+			}
+
+			constexpr std::uint64_t finish() noexcept
+			{
+				std::uint64_t total = length + fill;
+				if (fill != 0)
+				{
+					h ^= word * 0x94D049BB133111EBull;
+					h *= 0xBF58476D1CE4E5B9ull;
+				}
+				h ^= total;
+				h ^= h >> 33;
+				h *= 0xFF51AFD7ED558CCDull;
+				h ^= h >> 33;
+				h *= 0xC4CEB9FE1A85EC53ull;
+				h ^= h >> 33;
+				return h;
+			}
+		};
+
+		/// <summary>Folds eight ASCII bytes at once. Every byte must be below 0x80.</summary>
+		constexpr std::uint64_t _fold_word(std::uint64_t w) noexcept
+		{
+			const std::uint64_t at_least_a = w + 0x1F1F1F1F1F1F1F1Full;		// high bit set from 'a' (0x61)
+			const std::uint64_t above_z = w + 0x0505050505050505ull;		// high bit set from '{' (0x7B)
+			const std::uint64_t lower = at_least_a & ~above_z & 0x8080808080808080ull;
+			return w - (lower >> 2);
+		}
+
+		inline std::uint64_t _load64(const char* p) noexcept
+		{
+			std::uint64_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		constexpr std::uint64_t _ascii_bits = 0x8080808080808080ull;
+
+#if defined(REG_NAME_SSE2)
+		/// <summary>Folds sixteen bytes; only meaningful when all of them are ASCII</summary>
+		inline __m128i _fold_block(__m128i block) noexcept
+		{
+			const __m128i lower = _mm_and_si128(
+				_mm_cmpgt_epi8(block, _mm_set1_epi8('a' - 1)),
+				_mm_cmplt_epi8(block, _mm_set1_epi8('z' + 1)));
+			return _mm_sub_epi8(block, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+		}
+
+		/// <summary>Checks whether eight UTF-16 characters are all ASCII</summary>
+		inline bool _ascii16(__m128i block) noexcept
+		{
+			const __m128i wide = _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xFF80)));
+			return _mm_movemask_epi8(_mm_cmpeq_epi16(wide, _mm_setzero_si128())) == 0xFFFF;
+		}
+
+		/// <summary>Narrows and folds eight ASCII UTF-16 characters into the word the
+		/// hasher would build from their UTF-8 bytes</summary>
+		inline std::uint64_t _ascii_word(__m128i block) noexcept
+		{
+			std::uint64_t word;
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(&word), reg::_fold_block(_mm_packus_epi16(block, block)));
+			return word;
+		}
+#endif
+
+		/// <summary>Hashes a UTF-8 name from the given position on, one character at a time</summary>
+		constexpr std::uint64_t _ihash_tail(_name_hasher& state, const char* p, const char* end) noexcept
+		{
+			while (p != end)
+			{
+				if (static_cast<unsigned char>(*p) < 0x80)
+				{
+					state.byte(static_cast<unsigned char>(reg::fold(*p++)));
+					continue;
+				}
+				const char* start = p;
+				const char32_t c = reg::_decode(p, end);
+				if (p == start + 1 && static_cast<unsigned char>(*start) >= 0x80)
+					state.byte(static_cast<unsigned char>(*start)); // not valid UTF-8; hashed as is
+				else
+					state.code_point(reg::upcase(c));
+			}
+			return state.finish();
+		}
+
+		/// <summary>Hashes a UTF-8 name one byte at a time; usable in constant expressions</summary>
+		constexpr std::uint64_t _ihash_scalar(std::string_view name) noexcept
+		{
+			_name_hasher state;
+			return reg::_ihash_tail(state, name.data(), name.data() + name.size());
+		}
+
+		/// <summary>Hashes a UTF-8 name, folding and mixing whole blocks of ASCII at once</summary>
+		inline std::uint64_t _ihash_blocks(std::string_view name) noexcept
+		{
+			_name_hasher state;
+			const char* p = name.data();
+			const char* const end = p + name.size();
+
+#if defined(REG_NAME_SSE2)
+			for (; end - p >= 16; p += 16)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				if (_mm_movemask_epi8(block) != 0)
+					break;
+				alignas(16) std::uint64_t words[2];
+				_mm_store_si128(reinterpret_cast<__m128i*>(words), reg::_fold_block(block));
+				state.mix(words[0]);
+				state.mix(words[1]);
+			}
+#endif
+			for (; end - p >= 8; p += 8)
+			{
+				const std::uint64_t w = reg::_load64(p);
+				if (w & _ascii_bits)
+					return reg::_ihash_tail(state, p, end);
+				state.mix(reg::_fold_word(w));
+			}
+
+			// the last few bytes, as the partial word the scalar hasher would have built;
+			// read with one load ending at the last byte when the name is long enough
+			const unsigned rest = static_cast<unsigned>(end - p);
+			if (rest == 0)
+				return state.finish();
+			std::uint64_t w = 0;
+			if (name.size() >= 8)
+				w = reg::_load64(end - 8) >> (64 - 8 * rest);
+			else
+				for (unsigned i = 0; i < rest; i++)
+					w |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+			if (w & _ascii_bits)
+				return reg::_ihash_tail(state, p, end);
+			state.word = reg::_fold_word(w);
+			state.fill = rest;
+			return state.finish();
+		}
+	}
+
+	/// <summary>Hashes a name case-insensitively, so that names that compare equal
+	/// with <see cref="reg::iequals"/> have equal hashes.<para/>
+	/// Usable in constant expressions; at run time ASCII is hashed in blocks.</summary>
+	constexpr std::uint64_t ihash(std::string_view name) noexcept
+	{
+#if defined(REG_NAME_CONSTANT_EVALUATED)
+		if (!REG_NAME_CONSTANT_EVALUATED())
+			return reg::_ihash_blocks(name);
+#endif
+		return reg::_ihash_scalar(name);
+	}
+
+	/// <summary>Hashes a UTF-16 name case-insensitively. The result equals
+	/// <see cref="reg::ihash"/> of the same name in UTF-8.</summary>
+	inline std::uint64_t ihash(std::u16string_view name) noexcept
+	{
+		_name_hasher state;
+		const char16_t* p = name.data();
+		const char16_t* const end = p + name.size();
+
+#if defined(REG_NAME_SSE2)
+		for (; end - p >= 8; p += 8)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			if (!reg::_ascii16(block))
+				break;
+			state.mix(reg::_ascii_word(block));
+		}
+
+		const unsigned rest = static_cast<unsigned>(end - p);
+		if (rest != 0 && rest < 8 && name.size() >= 8)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(end - 8));
+			if (reg::_ascii16(block))
+			{
+				state.word = reg::_ascii_word(block) >> (64 - 8 * rest);
+				state.fill = rest;
+				return state.finish();
+			}
+		}
+#endif
+		while (p != end)
+		{
+			if (*p < 0x80)
+				state.byte(static_cast<unsigned char>(reg::fold(static_cast<char>(*p++))));
+			else
+				state.code_point(reg::upcase(reg::_decode(p, end)));
+		}
+		return state.finish();
+	}
+
+	namespace
+	{
+		/// <summary>Compares UTF-8 names code point by code point, from a position
+		/// where both start a code point</summary>
+		inline int _icompare_tail(const char* a, const char* a_end, const char* b, const char* b_end) noexcept
+		{
+			while (a != a_end && b != b_end)
+			{
+				const char32_t x = reg::upcase(reg::_decode(a, a_end));
+				const char32_t y = reg::upcase(reg::_decode(b, b_end));
+				if (x != y)
+					return x < y ? -1 : 1;
+			}
+			if (a == a_end && b == b_end)
+				return 0;
+			return a == a_end ? -1 : 1;
+		}
+
+		inline unsigned _lowest_bit(unsigned mask) noexcept
+		{
+#if defined(_MSC_VER)
+			unsigned long index = 0;
+			_BitScanForward(&index, mask);
+			return static_cast<unsigned>(index);
+#else
+			return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+		}
+
+		/// <summary>Returns the index of the lowest nonzero byte of a nonzero word</summary>
+		inline unsigned _lowest_byte(std::uint64_t mask) noexcept
+		{
+			const unsigned low = static_cast<unsigned>(mask);
+			return (low ? reg::_lowest_bit(low) : 32 + reg::_lowest_bit(static_cast<unsigned>(mask >> 32))) / 8;
+		}
+
+		/// <summary>Marks the bytes of two words that differ after folding or are not ASCII.
+		/// Bytes above the first one that is not ASCII may be marked wrongly.</summary>
+		inline std::uint64_t _stop_word(std::uint64_t x, std::uint64_t y) noexcept
+		{
+			return (reg::_fold_word(x) ^ reg::_fold_word(y)) | ((x | y) & _ascii_bits);
+		}
+
+#if defined(REG_NAME_SSE2)
+		inline unsigned _stop_block(const char* a, const char* b) noexcept
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			return (~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(reg::_fold_block(x), reg::_fold_block(y)))) & 0xFFFF) |
+				static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(x, y)));
+		}
+#endif
+
+		/// <summary>Finds the first position where two names differ after folding ASCII,
+		/// or where either has a byte that is not ASCII.<para/>
+		/// The last partial block is read as a whole block ending at the last byte;
+		/// the bytes it reads again are known to match.</summary>
+		/// <returns>The position found, or length if there is none</returns>
+		inline size_t _ascii_prefix(const char* a, const char* b, size_t length) noexcept
+		{
+			size_t i = 0;
+#if defined(REG_NAME_AVX2)
+			const __m256i low_a = _mm256_set1_epi8('a' - 1);
+			const __m256i high_z = _mm256_set1_epi8('z' + 1);
+			const __m256i case_bit = _mm256_set1_epi8(0x20);
+			for (; length - i >= 32; i += 32)
+			{
+				const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+				const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+				const __m256i fx = _mm256_sub_epi8(x, _mm256_and_si256(case_bit,
+					_mm256_and_si256(_mm256_cmpgt_epi8(x, low_a), _mm256_cmpgt_epi8(high_z, x))));
+				const __m256i fy = _mm256_sub_epi8(y, _mm256_and_si256(case_bit,
+					_mm256_and_si256(_mm256_cmpgt_epi8(y, low_a), _mm256_cmpgt_epi8(high_z, y))));
+				const unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(fx, fy))) |
+					static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(x, y)));
+				if (stop)
+					return i + reg::_lowest_bit(stop);
+			}
+#endif
+#if defined(REG_NAME_SSE2)
+			for (; length - i >= 16; i += 16)
+				if (const unsigned stop = reg::_stop_block(a + i, b + i))
+					return i + reg::_lowest_bit(stop);
+			if (i != length && length >= 16)
+			{
+				const unsigned stop = reg::_stop_block(a + length - 16, b + length - 16);
+				return stop ? length - 16 + reg::_lowest_bit(stop) : length;
+			}
+#endif
+			for (; length - i >= 8; i += 8)
+				if (const std::uint64_t stop = reg::_stop_word(reg::_load64(a + i), reg::_load64(b + i)))
+					return i + reg::_lowest_byte(stop);
+			if (i != length && length >= 8)
+			{
+				const std::uint64_t stop = reg::_stop_word(reg::_load64(a + length - 8), reg::_load64(b + length - 8));
+				return stop ? length - 8 + reg::_lowest_byte(stop) : length;
+			}
+
+			for (; i < length; i++)
+			{
+				const unsigned char x = static_cast<unsigned char>(a[i]);
+				const unsigned char y = static_cast<unsigned char>(b[i]);
+				if (((x | y) & 0x80) != 0 || reg::fold(static_cast<char>(x)) != reg::fold(static_cast<char>(y)))
+					break;
+			}
+			return i;
+		}
+	}
+
+	/// <summary>Compares two names case-insensitively, code point by code point.<para/>
+	/// ASCII is compared in blocks; names are only decoded from the first
+	/// character that is not ASCII.</summary>
+	/// <returns>A negative number, zero or a positive number if the first name is
+	/// less than, equal to or greater than the second</returns>
+	inline int icompare(std::string_view a, std::string_view b) noexcept
+	{
+		const size_t length = a.size() < b.size() ? a.size() : b.size();
+		if (length != 0)
+		{
+			// names being sorted or merged mostly differ in the first character
+			const unsigned char x = static_cast<unsigned char>(reg::fold(a[0]));
+			const unsigned char y = static_cast<unsigned char>(reg::fold(b[0]));
+			if (((x | y) & 0x80) == 0 && x != y)
+				return x < y ? -1 : 1;
+		}
+
+		const size_t i = reg::_ascii_prefix(a.data(), b.data(), length);
+		if (i == length)
+			return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+
+		const unsigned char x = static_cast<unsigned char>(reg::fold(a[i]));
+		const unsigned char y = static_cast<unsigned char>(reg::fold(b[i]));
+		if (((x | y) & 0x80) == 0)
+			return x < y ? -1 : 1;
+		return reg::_icompare_tail(a.data() + i, a.data() + a.size(), b.data() + i, b.data() + b.size());
+	}
+
+	/// <summary>Checks whether two names are equal, ignoring case</summary>
+	inline bool iequals(std::string_view a, std::string_view b) noexcept
+	{
+		if (a.size() != b.size())
+			return false;
+		const size_t i = reg::_ascii_prefix(a.data(), b.data(), a.size());
+		if (i == a.size())
+			return true;
+		if (((static_cast<unsigned char>(a[i]) | static_cast<unsigned char>(b[i])) & 0x80) == 0)
+			return false;
+		return reg::_icompare_tail(a.data() + i, a.data() + a.size(), b.data() + i, b.data() + b.size()) == 0;
+	}
+
+	/// <summary>Checks whether two UTF-16 names are equal, ignoring case</summary>
+	inline bool iequals(std::u16string_view a, std::u16string_view b) noexcept
+	{
+		if (a.size() != b.size())
+			return false;
+
+		size_t i = 0;
+#if defined(REG_NAME_SSE2)
+		// the last partial block is compared as a whole block ending at the last character
+		while (i != a.size() && a.size() >= 8)
+		{
+			if (a.size() - i < 8)
+				i = a.size() - 8;
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+			const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i));
+			if (!reg::_ascii16(_mm_or_si128(x, y)))
+				break;
+			const __m128i fx = _mm_packus_epi16(x, x);
+			const __m128i fy = _mm_packus_epi16(y, y);
+			if ((_mm_movemask_epi8(_mm_cmpeq_epi8(reg::_fold_block(fx), reg::_fold_block(fy))) & 0xFF) != 0xFF)
+				return false;
+			i += 8;
+		}
+#endif
+		const char16_t* x = a.data() + i;
+		const char16_t* y = b.data() + i;
+		const char16_t* const end = a.data() + a.size();
+		const char16_t* const y_end = b.data() + b.size();
+		while (x != end && y != y_end)
+		{
+			if (*x < 0x80 && *y < 0x80)
+			{
+				if (reg::fold(static_cast<char>(*x++)) != reg::fold(static_cast<char>(*y++)))
+					return false;
+			}
+			else if (reg::upcase(reg::_decode(x, end)) != reg::upcase(reg::_decode(y, y_end)))
+				return false;
+		}
+		return x == end && y == y_end;
+	}
+
+	/// <summary>Folds a name to upper case, as the registry compares it</summary>
+	/// <param name='name'>The name to be folded</param>
+	/// <param name='out'>Receives the folded name; its length equals the length of the input</param>
+	inline void upcase(std::string_view name, std::string& out)
+	{
+		out.resize(name.size());
+		const char* p = name.data();
+		const char* const end = p + name.size();
+		char* o = out.data();
+
+#if defined(REG_NAME_SSE2)
+		for (; end - p >= 16; p += 16, o += 16)
+		{
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			if (_mm_movemask_epi8(block) != 0)
+				break;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o), reg::_fold_block(block));
+		}
+#endif
+		while (p != end)
+		{
+			const char* start = p;
+			const char32_t c = reg::upcase(reg::_decode(p, end));
+			if (p == start + 1 && static_cast<unsigned char>(*start) >= 0x80)
+				*o++ = *start; // not valid UTF-8; kept as is
+			else if (c < 0x80)
+				*o++ = static_cast<char>(c);
+			else if (c < 0x800)
+			{
+				*o++ = static_cast<char>(0xC0 | (c >> 6));
+				*o++ = static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				*o++ = static_cast<char>(0xE0 | (c >> 12));
+				*o++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				*o++ = static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				*o++ = static_cast<char>(0xF0 | (c >> 18));
+				*o++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+				*o++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				*o++ = static_cast<char>(0x80 | (c & 0x3F));
+			}
+		}
+	}
+
+	/// <summary>Folds a UTF-16 name to upper case, as the registry compares it</summary>
+	/// <param name='name'>The name to be folded</param>
+	/// <param name='out'>Receives the folded name; its length equals the length of the input</param>
+	inline void upcase(std::u16string_view name, std::u16string& out)
+	{
+		out.resize(name.size());
+		size_t i = 0;
+#if defined(REG_NAME_SSE2)
+		const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+		const __m128i low_a = _mm_set1_epi16('a' - 1);
+		const __m128i high_z = _mm_set1_epi16('z' + 1);
+		const __m128i case_bit = _mm_set1_epi16(0x20);
+		for (; name.size() - i >= 8; i += 8)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(name.data() + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(x, non_ascii), _mm_setzero_si128())) != 0xFFFF)
+				break;
+			const __m128i folded = _mm_sub_epi16(x, _mm_and_si128(case_bit,
+				_mm_and_si128(_mm_cmpgt_epi16(x, low_a), _mm_cmplt_epi16(x, high_z))));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out.data() + i), folded);
+		}
+#endif
+		for (; i < name.size(); i++)
+		{
+			const char16_t c = name[i];
+			out[i] = (c >= 0xD800 && c <= 0xDFFF) ? c : static_cast<char16_t>(reg::upcase(c));
+		}
+	}
+}
@@ -0,0 +1,475 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "registry.h"
+#include "registry_batch.h"
+#include "registry_name.h"
+#include "registry_tree.h"
+
+namespace reg
+{
+	/// <summary>A copy-on-write layer over the live registry.<para/>
+	/// Writes and deletions go to an in-memory delta instead of the registry. Reads look
+	/// at the delta first and fall through to the registry for everything the delta does
+	/// not cover, so the overlay shows the registry as it would be after the changes.
+	/// Deleted values and keys are kept as tombstones that hide what the registry holds;
+	/// a deleted key hides its whole subtree. Nothing touches the registry until
+	/// <see cref="commit"/>; <see cref="discard"/> drops the changes.<para/>
+	/// Keys and value names are compared case-insensitively, like the registry does.
+	/// Keys are created by the values written to them.</summary>
+	/// <example><code>reg::overlay sandbox;
+	/// sandbox.set&lt;DWORD&gt;(HKEY_CURRENT_USER, "Software\\X", "Timeout", 60);
+	/// sandbox.remove_key(HKEY_CURRENT_USER, "Software\\X\\Cache");
+	/// if (sandbox.number(HKEY_CURRENT_USER, "Software\\X", "Timeout") == 60)	// read from the delta
+	///     sandbox.commit();</code></example>
+	class overlay
+	{
+	public:
+		overlay() = default;
+		overlay(const overlay&) = delete;
+		overlay& operator=(const overlay&) = delete;
+		overlay(overlay&&) = default;
+		overlay& operator=(overlay&&) = default;
+
+		/// <summary>Writes the value to the delta, stored as the type T maps to
+		/// (see <see cref="reg::value_traits"/>). The key and its parents exist from then on.</summary>
+		template<typename T>
+		overlay& set(HKEY machine, std::string_view key, std::string_view value, typename reg::value_traits<T>::argument data)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+			std::string scratch;
+			_value_delta& entry = _value(_touch(machine, _normal(key, scratch)), value);
+			entry.removed = false;
+			entry.type = reg::value_traits<T>::type;
+			entry.data.clear();
+			reg::value_traits<T>::encode(data, entry.data);
+			return *this;
+		}
+
+		/// <summary>Deletes the value in the delta. Deleting a value that does not exist is not an error.</summary>
+		overlay& remove_value(HKEY machine, std::string_view key, std::string_view value)
+		{
+			std::string scratch;
+			_value_delta& entry = _value(_node(machine, _normal(key, scratch)), value);
+			entry.removed = true;
+			entry.type = REG_NONE;
+			entry.data.clear();
+			return *this;
+		}
+
+		/// <summary>Deletes the key and its whole subtree in the delta, including changes
+		/// made to them earlier. Values written under the key afterwards go to a fresh key.<para/>
+		/// Throws an exception if the key is empty; a root key cannot be removed</summary>
+		overlay& remove_key(HKEY machine, std::string_view key)
+		{
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			if (path.empty())
+				throw std::invalid_argument("A root key cannot be removed");
+
+			for (const auto& node : _keys)
+			{
+				if (node->machine == machine && _is_below(node->path, path))
+				{
+					// the removal of the key covers whatever happened below it
+					node->values.clear();
+					node->exists = false;
+					if (node->removed)
+					{
+						node->removed = false;
+						--_removed;
+					}
+				}
+			}
+
+			_key_delta& node = _node(machine, path);
+			node.values.clear();
+			node.exists = false;
+			if (!node.removed)
+			{
+				node.removed = true;
+				++_removed;
+			}
+			return *this;
+		}
+
+		/// <summary>Reads a value into a caller's object, from the delta if it has the
+		/// value and from the registry otherwise.<para/>
+		/// Throws the same exceptions as <see cref="reg::query::get"/></summary>
+		template<typename T>
+		void get(HKEY machine, std::string_view key, std::string_view value, T& data) const
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+			if (_keys.empty())
+			{
+				reg::query::get(machine, key, value, data);
+				return;
+			}
+
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			const _key_delta* node = _find(machine, path);
+			if (node)
+			{
+				auto it = node->values.find(value);
+				if (it != node->values.end())
+				{
+					const _value_delta& entry = it->second;
+					if (entry.removed)
+						throw reg::except::value_not_found(machine, key, value);
+
+					DWORD code = reg::value_traits<T>::decode(entry.type, entry.data, data);
+					if (code == ERROR_UNSUPPORTED_TYPE)
+						throw reg::except::type_error(machine, key, value,
+							reg::_type_name(reg::value_traits<T>::type), reg::_type_name(entry.type));
+					reg::assert::success(code);
+					return;
+				}
+			}
+
+			const bool exists = node && node->exists;
+			if (_hidden(machine, path))
+			{
+				if (exists)
+					throw reg::except::value_not_found(machine, key, value);
+				throw reg::except::key_not_found(machine, key);
+			}
+
+			if (!exists)
+			{
+				reg::query::get(machine, key, value, data);
+				return;
+			}
+
+			// the key exists in the delta, so it is the value that is missing
+			try
+			{
+				reg::query::get(machine, key, value, data);
+			}
+			catch (const reg::except::key_not_found&)
+			{
+				throw reg::except::value_not_found(machine, key, value);
+			}
+		}
+
+		/// <summary>Reads a value of the registry type that follows from T.<para/>
+		/// Throws the same exceptions as <see cref="reg::query::get"/></summary>
+		template<typename T>
+		T get(HKEY machine, std::string_view key, std::string_view value) const
+		{
+			T data{};
+			get(machine, key, value, data);
+			return data;
+		}
+
+		/// <summary>Reads a DWORD value; see <see cref="get"/></summary>
+		DWORD number(HKEY machine, std::string_view key, std::string_view value) const
+		{
+			return get<DWORD>(machine, key, value);
+		}
+
+		/// <summary>Reads a string value as UTF-8; see <see cref="get"/></summary>
+		std::string string(HKEY machine, std::string_view key, std::string_view value) const
+		{
+			return get<std::string>(machine, key, value);
+		}
+
+		/// <summary>Checks whether the key exists with the delta applied</summary>
+		[[nodiscard]]
+		bool key_exists(HKEY machine, std::string_view key) const noexcept
+		{
+			if (_keys.empty())
+				return reg::key_exists(machine, key);
+
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			const _key_delta* node = _find(machine, path);
+			if (node && node->exists)
+				return true;
+			return !_hidden(machine, path) && reg::key_exists(machine, key);
+		}
+
+		/// <summary>Checks whether the value exists with the delta applied</summary>
+		[[nodiscard]]
+		bool value_exists(HKEY machine, std::string_view key, std::string_view value) const noexcept
+		{
+			if (_keys.empty())
+				return reg::value_exists(machine, key, value);
+
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			if (const _key_delta* node = _find(machine, path))
+			{
+				auto it = node->values.find(value);
+				if (it != node->values.end())
+					return !it->second.removed;
+			}
+			return !_hidden(machine, path) && reg::value_exists(machine, key, value);
+		}
+
+		/// <summary>The names of the subkeys with the delta applied, the registry's
+		/// first and then the ones only the delta has.<para/>
+		/// Throws an exception if the key does not exist</summary>
+		std::vector<std::string> keys(HKEY machine, std::string_view key) const
+		{
+			if (!key_exists(machine, key))
+				throw reg::except::key_not_found(machine, key);
+
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			std::vector<std::string> names = _base(machine, key, path, true);
+
+			// children the delta removed, and children it created
+			std::vector<const _key_delta*> children;
+			for (const auto& node : _keys)
+				if (node->machine == machine && _is_below(node->path, path)
+					&& node->path.find('\\', path.empty() ? 0 : path.size() + 1) == std::string::npos)
+					children.push_back(node.get());
+
+			for (const _key_delta* child : children)
+			{
+				std::string_view name = std::string_view(child->path).substr(path.empty() ? 0 : path.size() + 1);
+				auto it = std::find_if(names.begin(), names.end(), [name](const std::string& n) { return reg::iequals(n, name); });
+				if (child->removed && !child->exists && it != names.end())
+					names.erase(it);
+				else if (child->exists && it == names.end())
+					names.emplace_back(name);
+			}
+			return names;
+		}
+
+		/// <summary>The names of the values with the delta applied, the registry's
+		/// first and then the ones only the delta has.<para/>
+		/// Throws an exception if the key does not exist</summary>
+		std::vector<std::string> value_names(HKEY machine, std::string_view key) const
+		{
+			if (!key_exists(machine, key))
+				throw reg::except::key_not_found(machine, key);
+
+			std::string scratch;
+			std::string_view path = _normal(key, scratch);
+			std::vector<std::string> names = _base(machine, key, path, false);
+
+			const _key_delta* node = _find(machine, path);
+			if (!node)
+				return names;
+
+			for (const auto& [name, entry] : node->values)
+			{
+				auto it = std::find_if(names.begin(), names.end(), [&name](const std::string& n) { return reg::iequals(n, name); });
+				if (entry.removed && it != names.end())
+					names.erase(it);
+				else if (!entry.removed && it == names.end())
+					names.push_back(name);
+			}
+			return names;
+		}
+
+		/// <summary>The number of pending changes: written or deleted values, and removed keys</summary>
+		size_t size() const noexcept
+		{
+			size_t count = _removed;
+			for (const auto& node : _keys)
+				count += node->values.size();
+			return count;
+		}
+
+		bool empty() const noexcept { return size() == 0; }
+
+		/// <summary>Applies the delta to the registry and empties it.<para/>
+		/// Removed keys are deleted first, then the values are written and deleted through
+		/// a <see cref="reg::write_batch"/>, which opens each key once. Throws an exception
+		/// if a key cannot be removed, opened or created, or a value cannot be written or
+		/// deleted; changes applied before the failure stay applied and the overlay keeps
+		/// all of its changes.</summary>
+		/// <returns>The number of changes applied</returns>
+		size_t commit()
+		{
+			const size_t changes = size();
+
+			for (const auto& node : _keys)
+			{
+				if (!node->removed)
+					continue;
+				// given a subkey, RegDeleteTree removes the subkey itself as well
+				DWORD code = reg::api::delete_tree(node->machine, node->path);
+				if (code != ERROR_FILE_NOT_FOUND)
+					reg::assert::success(code);
+			}
+
+			reg::write_batch batch;
+			for (const auto& node : _keys)
+			{
+				for (const auto& [name, entry] : node->values)
+				{
+					if (entry.removed)
+						batch.remove(node->machine, node->path, name);
+					else
+						batch.set(node->machine, node->path, name, entry.type, entry.data);
+				}
+			}
+			batch.commit();
+
+			discard();
+			return changes;
+		}
+
+		/// <summary>Drops every pending change</summary>
+		void discard() noexcept
+		{
+			_keys.clear();
+			_index.clear();
+			_removed = 0;
+		}
+
+	private:
+		struct _value_delta
+		{
+			/// <summary>A tombstone: the value is deleted</summary>
+			bool removed = false;
+			DWORD type = REG_NONE;
+			/// <summary>The data exactly as stored in the registry</summary>
+			std::string data;
+		};
+
+		struct _key_delta
+		{
+			HKEY machine;
+			/// <summary>The path in normal form, without empty segments</summary>
+			std::string path;
+			/// <summary>A value was written in the key or below it, so the key exists</summary>
+			bool exists = false;
+			/// <summary>A tombstone: the key was removed, and the registry's contents of
+			/// the key and its subtree are hidden</summary>
+			bool removed = false;
+			std::map<std::string, _value_delta, reg::iless> values = {};
+		};
+
+		/// <summary>The key without leading, trailing or doubled backslashes. Only a key
+		/// that is not in that form already is copied to the scratch string.</summary>
+		static std::string_view _normal(std::string_view key, std::string& scratch)
+		{
+			if (key.empty() || (key.front() != '\\' && key.back() != '\\' && key.find("\\\\") == std::string_view::npos))
+				return key;
+
+			scratch.clear();
+			for (std::string_view segment = reg::next_segment(key); !segment.empty(); segment = reg::next_segment(key))
+			{
+				if (!scratch.empty())
+					scratch += '\\';
+				scratch += segment;
+			}
+			return scratch;
+		}
+
+		/// <summary>Whether a path lies strictly below another one</summary>
+		static bool _is_below(std::string_view path, std::string_view parent) noexcept
+		{
+			if (parent.empty())
+				return !path.empty();
+			return path.size() > parent.size() && path[parent.size()] == '\\'
+				&& reg::iequals(path.substr(0, parent.size()), parent);
+		}
+
+		static std::uint64_t _hash(HKEY machine, std::string_view path) noexcept
+		{
+			return reg::ihash(path) ^ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(machine));
+		}
+
+		_key_delta* _find(HKEY machine, std::string_view path) const noexcept
+		{
+			auto [first, last] = _index.equal_range(_hash(machine, path));
+			for (auto it = first; it != last; ++it)
+				if (it->second->machine == machine && reg::iequals(it->second->path, path))
+					return it->second;
+			return nullptr;
+		}
+
+		/// <summary>Whether the registry's contents of the key are hidden by the removal
+		/// of the key itself or one of its parents</summary>
+		bool _hidden(HKEY machine, std::string_view path) const noexcept
+		{
+			// without removals a miss costs no more than the lookup of the key itself
+			if (_removed == 0)
+				return false;
+
+			for (;;)
+			{
+				const _key_delta* node = _find(machine, path);
+				if (node && node->removed)
+					return true;
+				size_t separator = path.rfind('\\');
+				if (separator == std::string_view::npos)
+					return false;
+				path = path.substr(0, separator);
+			}
+		}
+
+		/// <summary>The delta of a key, added if there is none</summary>
+		_key_delta& _node(HKEY machine, std::string_view path)
+		{
+			if (_key_delta* node = _find(machine, path))
+				return *node;
+
+			_keys.push_back(std::make_unique<_key_delta>(_key_delta{ machine, std::string(path) }));
+			_key_delta* node = _keys.back().get();
+			_index.emplace(_hash(machine, path), node);
+			return *node;
+		}
+
+		/// <summary>The delta of a key that is written to; the key and its parents exist from then on</summary>
+		_key_delta& _touch(HKEY machine, std::string_view path)
+		{
+			_key_delta& node = _node(machine, path);
+			for (std::string_view parent = path; ; )
+			{
+				_key_delta& ancestor = _node(machine, parent);
+				if (ancestor.exists)
+					break; // and so do its parents
+				ancestor.exists = true;
+				size_t separator = parent.rfind('\\');
+				if (separator == std::string_view::npos)
+					break;
+				parent = parent.substr(0, separator);
+			}
+			return node;
+		}
+
+		static _value_delta& _value(_key_delta& node, std::string_view name)
+		{
+			auto it = node.values.find(name);
+			if (it == node.values.end())
+				it = node.values.emplace(std::string(name), _value_delta{}).first;
+			return it->second;
+		}
+
+		/// <summary>The registry's subkey or value names under a key, or none if the key
+		/// is hidden or only exists in the delta</summary>
+		std::vector<std::string> _base(HKEY machine, std::string_view key, std::string_view path, bool subkeys) const
+		{
+			if (_hidden(machine, path))
+				return {};
+			try
+			{
+				return subkeys ? reg::query::keys(machine, key) : reg::query::value_names(machine, key);
+			}
+			catch (const reg::except::key_not_found&)
+			{
+				return {};
+			}
+		}
+
+		std::vector<std::unique_ptr<_key_delta>> _keys;
+		std::unordered_multimap<std::uint64_t, _key_delta*> _index;
+		/// <summary>The number of key tombstones</summary>
+		size_t _removed = 0;
+	};
+}
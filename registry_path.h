@@ -0,0 +1,239 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry_tree.h"
+
+namespace reg
+{
+	namespace
+	{
+		/// <summary>Longest key name the registry accepts, in UTF-16 code units</summary>
+		constexpr size_t _max_segment = 255;
+		/// <summary>Deepest nesting of keys the registry accepts</summary>
+		constexpr size_t _max_depth = 512;
+
+		/// <summary>The number of UTF-16 code units a UTF-8 byte adds to a name:
+		/// one for each lead byte, two for the lead byte of a four-byte sequence</summary>
+		constexpr size_t _utf16_units(char c) noexcept
+		{
+			const unsigned char byte = static_cast<unsigned char>(c);
+			return byte >= 0xF0 ? 2 : (byte & 0xC0) == 0x80 ? 0 : 1;
+		}
+
+		/// <summary>Checks that a path is already in normal form: segments separated by
+		/// single backslashes, no leading or trailing backslash, no embedded null</summary>
+		/// <returns>The number of segments</returns>
+		constexpr size_t _check_normal(std::string_view text)
+		{
+			if (text.empty())
+				return 0;
+			if (text.front() == '\\' || text.back() == '\\')
+				throw std::invalid_argument("Registry paths must not start or end with a backslash");
+
+			size_t segments = 1;
+			size_t length = 0;
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				if (text[i] == '\0')
+					throw std::invalid_argument("Registry paths must not contain null characters");
+				if (text[i] != '\\')
+				{
+					if ((length += _utf16_units(text[i])) > _max_segment)
+						throw std::invalid_argument("Registry key names are limited to 255 characters");
+					continue;
+				}
+				if (text[i - 1] == '\\')
+					throw std::invalid_argument("Registry paths must not contain empty segments");
+				length = 0;
+				++segments;
+			}
+
+			if (segments > _max_depth)
+				throw std::invalid_argument("Registry paths are limited to 512 levels");
+			return segments;
+		}
+	}
+
+	/// <summary>A registry path known at compile time.<para/>
+	/// The literal is validated, split and hashed by the compiler; a path that is not in
+	/// normal form does not compile. Converts to std::string_view (the text is a literal,
+	/// so it is null terminated) and to <see cref="reg::path"/> without hashing again.</summary>
+	/// <example><code>constexpr reg::static_path run("Software\\Microsoft\\Windows\\CurrentVersion\\Run");</code></example>
+	template<size_t N>
+	class static_path
+	{
+	public:
+		constexpr static_path(const char(&literal)[N])
+			: _text(literal, N - 1), _count(reg::_check_normal(_text)), _hash(reg::ihash(_text))
+		{
+			size_t segment = 0;
+			for (size_t i = 0; i < _text.size(); i++)
+				if (i == 0 || _text[i - 1] == '\\')
+					_offsets[segment++] = static_cast<std::uint32_t>(i);
+		}
+
+		constexpr std::string_view str() const noexcept { return _text; }
+		constexpr const char* c_str() const noexcept { return _text.data(); }
+		constexpr operator std::string_view() const noexcept { return _text; }
+
+		/// <summary>The case-insensitive hash of the path, equal to reg::ihash(str())</summary>
+		constexpr std::uint64_t hash() const noexcept { return _hash; }
+		/// <summary>The number of segments (key names) in the path</summary>
+		constexpr size_t size() const noexcept { return _count; }
+		constexpr bool empty() const noexcept { return _count == 0; }
+		/// <summary>The offset of each segment in the text</summary>
+		constexpr const std::uint32_t* offsets() const noexcept { return _offsets; }
+
+	private:
+		std::string_view _text;
+		size_t _count;
+		std::uint64_t _hash;
+		std::uint32_t _offsets[N] = {};
+	};
+
+	/// <summary>A validated, normalized registry path with precomputed segment offsets
+	/// and case-insensitive hash.<para/>
+	/// Construction removes leading, trailing and doubled backslashes and rejects names
+	/// the registry would refuse, so every later use is free of re-splitting and
+	/// re-hashing. The text is always null terminated, and the path converts to
+	/// std::string_view, so it can be passed to every function that takes a key.</summary>
+	class path
+	{
+	public:
+		/// <summary>The empty path, naming the key it is relative to</summary>
+		path() = default;
+
+		/// <summary>Normalizes and validates a path.<para/>
+		/// Throws std::invalid_argument if a key name is longer than 255 characters,
+		/// contains a null character or the path is deeper than 512 levels.</summary>
+		/// <param name='text'>Key names separated by backslashes</param>
+		path(std::string_view text)
+		{
+			_text.reserve(text.size());
+			for (std::string_view segment = reg::next_segment(text); !segment.empty(); segment = reg::next_segment(text))
+				_append(segment);
+			_hash = reg::ihash(_text);
+		}
+
+		path(const char* text) : path(std::string_view(text)) {}
+		path(const std::string& text) : path(std::string_view(text)) {}
+
+		/// <summary>Copies a compile-time path without validating or hashing it again</summary>
+		template<size_t N>
+		path(const reg::static_path<N>& other)
+			: _text(other.str()), _offsets(other.offsets(), other.offsets() + other.size()), _hash(other.hash())
+		{}
+
+		std::string_view str() const noexcept { return _text; }
+		const char* c_str() const noexcept { return _text.c_str(); }
+		operator std::string_view() const noexcept { return _text; }
+
+		/// <summary>The case-insensitive hash of the path, equal to reg::ihash(str())</summary>
+		std::uint64_t hash() const noexcept { return _hash; }
+		/// <summary>The number of segments (key names) in the path</summary>
+		size_t size() const noexcept { return _offsets.size(); }
+		bool empty() const noexcept { return _offsets.empty(); }
+
+		/// <summary>The key name at the given depth</summary>
+		std::string_view operator[](size_t index) const noexcept
+		{
+			size_t begin = _offsets[index];
+			size_t end = index + 1 < _offsets.size() ? _offsets[index + 1] - 1 : _text.size();
+			return std::string_view(_text).substr(begin, end - begin);
+		}
+
+		/// <summary>The last key name, or an empty string for the empty path</summary>
+		std::string_view name() const noexcept
+		{
+			return empty() ? std::string_view() : (*this)[size() - 1];
+		}
+
+		/// <summary>The path without its last segment</summary>
+		path parent() const
+		{
+			path result;
+			if (size() > 1)
+			{
+				result._text.assign(_text, 0, _offsets.back() - 1);
+				result._offsets.assign(_offsets.begin(), _offsets.end() - 1);
+				result._hash = reg::ihash(result._text);
+			}
+			return result;
+		}
+
+		/// <summary>Appends a relative path</summary>
+		path& operator/=(const path& other)
+		{
+			const size_t base = _text.size() + (empty() ? 0 : 1);
+			if (!other.empty())
+			{
+				if (!empty())
+					_text.push_back('\\');
+				_text.append(other._text);
+				for (std::uint32_t offset : other._offsets)
+					_offsets.push_back(static_cast<std::uint32_t>(base + offset));
+				if (_offsets.size() > reg::_max_depth)
+					throw std::invalid_argument("Registry paths are limited to 512 levels");
+				_hash = reg::ihash(_text);
+			}
+			return *this;
+		}
+
+		friend path operator/(path left, const path& right)
+		{
+			left /= right;
+			return left;
+		}
+
+		/// <summary>Paths are equal if they name the same key, ignoring case</summary>
+		friend bool operator==(const path& a, const path& b) noexcept
+		{
+			return a._hash == b._hash && reg::iequals(a._text, b._text);
+		}
+
+		friend bool operator!=(const path& a, const path& b) noexcept
+		{
+			return !(a == b);
+		}
+
+	private:
+		void _append(std::string_view segment)
+		{
+			size_t length = 0;
+			for (char c : segment)
+				length += reg::_utf16_units(c);
+			if (length > reg::_max_segment)
+				throw std::invalid_argument("Registry key names are limited to 255 characters");
+			if (segment.find('\0') != std::string_view::npos)
+				throw std::invalid_argument("Registry paths must not contain null characters");
+			if (_offsets.size() == reg::_max_depth)
+				throw std::invalid_argument("Registry paths are limited to 512 levels");
+
+			if (!_text.empty())
+				_text.push_back('\\');
+			_offsets.push_back(static_cast<std::uint32_t>(_text.size()));
+			_text.append(segment.data(), segment.size());
+		}
+
+		std::string _text;
+		std::vector<std::uint32_t> _offsets;
+		std::uint64_t _hash = reg::ihash("");
+	};
+}
+
+namespace std
+{
+	/// <summary>Lets paths key unordered containers without hashing them again</summary>
+	template<>
+	struct hash<reg::path>
+	{
+		size_t operator()(const reg::path& p) const noexcept
+		{
+			return static_cast<size_t>(p.hash());
+		}
+	};
+}
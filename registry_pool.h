@@ -0,0 +1,284 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "registry.h"
+#include "registry_name.h"
+
+namespace reg
+{
+	/// <summary>Open key handles shared by many threads, keyed by root key, path and access rights.<para/>
+	/// The handles are spread over shards by the hash of their path; each shard has its own lock
+	/// and keeps its handles in least recently used order, evicting the oldest when it is full.
+	/// A handle is reference counted: eviction only drops the pool's reference, and the key is
+	/// closed once the last <see cref="lease"/> on it is gone, so a lease stays usable after
+	/// the pool let go of it. Keys are opened outside the shard lock.<para/>
+	/// A handle to a key that is deleted stays open but fails with ERROR_KEY_DELETED; call
+	/// evict after deleting or replacing a pooled key or one of its ancestors.</summary>
+	/// <example><code>reg::handle_pool pool;
+	/// // on any thread
+	/// DWORD timeout = pool.get&lt;DWORD&gt;(HKEY_LOCAL_MACHINE, "Software\\X", "Timeout");
+	/// auto lease = pool.acquire(HKEY_LOCAL_MACHINE, "Software\\X", KEY_QUERY_VALUE);
+	/// auto names = reg::query::value_names(lease.get());</code></example>
+	class handle_pool
+	{
+		struct _entry
+		{
+			HKEY machine;
+			std::string key;
+			REGSAM rights;
+			HKEY handle;
+
+			_entry(HKEY machine, std::string_view key, REGSAM rights, HKEY handle)
+				: machine(machine), key(key), rights(rights), handle(handle)
+			{
+			}
+			_entry(const _entry&) = delete;
+			_entry& operator=(const _entry&) = delete;
+			~_entry()
+			{
+				reg::api::close_key(handle);
+			}
+		};
+
+	public:
+		/// <summary>A shared reference to a pooled handle, which stays open as long as the lease lives</summary>
+		class lease
+		{
+		public:
+			lease() = default;
+
+			HKEY get() const noexcept { return _held ? _held->handle : nullptr; }
+			explicit operator bool() const noexcept { return _held != nullptr; }
+
+		private:
+			friend class handle_pool;
+			explicit lease(std::shared_ptr<const handle_pool::_entry> entry) noexcept
+				: _held(std::move(entry))
+			{
+			}
+
+			std::shared_ptr<const handle_pool::_entry> _held;
+		};
+
+		/// <summary>Creates an empty pool</summary>
+		/// <param name='capacity'>The number of handles kept open at most</param>
+		/// <param name='shards'>The number of independently locked parts; more shards mean less
+		/// contention between threads using different keys</param>
+		explicit handle_pool(size_t capacity = 1024, size_t shards = 32)
+			: _shards((std::max)(shards, static_cast<size_t>(1))),
+			_shard_capacity((std::max)(capacity / _shards.size(), static_cast<size_t>(1)))
+		{
+		}
+
+		handle_pool(const handle_pool&) = delete;
+		handle_pool& operator=(const handle_pool&) = delete;
+
+		/// <summary>Returns a handle to a key opened with the given rights, opening it if the pool has none.<para/>
+		/// Throws an exception if the key does not exist or cannot be opened</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='rights'>A mask that specifies the desired access rights to the key</param>
+		[[nodiscard]]
+		lease acquire(HKEY machine, std::string_view key, REGSAM rights)
+		{
+			const std::uint64_t hash = _hash(machine, key, rights);
+			_shard& shard = _shards[hash % _shards.size()];
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				if (auto found = shard.find(hash, machine, key, rights); found != shard.order.end())
+				{
+					shard.order.splice(shard.order.begin(), shard.order, found);
+					++shard.hits;
+					return lease(*found);
+				}
+			}
+
+			// opening can take a while, so other threads keep using the shard meanwhile
+			auto opened = std::make_shared<const _entry>(machine, key, rights, reg::_open_existing(machine, key, rights));
+
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			++shard.misses;
+			if (auto found = shard.find(hash, machine, key, rights); found != shard.order.end())
+			{
+				// another thread opened it first; ours is closed on return
+				shard.order.splice(shard.order.begin(), shard.order, found);
+				return lease(*found);
+			}
+
+			if (shard.order.size() >= _shard_capacity)
+			{
+				const auto& oldest = shard.order.back();
+				shard.erase(_hash(oldest->machine, oldest->key, oldest->rights), oldest.get());
+				shard.order.pop_back();
+			}
+			shard.order.push_front(opened);
+			shard.index.emplace(hash, shard.order.begin());
+			return lease(std::move(opened));
+		}
+
+		/// <summary>Reads a value of the registry type that follows from T through a pooled handle.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value has a different type
+		/// or the function fails to retrieve the data</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='value'>Name of the value to be queried</param>
+		template<typename T>
+		T get(HKEY machine, std::string_view key, std::string_view value)
+		{
+			static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+
+			lease handle = acquire(machine, key, KEY_QUERY_VALUE);
+			T data{};
+			DWORD code = reg::value_traits<T>::read(handle.get(), "", value, data);
+			reg::_check_read(code, machine, key, value, reg::value_traits<T>::type);
+			return data;
+		}
+
+		/// <summary>Drops the pooled handles to a key and to every key below it, whatever their rights,
+		/// so that deleting a subtree needs a single call. Leases on them stay valid.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node; an empty path drops every handle under the root key</param>
+		/// <returns>The number of handles dropped</returns>
+		size_t evict(HKEY machine, std::string_view key)
+		{
+			while (!key.empty() && key.back() == '\\')
+				key.remove_suffix(1);
+
+			size_t dropped = 0;
+			for (_shard& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				for (auto it = shard.order.begin(); it != shard.order.end(); )
+				{
+					if ((*it)->machine == machine && _within((*it)->key, key))
+					{
+						shard.erase(_hash(machine, (*it)->key, (*it)->rights), it->get());
+						it = shard.order.erase(it);
+						++dropped;
+					}
+					else
+						++it;
+				}
+			}
+			return dropped;
+		}
+
+		/// <summary>Drops every pooled handle. Leases on them stay valid.</summary>
+		void clear()
+		{
+			for (_shard& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				shard.index.clear();
+				shard.order.clear();
+			}
+		}
+
+		/// <summary>The number of handles the pool holds</summary>
+		size_t size() const
+		{
+			size_t total = 0;
+			for (const _shard& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				total += shard.order.size();
+			}
+			return total;
+		}
+
+		/// <summary>The number of acquisitions served by a pooled handle</summary>
+		size_t hits() const
+		{
+			size_t total = 0;
+			for (const _shard& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				total += shard.hits;
+			}
+			return total;
+		}
+
+		/// <summary>The number of acquisitions that opened the key</summary>
+		size_t misses() const
+		{
+			size_t total = 0;
+			for (const _shard& shard : _shards)
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				total += shard.misses;
+			}
+			return total;
+		}
+
+	private:
+		using _list = std::list<std::shared_ptr<const _entry>>;
+
+		/// <summary>A part of the pool with its own lock, on its own cache lines</summary>
+		struct alignas(64) _shard
+		{
+			mutable std::mutex mutex;
+			/// <summary>Most recently used first</summary>
+			_list order;
+			std::unordered_multimap<std::uint64_t, _list::iterator> index;
+			size_t hits = 0;
+			size_t misses = 0;
+
+			_list::iterator find(std::uint64_t hash, HKEY machine, std::string_view key, REGSAM rights)
+			{
+				auto [first, last] = index.equal_range(hash);
+				for (auto it = first; it != last; ++it)
+				{
+					const _entry& e = **it->second;
+					if (e.machine == machine && e.rights == rights && reg::iequals(e.key, key))
+						return it->second;
+				}
+				return order.end();
+			}
+
+			void erase(std::uint64_t hash, const _entry* entry)
+			{
+				auto [first, last] = index.equal_range(hash);
+				for (auto it = first; it != last; ++it)
+					if (it->second->get() == entry)
+					{
+						index.erase(it);
+						return;
+					}
+			}
+		};
+
+		/// <summary>Checks whether a path names the given key or one below it.
+		/// The path is cut at each separator rather than at the length of the key,
+		/// since names that compare equal can differ in length.</summary>
+		static bool _within(std::string_view path, std::string_view key) noexcept
+		{
+			if (key.empty() || reg::iequals(path, key))
+				return true;
+			for (size_t end = path.find('\\'); end != std::string_view::npos; end = path.find('\\', end + 1))
+				if (reg::iequals(path.substr(0, end), key))
+					return true;
+			return false;
+		}
+
+		static std::uint64_t _hash(HKEY machine, std::string_view key, REGSAM rights) noexcept
+		{
+			std::uint64_t hash = reg::ihash(key);
+			hash ^= (static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(machine)) + 0x9E3779B97F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+			hash ^= (static_cast<std::uint64_t>(rights) + 0x94D049BB133111EBull) * 0x9E3779B97F4A7C15ull;
+			return hash ^ (hash >> 31);
+		}
+
+		std::vector<_shard> _shards;
+		size_t _shard_capacity;
+	};
+}
@@ -0,0 +1,295 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "registry.h"
+#include "registry_name.h"
+#include "registry_tree.h"
+
+namespace reg
+{
+	/// <summary>Answers existence probes below one key, mostly without calling the registry.<para/>
+	/// The key's subkeys and values are enumerated once into a Bloom filter. A probe for
+	/// a path whose first segment is not in the filter, or for a value of the key that is
+	/// not in it, is answered "no" on the spot: a Bloom filter never misses a name it was
+	/// given, so such an answer is exact. Probes the filter cannot rule out go to the
+	/// registry through a handle that stays open, and the misses among them are kept in an
+	/// exact set, so asking again costs nothing. The cache never answers "yes" by itself.<para/>
+	/// The filter and the set are rebuilt after a change anywhere in the subtree, which is
+	/// reported by RegNotifyChangeKeyValue, and after a time to live. If the key itself does
+	/// not exist, every probe is answered "no" until the time to live runs out.<para/>
+	/// Paths are relative to the key. One thread at a time may use the cache.</summary>
+	/// <example><code>reg::negative_cache plugins(HKEY_LOCAL_MACHINE, "Software\\X\\Plugins");
+	/// for (const std::string&amp; name : candidates)
+	///     if (plugins.value_exists(name, "Path"))	// misses cost nanoseconds
+	///         load(name);</code></example>
+	class negative_cache
+	{
+	public:
+		/// <summary>Enumerates the key and starts watching it for changes.<para/>
+		/// Throws an exception if the key exists but cannot be read or watched</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>The key below which probes are answered</param>
+		/// <param name='ttl'>How long the cache is trusted without a change being reported</param>
+		/// <param name='notify'>Whether to rebuild as soon as the subtree changes; without it
+		/// changes are only seen once the time to live has run out</param>
+		negative_cache(HKEY machine, std::string_view key,
+			std::chrono::steady_clock::duration ttl = std::chrono::seconds(30), bool notify = true)
+			: _machine(machine), _key(key), _ttl(ttl)
+		{
+			if (notify)
+			{
+				_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+				if (_event == NULL)
+					throw std::runtime_error("Could not create the change notification event");
+				if (!RegisterWaitForSingleObject(&_wait, _event, &negative_cache::_on_change, this, INFINITE, WT_EXECUTEDEFAULT))
+				{
+					CloseHandle(_event);
+					throw std::runtime_error("Could not wait for change notifications");
+				}
+			}
+
+			try
+			{
+				_refresh();
+			}
+			catch (...)
+			{
+				_release();
+				throw;
+			}
+		}
+
+		negative_cache(const negative_cache&) = delete;
+		negative_cache& operator=(const negative_cache&) = delete;
+		~negative_cache()
+		{
+			_release();
+		}
+
+		/// <summary>Checks whether a key exists below the cached key</summary>
+		/// <param name='key'>Path relative to the cached key; empty for the cached key itself</param>
+		[[nodiscard]]
+		bool key_exists(std::string_view key)
+		{
+			_check();
+			std::string_view rest = key;
+			const std::string_view child = reg::next_segment(rest);
+			if (_handle == nullptr || (!child.empty() && !_maybe(reg::ihash(child))))
+				return _answer(false);
+			if (child.empty())
+				return _answer(true);
+
+			const std::uint64_t hash = reg::ihash(key);
+			if (_missed(hash, key, {}, false))
+				return _answer(false);
+
+			HKEY handle = nullptr;
+			DWORD code = reg::api::open_key(_handle, key, KEY_QUERY_VALUE, &handle);
+			if (code == ERROR_SUCCESS)
+			{
+				reg::api::close_key(handle);
+				return true;
+			}
+			if (code == ERROR_FILE_NOT_FOUND)
+				_remember(hash, key, {}, false);
+			return false;
+		}
+
+		/// <summary>Checks whether a value exists in or below the cached key</summary>
+		/// <param name='key'>Path relative to the cached key; empty for the cached key itself</param>
+		/// <param name='value'>Name of the value</param>
+		[[nodiscard]]
+		bool value_exists(std::string_view key, std::string_view value)
+		{
+			_check();
+			std::string_view rest = key;
+			const std::string_view child = reg::next_segment(rest);
+			if (_handle == nullptr || !_maybe(child.empty() ? _value_hash(value) : reg::ihash(child)))
+				return _answer(false);
+
+			const std::uint64_t hash = reg::ihash(key) * 0x9E3779B97F4A7C15ull ^ reg::ihash(value);
+			if (_missed(hash, key, value, true))
+				return _answer(false);
+
+			DWORD code = reg::api::get_value(_handle, key, value, RRF_RT_ANY, NULL, NULL, NULL);
+			if (code == ERROR_SUCCESS)
+				return true;
+			if (code == ERROR_FILE_NOT_FOUND)
+				_remember(hash, key, value, true);
+			return false;
+		}
+
+		/// <summary>Makes the next probe rebuild the cache</summary>
+		void invalidate() noexcept
+		{
+			_changed.store(true, std::memory_order_release);
+		}
+
+		/// <summary>The number of probes answered without calling the registry</summary>
+		size_t answered() const noexcept { return _answered; }
+
+	private:
+		struct _miss
+		{
+			std::string key;
+			std::string value;
+			bool is_value;
+		};
+
+		/// <summary>Misses remembered before the set is emptied and starts over</summary>
+		static constexpr size_t _recent = 4096;
+		/// <summary>Filter bits per name and bits set per name: under 1% false "maybe" answers</summary>
+		static constexpr size_t _bits_per_name = 12;
+		static constexpr int _probes = 5;
+
+		static void CALLBACK _on_change(PVOID context, BOOLEAN)
+		{
+			static_cast<negative_cache*>(context)->invalidate();
+		}
+
+		static std::uint64_t _value_hash(std::string_view value) noexcept
+		{
+			// keeps value names apart from subkey names of the same spelling
+			return reg::ihash(value) ^ 0xC2B2AE3D27D4EB4Full;
+		}
+
+		bool _answer(bool result) noexcept
+		{
+			++_answered;
+			return result;
+		}
+
+		/// <summary>Rebuilds the cache if a change was reported or the time to live ran out</summary>
+		void _check()
+		{
+			if (_changed.load(std::memory_order_acquire))
+			{
+				_armed = false; // the notification fired
+				_refresh();
+			}
+			else if (std::chrono::steady_clock::now() >= _expires)
+				_refresh();
+		}
+
+		void _refresh()
+		{
+			_changed.store(false, std::memory_order_relaxed);
+			const auto now = std::chrono::steady_clock::now();
+			_expires = _ttl >= std::chrono::steady_clock::time_point::max() - now
+				? std::chrono::steady_clock::time_point::max() : now + _ttl;
+			_misses.clear();
+			_filter.assign(1, 0);
+			_mask = 63;
+
+			// the handle is kept across rebuilds, unless the key was deleted meanwhile
+			if (_handle != nullptr && reg::api::query_info(_handle, NULL, NULL, NULL, NULL, NULL, NULL) != ERROR_SUCCESS)
+				_close();
+			if (_handle == nullptr)
+			{
+				HKEY handle = nullptr;
+				DWORD code = reg::api::open_key(_machine, _key, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS | KEY_NOTIFY, &handle);
+				if (code == ERROR_FILE_NOT_FOUND)
+					return;
+				reg::assert::success(code);
+				_handle = handle;
+			}
+
+			// watch before enumerating, so a change made meanwhile is not lost. A notification
+			// stays armed until it fires, so it is only requested again once it has.
+			if (_event != NULL && !_armed)
+			{
+				reg::assert::success(reg::api::notify_change(_handle, true,
+					REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC, _event));
+				_armed = true;
+			}
+
+			const std::vector<std::string> keys = reg::query::keys(_handle);
+			const std::vector<std::string> values = reg::query::value_names(_handle);
+
+			size_t bits = 64;
+			while (bits < (keys.size() + values.size()) * _bits_per_name)
+				bits *= 2;
+			_filter.assign(bits / 64, 0);
+			_mask = bits - 1;
+			for (const std::string& name : keys)
+				_add(reg::ihash(name));
+			for (const std::string& name : values)
+				_add(_value_hash(name));
+		}
+
+		void _add(std::uint64_t hash) noexcept
+		{
+			const std::uint64_t step = (hash >> 32) | 1;
+			for (int i = 0; i < _probes; ++i, hash += step)
+				_filter[(hash & _mask) / 64] |= 1ull << (hash & 63);
+		}
+
+		/// <summary>False if the name was certainly not in the key when it was enumerated</summary>
+		bool _maybe(std::uint64_t hash) const noexcept
+		{
+			const std::uint64_t step = (hash >> 32) | 1;
+			for (int i = 0; i < _probes; ++i, hash += step)
+				if ((_filter[(hash & _mask) / 64] & (1ull << (hash & 63))) == 0)
+					return false;
+			return true;
+		}
+
+		bool _missed(std::uint64_t hash, std::string_view key, std::string_view value, bool is_value) const noexcept
+		{
+			auto [first, last] = _misses.equal_range(hash);
+			for (auto it = first; it != last; ++it)
+				if (it->second.is_value == is_value && reg::iequals(it->second.key, key) && reg::iequals(it->second.value, value))
+					return true;
+			return false;
+		}
+
+		void _remember(std::uint64_t hash, std::string_view key, std::string_view value, bool is_value)
+		{
+			if (_misses.size() >= _recent)
+				_misses.clear();
+			_misses.emplace(hash, _miss{ std::string(key), std::string(value), is_value });
+		}
+
+		void _close() noexcept
+		{
+			// closing the key also ends its notification
+			if (_handle != nullptr)
+				reg::api::close_key(_handle);
+			_handle = nullptr;
+			_armed = false;
+		}
+
+		void _release() noexcept
+		{
+			// waits for a callback that is running to return
+			if (_wait != NULL)
+				UnregisterWaitEx(_wait, INVALID_HANDLE_VALUE);
+			if (_event != NULL)
+				CloseHandle(_event);
+			_close();
+		}
+
+		HKEY _machine;
+		std::string _key;
+		std::chrono::steady_clock::duration _ttl;
+		std::chrono::steady_clock::time_point _expires{};
+		/// <summary>The open key, or null if it does not exist</summary>
+		HKEY _handle = nullptr;
+		HANDLE _event = NULL;
+		HANDLE _wait = NULL;
+		/// <summary>A change notification is pending on the handle</summary>
+		bool _armed = false;
+		std::atomic<bool> _changed{ false };
+		std::vector<std::uint64_t> _filter;
+		std::uint64_t _mask = 0;
+		std::unordered_multimap<std::uint64_t, _miss> _misses;
+		size_t _answered = 0;
+	};
+}
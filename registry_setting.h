@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "registry.h"
+#include "registry_path.h"
+
+namespace reg
+{
+	/// <summary>The predefined root keys, usable in constant expressions.<para/>
+	/// The HKEY_* macros are pointer casts and cannot appear in a constant expression;
+	/// the enumerators carry the same values and convert back with <see cref="reg::to_hkey"/>.</summary>
+	enum class hive : std::uint32_t
+	{
+		classes_root = 0x80000000,
+		current_user = 0x80000001,
+		local_machine = 0x80000002,
+		users = 0x80000003,
+		current_config = 0x80000005,
+	};
+
+	/// <summary>The HKEY_* handle of a predefined root key</summary>
+	inline HKEY to_hkey(reg::hive hive) noexcept
+	{
+		// the handles are the enumerator values sign-extended, exactly as the HKEY_* macros build them
+		return reinterpret_cast<HKEY>(static_cast<ULONG_PTR>(static_cast<LONG>(hive)));
+	}
+
+	namespace
+	{
+		/// <summary>Longest value name the registry accepts</summary>
+		constexpr size_t _max_value_name = 16383;
+
+		/// <summary>Checks that a value name is one the registry accepts</summary>
+		constexpr std::string_view _check_value_name(std::string_view name)
+		{
+			if (name.size() > _max_value_name)
+				throw std::invalid_argument("Registry value names are limited to 16383 characters");
+			for (char c : name)
+				if (c == '\0')
+					throw std::invalid_argument("Registry value names must not contain null characters");
+			return name;
+		}
+	}
+
+	/// <summary>Describes one registry value: where it lives and what C++ type it holds.<para/>
+	/// The path and value name are validated and the path is hashed when the descriptor is
+	/// constructed, so a constexpr descriptor with a malformed path does not compile. The
+	/// registry type follows from T at compile time (see <see cref="reg::value_traits"/>):
+	/// reading is a single RegGetValue call restricted to that type, with no type lookups
+	/// or string building unless it fails.</summary>
+	/// <example><code>constexpr reg::setting&lt;DWORD&gt; timeout(reg::hive::current_user, "Software\\X", "Timeout");
+	/// DWORD seconds = timeout.ensure(30);</code></example>
+	template<typename T>
+	class setting
+	{
+		static_assert(reg::value_traits<T>::supported, "The type cannot be stored in the registry; see reg::value_traits");
+		using traits = reg::value_traits<T>;
+
+	public:
+		/// <summary>The type of data passed to set and ensure</summary>
+		using argument = typename traits::argument;
+
+		/// <param name='hive'>Root key in the hierarchy</param>
+		/// <param name='path'>Subkey holding the value, in normal form (no leading, trailing or doubled backslashes)</param>
+		/// <param name='name'>Name of the value (empty for the default value)</param>
+		template<size_t P, size_t V>
+		constexpr setting(reg::hive hive, const char(&path)[P], const char(&name)[V])
+			: _hive(hive), _path(path, P - 1), _name(reg::_check_value_name(std::string_view(name, V - 1))),
+			_hash(reg::ihash(_path))
+		{
+			reg::_check_normal(_path);
+		}
+
+		constexpr reg::hive hive() const noexcept { return _hive; }
+		HKEY machine() const noexcept { return reg::to_hkey(_hive); }
+		constexpr std::string_view path() const noexcept { return _path; }
+		constexpr std::string_view name() const noexcept { return _name; }
+		/// <summary>The case-insensitive hash of the path, equal to reg::ihash(path())</summary>
+		constexpr std::uint64_t hash() const noexcept { return _hash; }
+		/// <summary>The registry type the value is stored as</summary>
+		static constexpr DWORD type() noexcept { return traits::type; }
+
+		/// <summary>Reads the value.<para/>
+		/// Throws an exception if
+		/// the key does not exist,
+		/// the value does not exist,
+		/// the value has a different type
+		/// or the data cannot be read</summary>
+		T get() const
+		{
+			T data{};
+			reg::query::get(machine(), _path, _name, data);
+			return data;
+		}
+
+		/// <summary>Writes the value, creating it if it does not exist.<para/>
+		/// Throws an exception if the key does not exist or the data cannot be written</summary>
+		void set(argument data) const
+		{
+			reg::update::set<T>(machine(), _path, _name, data);
+		}
+
+		/// <summary>Makes sure the value exists, creating the key and writing the fallback
+		/// if it is missing. An existing value is left untouched.<para/>
+		/// Throws an exception if
+		/// the value exists with a different type
+		/// or the key cannot be created</summary>
+		/// <param name='fallback'>The data written if the value does not exist</param>
+		/// <returns>The data the value holds afterwards</returns>
+		T ensure(argument fallback) const
+		{
+			HKEY handle = nullptr;
+			DWORD disposition = 0;
+			DWORD code = reg::api::create_key(machine(), _path, KEY_QUERY_VALUE | KEY_SET_VALUE, &handle, &disposition);
+			reg::assert::success(code);
+			auto closer = reg::self_closing_handle(&handle);
+
+			T data{};
+			code = disposition == REG_CREATED_NEW_KEY ? ERROR_FILE_NOT_FOUND : traits::read(handle, "", _name, data);
+			if (code == ERROR_FILE_NOT_FOUND)
+			{
+				traits::write(handle, _name, fallback);
+				return T(fallback);
+			}
+
+			reg::_check_read(code, machine(), _path, _name, traits::type);
+			return data;
+		}
+
+	private:
+		reg::hive _hive;
+		std::string_view _path;
+		std::string_view _name;
+		std::uint64_t _hash;
+	};
+}
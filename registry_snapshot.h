@@ -0,0 +1,651 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "registry_source.h"
+#include "registry_tree.h"
+#include "registry_utf.h"
+
+#if __has_include(<Windows.h>)
+#include "registry.h"
+#endif
+
+// Snapshot layout (all integers little-endian, "varint" is unsigned LEB128):
+//	header	"RSNP", u32 version, u32 flags, u32 reserved
+//	keys	one record per key, children before their parent:
+//			varint name, varint value count,
+//			per value: varint name, varint type, u8 encoding, payload
+//			varint subkey count, u32 offset per subkey (sorted by name)
+//	names	u32 count, u32 offset per name plus one end offset, name bytes
+//	trailer	u32 names offset, u32 root offset, u32 size, "RSNP"
+// Names of keys and values are interned, so every distinct name is stored once.
+// The fixed-width subkey offsets allow a child to be found by binary search
+// directly in the mapped file, without reading the rest of the snapshot.
+
+namespace reg
+{
+	namespace except
+	{
+		class snapshot_error : public std::runtime_error {
+		public:
+			snapshot_error(std::string_view message)
+				: std::runtime_error("Malformed snapshot: " + std::string(message))
+			{}
+		};
+	}
+
+	namespace snapshot
+	{
+		namespace
+		{
+			constexpr char _magic[4] = { 'R', 'S', 'N', 'P' };
+			constexpr std::uint32_t _version = 1;
+			constexpr size_t _header_size = 16;
+			constexpr size_t _trailer_size = 16;
+
+			/// <summary>How the payload of a value is stored</summary>
+			enum _payload : std::uint8_t
+			{
+				_raw = 0,		// varint size, bytes
+				_number = 1,	// varint; DWORD or QWORD data of the natural size
+				_text = 2,		// varint size, UTF-8 bytes; UTF-16 data with a single terminator
+			};
+
+			inline void _put_varint(std::string& out, std::uint64_t v)
+			{
+				while (v >= 0x80)
+				{
+					out.push_back(static_cast<char>(v | 0x80));
+					v >>= 7;
+				}
+				out.push_back(static_cast<char>(v));
+			}
+
+			inline void _put_u32(std::string& out, std::uint32_t v)
+			{
+				char bytes[4] = { static_cast<char>(v), static_cast<char>(v >> 8), static_cast<char>(v >> 16), static_cast<char>(v >> 24) };
+				out.append(bytes, 4);
+			}
+
+			/// <summary>Converts UTF-16LE bytes of any alignment to UTF-8</summary>
+			inline void _append_utf8(std::string_view bytes, std::string& out)
+			{
+				char16_t units[128];
+				const size_t total = bytes.size() / 2;
+				for (size_t done = 0; done < total;)
+				{
+					size_t count = total - done < 128 ? total - done : 128;
+					std::memcpy(units, bytes.data() + 2 * done, 2 * count);
+					reg::utf::append_utf8(units, count, out);
+					done += count;
+				}
+			}
+		}
+
+		/// <summary>Read-only view of a snapshot, queried in place.<para/>
+		/// Constructing the view only checks the header and trailer; keys and values are
+		/// decoded when they are visited, so a mapped snapshot is usable immediately.<para/>
+		/// The view satisfies the tree source interface (see registry_source.h), so it can be
+		/// exported as .reg text or compared against the registry like any other tree.</summary>
+		class file
+		{
+		public:
+			/// <summary>The offset of a key record</summary>
+			using node = std::uint32_t;
+
+			/// <summary>Views a snapshot already in memory, such as a mapped file.
+			/// The memory must outlive the view.<para/>
+			/// Throws a <see cref="reg::except::snapshot_error"/> if the header or trailer is invalid.</summary>
+			/// <param name='image'>The bytes of the whole snapshot</param>
+			explicit file(std::string_view image) : _image(image)
+			{
+				_validate();
+			}
+
+			/// <summary>Reads a snapshot file into memory.<para/>
+			/// Throws an exception if the file cannot be read or is not a snapshot.</summary>
+			/// <param name='filename'>Path to the snapshot file</param>
+			static file load(const std::string& filename)
+			{
+				std::ifstream in(filename, std::ios::binary | std::ios::ate);
+				if (!in)
+					throw std::runtime_error("Could not open \"" + filename + "\"");
+
+				std::string bytes(static_cast<size_t>(in.tellg()), '\0');
+				in.seekg(0);
+				in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+				return file(std::move(bytes));
+			}
+
+			file(file&& other) noexcept { *this = std::move(other); }
+			file& operator=(file&& other) noexcept
+			{
+				bool owning = other._image.data() == other._owned.data();
+				_owned = std::move(other._owned);
+				_image = owning ? std::string_view(_owned) : other._image;
+				_names = other._names;
+				_name_count = other._name_count;
+				_root = other._root;
+				return *this;
+			}
+
+			/// <summary>The record of the key the snapshot was taken from</summary>
+			node root() const noexcept { return _root; }
+
+			/// <summary>Finds a key by its path relative to the snapshot root</summary>
+			std::optional<node> open(std::string_view path) const
+			{
+				node current = _root;
+				for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+				{
+					std::optional<node> next = child(current, segment);
+					if (!next)
+						return std::nullopt;
+					current = *next;
+				}
+				return current;
+			}
+
+			/// <summary>Finds a direct subkey by binary searching the offset table of the key</summary>
+			std::optional<node> child(const node& parent, std::string_view name) const
+			{
+				const char* p = _subkeys(parent);
+				const size_t count = static_cast<size_t>(_varint(p));
+				_need(p, 4 * count);
+
+				size_t low = 0;
+				size_t high = count;
+				while (low < high)
+				{
+					size_t middle = low + (high - low) / 2;
+					node candidate = _u32(p + 4 * middle);
+					int order = reg::icompare(this->name(candidate), name);
+					if (order == 0)
+						return candidate;
+					if (order < 0)
+						low = middle + 1;
+					else
+						high = middle;
+				}
+				return std::nullopt;
+			}
+
+			void keys(const node& n, std::vector<std::string>& names) const
+			{
+				const char* p = _subkeys(n);
+				const size_t count = static_cast<size_t>(_varint(p));
+				_need(p, 4 * count);
+
+				names.resize(count);
+				for (size_t i = 0; i < count; i++)
+					names[i] = this->name(_u32(p + 4 * i));
+			}
+
+			template<typename F>
+			void values(const node& n, F&& visit) const
+			{
+				const char* p = _at(n);
+				_varint(p);
+				for (std::uint64_t count = _varint(p); count > 0; count--)
+				{
+					std::string_view value_name = _name(_varint(p));
+					std::uint32_t type = static_cast<std::uint32_t>(_varint(p));
+					visit(value_name, type, _payload_data(p));
+				}
+			}
+
+			/// <summary>Retrieves a single value of a key, skipping the payloads of the others</summary>
+			/// <returns>The value, or nothing if the key has no value with that name</returns>
+			std::optional<reg::value> get(const node& n, std::string_view value_name) const
+			{
+				const char* p = _at(n);
+				_varint(p);
+				for (std::uint64_t count = _varint(p); count > 0; count--)
+				{
+					std::string_view candidate = _name(_varint(p));
+					std::uint32_t type = static_cast<std::uint32_t>(_varint(p));
+					if (reg::iequals(candidate, value_name))
+						return reg::value{ type, std::string(_payload_data(p)) };
+					_skip_payload(p);
+				}
+				return std::nullopt;
+			}
+
+			/// <summary>The name of a key, as stored in the name table</summary>
+			std::string_view name(const node& n) const
+			{
+				const char* p = _at(n);
+				return _name(_varint(p));
+			}
+
+		private:
+			explicit file(std::string&& bytes) : _owned(std::move(bytes)), _image(_owned)
+			{
+				_validate();
+			}
+
+			static std::uint32_t _u32(const char* p) noexcept
+			{
+				const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+				return static_cast<std::uint32_t>(b[0]) | (static_cast<std::uint32_t>(b[1]) << 8) |
+					(static_cast<std::uint32_t>(b[2]) << 16) | (static_cast<std::uint32_t>(b[3]) << 24);
+			}
+
+			void _validate()
+			{
+				if (_image.size() < _header_size + _trailer_size ||
+					std::memcmp(_image.data(), _magic, 4) != 0 ||
+					std::memcmp(_image.data() + _image.size() - 4, _magic, 4) != 0)
+					throw reg::except::snapshot_error("missing signature");
+				if (_u32(_image.data() + 4) != _version)
+					throw reg::except::snapshot_error("unsupported version");
+
+				const char* trailer = _image.data() + _image.size() - _trailer_size;
+				_names = _u32(trailer);
+				_root = _u32(trailer + 4);
+				if (_u32(trailer + 8) != _image.size())
+					throw reg::except::snapshot_error("size does not match the trailer");
+				if (_names < _header_size || _root < _header_size || _root >= _names ||
+					static_cast<size_t>(_names) + 4 > _image.size() - _trailer_size)
+					throw reg::except::snapshot_error("offsets out of range");
+
+				_name_count = _u32(_image.data() + _names);
+				if ((static_cast<size_t>(_name_count) + 1) * 4 > _image.size() - _trailer_size - _names - 4)
+					throw reg::except::snapshot_error("name table out of range");
+			}
+
+			const char* _at(node n) const
+			{
+				if (n < _header_size || n >= _names)
+					throw reg::except::snapshot_error("key offset out of range");
+				return _image.data() + n;
+			}
+
+			/// <summary>Checks that the given number of bytes can be read from the key area</summary>
+			void _need(const char* p, size_t count) const
+			{
+				if (count > static_cast<size_t>(_image.data() + _names - p))
+					throw reg::except::snapshot_error("record exceeds its bounds");
+			}
+
+			std::uint64_t _varint(const char*& p) const
+			{
+				const char* end = _image.data() + _names;
+				std::uint64_t v = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					if (p == end)
+						throw reg::except::snapshot_error("record exceeds its bounds");
+					unsigned char byte = static_cast<unsigned char>(*p++);
+					v |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+					if ((byte & 0x80) == 0)
+						return v;
+				}
+				throw reg::except::snapshot_error("varint too long");
+			}
+
+			std::string_view _name(std::uint64_t id) const
+			{
+				if (id >= _name_count)
+					throw reg::except::snapshot_error("name index out of range");
+
+				const char* offsets = _image.data() + _names + 4;
+				std::uint32_t first = _u32(offsets + 4 * id);
+				std::uint32_t last = _u32(offsets + 4 * (id + 1));
+				size_t table = _names + 4 + 4 * (static_cast<size_t>(_name_count) + 1);
+				if (first > last || table + last > _image.size() - _trailer_size)
+					throw reg::except::snapshot_error("name out of range");
+
+				return _image.substr(table + first, last - first);
+			}
+
+			/// <summary>Skips the name and values of a key record</summary>
+			const char* _subkeys(node n) const
+			{
+				const char* p = _at(n);
+				_varint(p);
+				for (std::uint64_t count = _varint(p); count > 0; count--)
+				{
+					_varint(p);
+					_varint(p);
+					_skip_payload(p);
+				}
+				return p;
+			}
+
+			void _skip_payload(const char*& p) const
+			{
+				_need(p, 1);
+				std::uint8_t encoding = static_cast<std::uint8_t>(*p++);
+				std::uint64_t v = _varint(p);
+				if (encoding != _number)
+				{
+					_need(p, v);
+					p += v;
+				}
+			}
+
+			/// <summary>Decodes a value payload into the registry representation.
+			/// Raw payloads are returned in place; the others use a reused buffer.</summary>
+			std::string_view _payload_data(const char*& p) const
+			{
+				_need(p, 1);
+				std::uint8_t encoding = static_cast<std::uint8_t>(*p++);
+				std::uint64_t v = _varint(p);
+
+				switch (encoding)
+				{
+				case _raw:
+				{
+					_need(p, v);
+					std::string_view bytes(p, static_cast<size_t>(v));
+					p += v;
+					return bytes;
+				}
+				case _number:
+					_data.clear();
+					for (int i = 0; i < (v > 0xFFFFFFFFu ? 8 : 4); i++)
+						_data.push_back(static_cast<char>(v >> (8 * i)));
+					return _data;
+				case _text:
+				{
+					_need(p, v);
+					_data.clear();
+					reg::utf::append_utf16le(std::string_view(p, static_cast<size_t>(v)), _data);
+					p += v;
+					return _data;
+				}
+				default:
+					throw reg::except::snapshot_error("unknown value encoding");
+				}
+			}
+
+			std::string _owned;
+			std::string_view _image;
+			std::uint32_t _names = 0;
+			std::uint32_t _name_count = 0;
+			node _root = 0;
+
+			mutable std::string _data;
+		};
+
+		/// <summary>Writes a snapshot while walking a tree source.<para/>
+		/// Keys are written after their subkeys, so every record can be emitted as soon as
+		/// it is complete and the output only ever grows at the end; nothing is seeked or
+		/// patched. Besides the output block, the writer keeps the interned names and the
+		/// name and offset lists of the keys on the current path.</summary>
+		template<typename Sink>
+		class writer
+		{
+		public:
+			/// <param name='sink'>Receives the output in blocks</param>
+			/// <param name='block_size'>Number of bytes collected before calling the sink</param>
+			explicit writer(Sink& sink, size_t block_size = 1 << 16) : _sink(sink), _block_size(block_size)
+			{
+				_block.append(_magic, 4);
+				_put_u32(_block, _version);
+				_put_u32(_block, 0);
+				_put_u32(_block, 0);
+			}
+
+			/// <summary>Writes the subtree and the name table, and completes the snapshot</summary>
+			/// <param name='source'>Any tree source</param>
+			/// <param name='root'>The node the snapshot is taken from</param>
+			template<typename Source>
+			void write(Source& source, const typename Source::node& root)
+			{
+				std::uint32_t root_offset = _record(source, root, std::string_view(), 0);
+				std::uint32_t names_offset = _offset();
+
+				_put_u32(_block, static_cast<std::uint32_t>(_names.size()));
+				std::uint32_t position = 0;
+				for (std::string_view name : _names)
+				{
+					_put_u32(_block, position);
+					position += static_cast<std::uint32_t>(name.size());
+				}
+				_put_u32(_block, position);
+				for (std::string_view name : _names)
+				{
+					_block.append(name.data(), name.size());
+					_spill();
+				}
+
+				_put_u32(_block, names_offset);
+				_put_u32(_block, root_offset);
+				_put_u32(_block, _offset() + 8);
+				_block.append(_magic, 4);
+				_flush();
+			}
+
+		private:
+			template<typename Source>
+			std::uint32_t _record(Source& source, const typename Source::node& n, std::string_view name, size_t depth)
+			{
+				if (_levels.size() <= depth)
+					_levels.emplace_back();
+				source.keys(n, _levels[depth].names);
+				_levels[depth].offsets.clear();
+
+				for (size_t i = 0; i < _levels[depth].names.size(); i++)
+				{
+					auto child = source.child(n, _levels[depth].names[i]);
+					if (!child)
+						continue; // removed while walking
+					std::uint32_t offset = _record(source, *child, _levels[depth].names[i], depth + 1);
+					_levels[depth].offsets.push_back(offset);
+				}
+
+				_values.clear();
+				std::uint64_t count = 0;
+				source.values(n, [this, &count](std::string_view value_name, std::uint32_t type, std::string_view data) {
+					_put_varint(_values, _intern(value_name));
+					_put_varint(_values, type);
+					_encode(type, data);
+					++count;
+					});
+
+				std::uint32_t offset = _offset();
+				_put_varint(_block, _intern(name));
+				_put_varint(_block, count);
+				_block += _values;
+				_put_varint(_block, _levels[depth].offsets.size());
+				for (std::uint32_t child : _levels[depth].offsets)
+					_put_u32(_block, child);
+				_spill();
+				return offset;
+			}
+
+			/// <summary>Picks the most compact lossless encoding for a value</summary>
+			void _encode(std::uint32_t type, std::string_view data)
+			{
+				if ((type == reg::types::dword && data.size() == 4) || (type == reg::types::qword && data.size() == 8))
+				{
+					std::uint64_t v = 0;
+					for (size_t i = 0; i < data.size(); i++)
+						v |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+					// a QWORD that fits in 32 bits would come back as 4 bytes
+					if (type == reg::types::dword || v > 0xFFFFFFFFu)
+					{
+						_values.push_back(static_cast<char>(_number));
+						_put_varint(_values, v);
+						return;
+					}
+				}
+
+				if (reg::types::is_string(type) && data.size() >= 2 && data.size() % 2 == 0 &&
+					data[data.size() - 2] == '\0' && data[data.size() - 1] == '\0')
+				{
+					_utf8.clear();
+					_append_utf8(data.substr(0, data.size() - 2), _utf8);
+					_check.clear();
+					reg::utf::append_utf16le(_utf8, _check);
+					if (_check == data)
+					{
+						_values.push_back(static_cast<char>(_text));
+						_put_varint(_values, _utf8.size());
+						_values += _utf8;
+						return;
+					}
+				}
+
+				_values.push_back(static_cast<char>(_raw));
+				_put_varint(_values, data.size());
+				_values.append(data.data(), data.size());
+			}
+
+			std::uint32_t _intern(std::string_view name)
+			{
+				_key.assign(name.data(), name.size());
+				auto [it, inserted] = _ids.emplace(_key, static_cast<std::uint32_t>(_names.size()));
+				if (inserted)
+					_names.push_back(it->first);
+				return it->second;
+			}
+
+			std::uint32_t _offset() const
+			{
+				std::uint64_t offset = _written + _block.size();
+				if (offset > 0xFFFFFFF0u)
+					throw std::length_error("Snapshots are limited to 4 GiB");
+				return static_cast<std::uint32_t>(offset);
+			}
+
+			void _spill()
+			{
+				if (_block.size() >= _block_size)
+					_flush();
+			}
+
+			void _flush()
+			{
+				if (_block.empty())
+					return;
+				_sink(std::string_view(_block));
+				_written += _block.size();
+				_block.clear();
+			}
+
+			struct _level
+			{
+				std::vector<std::string> names;
+				std::vector<std::uint32_t> offsets;
+			};
+
+			Sink& _sink;
+			size_t _block_size;
+			std::string _block;
+			std::uint64_t _written = 0;
+
+			std::deque<_level> _levels;
+			std::unordered_map<std::string, std::uint32_t> _ids;
+			std::vector<std::string_view> _names;
+			std::string _key;
+			std::string _values;
+			std::string _utf8;
+			std::string _check;
+		};
+
+		/// <summary>Writes a snapshot of a subtree of any tree source</summary>
+		/// <param name='source'>A live registry, hive file, tree or another snapshot</param>
+		/// <param name='root'>The node the snapshot is taken from</param>
+		/// <param name='sink'>Callable receiving std::string_view blocks of output</param>
+		template<typename Source, typename Sink,
+			typename = std::enable_if_t<std::is_invocable_v<Sink&, std::string_view>>>
+		void write(Source& source, const typename Source::node& root, Sink&& sink)
+		{
+			reg::snapshot::writer<std::remove_reference_t<Sink>> out(sink);
+			out.write(source, root);
+		}
+
+		/// <summary>Writes a snapshot of a subtree of any tree source to a stream</summary>
+		/// <param name='out'>Stream opened in binary mode</param>
+		template<typename Source>
+		void write(Source& source, const typename Source::node& root, std::ostream& out)
+		{
+			reg::snapshot::write(source, root, [&out](std::string_view block) {
+				out.write(block.data(), static_cast<std::streamsize>(block.size()));
+				});
+		}
+
+#if __has_include(<Windows.h>)
+		/// <summary>Writes a snapshot of a registry key and all of its subkeys.<para/>
+		/// Throws an exception if the key does not exist or cannot be read.</summary>
+		/// <param name='machine'>Root key in the hierarchy</param>
+		/// <param name='key'>Subkey to the desired node</param>
+		/// <param name='out'>Stream opened in binary mode</param>
+		inline void write(HKEY machine, std::string_view key, std::ostream& out)
+		{
+			reg::source::live source(machine);
+			auto root = source.open(key);
+			if (!root)
+				throw reg::except::key_not_found(machine, key);
+
+			reg::snapshot::write(source, *root, out);
+		}
+
+		/// <summary>A read-only memory mapping of a snapshot file.<para/>
+		/// Pass <see cref="bytes"/> to <see cref="reg::snapshot::file"/>; the mapping must
+		/// outlive the view. Pages are only read when the keys on them are visited.</summary>
+		class mapping
+		{
+		public:
+			/// <summary>Maps a file. Throws an exception if it cannot be opened.</summary>
+			/// <param name='filename'>Path to the snapshot file</param>
+			explicit mapping(const std::string& filename)
+			{
+				_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+				if (_file == INVALID_HANDLE_VALUE)
+					throw std::runtime_error("Could not open \"" + filename + "\"");
+
+				LARGE_INTEGER size;
+				if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+				{
+					CloseHandle(_file);
+					throw std::runtime_error("Could not map \"" + filename + "\"");
+				}
+
+				_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+				_view = _mapping ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+				if (_view == nullptr)
+				{
+					if (_mapping)
+						CloseHandle(_mapping);
+					CloseHandle(_file);
+					throw std::runtime_error("Could not map \"" + filename + "\"");
+				}
+				_size = static_cast<size_t>(size.QuadPart);
+			}
+
+			mapping(const mapping&) = delete;
+			mapping& operator=(const mapping&) = delete;
+			~mapping()
+			{
+				UnmapViewOfFile(_view);
+				CloseHandle(_mapping);
+				CloseHandle(_file);
+			}
+
+			/// <summary>The mapped contents of the file</summary>
+			std::string_view bytes() const noexcept
+			{
+				return std::string_view(static_cast<const char*>(_view), _size);
+			}
+
+		private:
+			HANDLE _file = INVALID_HANDLE_VALUE;
+			HANDLE _mapping = nullptr;
+			void* _view = nullptr;
+			size_t _size = 0;
+		};
+#endif
+	}
+}
@@ -0,0 +1,291 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "registry_tree.h"
+#include "registry_utf.h"
+
+#if __has_include(<Windows.h>)
+#include "registry.h"
+#endif
+
+// A tree source is anything that can be walked like a registry subtree.
+// Every source provides:
+//	using node = ...;
+//	std::optional<node> open(std::string_view path);
+//	std::optional<node> child(const node& parent, std::string_view name);
+//	void keys(const node& n, std::vector<std::string>& names);	// sorted with reg::iless
+//	template<typename F> void values(const node& n, F&& visit);	// visit(name, type, data)
+// Value data is passed exactly as the registry stores it. The views passed to visit
+// are only valid for the duration of the call; sources reuse their buffers.
+// Sources that track modification times may also provide:
+//	std::uint64_t last_write(const node& n);	// FILETIME of the last change to the key
+
+namespace reg
+{
+	namespace source
+	{
+		namespace
+		{
+			template<typename Source, typename Handler>
+			void _walk(Source& source, const typename Source::node& n, std::string& path, Handler& handler,
+				std::deque<std::vector<std::string>>& levels, size_t depth)
+			{
+				handler.key(path);
+				source.values(n, [&handler](std::string_view name, std::uint32_t type, std::string_view data) {
+					handler.value(name, type, data);
+					});
+
+				if (levels.size() <= depth)
+					levels.emplace_back();
+				std::vector<std::string>& names = levels[depth];
+				source.keys(n, names);
+
+				const size_t length = path.size();
+				for (const std::string& name : names)
+				{
+					auto child = source.child(n, name);
+					if (!child)
+						continue; // removed while walking
+
+					if (!path.empty())
+						path.push_back('\\');
+					path.append(name);
+					reg::source::_walk(source, *child, path, handler, levels, depth + 1);
+					path.resize(length);
+				}
+			}
+		}
+
+		/// <summary>Walks a subtree depth-first, reporting every key and value to a handler
+		/// with the same member functions as a .reg parser handler (key and value).<para/>
+		/// Only the nodes on the current path are held open, and the name lists of each
+		/// depth are reused between siblings, so memory use depends on the depth and
+		/// fan-out of the subtree rather than on its size.</summary>
+		/// <param name='source'>Any tree source</param>
+		/// <param name='root'>The node the walk starts at</param>
+		/// <param name='root_path'>The path reported for the starting node</param>
+		/// <param name='handler'>Receives key(path) and value(name, type, data) calls</param>
+		template<typename Source, typename Handler>
+		void walk(Source& source, const typename Source::node& root, std::string_view root_path, Handler& handler)
+		{
+			std::string path(root_path);
+			std::deque<std::vector<std::string>> levels;
+			reg::source::_walk(source, root, path, handler, levels, 0);
+		}
+
+		/// <summary>Walks an in-memory <see cref="reg::tree"/></summary>
+		class tree
+		{
+		public:
+			using node = const reg::tree*;
+
+			explicit tree(const reg::tree& root) : _root(root) {}
+
+			std::optional<node> open(std::string_view path) const
+			{
+				node found = _root.find(path);
+				if (found == nullptr)
+					return std::nullopt;
+				return found;
+			}
+
+			std::optional<node> child(const node& parent, std::string_view name) const
+			{
+				auto it = parent->keys().find(name);
+				if (it == parent->keys().end())
+					return std::nullopt;
+				return it->second.get();
+			}
+
+			void keys(const node& n, std::vector<std::string>& names) const
+			{
+				// assign into the existing strings so their capacity is reused
+				names.resize(n->keys().size());
+				size_t i = 0;
+				for (const auto& [name, subkey] : n->keys())
+					names[i++].assign(name);
+			}
+
+			template<typename F>
+			void values(const node& n, F&& visit) const
+			{
+				for (const auto& [name, value] : n->values())
+					visit(std::string_view(name), value.type, std::string_view(value.data));
+			}
+
+		private:
+			const reg::tree& _root;
+		};
+
+#if __has_include(<Windows.h>)
+		/// <summary>Walks the live registry under one of the hives.<para/>
+		/// Each node owns exactly one open handle, and enumeration buffers are kept
+		/// in the source and reused for every key, so walking a subtree allocates
+		/// only for the names it returns.<para/>
+		/// Subkeys that cannot be opened with the requested rights, such as those under
+		/// HKLM\SECURITY, are skipped like subkeys removed while walking, and counted.</summary>
+		class live
+		{
+		public:
+			/// <summary>An open registry key, closed when the node is destroyed</summary>
+			class node
+			{
+			public:
+				node() = default;
+				explicit node(HKEY handle) noexcept : _handle(handle) {}
+				node(node&& other) noexcept : _handle(other._handle) { other._handle = nullptr; }
+				node& operator=(node&& other) noexcept
+				{
+					std::swap(_handle, other._handle);
+					return *this;
+				}
+				node(const node&) = delete;
+				node& operator=(const node&) = delete;
+				~node()
+				{
+					if (_handle)
+						reg::api::close_key(_handle);
+				}
+
+				HKEY get() const noexcept { return _handle; }
+
+			private:
+				HKEY _handle = nullptr;
+			};
+
+			/// <param name='machine'>Root key in the hierarchy</param>
+			/// <param name='rights'>Access rights every key is opened with</param>
+			explicit live(HKEY machine, REGSAM rights = KEY_READ) : _machine(machine), _rights(rights) {}
+
+			/// <summary>Throws an exception if the key exists but cannot be opened</summary>
+			std::optional<node> open(std::string_view path)
+			{
+				return _open(_machine, path, false);
+			}
+
+			std::optional<node> child(const node& parent, std::string_view name)
+			{
+				return _open(parent.get(), name, true);
+			}
+
+			/// <summary>The number of subkeys skipped because access to them was denied</summary>
+			size_t denied() const noexcept { return _denied; }
+
+			/// <summary>The last time the key or one of its values was written, as a FILETIME</summary>
+			std::uint64_t last_write(const node& n)
+			{
+				FILETIME time = {};
+				DWORD code = reg::api::query_info(n.get(), NULL, NULL, NULL, NULL, NULL, &time);
+				reg::assert::success(code);
+				return static_cast<std::uint64_t>(time.dwLowDateTime) | (static_cast<std::uint64_t>(time.dwHighDateTime) << 32);
+			}
+
+			void keys(const node& n, std::vector<std::string>& names)
+			{
+				names.clear();
+				_info(n.get());
+
+				DWORD i = 0;
+				for (;;)
+				{
+					DWORD characters_read = static_cast<DWORD>(_name.size());
+					DWORD code = reg::api::enum_key(n.get(), i, _name.data(), &characters_read);
+
+					if (code == ERROR_NO_MORE_ITEMS)
+						break;
+					if (code == ERROR_MORE_DATA)
+					{
+						_name.resize(_name.size() * 2);
+						continue;
+					}
+					reg::assert::success(code);
+
+					names.emplace_back();
+					reg::utf::append_utf8(_name.data(), characters_read, names.back());
+					++i;
+				}
+
+				std::sort(names.begin(), names.end(), reg::iless());
+			}
+
+			template<typename F>
+			void values(const node& n, F&& visit)
+			{
+				_info(n.get());
+
+				DWORD i = 0;
+				for (;;)
+				{
+					DWORD characters_read = static_cast<DWORD>(_name.size());
+					DWORD size = static_cast<DWORD>(_data.size());
+					DWORD type = REG_NONE;
+					DWORD code = reg::api::enum_value(n.get(), i, _name.data(), &characters_read, &type, _data.data(), &size);
+
+					if (code == ERROR_NO_MORE_ITEMS)
+						break;
+					if (code == ERROR_MORE_DATA)
+					{
+						// the value grew after the key was queried
+						_name.resize(_name.size() * 2);
+						_data.resize(std::max<size_t>(_data.size() * 2, size));
+						continue;
+					}
+					reg::assert::success(code);
+
+					_utf8.clear();
+					reg::utf::append_utf8(_name.data(), characters_read, _utf8);
+					visit(std::string_view(_utf8), static_cast<std::uint32_t>(type),
+						std::string_view(reinterpret_cast<const char*>(_data.data()), size));
+					++i;
+				}
+			}
+
+		private:
+			std::optional<node> _open(HKEY parent, std::string_view path, bool skip_denied)
+			{
+				HKEY handle = nullptr;
+				DWORD code = reg::api::open_key(parent, path, _rights, &handle);
+				if (code == ERROR_FILE_NOT_FOUND)
+					return std::nullopt;
+				if (code == ERROR_ACCESS_DENIED && skip_denied)
+				{
+					++_denied;
+					return std::nullopt;
+				}
+				reg::assert::success(code);
+
+				return node(handle);
+			}
+
+			/// <summary>Grows the reusable buffers to fit the longest name and data of the key</summary>
+			void _info(HKEY handle)
+			{
+				DWORD maxkeynamelen = 0;
+				DWORD maxvaluenamelen = 0;
+				DWORD maxdatalen = 0;
+
+				DWORD code = reg::api::query_info(handle, NULL, &maxkeynamelen, NULL, &maxvaluenamelen, &maxdatalen, NULL);
+				reg::assert::success(code);
+
+				size_t longest = std::max(maxkeynamelen, maxvaluenamelen) + 1;
+				if (_name.size() < longest)
+					_name.resize(longest);
+				if (_data.size() < maxdatalen)
+					_data.resize(maxdatalen);
+			}
+
+			HKEY _machine;
+			REGSAM _rights;
+			size_t _denied = 0;
+			std::vector<char16_t> _name = std::vector<char16_t>(256);
+			std::vector<BYTE> _data = std::vector<BYTE>(256);
+			std::string _utf8;
+		};
+#endif
+	}
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "registry.h"
+#include "registry_setting.h"
+
+namespace reg
+{
+	/// <summary>Maps one member of a struct to a registry value of the same name.
+	/// The registry type follows from the member's type (see <see cref="reg::value_traits"/>).</summary>
+	template<typename Struct, typename T>
+	struct field
+	{
+		static_assert(reg::value_traits<T>::supported, "The member type cannot be stored in the registry; see reg::value_traits");
+		using type = T;
+
+		std::string_view name;
+		T Struct::* member;
+	};
+
+	/// <summary>Binds a member to a value name, which is checked at compile time when the call is constexpr</summary>
+	/// <param name='name'>Name of the value (empty for the default value)</param>
+	/// <param name='member'>Pointer to the member holding the data</param>
+	template<typename Struct, typename T, size_t N>
+	constexpr reg::field<Struct, T> bind(const char(&name)[N], T Struct::* member)
+	{
+		return { reg::_check_value_name(std::string_view(name, N - 1)), member };
+	}
+
+	/// <summary>Lists the members of a struct that are kept in the registry.<para/>
+	/// Specialize it with a static constexpr tuple of <see cref="reg::field"/>s named list;
+	/// REG_FIELD names each value after its member.</summary>
+	/// <example><code>struct options { DWORD timeout = 30; std::string user; bool verbose = false; };
+	/// template&lt;&gt; struct reg::fields&lt;options&gt; {
+	///		static constexpr auto list = std::make_tuple(
+	///			reg::bind("Timeout", &amp;options::timeout), REG_FIELD(options, user), REG_FIELD(options, verbose));
+	/// };</code></example>
+	template<typename Struct>
+	struct fields;
+
+	/// <summary>Binds a member to a value named after it</summary>
+#define REG_FIELD(type, member) reg::bind(#member, &type::member)
+
+	namespace
+	{
+		/// <summary>Reads a fixed list of values of one open key into a single buffer.<para/>
+		/// The values are fetched with one RegQueryMultipleValues call. That call fails as a
+		/// whole if any value is missing, in which case they are read one by one from the
+		/// same handle. The buffers are kept between reads.</summary>
+		class _value_batch
+		{
+		public:
+			struct entry
+			{
+				bool found = false;
+				DWORD type = REG_NONE;
+				std::string_view data;
+			};
+
+			void read(HKEY handle, const std::string_view* names, size_t count)
+			{
+				// the names as one block of null-terminated UTF-16 strings
+				size_t capacity = 0;
+				for (size_t i = 0; i < count; ++i)
+					capacity += names[i].size() + 1;
+
+				char16_t* units = _names.reserve(capacity);
+				_list.resize(count);
+				size_t used = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					_list[i] = {};
+					_list[i].ve_valuename = reinterpret_cast<LPWSTR>(units + used);
+					used += reg::utf::to_utf16(names[i], units + used);
+					units[used++] = u'\0';
+				}
+
+				DWORD size = static_cast<DWORD>(_data.size());
+				DWORD code = reg::api::query_values(handle, _list.data(), static_cast<DWORD>(count), _data.data(), &size);
+				while (code == ERROR_MORE_DATA)
+				{
+					_data.resize(size);
+					code = reg::api::query_values(handle, _list.data(), static_cast<DWORD>(count), _data.data(), &size);
+				}
+
+				_entries.resize(count);
+				if (code == ERROR_FILE_NOT_FOUND)
+					return _read_each(handle, names, count);
+				reg::assert::success(code);
+
+				for (size_t i = 0; i < count; ++i)
+					_entries[i] = { true, _list[i].ve_type,
+						std::string_view(reinterpret_cast<const char*>(_list[i].ve_valueptr), _list[i].ve_valuelen) };
+			}
+
+			const entry& operator[](size_t i) const noexcept { return _entries[i]; }
+
+		private:
+			void _read_each(HKEY handle, const std::string_view* names, size_t count)
+			{
+				// offsets, not views, until every value is in; the buffer may move while it grows
+				_offsets.resize(count);
+				size_t used = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					DWORD type = REG_NONE;
+					DWORD size = static_cast<DWORD>(_data.size() - used);
+					DWORD code = reg::api::query_value(handle, names[i], &type, _data.data() + used, &size);
+					while (code == ERROR_MORE_DATA)
+					{
+						_data.resize(used + size);
+						code = reg::api::query_value(handle, names[i], &type, _data.data() + used, &size);
+					}
+
+					_entries[i] = {};
+					if (code == ERROR_FILE_NOT_FOUND)
+						continue;
+					reg::assert::success(code);
+
+					_entries[i].found = true;
+					_entries[i].type = type;
+					_offsets[i] = { used, size };
+					used += size;
+				}
+
+				for (size_t i = 0; i < count; ++i)
+					if (_entries[i].found)
+						_entries[i].data = std::string_view(reinterpret_cast<const char*>(_data.data()) + _offsets[i].first, _offsets[i].second);
+			}
+
+			reg::utf::small_buffer<char16_t> _names;
+			std::vector<VALENTW> _list;
+			std::vector<BYTE> _data = std::vector<BYTE>(1024);
+			std::vector<entry> _entries;
+			std::vector<std::pair<size_t, size_t>> _offsets;
+		};
+
+		template<typename Struct>
+		constexpr size_t _field_count = std::tuple_size_v<std::decay_t<decltype(reg::fields<Struct>::list)>>;
+
+		template<typename Struct, size_t... I>
+		constexpr std::array<std::string_view, sizeof...(I)> _field_names(std::index_sequence<I...>)
+		{
+			return { std::get<I>(reg::fields<Struct>::list).name... };
+		}
+
+		template<typename Struct, typename F, size_t... I>
+		void _for_each_field(F&& visit, std::index_sequence<I...>)
+		{
+			(visit(std::get<I>(reg::fields<Struct>::list), I), ...);
+		}
+	}
+
+	/// <summary>Reads every field of a struct from the values of one key.<para/>
+	/// The key is opened once and all values are fetched in a single call. Fields whose
+	/// value does not exist keep the data they had.<para/>
+	/// Throws an exception if
+	/// the key does not exist,
+	/// a value has a different type than its field
+	/// or the data cannot be read</summary>
+	/// <param name='machine'>Root key in the hierarchy</param>
+	/// <param name='key'>Subkey holding the values</param>
+	/// <param name='data'>The struct receiving the data; see <see cref="reg::fields"/></param>
+	/// <returns>The number of fields read from the registry</returns>
+	template<typename Struct>
+	size_t load(HKEY machine, std::string_view key, Struct& data)
+	{
+		REG_OPERATION("load");
+		constexpr size_t count = reg::_field_count<Struct>;
+		constexpr auto names = reg::_field_names<Struct>(std::make_index_sequence<count>());
+
+		HKEY handle = reg::_open_existing(machine, key, KEY_QUERY_VALUE);
+		auto closer = reg::self_closing_handle(&handle);
+
+		reg::_value_batch batch;
+		batch.read(handle, names.data(), count);
+
+		size_t found = 0;
+		reg::_for_each_field<Struct>([&](const auto& field, size_t i) {
+			using traits = reg::value_traits<typename std::decay_t<decltype(field)>::type>;
+			const auto& entry = batch[i];
+			if (!entry.found)
+				return;
+
+			DWORD code = traits::decode(entry.type, entry.data, data.*field.member);
+			if (code == ERROR_UNSUPPORTED_TYPE)
+				throw reg::except::type_error(machine, key, field.name, reg::_type_name(traits::type), reg::_type_name(entry.type));
+			reg::assert::success(code);
+			++found;
+			}, std::make_index_sequence<count>());
+		return found;
+	}
+
+	/// <summary>Writes every field of a struct to the values of one key, creating the key
+	/// if it does not exist.<para/>
+	/// The key is opened once and its current values are fetched in a single call; only
+	/// the fields whose stored data or type differs are written.<para/>
+	/// Throws an exception if the key cannot be created or a value cannot be written</summary>
+	/// <param name='machine'>Root key in the hierarchy</param>
+	/// <param name='key'>Subkey holding the values</param>
+	/// <param name='data'>The struct to be written; see <see cref="reg::fields"/></param>
+	/// <returns>The number of values written</returns>
+	template<typename Struct>
+	size_t store(HKEY machine, std::string_view key, const Struct& data)
+	{
+		REG_OPERATION("store");
+		constexpr size_t count = reg::_field_count<Struct>;
+		constexpr auto names = reg::_field_names<Struct>(std::make_index_sequence<count>());
+
+		HKEY handle = nullptr;
+		DWORD code = reg::api::create_key(machine, key, KEY_QUERY_VALUE | KEY_SET_VALUE, &handle, NULL);
+		reg::assert::success(code);
+		auto closer = reg::self_closing_handle(&handle);
+
+		reg::_value_batch batch;
+		batch.read(handle, names.data(), count);
+
+		std::string bytes;
+		size_t written = 0;
+		reg::_for_each_field<Struct>([&](const auto& field, size_t i) {
+			using traits = reg::value_traits<typename std::decay_t<decltype(field)>::type>;
+			traits::encode(data.*field.member, bytes);
+
+			const auto& entry = batch[i];
+			if (entry.found && entry.type == traits::type && entry.data == bytes)
+				return;
+
+			code = reg::api::set_value(handle, field.name, traits::type,
+				reinterpret_cast<const BYTE*>(bytes.data()), static_cast<DWORD>(bytes.size()));
+			reg::assert::success(code);
+			++written;
+			}, std::make_index_sequence<count>());
+		return written;
+	}
+}
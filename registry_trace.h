@@ -0,0 +1,362 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "registry.h"
+#include "registry_name.h"
+
+#ifndef REG_INSTRUMENT
+#error "registry_trace.h records the calls seen by the instrumentation: define REG_INSTRUMENT for every translation unit"
+#endif
+
+namespace reg
+{
+	/// <summary>Records every call the library makes into the registry while it is started, to find
+	/// out afterwards what a slow sequence of calls did.<para/>
+	/// Each thread appends its calls to its own ring buffer, without locking; a background thread
+	/// moves them to a sink at a fixed interval. When a ring is full, new calls are dropped and
+	/// counted rather than waiting. While the tracer is stopped, a call costs one atomic load
+	/// on top of the instrumentation. Requires REG_INSTRUMENT.</summary>
+	/// <example><code>reg::trace::chrome_sink out("registry.json");	// open in chrome://tracing or Perfetto
+	/// reg::trace::start(out);
+	/// ...
+	/// reg::trace::stop();</code></example>
+	namespace trace
+	{
+		/// <summary>One call into the registry</summary>
+		struct event
+		{
+			/// <summary>Clock ticks when the call started and returned; see sink::ns_per_tick</summary>
+			std::uint64_t start;
+			std::uint64_t end;
+			/// <summary>The key handle the call was given, such as HKEY_LOCAL_MACHINE</summary>
+			std::uint64_t key;
+			/// <summary>reg::ihash of the path or value name the call was given, or 0 if none</summary>
+			std::uint64_t subject;
+			/// <summary>A small number for the thread that made the call</summary>
+			std::uint32_t thread;
+			/// <summary>The error code the call returned</summary>
+			std::int32_t result;
+			/// <summary>A reg::instrument::function</summary>
+			std::uint32_t api;
+			std::uint32_t reserved;
+		};
+		static_assert(sizeof(event) == 48, "events are written to files as they are");
+
+		/// <summary>Receives the recorded calls, from one thread at a time</summary>
+		class sink
+		{
+		public:
+			virtual ~sink() = default;
+			/// <summary>Takes a batch of calls, ordered by thread and then by time</summary>
+			virtual void write(const event* events, size_t count) = 0;
+			/// <summary>Called once the tracer has stopped</summary>
+			virtual void flush() {}
+
+			/// <summary>Nanoseconds per clock tick of the event times; set when tracing starts</summary>
+			double ns_per_tick = 1;
+			/// <summary>The clock reading when tracing started</summary>
+			std::uint64_t origin = 0;
+		};
+
+		/// <summary>Writes the events as they are after a 24-byte header: "RGT1", the size of an
+		/// event as a uint32, the nanoseconds per tick as a double and the origin as a uint64.</summary>
+		class binary_file_sink : public sink
+		{
+		public:
+			/// <summary>Creates or truncates the file. Throws an exception if it cannot be opened</summary>
+			explicit binary_file_sink(const std::string& filename)
+				: _out(filename, std::ios::binary | std::ios::trunc)
+			{
+				if (!_out)
+					throw std::runtime_error("Could not open trace file: " + filename);
+			}
+
+			void write(const event* events, size_t count) override
+			{
+				if (!_header)
+				{
+					const std::uint32_t size = sizeof(event);
+					_out.write("RGT1", 4);
+					_out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+					_out.write(reinterpret_cast<const char*>(&ns_per_tick), sizeof(ns_per_tick));
+					_out.write(reinterpret_cast<const char*>(&origin), sizeof(origin));
+					_header = true;
+				}
+				_out.write(reinterpret_cast<const char*>(events), static_cast<std::streamsize>(count * sizeof(event)));
+			}
+
+			void flush() override
+			{
+				if (!_header)
+					write(nullptr, 0);
+				_out.flush();
+			}
+
+		private:
+			std::ofstream _out;
+			bool _header = false;
+		};
+
+		/// <summary>Writes the events in the Chrome trace event format, which chrome://tracing and
+		/// Perfetto display as one timeline per thread. The file is complete once the sink is destroyed.</summary>
+		class chrome_sink : public sink
+		{
+		public:
+			/// <summary>Creates or truncates the file. Throws an exception if it cannot be opened</summary>
+			explicit chrome_sink(const std::string& filename)
+				: _out(filename, std::ios::trunc)
+			{
+				if (!_out)
+					throw std::runtime_error("Could not open trace file: " + filename);
+				_out << "{\"traceEvents\":[";
+			}
+
+			~chrome_sink() override
+			{
+				_out << "\n]}\n";
+			}
+
+			void write(const event* events, size_t count) override
+			{
+				char line[320];
+				for (size_t i = 0; i < count; ++i)
+				{
+					const event& e = events[i];
+					const std::string_view name = e.api < reg::instrument::function_names.size()
+						? reg::instrument::function_names[e.api] : std::string_view("unknown");
+					const double start = static_cast<double>(e.start - origin) * ns_per_tick / 1000;
+					const double duration = static_cast<double>(e.end - e.start) * ns_per_tick / 1000;
+					std::snprintf(line, sizeof(line),
+						"%s\n{\"name\":\"%.*s\",\"cat\":\"registry\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+						"\"args\":{\"key\":\"0x%llx\",\"subject\":\"0x%016llx\",\"result\":%d}}",
+						_first ? "" : ",", static_cast<int>(name.size()), name.data(), e.thread, start, duration,
+						static_cast<unsigned long long>(e.key), static_cast<unsigned long long>(e.subject), e.result);
+					_out << line;
+					_first = false;
+				}
+			}
+
+			void flush() override
+			{
+				_out.flush();
+			}
+
+		private:
+			std::ofstream _out;
+			bool _first = true;
+		};
+
+		/// <summary>The ring of one thread: written by that thread, read by the drain</summary>
+		struct _ring
+		{
+			explicit _ring(size_t capacity, std::uint32_t thread)
+				: slots(capacity), mask(capacity - 1), thread(thread)
+			{
+			}
+
+			std::vector<event> slots;
+			const size_t mask;
+			const std::uint32_t thread;
+			alignas(64) std::atomic<std::uint64_t> head{ 0 };
+			std::atomic<std::uint64_t> dropped{ 0 };
+			alignas(64) std::atomic<std::uint64_t> tail{ 0 };
+			/// <summary>The thread has ended; the ring goes once it is drained</summary>
+			std::atomic<bool> finished{ false };
+		};
+
+		struct _state
+		{
+			std::mutex mutex;
+			std::vector<std::shared_ptr<_ring>> rings;
+			std::uint32_t threads = 0;
+			/// <summary>Events in the ring of each thread, a power of two</summary>
+			size_t capacity = 8192;
+			std::uint64_t dropped = 0;
+
+			std::mutex drain_mutex;
+			sink* out = nullptr;
+			std::vector<event> batch;
+
+			std::thread drainer;
+			std::condition_variable wake;
+			bool stopping = false;
+		};
+
+		inline _state& _global()
+		{
+			static _state* state = new _state(); // never destroyed: threads may end after static destruction
+			return *state;
+		}
+
+		/// <summary>Gives each thread its ring on its first traced call</summary>
+		class _thread_ring
+		{
+		public:
+			_thread_ring()
+			{
+				_state& state = _global();
+				std::lock_guard<std::mutex> lock(state.mutex);
+				ring = std::make_shared<_ring>(state.capacity, ++state.threads);
+				state.rings.push_back(ring);
+			}
+			~_thread_ring()
+			{
+				ring->finished.store(true, std::memory_order_release);
+			}
+
+			std::shared_ptr<_ring> ring;
+		};
+
+		inline void _on_call(const reg::instrument::call& call)
+		{
+			thread_local _thread_ring local;
+			_ring& ring = *local.ring;
+
+			const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+			if (head - ring.tail.load(std::memory_order_acquire) > ring.mask)
+			{
+				ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+			event& e = ring.slots[head & ring.mask];
+			e.start = call.start;
+			e.end = call.end;
+			e.key = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(call.key));
+			e.subject = call.subject.empty() ? 0 : reg::ihash(call.subject);
+			e.thread = ring.thread;
+			e.result = static_cast<std::int32_t>(call.result);
+			e.api = static_cast<std::uint32_t>(call.api);
+			e.reserved = 0;
+			ring.head.store(head + 1, std::memory_order_release);
+		}
+
+		/// <summary>Moves the recorded calls of every thread to the sink</summary>
+		/// <returns>The number of calls moved</returns>
+		inline size_t drain()
+		{
+			_state& state = _global();
+			std::lock_guard<std::mutex> drain_lock(state.drain_mutex);
+
+			std::vector<std::shared_ptr<_ring>> rings;
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				rings = state.rings;
+			}
+
+			size_t moved = 0;
+			for (const auto& ring : rings)
+			{
+				// read finished before head, so that the last events of an ended thread are not missed
+				const bool finished = ring->finished.load(std::memory_order_acquire);
+				const std::uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+				const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+				if (head != tail && state.out != nullptr)
+				{
+					state.batch.clear();
+					for (std::uint64_t i = tail; i != head; ++i)
+						state.batch.push_back(ring->slots[i & ring->mask]);
+					state.out->write(state.batch.data(), state.batch.size());
+					moved += state.batch.size();
+				}
+				ring->tail.store(head, std::memory_order_release);
+
+				if (finished)
+				{
+					std::lock_guard<std::mutex> lock(state.mutex);
+					state.dropped += ring->dropped.load(std::memory_order_relaxed);
+					state.rings.erase(std::find(state.rings.begin(), state.rings.end(), ring));
+				}
+			}
+			return moved;
+		}
+
+		/// <summary>Whether calls are being recorded</summary>
+		inline bool enabled() noexcept
+		{
+			return reg::instrument::_tracer.load(std::memory_order_relaxed) != nullptr;
+		}
+
+		/// <summary>The number of calls dropped because the ring of their thread was full</summary>
+		inline std::uint64_t dropped()
+		{
+			_state& state = _global();
+			std::lock_guard<std::mutex> lock(state.mutex);
+			std::uint64_t total = state.dropped;
+			for (const auto& ring : state.rings)
+				total += ring->dropped.load(std::memory_order_relaxed);
+			return total;
+		}
+
+		/// <summary>Stops recording, moves the remaining calls to the sink and flushes it</summary>
+		inline void stop()
+		{
+			_state& state = _global();
+			reg::instrument::_tracer.store(nullptr, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.stopping = true;
+			}
+			state.wake.notify_one();
+			if (state.drainer.joinable())
+				state.drainer.join();
+
+			reg::trace::drain();
+			std::lock_guard<std::mutex> drain_lock(state.drain_mutex);
+			if (state.out != nullptr)
+				state.out->flush();
+			state.out = nullptr;
+		}
+
+		/// <summary>Starts recording every registry call into per-thread rings that a background
+		/// thread moves to the sink. Stops a trace that is running first.</summary>
+		/// <param name='out'>Receives the calls; it must live until stop returns</param>
+		/// <param name='interval'>How often the rings are moved to the sink</param>
+		/// <param name='capacity'>Calls each thread can hold between two moves; rounded up to a power of two.
+		/// Applies to the threads that make their first call after this one.</param>
+		inline void start(reg::trace::sink& out, std::chrono::milliseconds interval = std::chrono::milliseconds(100), size_t capacity = 8192)
+		{
+			reg::trace::stop();
+
+			_state& state = _global();
+			{
+				// whatever was recorded after the previous stop belongs to no trace
+				std::lock_guard<std::mutex> drain_lock(state.drain_mutex);
+				std::lock_guard<std::mutex> lock(state.mutex);
+				for (const auto& ring : state.rings)
+					ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+				size_t rounded = 1;
+				while (rounded < capacity)
+					rounded *= 2;
+				state.capacity = rounded;
+				state.stopping = false;
+
+				out.ns_per_tick = reg::instrument::_ns_per_tick();
+				out.origin = reg::instrument::_ticks();
+				state.out = &out;
+			}
+
+			state.drainer = std::thread([interval] {
+				_state& state = _global();
+				std::unique_lock<std::mutex> lock(state.mutex);
+				while (!state.wake.wait_for(lock, interval, [&state] { return state.stopping; }))
+				{
+					lock.unlock();
+					reg::trace::drain();
+					lock.lock();
+				}
+			});
+			reg::instrument::_tracer.store(&reg::trace::_on_call, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "registry_name.h"
+
+namespace reg
+{
+	/// <summary>Registry value types.<para/>
+	/// The constants match the REG_* macros from the Windows API, so that the parts of
+	/// the library that do not talk to the registry can be used without Windows.h</summary>
+	namespace types
+	{
+		constexpr std::uint32_t none = 0;
+		constexpr std::uint32_t sz = 1;
+		constexpr std::uint32_t expand_sz = 2;
+		constexpr std::uint32_t binary = 3;
+		constexpr std::uint32_t dword = 4;
+		constexpr std::uint32_t dword_big_endian = 5;
+		constexpr std::uint32_t link = 6;
+		constexpr std::uint32_t multi_sz = 7;
+		constexpr std::uint32_t resource_list = 8;
+		constexpr std::uint32_t full_resource_descriptor = 9;
+		constexpr std::uint32_t resource_requirements_list = 10;
+		constexpr std::uint32_t qword = 11;
+
+		/// <summary>Checks whether the data of a value of the given type is UTF-16 text</summary>
+		constexpr bool is_string(std::uint32_t type) noexcept
+		{
+			return type == sz || type == expand_sz || type == multi_sz || type == link;
+		}
+	}
+
+	/// <summary>Case-insensitive ordering for registry names.
+	/// Usable as a transparent comparator in ordered containers.</summary>
+	struct iless
+	{
+		using is_transparent = void;
+
+		bool operator()(std::string_view a, std::string_view b) const noexcept
+		{
+			return reg::icompare(a, b) < 0;
+		}
+	};
+
+	/// <summary>Splits off the first segment of a registry path.<para/>
+	/// Empty segments (leading, trailing or doubled backslashes) are skipped.</summary>
+	/// <param name='path'>The path to consume. On return it holds the remaining segments</param>
+	/// <returns>The first segment, or an empty string if there are no segments left</returns>
+	inline std::string_view next_segment(std::string_view& path) noexcept
+	{
+		while (!path.empty() && path.front() == '\\')
+			path.remove_prefix(1);
+
+		size_t separator = path.find('\\');
+		std::string_view segment = path.substr(0, separator);
+		path.remove_prefix(separator == std::string_view::npos ? path.size() : separator);
+		return segment;
+	}
+
+	/// <summary>The type and raw data of a registry value.<para/>
+	/// Data is kept exactly as the registry stores it; string types hold
+	/// little-endian UTF-16 including the null terminator.</summary>
+	struct value
+	{
+		std::uint32_t type = reg::types::none;
+		std::string data;
+
+		bool operator==(const value& other) const noexcept
+		{
+			return type == other.type && data == other.data;
+		}
+
+		bool operator!=(const value& other) const noexcept
+		{
+			return !(*this == other);
+		}
+	};
+
+	/// <summary>An in-memory registry key: a set of values and a set of subkeys,
+	/// both looked up case-insensitively and kept in registry order.</summary>
+	class tree
+	{
+	public:
+		using key_map = std::map<std::string, std::unique_ptr<tree>, reg::iless>;
+		using value_map = std::map<std::string, reg::value, reg::iless>;
+
+		tree() = default;
+		tree(tree&&) = default;
+		tree& operator=(tree&&) = default;
+
+		/// <summary>Finds the key at the given path, relative to this key</summary>
+		/// <returns>A pointer to the key, or nullptr if it does not exist</returns>
+		tree* find(std::string_view path) noexcept
+		{
+			tree* node = this;
+			for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+			{
+				auto it = node->_keys.find(segment);
+				if (it == node->_keys.end())
+					return nullptr;
+				node = it->second.get();
+			}
+			return node;
+		}
+
+		/// <summary>Finds the key at the given path, relative to this key</summary>
+		/// <returns>A pointer to the key, or nullptr if it does not exist</returns>
+		const tree* find(std::string_view path) const noexcept
+		{
+			return const_cast<tree*>(this)->find(path);
+		}
+
+		/// <summary>Creates the key at the given path, relative to this key,
+		/// along with any missing parents. If the key already exists, it is returned.</summary>
+		tree& create(std::string_view path)
+		{
+			tree* node = this;
+			for (std::string_view segment = reg::next_segment(path); !segment.empty(); segment = reg::next_segment(path))
+			{
+				auto it = node->_keys.find(segment);
+				if (it == node->_keys.end())
+					it = node->_keys.emplace(std::string(segment), std::make_unique<tree>()).first;
+				node = it->second.get();
+			}
+			return *node;
+		}
+
+		/// <summary>Removes the key at the given path recursively</summary>
+		/// <returns>True, if the key was removed. False if it does not exist</returns>
+		bool remove(std::string_view path)
+		{
+			size_t separator = path.find_last_not_of('\\');
+			path = path.substr(0, separator == std::string_view::npos ? 0 : separator + 1);
+
+			separator = path.rfind('\\');
+			std::string_view parent = separator == std::string_view::npos ? std::string_view() : path.substr(0, separator);
+			std::string_view name = separator == std::string_view::npos ? path : path.substr(separator + 1);
+
+			tree* node = find(parent);
+			if (node == nullptr || name.empty())
+				return false;
+
+			auto it = node->_keys.find(name);
+			if (it == node->_keys.end())
+				return false;
+
+			node->_keys.erase(it);
+			return true;
+		}
+
+		/// <summary>Creates or overwrites a value of this key</summary>
+		/// <param name='name'>Name of the value (empty for the default value)</param>
+		/// <param name='type'>One of the registry value types</param>
+		/// <param name='data'>Raw data of the value</param>
+		void set(std::string_view name, std::uint32_t type, std::string_view data)
+		{
+			auto it = _values.find(name);
+			if (it == _values.end())
+				it = _values.emplace(std::string(name), reg::value()).first;
+
+			it->second.type = type;
+			it->second.data.assign(data.data(), data.size());
+		}
+
+		/// <summary>Removes a value of this key</summary>
+		/// <returns>True, if the value was removed. False if it does not exist</returns>
+		bool unset(std::string_view name)
+		{
+			auto it = _values.find(name);
+			if (it == _values.end())
+				return false;
+
+			_values.erase(it);
+			return true;
+		}
+
+		/// <summary>Retrieves a value of this key</summary>
+		/// <returns>A pointer to the value, or nullptr if it does not exist</returns>
+		const reg::value* get(std::string_view name) const noexcept
+		{
+			auto it = _values.find(name);
+			return it == _values.end() ? nullptr : &it->second;
+		}
+
+		/// <summary>The direct subkeys of this key, ordered by name</summary>
+		const key_map& keys() const noexcept { return _keys; }
+
+		/// <summary>The values of this key, ordered by name</summary>
+		const value_map& values() const noexcept { return _values; }
+
+		/// <summary>Removes all subkeys and values</summary>
+		void clear() noexcept
+		{
+			_keys.clear();
+			_values.clear();
+		}
+
+	private:
+		key_map _keys;
+		value_map _values;
+	};
+}
@@ -0,0 +1,310 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REG_UTF_SSE2
+#endif
+
+namespace reg
+{
+	namespace utf
+	{
+		/// <summary>The replacement character emitted for malformed input</summary>
+		constexpr char16_t replacement = 0xFFFD;
+
+		/// <summary>Converts UTF-8 text to UTF-16.<para/>
+		/// The output buffer must be able to hold at least utf8.size() code units,
+		/// which is the worst case for the conversion.<para/>
+		/// Malformed sequences are replaced by U+FFFD.</summary>
+		/// <param name='utf8'>Text to be converted</param>
+		/// <param name='out'>Buffer that receives the UTF-16 code units</param>
+		/// <returns>The number of code units written to the output buffer</returns>
+		inline size_t to_utf16(std::string_view utf8, char16_t* out) noexcept
+		{
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(utf8.data());
+			const unsigned char* const end = p + utf8.size();
+			char16_t* const begin = out;
+
+			while (p != end)
+			{
+#if defined(REG_UTF_SSE2)
+				// widen runs of ASCII sixteen bytes at a time
+				while (end - p >= 16)
+				{
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+					if (_mm_movemask_epi8(block) != 0)
+						break;
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(block, _mm_setzero_si128()));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(block, _mm_setzero_si128()));
+					p += 16;
+					out += 16;
+				}
+				if (p == end)
+					break;
+#endif
+				unsigned char c = *p;
+				if (c < 0x80)
+				{
+					*out++ = c;
+					++p;
+					continue;
+				}
+
+				size_t length = 0;
+				std::uint32_t code = 0;
+				std::uint32_t minimum = 0;
+				if ((c & 0xE0) == 0xC0) { length = 2; code = c & 0x1F; minimum = 0x80; }
+				else if ((c & 0xF0) == 0xE0) { length = 3; code = c & 0x0F; minimum = 0x800; }
+				else if ((c & 0xF8) == 0xF0) { length = 4; code = c & 0x07; minimum = 0x10000; }
+
+				if (length == 0 || static_cast<size_t>(end - p) < length)
+				{
+					*out++ = replacement;
+					++p;
+					continue;
+				}
+
+				size_t i = 1;
+				for (; i < length && (p[i] & 0xC0) == 0x80; i++)
+					code = (code << 6) | (p[i] & 0x3F);
+
+				if (i != length || code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+				{
+					*out++ = replacement;
+					p += i;
+					continue;
+				}
+
+				if (code >= 0x10000)
+				{
+					code -= 0x10000;
+					*out++ = static_cast<char16_t>(0xD800 + (code >> 10));
+					*out++ = static_cast<char16_t>(0xDC00 + (code & 0x3FF));
+				}
+				else
+					*out++ = static_cast<char16_t>(code);
+
+				p += length;
+			}
+
+			return static_cast<size_t>(out - begin);
+		}
+
+		/// <summary>Converts UTF-8 text to UTF-16</summary>
+		/// <param name='utf8'>Text to be converted</param>
+		/// <returns>A string containing the UTF-16 code units</returns>
+		inline std::u16string to_utf16(std::string_view utf8)
+		{
+			std::u16string result(utf8.size(), u'\0');
+			result.resize(to_utf16(utf8, result.data()));
+			return result;
+		}
+
+		/// <summary>Converts UTF-16 text to UTF-8.<para/>
+		/// The output buffer must be able to hold at least 3 * count bytes,
+		/// which is the worst case for the conversion.<para/>
+		/// The conversion may be done in place: the output may overlap the input as long
+		/// as the input starts at least count bytes after the start of the output.<para/>
+		/// Unpaired surrogates are replaced by U+FFFD.</summary>
+		/// <param name='utf16'>Pointer to the UTF-16 code units</param>
+		/// <param name='count'>Number of code units to be converted</param>
+		/// <param name='out'>Buffer that receives the UTF-8 bytes</param>
+		/// <returns>The number of bytes written to the output buffer</returns>
+		inline size_t to_utf8(const char16_t* utf16, size_t count, char* out) noexcept
+		{
+			const char16_t* const end = utf16 + count;
+			char* const begin = out;
+			while (utf16 != end)
+			{
+#if defined(REG_UTF_SSE2)
+				// narrow runs of ASCII eight code units at a time
+				while (end - utf16 >= 8)
+				{
+					const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf16));
+					const __m128i wide = _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xFF80)));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi16(wide, _mm_setzero_si128())) != 0xFFFF)
+						break;
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(block, block));
+					utf16 += 8;
+					out += 8;
+				}
+				if (utf16 == end)
+					break;
+#endif
+				std::uint32_t code = *utf16++;
+				if (code >= 0xD800 && code <= 0xDBFF && utf16 != end && *utf16 >= 0xDC00 && *utf16 <= 0xDFFF)
+					code = 0x10000 + ((code - 0xD800) << 10) + (*utf16++ - 0xDC00);
+				else if (code >= 0xD800 && code <= 0xDFFF)
+					code = replacement;
+
+				if (code < 0x80)
+					*out++ = static_cast<char>(code);
+				else if (code < 0x800)
+				{
+					*out++ = static_cast<char>(0xC0 | (code >> 6));
+					*out++ = static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000)
+				{
+					*out++ = static_cast<char>(0xE0 | (code >> 12));
+					*out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					*out++ = static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					*out++ = static_cast<char>(0xF0 | (code >> 18));
+					*out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+					*out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					*out++ = static_cast<char>(0x80 | (code & 0x3F));
+				}
+			}
+
+			return static_cast<size_t>(out - begin);
+		}
+
+		/// <summary>Converts UTF-16 text to UTF-8 and appends it to the given string.<para/>
+		/// Unpaired surrogates are replaced by U+FFFD.</summary>
+		/// <param name='utf16'>Pointer to the UTF-16 code units</param>
+		/// <param name='count'>Number of code units to be converted</param>
+		/// <param name='out'>String that receives the converted text; any std::basic_string of char,
+		/// so std::pmr::string appends through its own memory resource</param>
+		template<typename String>
+		void append_utf8(const char16_t* utf16, size_t count, String& out)
+		{
+			const size_t offset = out.size();
+			out.resize(offset + 3 * count);
+			out.resize(offset + to_utf8(utf16, count, &out[offset]));
+		}
+
+		/// <summary>Returns the number of bytes the UTF-8 form of UTF-16 text takes</summary>
+		/// <param name='utf16'>Pointer to the UTF-16 code units</param>
+		/// <param name='count'>Number of code units</param>
+		inline size_t utf8_size(const char16_t* utf16, size_t count) noexcept
+		{
+			size_t size = 0;
+			const char16_t* const end = utf16 + count;
+			while (utf16 != end)
+			{
+				const char16_t code = *utf16++;
+				if (code >= 0xD800 && code <= 0xDBFF && utf16 != end && *utf16 >= 0xDC00 && *utf16 <= 0xDFFF)
+				{
+					++utf16;
+					size += 4;
+				}
+				else
+					size += code < 0x80 ? 1 : code < 0x800 ? 2 : 3;
+			}
+			return size;
+		}
+
+		/// <summary>A buffer that lives on the stack while it is small enough and moves
+		/// to the heap when it has to hold more than N elements.<para/>
+		/// Used to convert names for the wide registry functions without allocating.
+		/// The heap storage comes from a memory resource, the global heap by default.</summary>
+		template<typename T, size_t N = 256>
+		class small_buffer
+		{
+			static_assert(std::is_trivial_v<T>, "small_buffer holds raw code units and bytes only");
+
+		public:
+			small_buffer() = default;
+			/// <param name='resource'>Where the buffer goes when it outgrows the stack</param>
+			explicit small_buffer(std::pmr::memory_resource* resource) noexcept : _resource(resource) {}
+			small_buffer(const small_buffer&) = delete;
+			small_buffer& operator=(const small_buffer&) = delete;
+			~small_buffer() { _release(); }
+
+			/// <summary>Makes room for at least the given number of elements.
+			/// The contents are not kept when the buffer grows.</summary>
+			T* reserve(size_t count)
+			{
+				if (count > _capacity)
+				{
+					T* heap = static_cast<T*>(_resource->allocate(count * sizeof(T), alignof(T)));
+					_release();
+					_data = heap;
+					_capacity = count;
+				}
+				return _data;
+			}
+
+			T* data() noexcept { return _data; }
+			const T* data() const noexcept { return _data; }
+			size_t capacity() const noexcept { return _capacity; }
+
+		private:
+			void _release() noexcept
+			{
+				if (_data != _inline)
+					_resource->deallocate(_data, _capacity * sizeof(T), alignof(T));
+			}
+
+			T _inline[N];
+			std::pmr::memory_resource* _resource = std::pmr::new_delete_resource();
+			T* _data = _inline;
+			size_t _capacity = N;
+		};
+
+		/// <summary>Converts UTF-8 text to null terminated UTF-16 in a small buffer.
+		/// Text shorter than N bytes does not allocate.</summary>
+		/// <returns>The number of code units, without the terminator</returns>
+		template<size_t N>
+		size_t to_utf16(std::string_view utf8, small_buffer<char16_t, N>& out)
+		{
+			char16_t* units = out.reserve(utf8.size() + 1);
+			const size_t count = to_utf16(utf8, units);
+			units[count] = u'\0';
+			return count;
+		}
+
+		/// <summary>Converts UTF-16 text to UTF-8</summary>
+		/// <param name='utf16'>Text to be converted</param>
+		/// <returns>A string containing the UTF-8 text</returns>
+		inline std::string to_utf8(std::u16string_view utf16)
+		{
+			std::string result;
+			result.reserve(utf16.size());
+			append_utf8(utf16.data(), utf16.size(), result);
+			return result;
+		}
+
+		/// <summary>Converts UTF-8 text to the little-endian UTF-16 byte representation
+		/// the registry uses for string data and appends it to the given buffer.</summary>
+		/// <param name='utf8'>Text to be converted</param>
+		/// <param name='out'>Buffer that receives the bytes</param>
+		/// <param name='terminate'>Whether to append a null terminator</param>
+		inline void append_utf16le(std::string_view utf8, std::string& out, bool terminate = true)
+		{
+			small_buffer<char16_t> units;
+			const size_t count = to_utf16(utf8, units) + (terminate ? 1 : 0);
+
+			const size_t offset = out.size();
+			out.resize(offset + count * sizeof(char16_t));
+			std::memcpy(&out[offset], units.data(), count * sizeof(char16_t));
+		}
+
+		/// <summary>Converts little-endian UTF-16 bytes, as stored in string registry values,
+		/// to UTF-8 text. A trailing null terminator, if present, is dropped.</summary>
+		/// <param name='bytes'>The raw registry data</param>
+		/// <returns>A string containing the UTF-8 text</returns>
+		inline std::string from_utf16le(std::string_view bytes)
+		{
+			size_t count = bytes.size() / 2;
+			std::u16string units(count, u'\0');
+			if (count)
+				std::char_traits<char>::copy(reinterpret_cast<char*>(units.data()), bytes.data(), count * 2);
+
+			while (!units.empty() && units.back() == u'\0')
+				units.pop_back();
+
+			return to_utf8(units);
+		}
+	}
+}